@@ -149,6 +149,10 @@ void ensure_priority_queue_has_allocated_members(struct aws_priority_queue *cons
     ensure_array_list_has_allocated_data_member(&queue->container);
     ensure_array_list_has_allocated_data_member(&queue->backpointers);
     queue->pred = nondet_compare;
+    /* proofs cover binary heaps compared by callback */
+    queue->arity_shift = 1;
+    queue->key_size = 0;
+    queue->item_size = queue->container.item_size;
 }
 
 void ensure_allocated_hash_table(struct aws_hash_table *map, size_t max_table_entries) {
@@ -160,6 +164,8 @@ void ensure_allocated_hash_table(struct aws_hash_table *map, size_t max_table_en
     __CPROVER_assume(!hash_table_state_required_bytes(num_entries, &required_bytes));
     struct hash_table_state *impl = bounded_malloc(required_bytes);
     impl->size = num_entries;
+    /* proofs cover tables which aren't in the middle of an incremental resize */
+    impl->old_state = NULL;
     map->p_impl = impl;
 }
 
@@ -24,6 +24,11 @@ else()
     if (HAVE_M_AVX2_FLAG)
         set(AVX2_CFLAGS "-mavx -mavx2")
     endif()
+
+    check_c_compiler_flag(-msse4.2 HAVE_M_SSE42_FLAG)
+    if (HAVE_M_SSE42_FLAG)
+        set(SSE42_CFLAGS "-msse4.2")
+    endif()
 endif()
 
 
@@ -83,6 +88,15 @@ int main() {
     return 0;
 }" HAVE_MSVC_CPUIDEX)
 
+set(CMAKE_REQUIRED_FLAGS "${old_flags} ${SSE42_CFLAGS}")
+
+check_c_source_compiles("
+#include <nmmintrin.h>
+
+int main() {
+    return (int)_mm_crc32_u64(0, 1);
+}" HAVE_SSE42_INTRINSICS)
+
 set(CMAKE_REQUIRED_FLAGS "${old_flags}")
 
 macro(simd_add_definition_if target definition)
@@ -99,6 +113,7 @@ function(simd_add_definitions target)
     simd_add_definition_if(${target} HAVE_BUILTIN_CPU_SUPPORTS)
     simd_add_definition_if(${target} HAVE_MSVC_CPUIDEX)
     simd_add_definition_if(${target} HAVE_MM256_EXTRACT_EPI64)
+    simd_add_definition_if(${target} HAVE_SSE42_INTRINSICS)
 endfunction(simd_add_definitions)
 
 # Adds source files only if AVX2 is supported. These files will be built with
@@ -110,3 +125,13 @@ function(simd_add_source_avx2 target)
         set_source_files_properties(${file} PROPERTIES COMPILE_FLAGS "${AVX2_CFLAGS}")
     endforeach()
 endfunction(simd_add_source_avx2)
+
+# Adds source files only if SSE4.2 is supported. These files will be built with
+# sse4.2 intrinsics enabled.
+# Usage: simd_add_source_sse42(target file1.c file2.c ...)
+function(simd_add_source_sse42 target)
+    foreach(file ${ARGN})
+        target_sources(${target} PRIVATE ${file})
+        set_source_files_properties(${file} PROPERTIES COMPILE_FLAGS "${SSE42_CFLAGS}")
+    endforeach()
+endfunction(simd_add_source_sse42)
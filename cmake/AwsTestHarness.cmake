@@ -15,6 +15,7 @@ include(AwsCFlags)
 include(AwsSanitizers)
 
 option(ENABLE_NET_TESTS "Run tests requiring an internet connection." ON)
+option(ENABLE_BENCHMARK_TESTS "Run benchmark tests, which print timings rather than check results." OFF)
 
 # Registers a test case by name (the first argument to the AWS_TEST_CASE macro in aws_test_harness.h)
 macro(add_test_case name)
@@ -28,6 +29,13 @@ macro(add_net_test_case name)
     endif()
 endmacro()
 
+# Like add_test_case, but for benchmarks, which are only worth running when their timings are wanted.
+macro(add_benchmark_test_case name)
+    if (ENABLE_BENCHMARK_TESTS)
+        list(APPEND TEST_CASES "${name}")
+    endif()
+endmacro()
+
 # Generate a test driver executable with the given name
 function(generate_test_driver driver_exe_name)
     create_test_sourcelist(test_srclist test_runner.c ${TEST_CASES})
@@ -21,6 +21,18 @@
 
 AWS_EXTERN_C_BEGIN
 
+/* Memory usage reported by aws_allocator_get_stats() */
+struct aws_allocator_stats {
+    /* bytes in allocations which have not been released yet */
+    size_t bytes_in_use;
+    /* bytes the allocator is holding, in use or not, including its own bookkeeping where it can tell */
+    size_t bytes_reserved;
+    /* highest bytes_in_use has been */
+    size_t bytes_in_use_peak;
+    size_t acquire_count;
+    size_t release_count;
+};
+
 /* Allocator structure. An instance of this will be passed around for anything needing memory allocation */
 struct aws_allocator {
     void *(*mem_acquire)(struct aws_allocator *allocator, size_t size);
@@ -30,6 +42,17 @@ struct aws_allocator {
     /* Optional method; if not supported, this pointer must be NULL */
     void *(*mem_calloc)(struct aws_allocator *allocator, size_t num, size_t size);
     void *impl;
+    /* Optional method; if not supported, this pointer must be NULL. size is the size the memory was last acquired
+     * or reallocated with (num * size for calloc), so allocators providing this should also provide mem_realloc.
+     * Declared after impl so existing positional initializers remain valid. */
+    void (*mem_release_sized)(struct aws_allocator *allocator, void *ptr, size_t size);
+    /* Optional method; if not supported, this pointer must be NULL. Acquires up to count allocations of size bytes
+     * into ptrs and returns how many it acquired; aws_mem_acquire_batch() acquires the rest one at a time. */
+    size_t (*mem_acquire_batch)(struct aws_allocator *allocator, size_t size, size_t count, void **ptrs);
+    /* Optional method; if not supported, this pointer must be NULL. Releases count allocations of size bytes. */
+    void (*mem_release_batch)(struct aws_allocator *allocator, void **ptrs, size_t count, size_t size);
+    /* Optional method; if not supported, this pointer must be NULL. Fills in stats, see aws_allocator_get_stats(). */
+    void (*mem_stats)(struct aws_allocator *allocator, struct aws_allocator_stats *stats);
 };
 
 /**
@@ -38,9 +61,21 @@ struct aws_allocator {
 AWS_COMMON_API
 bool aws_allocator_is_valid(const struct aws_allocator *alloc);
 
+/**
+ * Returns the default allocator, which uses malloc/free. It keeps no statistics, so as not to slow down every
+ * allocation; wrap it with aws_mem_tracer_new() at AWS_MEMTRACE_BYTES to have aws_allocator_get_stats() report on it.
+ */
 AWS_COMMON_API
 struct aws_allocator *aws_default_allocator(void);
 
+/**
+ * Reports how much memory allocator holds. Counters are updated without synchronizing with each other, so while
+ * other threads are using the allocator the values can be slightly inconsistent with one another.
+ * Raises AWS_ERROR_UNSUPPORTED_OPERATION if the allocator doesn't keep statistics.
+ */
+AWS_COMMON_API
+int aws_allocator_get_stats(struct aws_allocator *allocator, struct aws_allocator_stats *stats);
+
 #ifdef __MACH__
 /* Avoid pulling in CoreFoundation headers in a header file. */
 struct __CFAllocator;
@@ -92,6 +127,45 @@ void *aws_mem_acquire_many(struct aws_allocator *allocator, size_t count, ...);
 AWS_COMMON_API
 void aws_mem_release(struct aws_allocator *allocator, void *ptr);
 
+/**
+ * Releases ptr back to whatever allocated it, like aws_mem_release(). size must be the size the memory was
+ * acquired with (num * size for aws_mem_calloc()), or the new size passed to the last aws_mem_realloc(). Allocators
+ * which can make use of the size (e.g. to avoid looking up or storing per-block metadata) implement
+ * mem_release_sized, for everyone else this is equivalent to aws_mem_release().
+ */
+AWS_COMMON_API
+void aws_mem_release_sized(struct aws_allocator *allocator, void *ptr, size_t size);
+
+/**
+ * Acquires count allocations of size bytes each, storing them in out_ptrs. Allocators which can hand out many
+ * objects at once (e.g. taking one lock per batch instead of one per object) implement mem_acquire_batch, everyone
+ * else gets one mem_acquire per object. Either all count allocations succeed, or none are left acquired and
+ * AWS_OP_ERR is returned.
+ */
+AWS_COMMON_API
+int aws_mem_acquire_batch(struct aws_allocator *allocator, size_t size, size_t count, void **out_ptrs);
+
+/**
+ * Releases count allocations made with the same size, e.g. by aws_mem_acquire_batch(). NULL entries are ignored.
+ */
+AWS_COMMON_API
+void aws_mem_release_batch(struct aws_allocator *allocator, void **ptrs, size_t count, size_t size);
+
+/**
+ * Acquires count allocations of size bytes each, returned as an intrusive free list: the first sizeof(void *) bytes
+ * of each allocation point to the next one, and the last one points to NULL. size must be at least sizeof(void *).
+ * This suits pools that keep their spare objects in a free list anyway. Returns the head of the list, or NULL if
+ * not all count allocations could be made.
+ */
+AWS_COMMON_API
+void *aws_mem_acquire_batch_list(struct aws_allocator *allocator, size_t size, size_t count);
+
+/**
+ * Releases every allocation in a free list built as described for aws_mem_acquire_batch_list().
+ */
+AWS_COMMON_API
+void aws_mem_release_batch_list(struct aws_allocator *allocator, void *list, size_t size);
+
 /*
  * Attempts to adjust the size of the pointed-to memory buffer from oldsize to
  * newsize. The pointer (*ptr) may be changed if the memory needs to be
@@ -110,6 +184,225 @@ int aws_mem_realloc(struct aws_allocator *allocator, void **ptr, size_t oldsize,
  * that we can leave unchanged on failure.
  */
 
+/*
+ * Small Block Allocator: a size-class pool allocator which carves small (<= 512 bytes) allocations out of
+ * page-aligned slabs acquired from the parent allocator, so that each acquire/release is O(1) and does not
+ * touch the parent. Larger allocations are passed through to the parent.
+ *
+ * Any memory still outstanding from the small block allocator is returned to the parent when it is destroyed.
+ * If multi_threaded is true, each size class is protected by its own mutex, otherwise the allocator must only
+ * be used from one thread at a time.
+ * aws_allocator_get_stats() reports on the size classes only; allocations passed through show up in the parent's.
+ */
+AWS_COMMON_API
+struct aws_allocator *aws_small_block_allocator_new(struct aws_allocator *allocator, bool multi_threaded);
+
+/*
+ * Destroys a Small Block Allocator instance and frees its memory to the parent allocator. The parent
+ * allocator will otherwise be unaffected.
+ */
+AWS_COMMON_API
+void aws_small_block_allocator_destroy(struct aws_allocator *sba_allocator);
+
+/*
+ * Thread Cache Allocator: a front-end for allocator which keeps a free list per size class (<= 1024 bytes) in each
+ * thread, so that most acquires and releases take no locks and touch no memory shared with other threads. Blocks
+ * move between the thread caches and central lists in batches, and a thread's cache is drained when it exits.
+ * Larger allocations are passed through to allocator.
+ *
+ * Only threads started with aws_thread_launch() get a cache, since that is the only way to learn when they exit;
+ * other threads share the central lists. Memory may be released from any thread.
+ */
+AWS_COMMON_API
+struct aws_allocator *aws_thread_cache_allocator_new(struct aws_allocator *allocator);
+
+/*
+ * Destroys a Thread Cache Allocator and frees all of its memory, including any allocations still outstanding, to
+ * the backing allocator. Every aws_thread which used the allocator must have been joined first.
+ */
+AWS_COMMON_API
+void aws_thread_cache_allocator_destroy(struct aws_allocator *tc_allocator);
+
+/*
+ * Arena Allocator: allocations are bumped out of optional caller supplied initial storage (e.g. a buffer on the
+ * stack), then out of a chain of chunks acquired from the parent allocator. Releasing memory to the arena does
+ * nothing (except for the most recent allocation), instead everything is reclaimed at once by
+ * aws_arena_allocator_reset(), which keeps the chunks around for re-use. Realloc of the most recent allocation
+ * extends it in place when there is room.
+ *
+ * Pass &arena.allocator to anything expecting an aws_allocator. Arenas are not thread safe.
+ */
+struct aws_arena_chunk;
+
+struct aws_arena_allocator {
+    struct aws_allocator allocator;
+    struct aws_allocator *parent;
+    size_t chunk_size;
+    uint8_t *initial_storage;
+    size_t initial_storage_size;
+    struct aws_arena_chunk *chunks;
+    struct aws_arena_chunk *current_chunk;
+    uint8_t *cursor;
+    uint8_t *end;
+    uint8_t *last_alloc;
+    struct aws_allocator_stats stats;
+};
+
+#define AWS_ARENA_DEFAULT_CHUNK_SIZE 4096
+
+/*
+ * Initializes an arena. initial_storage may be NULL, otherwise it must outlive the arena. If chunk_size is 0,
+ * AWS_ARENA_DEFAULT_CHUNK_SIZE is used. Allocations larger than chunk_size get a chunk of their own.
+ */
+AWS_COMMON_API
+int aws_arena_allocator_init(
+    struct aws_arena_allocator *arena,
+    struct aws_allocator *parent,
+    void *initial_storage,
+    size_t initial_storage_size,
+    size_t chunk_size);
+
+/*
+ * Reclaims every allocation made from the arena in O(1). Chunks acquired from the parent are kept for re-use.
+ */
+AWS_COMMON_API
+void aws_arena_allocator_reset(struct aws_arena_allocator *arena);
+
+/*
+ * Returns all chunks to the parent allocator. Any memory allocated from the arena is invalid afterwards.
+ */
+AWS_COMMON_API
+void aws_arena_allocator_clean_up(struct aws_arena_allocator *arena);
+
+enum aws_mmap_huge_pages {
+    AWS_MMAP_HUGE_PAGES_NONE = 0,
+    /* ask the kernel to back mappings with transparent huge pages where it can (madvise(MADV_HUGEPAGE)) */
+    AWS_MMAP_HUGE_PAGES_TRANSPARENT,
+    /* map from the reserved huge page pool (MAP_HUGETLB), falling back to transparent huge pages if it's empty */
+    AWS_MMAP_HUGE_PAGES_EXPLICIT,
+};
+
+struct aws_mmap_allocator_options {
+    /* allocations smaller than this go to the parent allocator, 0 means AWS_MMAP_ALLOCATOR_DEFAULT_MIN_SIZE */
+    size_t min_mmap_size;
+    enum aws_mmap_huge_pages huge_pages;
+    /* pre-fault mappings (MAP_POPULATE) so that first touch doesn't take a page fault per page */
+    bool populate;
+};
+
+#define AWS_MMAP_ALLOCATOR_DEFAULT_MIN_SIZE (256 * 1024)
+
+/*
+ * mmap Allocator: serves large allocations with anonymous memory mappings straight from the OS, optionally
+ * backed by huge pages and pre-faulted. Where the platform supports it (Linux mremap), realloc resizes the mapping
+ * without copying, so growing a multi-megabyte buffer is cheap. Each mapping is a whole number of pages (or huge
+ * pages) and the allocation starts on its first page. Smaller allocations are passed through to the parent
+ * allocator. Huge pages and pre-faulting are ignored on platforms which don't support them.
+ * options may be NULL for defaults.
+ */
+AWS_COMMON_API
+struct aws_allocator *aws_mmap_allocator_new(
+    struct aws_allocator *allocator,
+    const struct aws_mmap_allocator_options *options);
+
+/*
+ * Destroys an mmap allocator. All memory acquired from it must have been released first.
+ */
+AWS_COMMON_API
+void aws_mmap_allocator_destroy(struct aws_allocator *mmap_allocator);
+
+/* pass as cpu_group to aws_numa_allocator_new() to bind each allocation to the node of the calling thread */
+#define AWS_NUMA_CPU_GROUP_CURRENT (-1)
+
+/*
+ * NUMA Allocator: maps every allocation straight from the OS and binds its pages to the memory node of cpu_group
+ * (see aws_get_cpu_group_count() in system_info.h), or, with AWS_NUMA_CPU_GROUP_CURRENT, to the node the calling
+ * thread is running on at the time of the allocation. Binding is a preference: if the node is out of memory, or the
+ * platform has no NUMA support, pages come from wherever the OS finds them.
+ * Every allocation costs at least one page, so put a small block allocator on top of this one for small objects.
+ * Returns NULL with AWS_ERROR_INVALID_ARGUMENT if cpu_group is not a valid group index.
+ */
+AWS_COMMON_API
+struct aws_allocator *aws_numa_allocator_new(struct aws_allocator *allocator, int32_t cpu_group);
+
+/*
+ * Destroys a NUMA allocator. All memory acquired from it must have been released first.
+ */
+AWS_COMMON_API
+void aws_numa_allocator_destroy(struct aws_allocator *numa_allocator);
+
+enum aws_mem_trace_level {
+    AWS_MEMTRACE_NONE = 0,           /* no tracing, allocations are passed straight through */
+    AWS_MEMTRACE_BYTES = 1,          /* track live/peak bytes and allocation counts */
+    AWS_MEMTRACE_SAMPLED_STACKS = 2, /* as AWS_MEMTRACE_BYTES, plus capture call stacks for 1 in sample_rate allocs */
+    AWS_MEMTRACE_STACKS = 3,         /* as AWS_MEMTRACE_BYTES, plus capture call stacks for every allocation */
+};
+
+#define AWS_MEM_TRACE_MAX_FRAMES 32
+
+struct aws_mem_trace_stats {
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t live_allocs;
+    size_t total_allocs;
+    size_t total_releases;
+};
+
+/* Statistics for all traced allocations made from one call stack */
+struct aws_mem_trace_stack_stats {
+    size_t live_bytes;
+    size_t live_allocs;
+    size_t total_allocs;
+    size_t depth;
+    void *frames[AWS_MEM_TRACE_MAX_FRAMES];
+};
+
+/*
+ * Wraps an allocator and tracks the memory acquired through it. The overhead scales with level: AWS_MEMTRACE_BYTES
+ * only updates a few atomic counters per call, while the stack levels capture a backtrace (see aws_backtrace()) and
+ * update per-call-stack statistics under a lock. With AWS_MEMTRACE_SAMPLED_STACKS, only 1 in sample_rate
+ * allocations pays for a backtrace, so the per-stack statistics are a sample of the whole.
+ *
+ * frames_per_stack is the number of stack frames to keep per allocation, 0 means AWS_MEM_TRACE_MAX_FRAMES.
+ */
+AWS_COMMON_API
+struct aws_allocator *aws_mem_tracer_new(
+    struct aws_allocator *allocator,
+    enum aws_mem_trace_level level,
+    size_t sample_rate,
+    size_t frames_per_stack);
+
+/*
+ * Unwraps the traced allocator and cleans up the tracer.
+ * All memory acquired through the tracer must have been released first.
+ * Returns the original allocator.
+ */
+AWS_COMMON_API
+struct aws_allocator *aws_mem_tracer_destroy(struct aws_allocator *trace_allocator);
+
+/*
+ * Fills out stats with the current totals for the tracer. aws_allocator_get_stats() reports the same totals in the
+ * form shared by all allocators.
+ */
+AWS_COMMON_API
+void aws_mem_tracer_get_stats(struct aws_allocator *trace_allocator, struct aws_mem_trace_stats *stats);
+
+/*
+ * Copies out the statistics for the (up to) max_stacks call stacks with the most live bytes, largest first.
+ * Returns the number of entries written, which is 0 unless stacks are being captured.
+ */
+AWS_COMMON_API
+size_t aws_mem_tracer_top_stacks(
+    struct aws_allocator *trace_allocator,
+    struct aws_mem_trace_stack_stats *stacks,
+    size_t max_stacks);
+
+/*
+ * Logs the totals and the call stacks with the most live bytes to AWS_LS_COMMON_MEMTRACE at AWS_LL_TRACE.
+ */
+AWS_COMMON_API
+void aws_mem_tracer_dump(struct aws_allocator *trace_allocator);
+
 AWS_EXTERN_C_END
 
 #endif /* AWS_COMMON_ALLOCATOR_H */
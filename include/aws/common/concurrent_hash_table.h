@@ -0,0 +1,138 @@
+#ifndef AWS_COMMON_CONCURRENT_HASH_TABLE_H
+#define AWS_COMMON_CONCURRENT_HASH_TABLE_H
+
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/hash_table.h>
+
+struct aws_concurrent_hash_table_shard;
+
+/**
+ * A hash table which may be used from any number of threads at once, with the same callbacks as aws_hash_table.
+ *
+ * Keys are spread over a power of 2 number of shards by hash. Each shard is a pair of aws_hash_tables holding the
+ * same elements ("left-right" concurrency control): readers never take a lock, they register with the shard using an
+ * atomic counter and look in whichever copy is currently published. A writer takes the shard's mutex, applies its
+ * change to the unpublished copy, publishes it, waits for readers still in the old copy to leave, then applies the
+ * same change there. Reads therefore always see a consistent table and never wait for writers; writers to different
+ * shards never contend, and writers to the same shard wait only for in-flight lookups. The price is that every
+ * element is stored twice and every mutation is applied twice.
+ *
+ * Destroy callbacks are run exactly once, after neither copy refers to the element any more, so a key or value is
+ * never destroyed while a lookup may be comparing against it.
+ *
+ * Since elements may move between calls, lookups copy the element out rather than returning a pointer into the
+ * table. Keeping the value alive after it has been returned (e.g. by reference counting it) is up to the caller.
+ */
+struct aws_concurrent_hash_table {
+    struct aws_allocator *alloc;
+    aws_hash_fn *hash_fn;
+    aws_hash_callback_destroy_fn *destroy_key_fn;
+    aws_hash_callback_destroy_fn *destroy_value_fn;
+    struct aws_concurrent_hash_table_shard *shards;
+    /* always a power of 2 */
+    size_t shard_count;
+    /* shift applied to the mixed hash to pick a shard */
+    size_t shard_shift;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Initializes a concurrent hash table with room for about size elements in total before any shard has to grow.
+ * shard_count is rounded up to a power of 2; if it is 0, a number of shards based on the processor count is used.
+ * The callbacks behave exactly as for aws_hash_table_init(), and must themselves be safe to call from any thread.
+ */
+AWS_COMMON_API
+int aws_concurrent_hash_table_init(
+    struct aws_concurrent_hash_table *table,
+    struct aws_allocator *alloc,
+    size_t size,
+    size_t shard_count,
+    aws_hash_fn *hash_fn,
+    aws_hash_callback_eq_fn *equals_fn,
+    aws_hash_callback_destroy_fn *destroy_key_fn,
+    aws_hash_callback_destroy_fn *destroy_value_fn);
+
+/**
+ * Destroys every element and frees all memory. No other thread may be using the table. Idempotent.
+ */
+AWS_COMMON_API
+void aws_concurrent_hash_table_clean_up(struct aws_concurrent_hash_table *table);
+
+/**
+ * Returns the number of elements in the table. With writers running concurrently this is only a snapshot.
+ */
+AWS_COMMON_API
+size_t aws_concurrent_hash_table_get_entry_count(const struct aws_concurrent_hash_table *table);
+
+/**
+ * Looks up key without taking any lock. If it is found, *was_present is set to 1 and, if p_elem is non-NULL, the
+ * element is copied into it; otherwise *was_present is set to 0. Always returns AWS_OP_SUCCESS.
+ */
+AWS_COMMON_API
+int aws_concurrent_hash_table_find(
+    const struct aws_concurrent_hash_table *table,
+    const void *key,
+    struct aws_hash_element *p_elem,
+    int *was_present);
+
+/**
+ * Inserts or overwrites key with value, destroying any key and value it replaces, as aws_hash_table_put() does.
+ * Locks only the key's shard.
+ */
+AWS_COMMON_API
+int aws_concurrent_hash_table_put(
+    struct aws_concurrent_hash_table *table,
+    const void *key,
+    void *value,
+    int *was_created);
+
+/**
+ * Removes key. If p_value is non-NULL the removed element is moved into it and the destroy callbacks are not run.
+ * See aws_hash_table_remove(). Locks only the key's shard.
+ */
+AWS_COMMON_API
+int aws_concurrent_hash_table_remove(
+    struct aws_concurrent_hash_table *table,
+    const void *key,
+    struct aws_hash_element *p_value,
+    int *was_present);
+
+/**
+ * Calls callback for every element, with the same return value semantics as aws_hash_table_foreach(). Unlike there,
+ * where p_element is a copy, the callback may also overwrite p_element->value and the new value is stored in the
+ * table. Neither that nor deleting an element runs the destroy callbacks. Readers see a shard's deletions and new
+ * values together, once the callback has been through the whole shard.
+ *
+ * Shards are visited one at a time with the shard's lock held, so the callback must not modify the table itself, and
+ * writes to other shards may or may not be seen.
+ */
+AWS_COMMON_API
+int aws_concurrent_hash_table_foreach(
+    struct aws_concurrent_hash_table *table,
+    int (*callback)(void *context, struct aws_hash_element *p_element),
+    void *context);
+
+/**
+ * Destroys every element, one shard at a time, keeping the memory for re-use.
+ */
+AWS_COMMON_API
+void aws_concurrent_hash_table_clear(struct aws_concurrent_hash_table *table);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_COMMON_CONCURRENT_HASH_TABLE_H */
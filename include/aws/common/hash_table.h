@@ -81,17 +81,34 @@ enum aws_hash_iter_status {
     AWS_HASH_ITER_STATUS_READY_FOR_USE,
 };
 
+/**
+ * A snapshot of a hash table's occupancy and probe lengths, from aws_hash_table_get_stats().
+ *
+ * An element's probe length (or displacement) is how many slots past its home
+ * slot it is stored at. A lookup which finds the element reads probe length + 1
+ * slots, so these numbers show directly what the load factor costs in lookups.
+ */
+struct aws_hash_table_stats {
+    size_t entry_count;
+    /* slots allocated, including those of the old table while an incremental resize is in progress */
+    size_t slot_count;
+    double max_load_factor;
+    double mean_probe_length;
+    size_t max_probe_length;
+};
+
 struct aws_hash_iter {
     const struct aws_hash_table *map;
     struct aws_hash_element element;
     size_t slot;
     size_t limit;
     enum aws_hash_iter_status status;
+    /* non-zero once the iterator has moved on to the table an incremental resize is still draining */
+    int in_old_table;
     /*
      * Reserving extra fields for binary compatibility with future expansion of
      * iterator in case hash table implementation changes.
      */
-    int unused_0;
     void *unused_1;
     void *unused_2;
 };
@@ -145,6 +162,66 @@ int aws_hash_table_init(
     aws_hash_callback_destroy_fn *destroy_key_fn,
     aws_hash_callback_destroy_fn *destroy_value_fn);
 
+/**
+ * Enables or disables incremental resizing, which is off by default.
+ *
+ * Normally, the put which takes the table past its maximum load allocates a
+ * table twice the size and moves every element into it before returning,
+ * which takes time proportional to the size of the table. With incremental
+ * resizing, that put only allocates the new table; the old one is kept, and
+ * each subsequent put or remove moves a small, bounded number of its slots
+ * into the new one, so that no single operation pays for the whole resize.
+ * Until the move is complete, lookups may have to search both tables.
+ *
+ * Disabling incremental resizing finishes any move in progress.
+ */
+AWS_COMMON_API
+void aws_hash_table_set_incremental_resize(struct aws_hash_table *map, bool enabled);
+
+/**
+ * Makes room for at least entry_count elements, so that the table will not
+ * grow again until it holds more than that. Call before a bulk load to resize
+ * once rather than repeatedly. Does nothing if there is room already.
+ *
+ * The resize happens all at once, finishing any incremental resize in progress.
+ * Raises AWS_ERROR_OOM if the memory could not be allocated, in which case the
+ * table is unchanged.
+ */
+AWS_COMMON_API
+int aws_hash_table_reserve(struct aws_hash_table *map, size_t entry_count);
+
+/**
+ * Shrinks the table to the smallest size which holds its current elements
+ * within the maximum load factor, giving memory back after elements have been
+ * removed (aws_hash_table_clear() keeps the table's size). The table grows
+ * again as needed.
+ *
+ * Raises AWS_ERROR_OOM if the memory for the smaller table could not be
+ * allocated, in which case the table is unchanged.
+ */
+AWS_COMMON_API
+int aws_hash_table_shrink_to_fit(struct aws_hash_table *map);
+
+/**
+ * Sets the fraction of slots which may be in use before the table grows. The
+ * default is 0.95. Lower values mean shorter probes (see aws_hash_table_get_stats())
+ * at the cost of memory. If the table is now over its maximum load, it grows
+ * immediately.
+ *
+ * Raises AWS_ERROR_INVALID_ARGUMENT unless 0 < max_load_factor <= 1, or
+ * AWS_ERROR_OOM if growing failed, in which case the table keeps its previous
+ * max load factor.
+ */
+AWS_COMMON_API
+int aws_hash_table_set_max_load_factor(struct aws_hash_table *map, double max_load_factor);
+
+/**
+ * Fills in stats for the table. This looks at every slot, so takes time
+ * proportional to the table's size.
+ */
+AWS_COMMON_API
+void aws_hash_table_get_stats(const struct aws_hash_table *map, struct aws_hash_table_stats *stats);
+
 /**
  * Deletes every element from map and frees all associated memory.
  * destroy_fn will be called for each element.  aws_hash_table_init
@@ -284,6 +361,39 @@ int aws_hash_table_create(
 AWS_COMMON_API
 int aws_hash_table_put(struct aws_hash_table *map, const void *key, void *value, int *was_created);
 
+/**
+ * Looks up count keys at once, placing a pointer to the element for keys[i]
+ * (or NULL if it is not present) in p_elems[i]. Always returns AWS_OP_SUCCESS.
+ *
+ * The result is the same as calling aws_hash_table_find() for each key, but the
+ * keys are hashed and the memory they probe is prefetched a batch at a time
+ * before any of it is read, so that the cache misses of a large table overlap
+ * rather than being taken one after another.
+ */
+AWS_COMMON_API
+int aws_hash_table_find_many(
+    const struct aws_hash_table *map,
+    const void *const *keys,
+    size_t count,
+    struct aws_hash_element **p_elems);
+
+/**
+ * Puts count elements at once, keys[i] with values[i], prefetching as
+ * aws_hash_table_find_many() does. Each put behaves as aws_hash_table_put(),
+ * including destroying the elements it overwrites; later keys overwrite earlier
+ * equal ones. If was_created is non-NULL, was_created[i] is set for each key.
+ *
+ * If a put fails (because the table could not grow), AWS_OP_ERR is returned
+ * immediately; the elements before it have been put and the rest have not.
+ */
+AWS_COMMON_API
+int aws_hash_table_put_many(
+    struct aws_hash_table *map,
+    const void *const *keys,
+    void *const *values,
+    size_t count,
+    int *was_created);
+
 /**
  * Removes element at key. Always returns AWS_OP_SUCCESS.
  *
@@ -394,6 +504,36 @@ uint64_t aws_hash_byte_cursor_ptr(const void *item);
 AWS_COMMON_API
 uint64_t aws_hash_ptr(const void *item);
 
+/**
+ * Hashes len bytes with a faster function than the lookup3 hash behind aws_hash_c_string and friends: a CRC32C based
+ * hash on CPUs with SSE4.2, and a wyhash style multiply-mix hash elsewhere.
+ *
+ * Unlike lookup3, the result may differ between machines, builds and releases, so it must never be persisted or
+ * sent anywhere; it is meant for in-memory tables only. Equal bytes always hash equally within one process, and the
+ * functions below all hash their key's bytes with this, so e.g. an aws_string and a byte cursor with the same
+ * contents get the same hash.
+ */
+AWS_COMMON_API
+uint64_t aws_hash_bytes_fast(const void *data, size_t len);
+
+/**
+ * Faster alternative to aws_hash_c_string, see aws_hash_bytes_fast.
+ */
+AWS_COMMON_API
+uint64_t aws_hash_c_string_fast(const void *item);
+
+/**
+ * Faster alternative to aws_hash_string, see aws_hash_bytes_fast.
+ */
+AWS_COMMON_API
+uint64_t aws_hash_string_fast(const void *item);
+
+/**
+ * Faster alternative to aws_hash_byte_cursor_ptr, see aws_hash_bytes_fast.
+ */
+AWS_COMMON_API
+uint64_t aws_hash_byte_cursor_ptr_fast(const void *item);
+
 /**
  * Convenience eq callback for NULL-terminated C-strings
  */
@@ -0,0 +1,141 @@
+#ifndef AWS_COMMON_INLINE_HASH_TABLE_H
+#define AWS_COMMON_INLINE_HASH_TABLE_H
+
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/hash_table.h>
+
+/**
+ * A Robin Hood hash table, like aws_hash_table, which stores fixed size keys and values in its slot array rather
+ * than pointers to them. The key and value sizes are set at init time; keys and values are copied in and out, and
+ * lookups hand back a pointer to the value's storage in the slot.
+ *
+ * This suits maps whose keys are small plain data, such as stream IDs or file descriptors: there is no allocation per
+ * element and no pointer to follow on each key comparison. Keys are passed by address (e.g. &stream_id).
+ *
+ * If no hash and equality callbacks are given, keys are hashed and compared as raw bytes, with 4 and 8 byte keys
+ * taking a dedicated path where both are a few integer instructions. Keys whose bytes may differ while still being
+ * equal (e.g. structs with padding) need callbacks, which are passed pointers to the stored keys.
+ *
+ * Keys and values are plain data: there are no destroy callbacks, and removing an element simply forgets it.
+ * As with aws_hash_table, value pointers are invalidated by any operation which may change the number of elements,
+ * and concurrent use is only safe for non-mutating operations.
+ */
+struct aws_inline_hash_table {
+    struct aws_allocator *alloc;
+    aws_hash_fn *hash_fn;
+    aws_hash_callback_eq_fn *equals_fn;
+    size_t key_size;
+    size_t value_size;
+    /* each slot is the 8 byte hash code (0 when empty), then the key, then the value at value_offset */
+    size_t value_offset;
+    size_t slot_size;
+    /* size slots, followed by 2 slots of scratch space for moving elements around */
+    uint8_t *slots;
+    /* always a power of 2 */
+    size_t size;
+    size_t mask;
+    size_t entry_count;
+    size_t max_load;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Initializes an inline hash table with room for size elements before it has to grow, storing keys of key_size
+ * bytes and values of value_size bytes (which may be 0, for a set). hash_fn and equals_fn must either both be NULL, to
+ * hash and compare keys as raw bytes, or both be set.
+ */
+AWS_COMMON_API
+int aws_inline_hash_table_init(
+    struct aws_inline_hash_table *table,
+    struct aws_allocator *alloc,
+    size_t size,
+    size_t key_size,
+    size_t value_size,
+    aws_hash_fn *hash_fn,
+    aws_hash_callback_eq_fn *equals_fn);
+
+/**
+ * Frees all memory. The table must be initialized again before re-use. Idempotent.
+ */
+AWS_COMMON_API
+void aws_inline_hash_table_clean_up(struct aws_inline_hash_table *table);
+
+/**
+ * Returns the number of elements in the table.
+ */
+AWS_COMMON_API
+size_t aws_inline_hash_table_get_entry_count(const struct aws_inline_hash_table *table);
+
+/**
+ * Looks up the key_size bytes at key. *p_value is set to the value's storage if found, or NULL otherwise.
+ * Always returns AWS_OP_SUCCESS.
+ */
+AWS_COMMON_API
+int aws_inline_hash_table_find(const struct aws_inline_hash_table *table, const void *key, void **p_value);
+
+/**
+ * Looks up key, inserting it with a zeroed value if it isn't there. If p_value is non-NULL it is set to the value's
+ * storage either way. See aws_hash_table_create().
+ */
+AWS_COMMON_API
+int aws_inline_hash_table_create(
+    struct aws_inline_hash_table *table,
+    const void *key,
+    void **p_value,
+    int *was_created);
+
+/**
+ * Inserts or overwrites key, copying value_size bytes from value.
+ */
+AWS_COMMON_API
+int aws_inline_hash_table_put(
+    struct aws_inline_hash_table *table,
+    const void *key,
+    const void *value,
+    int *was_created);
+
+/**
+ * Removes key. If p_value is non-NULL and the key was present, its value is copied into it.
+ * If was_present is non-NULL, it is set to 1 if the key was found and 0 otherwise.
+ */
+AWS_COMMON_API
+int aws_inline_hash_table_remove(
+    struct aws_inline_hash_table *table,
+    const void *key,
+    void *p_value,
+    int *was_present);
+
+/**
+ * Calls callback with the stored key and value of every element, with the same return value semantics as
+ * aws_hash_table_foreach(). The callback may modify the value in place, but not the key.
+ */
+AWS_COMMON_API
+int aws_inline_hash_table_foreach(
+    struct aws_inline_hash_table *table,
+    int (*callback)(void *context, const void *key, void *value),
+    void *context);
+
+/**
+ * Removes every element, keeping the memory for re-use.
+ */
+AWS_COMMON_API
+void aws_inline_hash_table_clear(struct aws_inline_hash_table *table);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_COMMON_INLINE_HASH_TABLE_H */
@@ -17,6 +17,55 @@
 
 #include <aws/common/hash_table.h>
 #include <aws/common/linked_list.h>
+#include <aws/common/task_scheduler.h>
+
+/**
+ * How the cache chooses what to evict.
+ */
+enum aws_lru_cache_policy {
+    /**
+     * Exact LRU: every hit moves the element to the front of the list.
+     */
+    AWS_LRU_CACHE_POLICY_EXACT,
+    /**
+     * Approximate LRU (CLOCK, or second chance): a hit only sets a reference bit on the element, and eviction scans
+     * from the oldest element, clearing bits and giving those elements another lap, until it finds one that hasn't
+     * been used since it was last passed. Hits are read-mostly, so aws_lru_cache_find() is cheaper and may be called
+     * from several threads at once, provided nothing modifies the cache concurrently (for instance, with finds under
+     * the read side of an aws_rw_lock and everything else under the write side).
+     */
+    AWS_LRU_CACHE_POLICY_CLOCK,
+    /**
+     * 2Q (Johnson and Shasha): a new element goes into a FIFO queue of a quarter of the cache. An element requested
+     * again while there, or while it is remembered (by hash only) for a while after being pushed out of it, goes into
+     * an LRU queue for the rest of the cache. A one-off scan only ever displaces the FIFO queue.
+     */
+    AWS_LRU_CACHE_POLICY_2Q,
+    /**
+     * ARC (Megiddo and Modha): LRU queues of elements used once and used more than once, with the split between them
+     * adapted by remembering (by hash only) elements recently evicted from each.
+     */
+    AWS_LRU_CACHE_POLICY_ARC,
+    /**
+     * W-TinyLFU (Einziger, Friedman and Manes): a new element goes into a small LRU window, and an element pushed out
+     * of that only replaces the main cache's next victim if it has been requested more often, by the estimate of a
+     * count-min sketch of recent requests (which ages by halving). The main cache is a segmented LRU.
+     */
+    AWS_LRU_CACHE_POLICY_TINY_LFU,
+};
+
+struct aws_lru_cache_policy_state;
+
+/**
+ * Returns the cost (for instance, the size in bytes) of an element added by aws_lru_cache_put() to a cache with a
+ * cost budget.
+ */
+typedef size_t(aws_lru_cache_cost_fn)(const void *key, const void *value);
+
+/**
+ * Gets the current time, in nanoseconds, for a cache with expiring elements. Returns AWS_OP_SUCCESS on success.
+ */
+typedef int(aws_lru_cache_clock_fn)(uint64_t *timestamp);
 
 /**
  * Simple Least-recently-used cache using the standard lazy linked hash table
@@ -29,6 +78,86 @@ struct aws_lru_cache {
     struct aws_hash_table table;
     aws_hash_callback_destroy_fn *user_on_value_destroy;
     size_t max_items;
+    enum aws_lru_cache_policy policy;
+    /* elements removed to make room for new ones since init */
+    uint64_t eviction_count;
+    /* 0 if elements are only limited by count */
+    size_t max_cost;
+    /* sum of the costs of the elements in the cache */
+    size_t total_cost;
+    aws_lru_cache_cost_fn *cost_fn;
+    /* finds since init, except with AWS_LRU_CACHE_POLICY_CLOCK */
+    uint64_t hit_count;
+    uint64_t miss_count;
+    /* expiring elements only, soonest expiry on top */
+    struct aws_priority_queue expiry_queue;
+    aws_lru_cache_clock_fn *clock_fn;
+    /* 0 if elements added by aws_lru_cache_put() don't expire */
+    uint64_t ttl;
+    /* elements removed on or after expiry since init */
+    uint64_t expiration_count;
+    /* if set, purge_task is kept scheduled here for the next expiry, rounded up to a multiple of purge_interval */
+    struct aws_task_scheduler *purge_scheduler;
+    uint64_t purge_interval;
+    struct aws_task purge_task;
+    bool purge_scheduled;
+    /* queues, remembered evictions and request counts for the policies which need them */
+    struct aws_lru_cache_policy_state *policy_state;
+};
+
+/**
+ * Options for aws_lru_cache_init_with_options(). See aws_lru_cache_init() for the meaning of the other fields.
+ */
+struct aws_lru_cache_options {
+    aws_hash_fn *hash_fn;
+    aws_hash_callback_eq_fn *equals_fn;
+    aws_hash_callback_destroy_fn *destroy_key_fn;
+    aws_hash_callback_destroy_fn *destroy_value_fn;
+    /* may be 0, for no limit on the element count, if max_cost is set and the policy is EXACT or CLOCK */
+    size_t max_items;
+    enum aws_lru_cache_policy policy;
+    /*
+     * If non-zero, elements are also evicted (in the order the policy would evict them for space) until the total
+     * cost of those left is at most max_cost.
+     */
+    size_t max_cost;
+    /* optional: the cost of elements added by aws_lru_cache_put(). If NULL, those cost nothing. */
+    aws_lru_cache_cost_fn *cost_fn;
+    /* optional: nanoseconds until elements added by aws_lru_cache_put() or _put_with_cost() expire */
+    uint64_t ttl;
+    /* optional: the clock expiry times are on. Defaults to aws_high_res_clock_get_ticks(). */
+    aws_lru_cache_clock_fn *clock_fn;
+    /*
+     * optional: a scheduler on which the cache keeps a task scheduled to remove expired elements, so that they don't
+     * wait to be found or evicted. The task runs on the scheduler's clock, which must be the same as clock_fn, and
+     * removes every element expired by its run time. The cache must be used only from the thread running the
+     * scheduler, and must be cleaned up before it.
+     */
+    struct aws_task_scheduler *purge_scheduler;
+    /*
+     * optional: with purge_scheduler, the task is scheduled for the next expiry rounded up to a multiple of this many
+     * nanoseconds, so that elements expiring close together are removed in one run. If 0, the task runs at each
+     * distinct expiry time.
+     */
+    uint64_t purge_interval;
+};
+
+/**
+ * Statistics since init, as returned by aws_lru_cache_get_stats(). The hit ratio is hits / (hits + misses).
+ */
+struct aws_lru_cache_stats {
+    size_t element_count;
+    size_t total_cost;
+    /*
+     * finds which did and didn't find an element. Not counted with AWS_LRU_CACHE_POLICY_CLOCK, as finds may run
+     * concurrently there.
+     */
+    uint64_t hits;
+    uint64_t misses;
+    /* elements removed to make room, for count or cost */
+    uint64_t evictions;
+    /* elements removed on or after expiry */
+    uint64_t expirations;
 };
 
 AWS_EXTERN_C_BEGIN
@@ -49,6 +178,15 @@ int aws_lru_cache_init(
     aws_hash_callback_destroy_fn *destroy_value_fn,
     size_t max_items);
 
+/**
+ * Initializes the cache as aws_lru_cache_init() does, with the choice of eviction policy.
+ */
+AWS_COMMON_API
+int aws_lru_cache_init_with_options(
+    struct aws_lru_cache *cache,
+    struct aws_allocator *allocator,
+    const struct aws_lru_cache_options *options);
+
 /**
  * Cleans up the cache. Elements in the cache will be evicted and cleanup
  * callbacks will be invoked.
@@ -58,9 +196,13 @@ void aws_lru_cache_clean_up(struct aws_lru_cache *cache);
 
 /**
  * Finds element in the cache by key. If found, it will become most-recently
- * used, *p_value will hold the stored value, and AWS_OP_SUCCESS will be
+ * used (with AWS_LRU_CACHE_POLICY_CLOCK, it is marked as used instead; the
+ * other policies record the use as they describe above),
+ * *p_value will hold the stored value, and AWS_OP_SUCCESS will be
  * returned. If not found, AWS_OP_SUCCESS will be returned and *p_value will be
- * NULL.
+ * NULL. An element found on or after its expiry time is not returned, and is
+ * removed (except with AWS_LRU_CACHE_POLICY_CLOCK, where finds must not modify
+ * the cache, so it is left to be purged or evicted).
  *
  * If any errors occur AWS_OP_ERR will be returned.
  */
@@ -69,11 +211,41 @@ int aws_lru_cache_find(struct aws_lru_cache *cache, const void *key, void **p_va
 
 /**
  * Puts `p_value` at `key`. If an element is already stored at `key` it will be replaced. Added item becomes
- * most-recently used. If the cache is already full, the least-recently-used item will be removed.
+ * most-recently used. If the cache is already full, the least-recently-used item will be removed (or, with the
+ * 2Q, ARC and TinyLFU policies, whichever item the policy chooses, which for TinyLFU may be the added item itself).
+ * With a cost budget, the item costs what cost_fn returns for it; see aws_lru_cache_put_with_cost().
  */
 AWS_COMMON_API
 int aws_lru_cache_put(struct aws_lru_cache *cache, const void *key, void *p_value);
 
+/**
+ * Puts `p_value` at `key` as aws_lru_cache_put() does, with the given cost rather than that returned by cost_fn.
+ * Elements are then evicted until the total cost is within max_cost, if that is set. If `cost` alone is over
+ * max_cost, AWS_ERROR_INVALID_ARGUMENT is raised and the cache is left unchanged.
+ */
+AWS_COMMON_API
+int aws_lru_cache_put_with_cost(struct aws_lru_cache *cache, const void *key, void *p_value, size_t cost);
+
+/**
+ * Puts `p_value` at `key` as aws_lru_cache_put() does, expiring at `expiry_time` on the cache's clock rather than
+ * after the cache's ttl. If `expiry_time` is 0, the element doesn't expire.
+ */
+AWS_COMMON_API
+int aws_lru_cache_put_with_expiry(struct aws_lru_cache *cache, const void *key, void *p_value, uint64_t expiry_time);
+
+/**
+ * Removes up to `max_count` elements (every one, if 0) which expire at or before `current_time`, soonest expiring
+ * first, without looking at any others. Returns the number removed.
+ */
+AWS_COMMON_API
+size_t aws_lru_cache_purge_expired(struct aws_lru_cache *cache, uint64_t current_time, size_t max_count);
+
+/**
+ * Returns whether any element in the cache expires, and if so sets `expiry_time` to the soonest expiry.
+ */
+AWS_COMMON_API
+bool aws_lru_cache_get_next_expiry(const struct aws_lru_cache *cache, uint64_t *expiry_time);
+
 /**
  * Removes item at `key` from the cache.
  */
@@ -88,13 +260,19 @@ void aws_lru_cache_clear(struct aws_lru_cache *cache);
 
 /**
  * Accesses the least-recently-used element, sets it to most-recently-used
- * element, and returns the value.
+ * element, and returns the value. With any policy but AWS_LRU_CACHE_POLICY_EXACT,
+ * this is the element which would be evicted next, and it is used as by
+ * aws_lru_cache_find(). Expired elements which haven't yet been removed count.
  */
 AWS_COMMON_API
 void *aws_lru_cache_use_lru_element(struct aws_lru_cache *cache);
 
 /**
- * Accesses the most-recently-used element and returns its value.
+ * Accesses the most-recently-used element and returns its value. With
+ * AWS_LRU_CACHE_POLICY_CLOCK, this is the element most recently added or
+ * moved to the front (by eviction or aws_lru_cache_use_lru_element()).
+ * With the 2Q, ARC and TinyLFU policies, it is the element most recently
+ * added or used, if it is still there, or else a recently used one.
  */
 AWS_COMMON_API
 void *aws_lru_cache_get_mru_element(const struct aws_lru_cache *cache);
@@ -105,6 +283,18 @@ void *aws_lru_cache_get_mru_element(const struct aws_lru_cache *cache);
 AWS_COMMON_API
 size_t aws_lru_cache_get_element_count(const struct aws_lru_cache *cache);
 
+/**
+ * Returns the sum of the costs of the elements in the cache.
+ */
+AWS_COMMON_API
+size_t aws_lru_cache_get_total_cost(const struct aws_lru_cache *cache);
+
+/**
+ * Fills in `stats` with the cache's statistics since init.
+ */
+AWS_COMMON_API
+void aws_lru_cache_get_stats(const struct aws_lru_cache *cache, struct aws_lru_cache_stats *stats);
+
 AWS_EXTERN_C_END
 
 #endif /* AWS_COMMON_LRU_CACHE_H */
@@ -0,0 +1,190 @@
+#ifndef AWS_COMMON_ORDERED_HASH_TABLE_H
+#define AWS_COMMON_ORDERED_HASH_TABLE_H
+
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/hash_table.h>
+
+struct aws_ordered_hash_entry;
+
+/**
+ * A hash table which remembers insertion order, with the same callbacks and element semantics as aws_hash_table.
+ *
+ * Elements are kept in a dense array in the order they were first inserted, and a separate open addressing index of
+ * 32 bit positions maps hashes to them (the layout of CPython's dict). Iteration walks the dense array, so it visits
+ * elements in insertion order and touches only memory holding elements, rather than every slot of a sparse table.
+ * Overwriting a key's value keeps its position; removing it and inserting it again moves it to the end.
+ *
+ * Removal leaves a tombstone in the dense array, so a sweep can delete as it goes in O(1) per element. Tombstones are
+ * only cleared when an insert finds the array full and at least half of it is tombstones: then the live elements are
+ * slid down over them instead of the array growing. Iterators stay valid across inserts and removals, including
+ * removal of the element the iterator is on, and another iterator's: an iterator remembers the insertion sequence
+ * number of its element as well as its position, and finds its place again by that if the array was compacted.
+ *
+ * As with aws_hash_table, pointers to elements are invalidated by any operation which may change the number of
+ * elements, and concurrent use is only safe for non-mutating operations.
+ */
+struct aws_ordered_hash_table {
+    struct aws_allocator *alloc;
+    aws_hash_fn *hash_fn;
+    aws_hash_callback_eq_fn *equals_fn;
+    aws_hash_callback_destroy_fn *destroy_key_fn;
+    aws_hash_callback_destroy_fn *destroy_value_fn;
+    /* elements and tombstones in insertion order; entries_used of entries_capacity are in use */
+    struct aws_ordered_hash_entry *entries;
+    size_t entries_capacity;
+    size_t entries_used;
+    /* live elements */
+    size_t entry_count;
+    /* sequence number of the next element inserted */
+    uint64_t next_seq;
+    /* bumped whenever elements move, which tells iterators to find their place again */
+    size_t compactions;
+    /* index_mask + 1 positions into entries, each 1 + the entry's position, 0 if empty, or a deleted marker */
+    uint32_t *index;
+    size_t index_mask;
+};
+
+/**
+ * A position in an aws_ordered_hash_table. Use aws_ordered_hash_iter_get_element() for the element it is on.
+ */
+struct aws_ordered_hash_iter {
+    struct aws_ordered_hash_table *table;
+    size_t position;
+    /* the sequence number of the element at position, and table->compactions when position was last valid */
+    uint64_t seq;
+    size_t compactions;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Initializes an ordered hash table with room for size elements before it has to grow. The callbacks behave exactly
+ * as for aws_hash_table_init().
+ */
+AWS_COMMON_API
+int aws_ordered_hash_table_init(
+    struct aws_ordered_hash_table *table,
+    struct aws_allocator *alloc,
+    size_t size,
+    aws_hash_fn *hash_fn,
+    aws_hash_callback_eq_fn *equals_fn,
+    aws_hash_callback_destroy_fn *destroy_key_fn,
+    aws_hash_callback_destroy_fn *destroy_value_fn);
+
+/**
+ * Destroys every element and frees all memory. The table must be initialized again before re-use. Idempotent.
+ */
+AWS_COMMON_API
+void aws_ordered_hash_table_clean_up(struct aws_ordered_hash_table *table);
+
+/**
+ * Returns the number of elements in the table.
+ */
+AWS_COMMON_API
+size_t aws_ordered_hash_table_get_entry_count(const struct aws_ordered_hash_table *table);
+
+/**
+ * Looks up key. *p_elem is set to the element if found, or NULL otherwise. Always returns AWS_OP_SUCCESS.
+ * See aws_hash_table_find().
+ */
+AWS_COMMON_API
+int aws_ordered_hash_table_find(
+    const struct aws_ordered_hash_table *table,
+    const void *key,
+    struct aws_hash_element **p_elem);
+
+/**
+ * Looks up key, appending it with a NULL value if it isn't there. See aws_hash_table_create().
+ */
+AWS_COMMON_API
+int aws_ordered_hash_table_create(
+    struct aws_ordered_hash_table *table,
+    const void *key,
+    struct aws_hash_element **p_elem,
+    int *was_created);
+
+/**
+ * Inserts or overwrites key with value, destroying any key and value it replaces. See aws_hash_table_put().
+ * A new key goes after every other element; an overwritten one keeps its position.
+ */
+AWS_COMMON_API
+int aws_ordered_hash_table_put(struct aws_ordered_hash_table *table, const void *key, void *value, int *was_created);
+
+/**
+ * Removes key. If p_value is non-NULL the removed element is moved into it and the destroy callbacks are not run.
+ * See aws_hash_table_remove(). Never moves other elements (see above).
+ */
+AWS_COMMON_API
+int aws_ordered_hash_table_remove(
+    struct aws_ordered_hash_table *table,
+    const void *key,
+    struct aws_hash_element *p_value,
+    int *was_present);
+
+/**
+ * Calls callback for every element in insertion order, with the same return value semantics as
+ * aws_hash_table_foreach(). As there, deleting an element does not run the destroy callbacks. The callback may also
+ * insert elements, which will be visited in turn, but must not remove any other than through its return value.
+ */
+AWS_COMMON_API
+int aws_ordered_hash_table_foreach(
+    struct aws_ordered_hash_table *table,
+    int (*callback)(void *context, struct aws_hash_element *p_element),
+    void *context);
+
+/**
+ * Destroys every element, keeping the memory for re-use.
+ */
+AWS_COMMON_API
+void aws_ordered_hash_table_clear(struct aws_ordered_hash_table *table);
+
+/**
+ * Returns an iterator on the oldest element, or one for which aws_ordered_hash_iter_done() is true if the table is
+ * empty.
+ */
+AWS_COMMON_API
+struct aws_ordered_hash_iter aws_ordered_hash_iter_begin(struct aws_ordered_hash_table *table);
+
+/**
+ * Returns true once the iterator has moved past the newest element.
+ */
+AWS_COMMON_API
+bool aws_ordered_hash_iter_done(const struct aws_ordered_hash_iter *iter);
+
+/**
+ * Moves the iterator on to the next element in insertion order, skipping any removed since it was last moved.
+ */
+AWS_COMMON_API
+void aws_ordered_hash_iter_next(struct aws_ordered_hash_iter *iter);
+
+/**
+ * Returns the element the iterator is on, or NULL if it has been removed. The pointer is invalidated as for
+ * aws_ordered_hash_table_find(), but the iterator is not.
+ */
+AWS_COMMON_API
+struct aws_hash_element *aws_ordered_hash_iter_get_element(const struct aws_ordered_hash_iter *iter);
+
+/**
+ * Removes the element the iterator is on, running the destroy callbacks if destroy_contents is true. The iterator
+ * stays where it is until aws_ordered_hash_iter_next() is called.
+ */
+AWS_COMMON_API
+void aws_ordered_hash_iter_delete(struct aws_ordered_hash_iter *iter, bool destroy_contents);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_COMMON_ORDERED_HASH_TABLE_H */
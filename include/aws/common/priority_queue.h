@@ -48,6 +48,22 @@ struct aws_priority_queue {
      * with information needed to locate and remove a specific node later on.
      */
     struct aws_array_list backpointers;
+
+    /**
+     * log2 of the number of children of each node: 1 for a binary heap, 2 or 3 for a 4-ary or 8-ary heap.
+     */
+    size_t arity_shift;
+
+    /**
+     * In keyed mode, the number of bytes before each item in the container, holding its uint64_t priority.
+     * Otherwise 0.
+     */
+    size_t key_size;
+
+    /**
+     * The size of the items copied in and out of the queue. In keyed mode, this is less than container.item_size.
+     */
+    size_t item_size;
 };
 
 struct aws_priority_queue_node {
@@ -55,6 +71,28 @@ struct aws_priority_queue_node {
     size_t current_index;
 };
 
+/**
+ * Options for aws_priority_queue_init_dynamic_with_options().
+ */
+struct aws_priority_queue_options {
+    /* the initial capacity, in items */
+    size_t initial_size;
+    size_t item_size;
+    /* not used in keyed mode */
+    aws_priority_queue_compare_fn *pred;
+    /*
+     * the number of children of each node: 2 (the default, if 0), 4 or 8. With more children the heap is shallower,
+     * so a push or remove sifts past fewer levels, and the children compared at each level of a pop are adjacent in
+     * memory, at the cost of more comparisons per level. 4 is generally the fastest for large queues.
+     */
+    size_t arity;
+    /*
+     * If set, each item is given a uint64_t priority by aws_priority_queue_push_keyed(), which is stored inline next
+     * to the item, and the item with the lowest priority is popped first. Comparisons then need no callback.
+     */
+    bool keyed;
+};
+
 AWS_EXTERN_C_BEGIN
 
 /**
@@ -91,6 +129,16 @@ void aws_priority_queue_init_static(
     size_t item_size,
     aws_priority_queue_compare_fn *pred);
 
+/**
+ * Initializes a priority queue struct for use, as aws_priority_queue_init_dynamic() does, with the choice of the heap's
+ * arity and of keyed mode.
+ */
+AWS_COMMON_API
+int aws_priority_queue_init_dynamic_with_options(
+    struct aws_priority_queue *queue,
+    struct aws_allocator *alloc,
+    const struct aws_priority_queue_options *options);
+
 /**
  * Checks that the backpointer at a specific index of the queue is
  * NULL or points to a correctly allocated aws_priority_queue_node.
@@ -125,6 +173,7 @@ void aws_priority_queue_clean_up(struct aws_priority_queue *queue);
 
 /**
  * Copies item into the queue and places it in the proper priority order. Complexity: O(log(n)).
+ * In keyed mode, AWS_ERROR_UNSUPPORTED_OPERATION will be raised; use aws_priority_queue_push_keyed().
  */
 AWS_COMMON_API
 int aws_priority_queue_push(struct aws_priority_queue *queue, void *item);
@@ -146,6 +195,18 @@ int aws_priority_queue_push_ref(
     void *item,
     struct aws_priority_queue_node *backpointer);
 
+/**
+ * For a queue in keyed mode, copies item into the queue with the given priority, as aws_priority_queue_push_ref()
+ * does (backpointer may be NULL). Items of lower priority values are popped first. Otherwise,
+ * AWS_ERROR_UNSUPPORTED_OPERATION will be raised.
+ */
+AWS_COMMON_API
+int aws_priority_queue_push_keyed(
+    struct aws_priority_queue *queue,
+    uint64_t priority,
+    void *item,
+    struct aws_priority_queue_node *backpointer);
+
 /**
  * Copies the element of the highest priority, and removes it from the queue.. Complexity: O(log(n)).
  * If queue is empty, AWS_ERROR_PRIORITY_QUEUE_EMPTY will be raised.
@@ -163,6 +224,26 @@ int aws_priority_queue_pop(struct aws_priority_queue *queue, void *item);
 AWS_COMMON_API
 int aws_priority_queue_remove(struct aws_priority_queue *queue, void *item, const struct aws_priority_queue_node *node);
 
+/**
+ * Moves a specific node to its new place after its priority has changed, e.g. because the item points to a timer that
+ * was reset: one sift up or down from where it is, rather than a remove and a push. Complexity: O(log(n)).
+ * The node must have been pushed with a backpointer, which stays valid. For a queue in keyed mode, use
+ * aws_priority_queue_update_keyed() instead; here AWS_ERROR_UNSUPPORTED_OPERATION will be raised.
+ * If the node is not in the queue, AWS_ERROR_PRIORITY_QUEUE_BAD_NODE will be raised, as with aws_priority_queue_remove.
+ */
+AWS_COMMON_API
+int aws_priority_queue_update(struct aws_priority_queue *queue, const struct aws_priority_queue_node *node);
+
+/**
+ * For a queue in keyed mode, changes the priority of a specific node and moves it to its new place, as
+ * aws_priority_queue_update() does. Otherwise, AWS_ERROR_UNSUPPORTED_OPERATION will be raised.
+ */
+AWS_COMMON_API
+int aws_priority_queue_update_keyed(
+    struct aws_priority_queue *queue,
+    uint64_t priority,
+    const struct aws_priority_queue_node *node);
+
 /**
  * Obtains a pointer to the element of the highest priority. Complexity: constant time.
  * If queue is empty, AWS_ERROR_PRIORITY_QUEUE_EMPTY will be raised.
@@ -170,6 +251,14 @@ int aws_priority_queue_remove(struct aws_priority_queue *queue, void *item, cons
 AWS_COMMON_API
 int aws_priority_queue_top(const struct aws_priority_queue *queue, void **item);
 
+/**
+ * For a queue in keyed mode, obtains the priority of the element of the highest priority (the lowest value) without
+ * touching the element itself. Complexity: constant time.
+ * If queue is empty, AWS_ERROR_PRIORITY_QUEUE_EMPTY will be raised.
+ */
+AWS_COMMON_API
+int aws_priority_queue_top_priority(const struct aws_priority_queue *queue, uint64_t *priority);
+
 /**
  * Current number of elements in the queue
  */
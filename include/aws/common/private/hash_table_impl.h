@@ -47,6 +47,14 @@ struct hash_table_state {
     /* We AND a hash value with mask to get the slot index */
     size_t mask;
     double max_load_factor;
+    /*
+     * Incremental resize (see aws_hash_table_set_incremental_resize). While old_state is non-NULL, this is the larger
+     * table still being filled from old_state: every key is in exactly one of the two, entry_count only counts the
+     * entries in this one, and all of old_state's slots before migrate_cursor are empty.
+     */
+    struct hash_table_state *old_state;
+    size_t migrate_cursor;
+    bool incremental_resize;
     /* actually variable length */
     struct hash_table_entry slots[];
 };
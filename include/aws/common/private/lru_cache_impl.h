@@ -0,0 +1,75 @@
+#ifndef AWS_COMMON_PRIVATE_LRU_CACHE_IMPL_H
+#define AWS_COMMON_PRIVATE_LRU_CACHE_IMPL_H
+
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/atomics.h>
+#include <aws/common/lru_cache.h>
+
+struct cache_node {
+    struct aws_linked_list_node node;
+    struct aws_lru_cache *cache;
+    const void *key;
+    void *value;
+    /* counted in cache->total_cost */
+    size_t cost;
+    /* 0 if the node doesn't expire. Otherwise, it is on cache->expiry_queue. */
+    uint64_t expiry;
+    struct aws_priority_queue_node expiry_node;
+    /* AWS_LRU_CACHE_POLICY_CLOCK only: non-zero if used since the clock hand last passed. Atomic as finds may race. */
+    struct aws_atomic_var referenced;
+    /* policies with a policy_state only: the key's hash, and which of the policy's queues the node is on */
+    uint64_t hash_code;
+    int queue;
+};
+
+/*
+ * The 2Q, ARC and TinyLFU policies (lru_cache_policy.c). For these, the nodes live on the policy's queues rather than
+ * the cache's list, and the cache calls into the policy for every use, addition and removal.
+ */
+
+/* Sets up cache->policy_state once the rest of the cache is initialized */
+int lru_cache_policy_init(struct aws_lru_cache *cache, aws_hash_fn *hash_fn);
+
+/* Frees cache->policy_state, once the table no longer holds any nodes */
+void lru_cache_policy_clean_up(struct aws_lru_cache *cache);
+
+/* Forgets everything remembered about elements no longer in the cache */
+void lru_cache_policy_clear(struct aws_lru_cache *cache);
+
+/* The hash stored in a node. Always odd, so that it can serve as a non-NULL key in a table of pointers. */
+uint64_t lru_cache_policy_hash(const struct aws_lru_cache *cache, const void *key);
+
+void lru_cache_policy_on_hit(struct aws_lru_cache *cache, struct cache_node *node);
+
+void lru_cache_policy_on_miss(struct aws_lru_cache *cache, const void *key);
+
+/*
+ * Links in a node which has just been added to the table, first evicting as many elements as the policy requires
+ * (which may include the new node itself).
+ */
+void lru_cache_policy_insert(struct aws_lru_cache *cache, struct cache_node *node);
+
+/* Called as a node is removed from the table for any reason, before it is unlinked */
+void lru_cache_policy_on_destroy(struct aws_lru_cache *cache, struct cache_node *node);
+
+/* The node which would be evicted next, or NULL if the cache is empty */
+struct cache_node *lru_cache_policy_next_victim(const struct aws_lru_cache *cache);
+
+/* The node most recently added or used, or NULL if the cache is empty */
+struct cache_node *lru_cache_policy_mru(const struct aws_lru_cache *cache);
+
+#endif /* AWS_COMMON_PRIVATE_LRU_CACHE_IMPL_H */
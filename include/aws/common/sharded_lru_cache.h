@@ -0,0 +1,171 @@
+#ifndef AWS_COMMON_SHARDED_LRU_CACHE_H
+#define AWS_COMMON_SHARDED_LRU_CACHE_H
+
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/lru_cache.h>
+
+struct aws_sharded_lru_cache_shard;
+
+/**
+ * Called on a value found by aws_sharded_lru_cache_find(), before the shard's lock is released.
+ */
+typedef void(aws_sharded_lru_cache_acquire_fn)(void *value);
+
+/**
+ * A cache which may be used from any number of threads at once, with the same semantics as aws_lru_cache.
+ *
+ * Keys are spread over a power of 2 number of shards by hash, each an independent aws_lru_cache with its own mutex,
+ * so threads only contend when their keys land on the same shard. Each shard evicts on its own once it holds its
+ * share of max_items, so the cache as a whole is only approximately LRU.
+ *
+ * The callbacks are run with the shard's lock held, so they must not use the cache themselves. Once
+ * aws_sharded_lru_cache_find() has returned a value, another thread may evict or replace it at any time; if the
+ * cache destroys values, acquire_value_fn can take a reference to the value before that becomes possible.
+ */
+struct aws_sharded_lru_cache {
+    struct aws_allocator *allocator;
+    aws_hash_fn *hash_fn;
+    aws_sharded_lru_cache_acquire_fn *acquire_value_fn;
+    /* the budget for the whole cache, which caps the cost of any one element */
+    size_t max_cost;
+    struct aws_sharded_lru_cache_shard *shards;
+    /* always a power of 2 */
+    size_t shard_count;
+    /* shift applied to the mixed hash to pick a shard */
+    size_t shard_shift;
+};
+
+/**
+ * Options for aws_sharded_lru_cache_init(). The callbacks and policy are as for aws_lru_cache_init_with_options(),
+ * and must be safe to call from any thread.
+ */
+struct aws_sharded_lru_cache_options {
+    aws_hash_fn *hash_fn;
+    aws_hash_callback_eq_fn *equals_fn;
+    aws_hash_callback_destroy_fn *destroy_key_fn;
+    aws_hash_callback_destroy_fn *destroy_value_fn;
+    /* optional */
+    aws_sharded_lru_cache_acquire_fn *acquire_value_fn;
+    /* for the whole cache: each shard holds up to max_items / shard_count, rounded up */
+    size_t max_items;
+    /* rounded up to a power of 2; if 0, the processor count is used */
+    size_t shard_count;
+    enum aws_lru_cache_policy policy;
+    /*
+     * optional, for the whole cache: each shard's budget is max_cost / shard_count, rounded up. An element may cost
+     * up to max_cost itself; one over its shard's budget evicts everything else in the shard, so the cache may hold
+     * more than max_cost until those shards next evict.
+     */
+    size_t max_cost;
+    /* optional */
+    aws_lru_cache_cost_fn *cost_fn;
+    /* optional: expired elements are removed when found, or by aws_sharded_lru_cache_purge_expired() */
+    uint64_t ttl;
+    aws_lru_cache_clock_fn *clock_fn;
+};
+
+/**
+ * Totals over every shard, as returned by aws_sharded_lru_cache_get_stats().
+ */
+struct aws_sharded_lru_cache_stats {
+    size_t element_count;
+    size_t total_cost;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t expirations;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Initializes the cache and all its shards.
+ */
+AWS_COMMON_API
+int aws_sharded_lru_cache_init(
+    struct aws_sharded_lru_cache *cache,
+    struct aws_allocator *allocator,
+    const struct aws_sharded_lru_cache_options *options);
+
+/**
+ * Cleans up the cache. Elements in the cache will be evicted and cleanup callbacks will be invoked. No other thread
+ * may be using the cache. Idempotent.
+ */
+AWS_COMMON_API
+void aws_sharded_lru_cache_clean_up(struct aws_sharded_lru_cache *cache);
+
+/**
+ * Finds element in the cache by key, as aws_lru_cache_find() does, locking only the key's shard. If it is found and
+ * acquire_value_fn was set, that is called on the value before the lock is released.
+ */
+AWS_COMMON_API
+int aws_sharded_lru_cache_find(struct aws_sharded_lru_cache *cache, const void *key, void **p_value);
+
+/**
+ * Puts `p_value` at `key`, as aws_lru_cache_put() does, locking only the key's shard. If the shard is full, its
+ * least-recently-used item will be removed.
+ */
+AWS_COMMON_API
+int aws_sharded_lru_cache_put(struct aws_sharded_lru_cache *cache, const void *key, void *p_value);
+
+/**
+ * Puts `p_value` at `key` with the given cost, as aws_lru_cache_put_with_cost() does, locking only the key's shard.
+ * The cost may be up to the cache's max_cost, even if that is over the shard's budget; if it is over max_cost,
+ * AWS_ERROR_INVALID_ARGUMENT is raised and the cache is left unchanged.
+ */
+AWS_COMMON_API
+int aws_sharded_lru_cache_put_with_cost(
+    struct aws_sharded_lru_cache *cache,
+    const void *key,
+    void *p_value,
+    size_t cost);
+
+/**
+ * Removes item at `key` from the cache, locking only the key's shard.
+ */
+AWS_COMMON_API
+int aws_sharded_lru_cache_remove(struct aws_sharded_lru_cache *cache, const void *key);
+
+/**
+ * Removes every element which expires at or before `current_time`, as aws_lru_cache_purge_expired() does, one shard
+ * at a time. Returns the number removed.
+ */
+AWS_COMMON_API
+size_t aws_sharded_lru_cache_purge_expired(struct aws_sharded_lru_cache *cache, uint64_t current_time);
+
+/**
+ * Clears all items from the cache, one shard at a time.
+ */
+AWS_COMMON_API
+void aws_sharded_lru_cache_clear(struct aws_sharded_lru_cache *cache);
+
+/**
+ * Returns the number of elements in the cache. With other threads using the cache this is only a snapshot.
+ */
+AWS_COMMON_API
+size_t aws_sharded_lru_cache_get_element_count(struct aws_sharded_lru_cache *cache);
+
+/**
+ * Adds up the statistics of every shard since init. Shards are locked one at a time, so with other threads using the
+ * cache this is only a snapshot.
+ */
+AWS_COMMON_API
+void aws_sharded_lru_cache_get_stats(struct aws_sharded_lru_cache *cache, struct aws_sharded_lru_cache_stats *stats);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_COMMON_SHARDED_LRU_CACHE_H */
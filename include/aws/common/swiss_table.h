@@ -0,0 +1,133 @@
+#ifndef AWS_COMMON_SWISS_TABLE_H
+#define AWS_COMMON_SWISS_TABLE_H
+
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/hash_table.h>
+
+/**
+ * Swiss table: an open addressing hash table with the same callbacks and element semantics as aws_hash_table, laid
+ * out for fast probing at high load factors.
+ *
+ * Alongside the array of slots (key and value, 16 bytes each) the table keeps one control byte per slot: either
+ * "empty", "deleted", or 7 bits of the key's hash. Lookups compare a group of 16 control bytes at once (with SSE2
+ * where available, a scalar loop elsewhere) and only touch the slots whose hash bits match, so a probe usually costs
+ * one control byte load plus one slot, even when the table is 7/8 full. The hash code itself isn't stored, so
+ * resizing calls hash_fn again for every key.
+ *
+ * A table initialized with size 0 allocates no memory until the first element is inserted.
+ *
+ * As with aws_hash_table, pointers to elements are invalidated by any operation which may change the number of
+ * elements, and concurrent use is only safe for non-mutating operations.
+ */
+struct aws_swiss_table {
+    struct aws_allocator *alloc;
+    aws_hash_fn *hash_fn;
+    aws_hash_callback_eq_fn *equals_fn;
+    aws_hash_callback_destroy_fn *destroy_key_fn;
+    aws_hash_callback_destroy_fn *destroy_value_fn;
+    /* capacity slots, followed by capacity + AWS_SWISS_TABLE_GROUP_WIDTH control bytes, in one allocation */
+    struct aws_hash_element *slots;
+    int8_t *ctrl;
+    /* always 0 or a power of 2, no smaller than AWS_SWISS_TABLE_GROUP_WIDTH */
+    size_t capacity;
+    size_t entry_count;
+    /* number of empty slots which may still be filled before the table must be rehashed */
+    size_t growth_left;
+};
+
+#define AWS_SWISS_TABLE_GROUP_WIDTH 16
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Initializes a swiss table with room for size elements before it has to grow. If size is 0, no memory is allocated
+ * until the first insertion. The callbacks behave exactly as for aws_hash_table_init().
+ */
+AWS_COMMON_API
+int aws_swiss_table_init(
+    struct aws_swiss_table *table,
+    struct aws_allocator *alloc,
+    size_t size,
+    aws_hash_fn *hash_fn,
+    aws_hash_callback_eq_fn *equals_fn,
+    aws_hash_callback_destroy_fn *destroy_key_fn,
+    aws_hash_callback_destroy_fn *destroy_value_fn);
+
+/**
+ * Destroys every element and frees all memory. The table must be initialized again before re-use. Idempotent.
+ */
+AWS_COMMON_API
+void aws_swiss_table_clean_up(struct aws_swiss_table *table);
+
+/**
+ * Returns the number of elements in the table.
+ */
+AWS_COMMON_API
+size_t aws_swiss_table_get_entry_count(const struct aws_swiss_table *table);
+
+/**
+ * Looks up key. *p_elem is set to the element if found, or NULL otherwise. Always returns AWS_OP_SUCCESS.
+ * See aws_hash_table_find().
+ */
+AWS_COMMON_API
+int aws_swiss_table_find(const struct aws_swiss_table *table, const void *key, struct aws_hash_element **p_elem);
+
+/**
+ * Looks up key, inserting it with a NULL value if it isn't there. See aws_hash_table_create().
+ */
+AWS_COMMON_API
+int aws_swiss_table_create(
+    struct aws_swiss_table *table,
+    const void *key,
+    struct aws_hash_element **p_elem,
+    int *was_created);
+
+/**
+ * Inserts or overwrites key with value, destroying any key and value it replaces. See aws_hash_table_put().
+ */
+AWS_COMMON_API
+int aws_swiss_table_put(struct aws_swiss_table *table, const void *key, void *value, int *was_created);
+
+/**
+ * Removes key. If p_value is non-NULL the removed element is moved into it and the destroy callbacks are not run.
+ * See aws_hash_table_remove().
+ */
+AWS_COMMON_API
+int aws_swiss_table_remove(
+    struct aws_swiss_table *table,
+    const void *key,
+    struct aws_hash_element *p_value,
+    int *was_present);
+
+/**
+ * Calls callback for every element, with the same return value semantics as aws_hash_table_foreach().
+ */
+AWS_COMMON_API
+int aws_swiss_table_foreach(
+    struct aws_swiss_table *table,
+    int (*callback)(void *context, struct aws_hash_element *p_element),
+    void *context);
+
+/**
+ * Destroys every element, keeping the memory for re-use.
+ */
+AWS_COMMON_API
+void aws_swiss_table_clear(struct aws_swiss_table *table);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_COMMON_SWISS_TABLE_H */
@@ -24,6 +24,35 @@ AWS_EXTERN_C_BEGIN
 AWS_COMMON_API
 size_t aws_system_info_processor_count(void);
 
+/*
+ * CPU groups are the NUMA nodes of the machine: CPUs in the same group share the same local memory. Machines (or
+ * platforms) without NUMA information report a single group holding every processor.
+ */
+struct aws_cpu_info {
+    int32_t cpu_id;
+    /* true if this cpu shares a physical core with a lower numbered cpu */
+    bool suspected_hyper_thread;
+};
+
+/* Returns the number of cpu groups (NUMA nodes), always at least 1. */
+AWS_COMMON_API
+uint16_t aws_get_cpu_group_count(void);
+
+/* Returns the number of cpus in cpu group group_idx, or 0 if there is no such group. */
+AWS_COMMON_API
+size_t aws_get_cpu_count_for_group(uint16_t group_idx);
+
+/*
+ * Fills in cpu_ids_array with up to cpu_ids_array_length cpus belonging to group_idx, in ascending order of id.
+ * Unused entries have a cpu_id of -1.
+ */
+AWS_COMMON_API
+void aws_get_cpu_ids_for_group(uint16_t group_idx, struct aws_cpu_info *cpu_ids_array, size_t cpu_ids_array_length);
+
+/* Returns the cpu group of the cpu the calling thread is currently running on, or 0 if it can't be determined. */
+AWS_COMMON_API
+uint16_t aws_get_current_cpu_group(void);
+
 /* Returns true if a debugger is currently attached to the process. */
 AWS_COMMON_API
 bool aws_is_debugger_present(void);
@@ -32,6 +61,20 @@ bool aws_is_debugger_present(void);
 AWS_COMMON_API
 void aws_debug_break(void);
 
+/*
+ * Captures the call stack of the calling thread into stack_frames, at most num_frames deep, starting with the
+ * caller of aws_backtrace(). Returns the number of frames captured, which is 0 where this is not supported.
+ */
+AWS_COMMON_API
+size_t aws_backtrace(void **stack_frames, size_t num_frames);
+
+/*
+ * Converts stack frames captured by aws_backtrace() into human readable strings. Returns an array of stack_depth
+ * strings which must be released with a single call to free(), or NULL on failure.
+ */
+AWS_COMMON_API
+char **aws_backtrace_symbols(void *const *stack_frames, size_t stack_depth);
+
 AWS_EXTERN_C_END
 
 #endif /* AWS_COMMON_SYSTEM_INFO_H */
@@ -46,11 +46,46 @@ struct aws_task {
     size_t reserved;
 };
 
+struct aws_task_scheduler_timer_wheel;
+
+/**
+ * How a task scheduler keeps the tasks scheduled to run at specific times.
+ */
+enum aws_task_scheduler_timer_backend {
+    /**
+     * A heap ordered by run time: O(log n) to schedule or cancel a task.
+     */
+    AWS_TASK_SCHEDULER_TIMER_HEAP,
+    /**
+     * A hierarchical timing wheel (Varghese and Lauck) in front of the heap: O(1) to schedule or cancel a task due
+     * after the current tick. Tasks only move into the heap, to be run in order, once run_all reaches their tick (or,
+     * for a task due far in the future, the span of wheel slots containing it), so tasks cancelled before then never
+     * touch the heap. Suits large numbers of timeouts which mostly never fire. The wheel starts turning at the first
+     * aws_task_scheduler_run_all(); tasks scheduled before that go into the heap.
+     */
+    AWS_TASK_SCHEDULER_TIMER_WHEEL,
+};
+
+/**
+ * Options for aws_task_scheduler_init_with_options().
+ */
+struct aws_task_scheduler_options {
+    enum aws_task_scheduler_timer_backend timer_backend;
+    /**
+     * AWS_TASK_SCHEDULER_TIMER_WHEEL only: the length of a tick of the wheel, in the units of the times passed to the
+     * scheduler (nanoseconds, for the usual clocks). If 0, 1 millisecond. The wheel spans 2^36 ticks; tasks due
+     * further ahead than that go straight into the heap.
+     */
+    uint64_t wheel_tick;
+};
+
 struct aws_task_scheduler {
     struct aws_allocator *alloc;
     struct aws_priority_queue timed_queue; /* Tasks scheduled to run at specific times */
     struct aws_linked_list timed_list;     /* If timed_queue runs out of memory, further timed tests are stored here */
     struct aws_linked_list asap_list;      /* Tasks scheduled to run as soon as possible */
+    /* With AWS_TASK_SCHEDULER_TIMER_WHEEL, tasks scheduled beyond the current tick. Otherwise NULL. */
+    struct aws_task_scheduler_timer_wheel *timer_wheel;
 };
 
 AWS_EXTERN_C_BEGIN
@@ -73,6 +108,16 @@ void aws_task_run(struct aws_task *task, enum aws_task_status status);
 AWS_COMMON_API
 int aws_task_scheduler_init(struct aws_task_scheduler *scheduler, struct aws_allocator *alloc);
 
+/**
+ * Initializes a task scheduler instance with the choice of timer backend. Whichever backend is chosen, tasks run in
+ * the same order: aws_task_scheduler_run_all() runs tasks scheduled now first, then due tasks by their run time.
+ */
+AWS_COMMON_API
+int aws_task_scheduler_init_with_options(
+    struct aws_task_scheduler *scheduler,
+    struct aws_allocator *alloc,
+    const struct aws_task_scheduler_options *options);
+
 /**
  * Empties and executes all queued tasks, passing the AWS_TASK_STATUS_CANCELED status to the task function.
  * Cleans up any memory allocated, and prepares the instance for reuse or deletion.
@@ -87,6 +132,8 @@ bool aws_task_scheduler_is_valid(const struct aws_task_scheduler *scheduler);
  * Returns whether the scheduler has any scheduled tasks.
  * next_task_time (optional) will be set to time of the next task, note that 0 will be set if tasks were
  * added via aws_task_scheduler_schedule_now() and UINT64_MAX will be set if no tasks are scheduled at all.
+ * With AWS_TASK_SCHEDULER_TIMER_WHEEL, if the next task is still on the wheel this is the start of the span of
+ * wheel slots holding it, which may be earlier (running the scheduler then narrows it down). It is never later.
  */
 AWS_COMMON_API
 bool aws_task_scheduler_has_tasks(const struct aws_task_scheduler *scheduler, uint64_t *next_task_time);
@@ -108,6 +155,20 @@ void aws_task_scheduler_schedule_future(
     struct aws_task *task,
     uint64_t time_to_run);
 
+/**
+ * Moves a scheduled task to run at time_to_run instead, without invoking it, e.g. to push back a timeout. This is
+ * cheaper than cancelling the task and scheduling it again: a task waiting in the heap is sifted once from where it
+ * is, and one on the timer wheel, or scheduled now, is unlinked and filed again in constant time.
+ * The task must have been initialized with aws_task_init(), and not be scheduled with any other scheduler. If it was
+ * never scheduled, or has since run or been cancelled, this is the same as aws_task_scheduler_schedule_future(). If
+ * it is due in the aws_task_scheduler_run_all() in progress but has not run yet, it will not run there.
+ */
+AWS_COMMON_API
+void aws_task_scheduler_reschedule_future(
+    struct aws_task_scheduler *scheduler,
+    struct aws_task *task,
+    uint64_t time_to_run);
+
 /**
  * Removes task from the scheduler and invokes the task with the AWS_TASK_STATUS_CANCELED status.
  */
@@ -132,6 +132,14 @@ typedef void(aws_thread_atexit_fn)(void *user_data);
 AWS_COMMON_API
 int aws_thread_current_at_exit(aws_thread_atexit_fn *callback, void *user_data);
 
+/**
+ * Restricts the calling thread to the cpus of cpu_group (see aws_get_cpu_group_count()), so that it stays on the
+ * same NUMA node as the memory it works on. Raises AWS_ERROR_UNSUPPORTED_OPERATION on platforms without thread
+ * affinity.
+ */
+AWS_COMMON_API
+int aws_thread_current_bind_to_cpu_group(uint16_t cpu_group);
+
 AWS_EXTERN_C_END
 
 #endif /* AWS_COMMON_THREAD_H */
@@ -72,6 +72,19 @@ struct aws_allocator *aws_default_allocator(void) {
     return &default_allocator;
 }
 
+int aws_allocator_get_stats(struct aws_allocator *allocator, struct aws_allocator_stats *stats) {
+    AWS_PRECONDITION(aws_allocator_is_valid(allocator));
+    AWS_PRECONDITION(stats);
+
+    AWS_ZERO_STRUCT(*stats);
+    if (!allocator->mem_stats) {
+        return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+    }
+
+    allocator->mem_stats(allocator, stats);
+    return AWS_OP_SUCCESS;
+}
+
 void *aws_mem_acquire(struct aws_allocator *allocator, size_t size) {
     AWS_FATAL_PRECONDITION(allocator != NULL);
     AWS_FATAL_PRECONDITION(allocator->mem_acquire != NULL);
@@ -181,6 +194,103 @@ void aws_mem_release(struct aws_allocator *allocator, void *ptr) {
     }
 }
 
+void aws_mem_release_sized(struct aws_allocator *allocator, void *ptr, size_t size) {
+    AWS_FATAL_PRECONDITION(allocator != NULL);
+    AWS_FATAL_PRECONDITION(allocator->mem_release != NULL);
+
+    if (ptr != NULL) {
+        if (allocator->mem_release_sized) {
+            allocator->mem_release_sized(allocator, ptr, size);
+        } else {
+            allocator->mem_release(allocator, ptr);
+        }
+    }
+}
+
+int aws_mem_acquire_batch(struct aws_allocator *allocator, size_t size, size_t count, void **out_ptrs) {
+    AWS_FATAL_PRECONDITION(allocator != NULL);
+    AWS_FATAL_PRECONDITION(allocator->mem_acquire != NULL);
+    AWS_FATAL_PRECONDITION(size != 0);
+    AWS_PRECONDITION(out_ptrs || count == 0);
+
+    size_t acquired = 0;
+    if (allocator->mem_acquire_batch) {
+        acquired = allocator->mem_acquire_batch(allocator, size, count, out_ptrs);
+        AWS_FATAL_ASSERT(acquired <= count);
+    }
+
+    /* whatever the allocator couldn't (or doesn't know how to) batch, one at a time */
+    for (; acquired < count; ++acquired) {
+        out_ptrs[acquired] = allocator->mem_acquire(allocator, size);
+        if (!out_ptrs[acquired]) {
+            aws_mem_release_batch(allocator, out_ptrs, acquired, size);
+            return aws_raise_error(AWS_ERROR_OOM);
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+void aws_mem_release_batch(struct aws_allocator *allocator, void **ptrs, size_t count, size_t size) {
+    AWS_FATAL_PRECONDITION(allocator != NULL);
+    AWS_FATAL_PRECONDITION(allocator->mem_release != NULL);
+    AWS_PRECONDITION(ptrs || count == 0);
+
+    if (allocator->mem_release_batch) {
+        allocator->mem_release_batch(allocator, ptrs, count, size);
+        return;
+    }
+
+    for (size_t idx = 0; idx < count; ++idx) {
+        aws_mem_release_sized(allocator, ptrs[idx], size);
+    }
+}
+
+/* batches for the free list variants are gathered on the stack, this many at a time */
+enum { S_BATCH_LIST_STRIDE = 64 };
+
+void *aws_mem_acquire_batch_list(struct aws_allocator *allocator, size_t size, size_t count) {
+    AWS_FATAL_PRECONDITION(size >= sizeof(void *));
+
+    void *ptrs[S_BATCH_LIST_STRIDE];
+    void *head = NULL;
+    void **tail_next = &head;
+
+    /* the list comes out in the order the allocator handed the memory out */
+    while (count > 0) {
+        const size_t stride = count < S_BATCH_LIST_STRIDE ? count : S_BATCH_LIST_STRIDE;
+        if (aws_mem_acquire_batch(allocator, size, stride, ptrs)) {
+            aws_mem_release_batch_list(allocator, head, size);
+            return NULL;
+        }
+
+        for (size_t idx = 0; idx < stride; ++idx) {
+            *tail_next = ptrs[idx];
+            tail_next = (void **)ptrs[idx];
+            *tail_next = NULL;
+        }
+        count -= stride;
+    }
+
+    return head;
+}
+
+void aws_mem_release_batch_list(struct aws_allocator *allocator, void *list, size_t size) {
+    void *ptrs[S_BATCH_LIST_STRIDE];
+    size_t count = 0;
+
+    while (list) {
+        ptrs[count++] = list;
+        list = *(void **)list;
+        if (count == S_BATCH_LIST_STRIDE) {
+            aws_mem_release_batch(allocator, ptrs, count, size);
+            count = 0;
+        }
+    }
+
+    aws_mem_release_batch(allocator, ptrs, count, size);
+}
+
 int aws_mem_realloc(struct aws_allocator *allocator, void **ptr, size_t oldsize, size_t newsize) {
     AWS_FATAL_PRECONDITION(allocator != NULL);
     AWS_FATAL_PRECONDITION(allocator->mem_realloc || allocator->mem_acquire);
@@ -215,7 +325,7 @@ int aws_mem_realloc(struct aws_allocator *allocator, void **ptr, size_t oldsize,
     memcpy(newptr, *ptr, oldsize);
     memset((uint8_t *)newptr + oldsize, 0, newsize - oldsize);
 
-    aws_mem_release(allocator, *ptr);
+    aws_mem_release_sized(allocator, *ptr, oldsize);
 
     *ptr = newptr;
 
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/assert.h>
+#include <aws/common/common.h>
+#include <aws/common/math.h>
+
+/*
+ * Arena Allocator
+ * Allocations are bumped out of the initial storage (if any), then out of a chain of chunks acquired from the
+ * parent allocator. Nothing is released individually; reset rewinds to the start of the initial storage and
+ * keeps the chunks for re-use, so an arena that has warmed up makes no calls to its parent at all.
+ */
+
+/* Same alignment guarantee as aws_mem_acquire_many */
+enum { S_ARENA_ALIGNMENT = sizeof(intmax_t) };
+
+#define AWS_ARENA_ROUND_UP(value) (((value) + (S_ARENA_ALIGNMENT - 1)) & ~((size_t)S_ARENA_ALIGNMENT - 1))
+
+struct aws_arena_chunk {
+    struct aws_arena_chunk *next;
+    size_t capacity;
+    /* chunk memory follows, aligned to S_ARENA_ALIGNMENT */
+};
+
+static const size_t s_chunk_header_size = AWS_ARENA_ROUND_UP(sizeof(struct aws_arena_chunk));
+
+static uint8_t *s_chunk_begin(struct aws_arena_chunk *chunk) {
+    return (uint8_t *)chunk + s_chunk_header_size;
+}
+
+static uint8_t *s_chunk_end(struct aws_arena_chunk *chunk) {
+    return s_chunk_begin(chunk) + chunk->capacity;
+}
+
+/* Rounds size up to S_ARENA_ALIGNMENT, raising AWS_ERROR_OOM if that doesn't fit in a size_t */
+static int s_arena_round_up(size_t size, size_t *rounded) {
+    size_t padded = 0;
+    if (aws_add_size_checked(size, S_ARENA_ALIGNMENT - 1, &padded)) {
+        return aws_raise_error(AWS_ERROR_OOM);
+    }
+    *rounded = padded & ~((size_t)S_ARENA_ALIGNMENT - 1);
+    return AWS_OP_SUCCESS;
+}
+
+static void *s_arena_mem_acquire(struct aws_allocator *allocator, size_t size);
+static void s_arena_mem_release(struct aws_allocator *allocator, void *ptr);
+static void *s_arena_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size);
+static void s_arena_mem_stats(struct aws_allocator *allocator, struct aws_allocator_stats *stats);
+
+/* Points the bump region at the start of the initial storage, or the first chunk if there is none */
+static void s_arena_rewind(struct aws_arena_allocator *arena) {
+    arena->stats.bytes_in_use = 0;
+    arena->last_alloc = NULL;
+    arena->current_chunk = NULL;
+    if (arena->initial_storage) {
+        arena->cursor = arena->initial_storage;
+        arena->end = arena->initial_storage + arena->initial_storage_size;
+    } else {
+        arena->cursor = NULL;
+        arena->end = NULL;
+    }
+}
+
+int aws_arena_allocator_init(
+    struct aws_arena_allocator *arena,
+    struct aws_allocator *parent,
+    void *initial_storage,
+    size_t initial_storage_size,
+    size_t chunk_size) {
+    AWS_PRECONDITION(arena);
+    AWS_PRECONDITION(aws_allocator_is_valid(parent));
+    AWS_PRECONDITION(initial_storage || initial_storage_size == 0);
+
+    AWS_ZERO_STRUCT(*arena);
+    arena->allocator.mem_acquire = s_arena_mem_acquire;
+    arena->allocator.mem_release = s_arena_mem_release;
+    arena->allocator.mem_realloc = s_arena_mem_realloc;
+    arena->allocator.mem_stats = s_arena_mem_stats;
+    arena->allocator.impl = arena;
+    arena->parent = parent;
+    arena->chunk_size = chunk_size ? chunk_size : AWS_ARENA_DEFAULT_CHUNK_SIZE;
+
+    if (initial_storage) {
+        /* align the initial storage, it may be an arbitrary byte array on the stack */
+        uint8_t *begin = initial_storage;
+        uint8_t *aligned = (uint8_t *)AWS_ARENA_ROUND_UP((uintptr_t)begin);
+        if ((size_t)(aligned - begin) < initial_storage_size) {
+            arena->initial_storage = aligned;
+            arena->initial_storage_size = initial_storage_size - (size_t)(aligned - begin);
+        }
+    }
+    arena->stats.bytes_reserved = arena->initial_storage_size;
+
+    s_arena_rewind(arena);
+    return AWS_OP_SUCCESS;
+}
+
+void aws_arena_allocator_reset(struct aws_arena_allocator *arena) {
+    AWS_PRECONDITION(arena);
+    s_arena_rewind(arena);
+}
+
+void aws_arena_allocator_clean_up(struct aws_arena_allocator *arena) {
+    AWS_PRECONDITION(arena);
+
+    struct aws_arena_chunk *chunk = arena->chunks;
+    while (chunk) {
+        struct aws_arena_chunk *next = chunk->next;
+        aws_mem_release(arena->parent, chunk);
+        chunk = next;
+    }
+
+    AWS_ZERO_STRUCT(*arena);
+}
+
+/* Moves the bump region to the next chunk that can hold size bytes, acquiring a new chunk if necessary */
+static int s_arena_next_chunk(struct aws_arena_allocator *arena, size_t size) {
+    struct aws_arena_chunk *prev = arena->current_chunk;
+    struct aws_arena_chunk *next = prev ? prev->next : arena->chunks;
+
+    /* re-use chunks left over from before the last reset */
+    if (!next || next->capacity < size) {
+        const size_t capacity = size > arena->chunk_size ? size : arena->chunk_size;
+        size_t alloc_size = 0;
+        if (aws_add_size_checked(s_chunk_header_size, capacity, &alloc_size)) {
+            return aws_raise_error(AWS_ERROR_OOM);
+        }
+        struct aws_arena_chunk *chunk = aws_mem_acquire(arena->parent, alloc_size);
+        if (!chunk) {
+            return AWS_OP_ERR;
+        }
+        chunk->capacity = capacity;
+        arena->stats.bytes_reserved += alloc_size;
+
+        /* insert after the current chunk, so it will be tried first after a reset, too */
+        chunk->next = next;
+        if (prev) {
+            prev->next = chunk;
+        } else {
+            arena->chunks = chunk;
+        }
+        next = chunk;
+    }
+
+    arena->current_chunk = next;
+    arena->cursor = s_chunk_begin(next);
+    arena->end = s_chunk_end(next);
+    return AWS_OP_SUCCESS;
+}
+
+/* bytes_in_use counts bump space consumed since the last reset, including alignment padding */
+static void s_arena_add_in_use(struct aws_arena_allocator *arena, size_t size) {
+    arena->stats.bytes_in_use += size;
+    if (arena->stats.bytes_in_use > arena->stats.bytes_in_use_peak) {
+        arena->stats.bytes_in_use_peak = arena->stats.bytes_in_use;
+    }
+}
+
+static void *s_arena_mem_acquire(struct aws_allocator *allocator, size_t size) {
+    struct aws_arena_allocator *arena = allocator->impl;
+    if (s_arena_round_up(size, &size)) {
+        return NULL;
+    }
+
+    if ((size_t)(arena->end - arena->cursor) < size && s_arena_next_chunk(arena, size)) {
+        return NULL;
+    }
+
+    uint8_t *mem = arena->cursor;
+    arena->cursor += size;
+    arena->last_alloc = mem;
+    s_arena_add_in_use(arena, size);
+    ++arena->stats.acquire_count;
+    return mem;
+}
+
+static void s_arena_mem_release(struct aws_allocator *allocator, void *ptr) {
+    struct aws_arena_allocator *arena = allocator->impl;
+
+    /* memory is reclaimed all at once by reset, but the most recent allocation can be given back cheaply */
+    if (ptr && ptr == arena->last_alloc) {
+        arena->stats.bytes_in_use -= (size_t)(arena->cursor - arena->last_alloc);
+        arena->cursor = arena->last_alloc;
+        arena->last_alloc = NULL;
+    }
+    if (ptr) {
+        ++arena->stats.release_count;
+    }
+}
+
+static void *s_arena_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size) {
+    struct aws_arena_allocator *arena = allocator->impl;
+
+    if (new_size == 0) {
+        s_arena_mem_release(allocator, old_ptr);
+        return NULL;
+    }
+
+    /* the most recent allocation can grow or shrink in place if the current region has room */
+    if (old_ptr && old_ptr == arena->last_alloc) {
+        size_t rounded = 0;
+        if (s_arena_round_up(new_size, &rounded)) {
+            return NULL;
+        }
+        if ((size_t)(arena->end - (uint8_t *)old_ptr) >= rounded) {
+            arena->stats.bytes_in_use -= (size_t)(arena->cursor - (uint8_t *)old_ptr);
+            s_arena_add_in_use(arena, rounded);
+            arena->cursor = (uint8_t *)old_ptr + rounded;
+            return old_ptr;
+        }
+    }
+
+    void *new_mem = s_arena_mem_acquire(allocator, new_size);
+    if (!new_mem) {
+        return NULL;
+    }
+
+    if (old_ptr && old_size) {
+        memcpy(new_mem, old_ptr, old_size < new_size ? old_size : new_size);
+    }
+
+    return new_mem;
+}
+
+static void s_arena_mem_stats(struct aws_allocator *allocator, struct aws_allocator_stats *stats) {
+    struct aws_arena_allocator *arena = allocator->impl;
+    *stats = arena->stats;
+}
@@ -0,0 +1,571 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/allocator.h>
+#include <aws/common/array_list.h>
+#include <aws/common/assert.h>
+#include <aws/common/atomics.h>
+#include <aws/common/linked_list.h>
+#include <aws/common/mutex.h>
+
+/*
+ * Small Block Allocator
+ * This is a fairly standard approach: the idea is to always allocate aligned pages of memory so that for
+ * any address you can round to the nearest page boundary to find the bookkeeping data. The idea is
+ * to reduce overhead per alloc and greatly improve runtime speed by doing as little actual allocation
+ * work as possible, preferring instead to re-use (hopefully still cached) chunks in FIFO order, or chunking
+ * from a page that is already resident. Pages are carved out of larger slabs acquired from the parent
+ * allocator, and are only handed back to the parent when the allocator is destroyed.
+ *
+ * Each bin serves a single power-of-two chunk size. A bin keeps a list of the pages that still have room;
+ * every page keeps its own free list, so both acquire and release are O(1). Pages that become completely
+ * empty are returned to a pool shared by all bins.
+ *
+ * Allocations larger than the biggest bin are passed through to the parent allocator untouched.
+ */
+
+#define AWS_SBA_PAGE_SIZE ((uintptr_t)(4096))
+#define AWS_SBA_PAGE_MASK ((uintptr_t) ~(AWS_SBA_PAGE_SIZE - 1))
+#define AWS_SBA_TAG_VALUE 0x736f6d6570736575ULL
+#define AWS_SBA_FIRST_CHUNK_OFFSET 64
+
+/* number of pages acquired from the parent allocator at once */
+#define AWS_SBA_PAGES_PER_SLAB 16
+
+/* list of sizes of bins, must be powers of 2, and small enough that several chunks fit in a page */
+#define AWS_SBA_BIN_COUNT 6
+static const size_t s_bin_sizes[AWS_SBA_BIN_COUNT] = {16, 32, 64, 128, 256, 512};
+static const size_t s_max_bin_size = 512;
+
+struct sba_bin {
+    size_t size;                 /* size of allocs in this bin */
+    struct aws_mutex mutex;      /* lock protecting this bin */
+    struct aws_linked_list pages; /* pages owned by this bin which have at least one free chunk */
+    size_t page_count;           /* number of pages owned by this bin */
+    size_t acquire_count;        /* chunks handed out from this bin, ever */
+    size_t release_count;        /* chunks returned to this bin, ever */
+};
+
+/* Header stored at the top of each page.
+ * Pages are aligned to AWS_SBA_PAGE_SIZE, so the header will always be at the start of the page. */
+struct page_header {
+    uint64_t tag;                    /* marker to identify/validate pages */
+    struct sba_bin *bin;             /* bin this page belongs to */
+    struct aws_linked_list_node node; /* membership in bin->pages, only valid while the page has room */
+    void *free_chunks;               /* singly linked list of released chunks */
+    uint8_t *bump;                   /* next never-used chunk, or NULL once the page has been fully carved */
+    uint32_t alloc_count;            /* number of outstanding allocations from this page */
+    uint32_t chunk_count;            /* number of chunks that fit in this page */
+    uint64_t tag2;
+};
+AWS_STATIC_ASSERT(sizeof(struct page_header) <= AWS_SBA_FIRST_CHUNK_OFFSET);
+
+/* Pages in the shared pool are linked through their first bytes */
+struct free_page {
+    struct free_page *next;
+};
+
+/* This is the impl for the aws_allocator */
+struct small_block_allocator {
+    struct aws_allocator *allocator; /* parent allocator, for large allocs and slabs */
+    struct sba_bin bins[AWS_SBA_BIN_COUNT];
+    struct aws_mutex page_mutex;      /* lock protecting the page pool and slab list */
+    struct free_page *free_pages;     /* pool of unused pages, shared by all bins */
+    struct aws_array_list slabs;      /* raw allocations from the parent allocator */
+    struct aws_atomic_var bytes_in_use;      /* across all bins */
+    struct aws_atomic_var bytes_in_use_peak;
+    bool multi_threaded;
+    int (*lock)(struct aws_mutex *);
+    int (*unlock)(struct aws_mutex *);
+};
+
+static int s_null_lock(struct aws_mutex *mutex) {
+    (void)mutex;
+    /* NO OP */
+    return 0;
+}
+
+static int s_null_unlock(struct aws_mutex *mutex) {
+    (void)mutex;
+    /* NO OP */
+    return 0;
+}
+
+static void *s_sba_mem_acquire(struct aws_allocator *allocator, size_t size);
+static void s_sba_mem_release(struct aws_allocator *allocator, void *ptr);
+static void s_sba_mem_release_sized(struct aws_allocator *allocator, void *ptr, size_t size);
+static void *s_sba_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size);
+static size_t s_sba_mem_acquire_batch(struct aws_allocator *allocator, size_t size, size_t count, void **ptrs);
+static void s_sba_mem_release_batch(struct aws_allocator *allocator, void **ptrs, size_t count, size_t size);
+static void s_sba_mem_stats(struct aws_allocator *allocator, struct aws_allocator_stats *stats);
+
+static struct aws_allocator s_sba_allocator = {
+    .mem_acquire = s_sba_mem_acquire,
+    .mem_release = s_sba_mem_release,
+    .mem_realloc = s_sba_mem_realloc,
+    .mem_release_sized = s_sba_mem_release_sized,
+    .mem_acquire_batch = s_sba_mem_acquire_batch,
+    .mem_release_batch = s_sba_mem_release_batch,
+    .mem_stats = s_sba_mem_stats,
+};
+
+static int s_sba_init(struct small_block_allocator *sba, struct aws_allocator *allocator, bool multi_threaded) {
+    sba->allocator = allocator;
+    sba->free_pages = NULL;
+    sba->multi_threaded = multi_threaded;
+    aws_atomic_init_int(&sba->bytes_in_use, 0);
+    aws_atomic_init_int(&sba->bytes_in_use_peak, 0);
+
+    if (aws_array_list_init_dynamic(&sba->slabs, allocator, 4, sizeof(void *))) {
+        return AWS_OP_ERR;
+    }
+
+    unsigned initialized_mutexes = 0;
+    for (unsigned idx = 0; idx < AWS_SBA_BIN_COUNT; ++idx) {
+        struct sba_bin *bin = &sba->bins[idx];
+        bin->size = s_bin_sizes[idx];
+        bin->page_count = 0;
+        bin->acquire_count = 0;
+        bin->release_count = 0;
+        aws_linked_list_init(&bin->pages);
+        if (multi_threaded) {
+            if (aws_mutex_init(&bin->mutex)) {
+                goto cleanup;
+            }
+            ++initialized_mutexes;
+        }
+    }
+
+    if (multi_threaded && aws_mutex_init(&sba->page_mutex)) {
+        goto cleanup;
+    }
+
+    sba->lock = multi_threaded ? aws_mutex_lock : s_null_lock;
+    sba->unlock = multi_threaded ? aws_mutex_unlock : s_null_unlock;
+
+    return AWS_OP_SUCCESS;
+
+cleanup:
+    for (unsigned idx = 0; idx < initialized_mutexes; ++idx) {
+        aws_mutex_clean_up(&sba->bins[idx].mutex);
+    }
+    aws_array_list_clean_up(&sba->slabs);
+    return AWS_OP_ERR;
+}
+
+static void s_sba_clean_up(struct small_block_allocator *sba) {
+    /* release all slabs, which takes every page (and therefore every outstanding small allocation) with them */
+    const size_t slab_count = aws_array_list_length(&sba->slabs);
+    for (size_t idx = 0; idx < slab_count; ++idx) {
+        void *slab = NULL;
+        aws_array_list_get_at(&sba->slabs, &slab, idx);
+        aws_mem_release(sba->allocator, slab);
+    }
+    aws_array_list_clean_up(&sba->slabs);
+
+    if (sba->multi_threaded) {
+        for (unsigned idx = 0; idx < AWS_SBA_BIN_COUNT; ++idx) {
+            aws_mutex_clean_up(&sba->bins[idx].mutex);
+        }
+        aws_mutex_clean_up(&sba->page_mutex);
+    }
+}
+
+struct aws_allocator *aws_small_block_allocator_new(struct aws_allocator *allocator, bool multi_threaded) {
+    AWS_PRECONDITION(aws_allocator_is_valid(allocator));
+
+    struct small_block_allocator *sba = NULL;
+    struct aws_allocator *sba_allocator = NULL;
+    aws_mem_acquire_many(
+        allocator, 2, &sba, sizeof(struct small_block_allocator), &sba_allocator, sizeof(struct aws_allocator));
+
+    if (!sba || !sba_allocator) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*sba);
+    /* copy the template vtable */
+    *sba_allocator = s_sba_allocator;
+    sba_allocator->impl = sba;
+
+    if (s_sba_init(sba, allocator, multi_threaded)) {
+        aws_mem_release(allocator, sba);
+        return NULL;
+    }
+    return sba_allocator;
+}
+
+void aws_small_block_allocator_destroy(struct aws_allocator *sba_allocator) {
+    if (!sba_allocator) {
+        return;
+    }
+    struct small_block_allocator *sba = sba_allocator->impl;
+    if (!sba) {
+        return;
+    }
+
+    struct aws_allocator *allocator = sba->allocator;
+    s_sba_clean_up(sba);
+    aws_mem_release(allocator, sba);
+}
+
+/* NOTE: Expects the page mutex to be held by the caller */
+static int s_sba_grow_page_pool(struct small_block_allocator *sba) {
+    /* over-allocate by a page so that the slab can always be aligned */
+    const size_t slab_size = (AWS_SBA_PAGES_PER_SLAB + 1) * AWS_SBA_PAGE_SIZE;
+    void *slab = aws_mem_acquire(sba->allocator, slab_size);
+    if (!slab) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_array_list_push_back(&sba->slabs, &slab)) {
+        aws_mem_release(sba->allocator, slab);
+        return AWS_OP_ERR;
+    }
+
+    uintptr_t first_page = ((uintptr_t)slab + AWS_SBA_PAGE_SIZE - 1) & AWS_SBA_PAGE_MASK;
+    const uintptr_t slab_end = (uintptr_t)slab + slab_size;
+    for (uintptr_t page = first_page; page + AWS_SBA_PAGE_SIZE <= slab_end; page += AWS_SBA_PAGE_SIZE) {
+        struct free_page *free_page = (struct free_page *)page;
+        free_page->next = sba->free_pages;
+        sba->free_pages = free_page;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/* Takes a page out of the shared pool and formats it for bin */
+static struct page_header *s_sba_alloc_page(struct small_block_allocator *sba, struct sba_bin *bin) {
+    struct page_header *page = NULL;
+
+    sba->lock(&sba->page_mutex);
+    if (!sba->free_pages && s_sba_grow_page_pool(sba)) {
+        goto done;
+    }
+    struct free_page *free_page = sba->free_pages;
+    sba->free_pages = free_page->next;
+    page = (struct page_header *)free_page;
+
+done:
+    sba->unlock(&sba->page_mutex);
+
+    if (!page) {
+        return NULL;
+    }
+
+    /* chunks start after the header, on a cache line boundary */
+    const size_t first_chunk_offset = AWS_SBA_FIRST_CHUNK_OFFSET;
+
+    page->tag = AWS_SBA_TAG_VALUE;
+    page->bin = bin;
+    aws_linked_list_node_reset(&page->node);
+    page->free_chunks = NULL;
+    page->bump = (uint8_t *)page + first_chunk_offset;
+    page->alloc_count = 0;
+    page->chunk_count = (uint32_t)((AWS_SBA_PAGE_SIZE - first_chunk_offset) / bin->size);
+    page->tag2 = AWS_SBA_TAG_VALUE;
+
+    return page;
+}
+
+/* Returns a completely empty page to the shared pool */
+static void s_sba_free_page(struct small_block_allocator *sba, struct page_header *page) {
+    /* clear the tags so this page is no longer recognized as a bin page */
+    page->tag = 0;
+    page->tag2 = 0;
+
+    struct free_page *free_page = (struct free_page *)page;
+    sba->lock(&sba->page_mutex);
+    free_page->next = sba->free_pages;
+    sba->free_pages = free_page;
+    sba->unlock(&sba->page_mutex);
+}
+
+static struct sba_bin *s_sba_find_bin(struct small_block_allocator *sba, size_t size) {
+    AWS_PRECONDITION(size <= s_max_bin_size);
+
+    for (unsigned idx = 0; idx < AWS_SBA_BIN_COUNT; ++idx) {
+        if (size <= s_bin_sizes[idx]) {
+            return &sba->bins[idx];
+        }
+    }
+
+    AWS_ASSERT(false);
+    return NULL;
+}
+
+/* NOTE: Expects the bin mutex to be held by the caller */
+static void *s_sba_alloc_from_bin_locked(struct small_block_allocator *sba, struct sba_bin *bin) {
+    struct page_header *page = NULL;
+    if (aws_linked_list_empty(&bin->pages)) {
+        page = s_sba_alloc_page(sba, bin);
+        if (!page) {
+            return NULL;
+        }
+        aws_linked_list_push_front(&bin->pages, &page->node);
+        ++bin->page_count;
+    } else {
+        page = AWS_CONTAINER_OF(aws_linked_list_front(&bin->pages), struct page_header, node);
+    }
+
+    void *chunk = NULL;
+    if (page->free_chunks) {
+        /* prefer recently released chunks, they are most likely to still be in cache */
+        chunk = page->free_chunks;
+        page->free_chunks = *(void **)chunk;
+    } else {
+        AWS_ASSERT(page->bump);
+        chunk = page->bump;
+        page->bump += bin->size;
+        if (page->bump + bin->size > (uint8_t *)page + AWS_SBA_PAGE_SIZE) {
+            page->bump = NULL;
+        }
+    }
+
+    /* page is full, stop offering it until a chunk is released */
+    if (++page->alloc_count == page->chunk_count) {
+        aws_linked_list_remove(&page->node);
+    }
+
+    ++bin->acquire_count;
+    return chunk;
+}
+
+static void s_sba_add_in_use(struct small_block_allocator *sba, size_t size) {
+    const size_t in_use = aws_atomic_fetch_add_explicit(&sba->bytes_in_use, size, aws_memory_order_relaxed) + size;
+    size_t peak = aws_atomic_load_int_explicit(&sba->bytes_in_use_peak, aws_memory_order_relaxed);
+    while (in_use > peak &&
+           !aws_atomic_compare_exchange_int_explicit(
+               &sba->bytes_in_use_peak, &peak, in_use, aws_memory_order_relaxed, aws_memory_order_relaxed)) {
+        /* peak was reloaded by the failed exchange */
+    }
+}
+
+static void *s_sba_alloc_from_bin(struct small_block_allocator *sba, struct sba_bin *bin) {
+    sba->lock(&bin->mutex);
+    void *chunk = s_sba_alloc_from_bin_locked(sba, bin);
+    sba->unlock(&bin->mutex);
+    if (chunk) {
+        s_sba_add_in_use(sba, bin->size);
+    }
+    return chunk;
+}
+
+/* Returns the page header for a chunk if it came from one of this allocator's bins, or NULL otherwise */
+static struct page_header *s_sba_find_page(struct small_block_allocator *sba, void *addr) {
+    struct page_header *page = (struct page_header *)((uintptr_t)addr & AWS_SBA_PAGE_MASK);
+    /* Check to see if this page is tagged by the sba. For allocations passed through to the parent this reads
+     * memory we didn't allocate, but it is always on the same page as addr, so it is always mapped. This is why
+     * s_sba_find_page is listed in sanitizer-blacklist.txt. */
+    if (page->tag == AWS_SBA_TAG_VALUE && page->tag2 == AWS_SBA_TAG_VALUE && page->bin >= &sba->bins[0] &&
+        page->bin < &sba->bins[AWS_SBA_BIN_COUNT]) {
+        return page;
+    }
+    return NULL;
+}
+
+/* NOTE: Expects the bin mutex to be held by the caller */
+static void s_sba_free_to_bin_locked(struct small_block_allocator *sba, struct page_header *page, void *addr) {
+    struct sba_bin *bin = page->bin;
+    AWS_PRECONDITION(((uintptr_t)addr - (uintptr_t)page - AWS_SBA_FIRST_CHUNK_OFFSET) % bin->size == 0);
+
+    AWS_FATAL_ASSERT(page->alloc_count > 0);
+    const bool was_full = page->alloc_count == page->chunk_count;
+
+    *(void **)addr = page->free_chunks;
+    page->free_chunks = addr;
+    --page->alloc_count;
+    ++bin->release_count;
+
+    if (page->alloc_count == 0 && bin->page_count > 1) {
+        /* page is empty and the bin has others to serve from, give it back to the pool */
+        if (!was_full) {
+            aws_linked_list_remove(&page->node);
+        }
+        --bin->page_count;
+        /* bin mutex before page mutex, the same order as s_sba_alloc_page() */
+        s_sba_free_page(sba, page);
+        return;
+    }
+
+    if (was_full) {
+        aws_linked_list_push_front(&bin->pages, &page->node);
+    }
+}
+
+static void s_sba_free_to_bin(struct small_block_allocator *sba, struct page_header *page, void *addr) {
+    struct sba_bin *bin = page->bin;
+    sba->lock(&bin->mutex);
+    s_sba_free_to_bin_locked(sba, page, addr);
+    sba->unlock(&bin->mutex);
+    aws_atomic_fetch_sub_explicit(&sba->bytes_in_use, bin->size, aws_memory_order_relaxed);
+}
+
+static void *s_sba_mem_acquire(struct aws_allocator *allocator, size_t size) {
+    struct small_block_allocator *sba = allocator->impl;
+    if (size == 0) {
+        return NULL;
+    }
+
+    if (size <= s_max_bin_size) {
+        struct sba_bin *bin = s_sba_find_bin(sba, size);
+        AWS_FATAL_ASSERT(bin);
+        return s_sba_alloc_from_bin(sba, bin);
+    }
+    return aws_mem_acquire(sba->allocator, size);
+}
+
+static void s_sba_mem_release(struct aws_allocator *allocator, void *ptr) {
+    struct small_block_allocator *sba = allocator->impl;
+    if (!ptr) {
+        return;
+    }
+
+    struct page_header *page = s_sba_find_page(sba, ptr);
+    if (page) {
+        s_sba_free_to_bin(sba, page, ptr);
+        return;
+    }
+
+    /* large alloc, give back to parent */
+    aws_mem_release(sba->allocator, ptr);
+}
+
+static void s_sba_mem_release_sized(struct aws_allocator *allocator, void *ptr, size_t size) {
+    struct small_block_allocator *sba = allocator->impl;
+    if (!ptr) {
+        return;
+    }
+
+    /* realloc never leaves a large allocation in a bin or vice versa, so the size alone says where ptr lives,
+     * and pass-through allocations don't need their (foreign) page header inspected */
+    if (size > s_max_bin_size) {
+        aws_mem_release_sized(sba->allocator, ptr, size);
+        return;
+    }
+
+    struct page_header *page = s_sba_find_page(sba, ptr);
+    AWS_FATAL_ASSERT(page);
+    s_sba_free_to_bin(sba, page, ptr);
+}
+
+static void *s_sba_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size) {
+    struct small_block_allocator *sba = allocator->impl;
+    /* If both allocations come from the parent, let the parent do it */
+    if (old_size > s_max_bin_size && new_size > s_max_bin_size) {
+        void *ptr = old_ptr;
+        if (aws_mem_realloc(sba->allocator, &ptr, old_size, new_size)) {
+            return NULL;
+        }
+        return ptr;
+    }
+
+    if (new_size == 0) {
+        s_sba_mem_release(allocator, old_ptr);
+        return NULL;
+    }
+
+    /* the existing chunk may already be big enough */
+    if (old_ptr && new_size <= s_max_bin_size) {
+        struct page_header *page = s_sba_find_page(sba, old_ptr);
+        if (page && new_size <= page->bin->size) {
+            return old_ptr;
+        }
+    }
+
+    void *new_mem = s_sba_mem_acquire(allocator, new_size);
+    if (!new_mem) {
+        return NULL;
+    }
+
+    if (old_ptr && old_size) {
+        memcpy(new_mem, old_ptr, old_size < new_size ? old_size : new_size);
+        s_sba_mem_release(allocator, old_ptr);
+    }
+
+    return new_mem;
+}
+
+/* A batch all comes from one bin, so the bin is locked once for the whole batch rather than once per chunk */
+static size_t s_sba_mem_acquire_batch(struct aws_allocator *allocator, size_t size, size_t count, void **ptrs) {
+    struct small_block_allocator *sba = allocator->impl;
+    if (size > s_max_bin_size) {
+        /* nothing to gain, let the caller acquire them from the parent one by one */
+        return 0;
+    }
+
+    struct sba_bin *bin = s_sba_find_bin(sba, size);
+    AWS_FATAL_ASSERT(bin);
+
+    size_t acquired = 0;
+    sba->lock(&bin->mutex);
+    for (; acquired < count; ++acquired) {
+        ptrs[acquired] = s_sba_alloc_from_bin_locked(sba, bin);
+        if (!ptrs[acquired]) {
+            break;
+        }
+    }
+    sba->unlock(&bin->mutex);
+
+    s_sba_add_in_use(sba, acquired * bin->size);
+    return acquired;
+}
+
+static void s_sba_mem_release_batch(struct aws_allocator *allocator, void **ptrs, size_t count, size_t size) {
+    struct small_block_allocator *sba = allocator->impl;
+    if (size > s_max_bin_size) {
+        for (size_t idx = 0; idx < count; ++idx) {
+            aws_mem_release_sized(sba->allocator, ptrs[idx], size);
+        }
+        return;
+    }
+
+    struct sba_bin *bin = s_sba_find_bin(sba, size);
+    AWS_FATAL_ASSERT(bin);
+
+    size_t released = 0;
+    sba->lock(&bin->mutex);
+    for (size_t idx = 0; idx < count; ++idx) {
+        if (!ptrs[idx]) {
+            continue;
+        }
+        struct page_header *page = s_sba_find_page(sba, ptrs[idx]);
+        AWS_FATAL_ASSERT(page && page->bin == bin);
+        s_sba_free_to_bin_locked(sba, page, ptrs[idx]);
+        ++released;
+    }
+    sba->unlock(&bin->mutex);
+
+    aws_atomic_fetch_sub_explicit(&sba->bytes_in_use, released * bin->size, aws_memory_order_relaxed);
+}
+
+static void s_sba_mem_stats(struct aws_allocator *allocator, struct aws_allocator_stats *stats) {
+    struct small_block_allocator *sba = allocator->impl;
+
+    for (unsigned idx = 0; idx < AWS_SBA_BIN_COUNT; ++idx) {
+        struct sba_bin *bin = &sba->bins[idx];
+        sba->lock(&bin->mutex);
+        stats->acquire_count += bin->acquire_count;
+        stats->release_count += bin->release_count;
+        sba->unlock(&bin->mutex);
+    }
+
+    sba->lock(&sba->page_mutex);
+    stats->bytes_reserved = aws_array_list_length(&sba->slabs) * (AWS_SBA_PAGES_PER_SLAB + 1) * AWS_SBA_PAGE_SIZE;
+    sba->unlock(&sba->page_mutex);
+
+    stats->bytes_in_use = aws_atomic_load_int_explicit(&sba->bytes_in_use, aws_memory_order_relaxed);
+    stats->bytes_in_use_peak = aws_atomic_load_int_explicit(&sba->bytes_in_use_peak, aws_memory_order_relaxed);
+}
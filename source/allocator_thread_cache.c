@@ -0,0 +1,521 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/allocator.h>
+#include <aws/common/array_list.h>
+#include <aws/common/assert.h>
+#include <aws/common/atomics.h>
+#include <aws/common/mutex.h>
+#include <aws/common/thread.h>
+
+/*
+ * Thread Cache Allocator
+ * A front-end for any aws_allocator which keeps a free list per size class in each thread, so that the common
+ * acquire/release path touches no shared state and takes no locks. Threads exchange blocks with a central free
+ * list per size class in batches: an empty thread cache refills a batch at a time, and a thread cache which grows
+ * past its high water mark flushes a batch back. Each thread's cache is drained to the central lists when the
+ * thread exits, via aws_thread_current_at_exit().
+ *
+ * Blocks for the central lists are carved out of larger chunks acquired from the backing allocator, and are only
+ * returned to it when the allocator is destroyed. Every block carries a small header recording its size class so
+ * that it can be released from any thread. Allocations larger than the biggest size class, and all allocations made
+ * from threads that were not started with aws_thread_launch(), bypass the thread caches.
+ */
+
+#define AWS_TC_CLASS_COUNT 7
+static const size_t s_class_sizes[AWS_TC_CLASS_COUNT] = {16, 32, 64, 128, 256, 512, 1024};
+static const size_t s_max_class_size = 1024;
+
+/* number of blocks moved between a thread cache and the central lists at once */
+#define AWS_TC_BATCH_SIZE 32
+/* a thread cache holding more than this many blocks of one class flushes a batch back */
+#define AWS_TC_HIGH_WATER_MARK (2 * AWS_TC_BATCH_SIZE)
+
+/* size class recorded in the header of allocations passed through to the backing allocator */
+#define AWS_TC_LARGE_CLASS SIZE_MAX
+
+/* Header in front of every block, sized to preserve the alignment of the backing allocator */
+struct block_header {
+    size_t size_class;
+    size_t reserved;
+};
+
+/* Free blocks are linked through the first bytes of their payload */
+struct free_block {
+    struct free_block *next;
+};
+
+struct free_list {
+    struct free_block *head;
+    size_t count;
+};
+
+struct central_class {
+    struct aws_mutex mutex;
+    struct free_list blocks;
+};
+
+/* This is the impl for the aws_allocator */
+struct thread_cache_allocator {
+    struct aws_allocator *allocator; /* backing allocator */
+    struct central_class classes[AWS_TC_CLASS_COUNT];
+    struct aws_mutex chunk_mutex; /* protects chunks */
+    struct aws_array_list chunks; /* raw allocations from the backing allocator */
+    struct aws_atomic_var thread_cache_count;
+};
+
+/* One per (thread, allocator) pair; each thread keeps its caches in a thread local singly linked list */
+struct thread_cache {
+    struct thread_cache_allocator *owner;
+    struct thread_cache *next;
+    struct free_list classes[AWS_TC_CLASS_COUNT];
+};
+
+enum thread_cache_state {
+    THREAD_CACHE_UNREGISTERED = 0,
+    THREAD_CACHE_REGISTERED,
+    THREAD_CACHE_UNSUPPORTED,
+};
+
+static AWS_THREAD_LOCAL struct thread_cache *tl_thread_caches = NULL;
+static AWS_THREAD_LOCAL int tl_thread_cache_state = THREAD_CACHE_UNREGISTERED;
+
+static void *s_tc_mem_acquire(struct aws_allocator *allocator, size_t size);
+static void s_tc_mem_release(struct aws_allocator *allocator, void *ptr);
+static void *s_tc_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size);
+static size_t s_tc_mem_acquire_batch(struct aws_allocator *allocator, size_t size, size_t count, void **ptrs);
+static void s_tc_mem_release_batch(struct aws_allocator *allocator, void **ptrs, size_t count, size_t size);
+
+static struct aws_allocator s_tc_allocator = {
+    .mem_acquire = s_tc_mem_acquire,
+    .mem_release = s_tc_mem_release,
+    .mem_realloc = s_tc_mem_realloc,
+    .mem_acquire_batch = s_tc_mem_acquire_batch,
+    .mem_release_batch = s_tc_mem_release_batch,
+};
+
+struct aws_allocator *aws_thread_cache_allocator_new(struct aws_allocator *allocator) {
+    AWS_PRECONDITION(aws_allocator_is_valid(allocator));
+
+    struct thread_cache_allocator *tca = NULL;
+    struct aws_allocator *tc_allocator = NULL;
+    unsigned initialized_mutexes = 0;
+    aws_mem_acquire_many(
+        allocator, 2, &tca, sizeof(struct thread_cache_allocator), &tc_allocator, sizeof(struct aws_allocator));
+
+    if (!tca || !tc_allocator) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*tca);
+    *tc_allocator = s_tc_allocator;
+    tc_allocator->impl = tca;
+    tca->allocator = allocator;
+    aws_atomic_init_int(&tca->thread_cache_count, 0);
+
+    if (aws_array_list_init_dynamic(&tca->chunks, allocator, 4, sizeof(void *))) {
+        goto error;
+    }
+
+    for (unsigned idx = 0; idx < AWS_TC_CLASS_COUNT; ++idx) {
+        if (aws_mutex_init(&tca->classes[idx].mutex)) {
+            goto cleanup_mutexes;
+        }
+        ++initialized_mutexes;
+    }
+
+    if (aws_mutex_init(&tca->chunk_mutex)) {
+        goto cleanup_mutexes;
+    }
+
+    return tc_allocator;
+
+cleanup_mutexes:
+    for (unsigned idx = 0; idx < initialized_mutexes; ++idx) {
+        aws_mutex_clean_up(&tca->classes[idx].mutex);
+    }
+    aws_array_list_clean_up(&tca->chunks);
+
+error:
+    aws_mem_release(allocator, tca);
+    return NULL;
+}
+
+void aws_thread_cache_allocator_destroy(struct aws_allocator *tc_allocator) {
+    if (!tc_allocator) {
+        return;
+    }
+    struct thread_cache_allocator *tca = tc_allocator->impl;
+    if (!tca) {
+        return;
+    }
+
+    /* Every thread which used this allocator must have exited (and drained its cache) by now */
+    AWS_FATAL_ASSERT(aws_atomic_load_int(&tca->thread_cache_count) == 0);
+
+    const size_t chunk_count = aws_array_list_length(&tca->chunks);
+    for (size_t idx = 0; idx < chunk_count; ++idx) {
+        void *chunk = NULL;
+        aws_array_list_get_at(&tca->chunks, &chunk, idx);
+        aws_mem_release(tca->allocator, chunk);
+    }
+    aws_array_list_clean_up(&tca->chunks);
+
+    for (unsigned idx = 0; idx < AWS_TC_CLASS_COUNT; ++idx) {
+        aws_mutex_clean_up(&tca->classes[idx].mutex);
+    }
+    aws_mutex_clean_up(&tca->chunk_mutex);
+
+    struct aws_allocator *allocator = tca->allocator;
+    aws_mem_release(allocator, tca);
+}
+
+static size_t s_find_class(size_t size) {
+    AWS_PRECONDITION(size <= s_max_class_size);
+
+    for (size_t idx = 0; idx < AWS_TC_CLASS_COUNT; ++idx) {
+        if (size <= s_class_sizes[idx]) {
+            return idx;
+        }
+    }
+
+    AWS_ASSERT(false);
+    return AWS_TC_LARGE_CLASS;
+}
+
+static void *s_block_to_payload(struct block_header *block) {
+    return (uint8_t *)block + sizeof(struct block_header);
+}
+
+static struct block_header *s_payload_to_block(void *payload) {
+    return (struct block_header *)((uint8_t *)payload - sizeof(struct block_header));
+}
+
+static void s_free_list_push(struct free_list *list, struct free_block *block) {
+    block->next = list->head;
+    list->head = block;
+    ++list->count;
+}
+
+static struct free_block *s_free_list_pop(struct free_list *list) {
+    struct free_block *block = list->head;
+    if (block) {
+        list->head = block->next;
+        --list->count;
+    }
+    return block;
+}
+
+/* Carves block_count fresh blocks for size_class out of a new chunk from the backing allocator */
+static int s_carve_blocks(
+    struct thread_cache_allocator *tca,
+    size_t size_class,
+    size_t block_count,
+    struct free_list *out) {
+    const size_t block_size = sizeof(struct block_header) + s_class_sizes[size_class];
+    size_t chunk_size = 0;
+    if (aws_mul_size_checked(block_size, block_count, &chunk_size)) {
+        return AWS_OP_ERR;
+    }
+    uint8_t *chunk = aws_mem_acquire(tca->allocator, chunk_size);
+    if (!chunk) {
+        return AWS_OP_ERR;
+    }
+
+    aws_mutex_lock(&tca->chunk_mutex);
+    int result = aws_array_list_push_back(&tca->chunks, &chunk);
+    aws_mutex_unlock(&tca->chunk_mutex);
+    if (result) {
+        aws_mem_release(tca->allocator, chunk);
+        return AWS_OP_ERR;
+    }
+
+    for (size_t idx = 0; idx < block_count; ++idx) {
+        struct block_header *block = (struct block_header *)(chunk + idx * block_size);
+        block->size_class = size_class;
+        s_free_list_push(out, s_block_to_payload(block));
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/* Moves up to a batch of blocks from the central list into out, carving new blocks if the central list is empty */
+static int s_central_refill(struct thread_cache_allocator *tca, size_t size_class, struct free_list *out) {
+    struct central_class *central = &tca->classes[size_class];
+
+    aws_mutex_lock(&central->mutex);
+    for (size_t idx = 0; idx < AWS_TC_BATCH_SIZE && central->blocks.head; ++idx) {
+        s_free_list_push(out, s_free_list_pop(&central->blocks));
+    }
+    aws_mutex_unlock(&central->mutex);
+
+    if (out->count) {
+        return AWS_OP_SUCCESS;
+    }
+
+    return s_carve_blocks(tca, size_class, AWS_TC_BATCH_SIZE, out);
+}
+
+/* Moves up to count blocks from list back to the central list */
+static void s_central_flush(struct thread_cache_allocator *tca, size_t size_class, struct free_list *list, size_t count) {
+    struct central_class *central = &tca->classes[size_class];
+
+    aws_mutex_lock(&central->mutex);
+    for (size_t idx = 0; idx < count && list->head; ++idx) {
+        s_free_list_push(&central->blocks, s_free_list_pop(list));
+    }
+    aws_mutex_unlock(&central->mutex);
+}
+
+/* aws_thread_atexit_fn: drains every cache belonging to the exiting thread */
+static void s_thread_caches_drain(void *user_data) {
+    (void)user_data;
+
+    struct thread_cache *cache = tl_thread_caches;
+    while (cache) {
+        struct thread_cache *next = cache->next;
+        struct thread_cache_allocator *tca = cache->owner;
+        for (size_t idx = 0; idx < AWS_TC_CLASS_COUNT; ++idx) {
+            s_central_flush(tca, idx, &cache->classes[idx], cache->classes[idx].count);
+        }
+        aws_mem_release(tca->allocator, cache);
+        aws_atomic_fetch_sub(&tca->thread_cache_count, 1);
+        cache = next;
+    }
+
+    tl_thread_caches = NULL;
+    tl_thread_cache_state = THREAD_CACHE_UNREGISTERED;
+}
+
+/* Returns the calling thread's cache for tca, creating it if needed, or NULL if the thread can't have one */
+static struct thread_cache *s_get_thread_cache(struct thread_cache_allocator *tca) {
+    /* fast path: most threads only ever use one thread cache allocator */
+    struct thread_cache *cache = tl_thread_caches;
+    if (AWS_LIKELY(cache && cache->owner == tca)) {
+        return cache;
+    }
+
+    if (tl_thread_cache_state == THREAD_CACHE_UNSUPPORTED) {
+        return NULL;
+    }
+
+    for (; cache; cache = cache->next) {
+        if (cache->owner == tca) {
+            return cache;
+        }
+    }
+
+    if (tl_thread_cache_state == THREAD_CACHE_UNREGISTERED) {
+        /* only aws_threads can tell us when they exit; everyone else goes straight to the central lists */
+        if (aws_thread_current_at_exit(s_thread_caches_drain, NULL)) {
+            aws_reset_error();
+            tl_thread_cache_state = THREAD_CACHE_UNSUPPORTED;
+            return NULL;
+        }
+        tl_thread_cache_state = THREAD_CACHE_REGISTERED;
+    }
+
+    cache = aws_mem_calloc(tca->allocator, 1, sizeof(struct thread_cache));
+    if (!cache) {
+        aws_reset_error();
+        return NULL;
+    }
+    cache->owner = tca;
+    cache->next = tl_thread_caches;
+    tl_thread_caches = cache;
+    aws_atomic_fetch_add(&tca->thread_cache_count, 1);
+
+    return cache;
+}
+
+static void *s_tc_mem_acquire(struct aws_allocator *allocator, size_t size) {
+    struct thread_cache_allocator *tca = allocator->impl;
+
+    if (size > s_max_class_size) {
+        struct block_header *block = aws_mem_acquire(tca->allocator, sizeof(struct block_header) + size);
+        if (!block) {
+            return NULL;
+        }
+        block->size_class = AWS_TC_LARGE_CLASS;
+        return s_block_to_payload(block);
+    }
+
+    const size_t size_class = s_find_class(size);
+    struct thread_cache *cache = s_get_thread_cache(tca);
+    if (cache) {
+        struct free_list *local = &cache->classes[size_class];
+        if (AWS_UNLIKELY(!local->head) && s_central_refill(tca, size_class, local)) {
+            return NULL;
+        }
+        return s_free_list_pop(local);
+    }
+
+    /* no thread cache, take a single block from the central list */
+    struct free_list single = {.head = NULL, .count = 0};
+    struct central_class *central = &tca->classes[size_class];
+    aws_mutex_lock(&central->mutex);
+    struct free_block *block = s_free_list_pop(&central->blocks);
+    aws_mutex_unlock(&central->mutex);
+    if (block) {
+        return block;
+    }
+
+    if (s_carve_blocks(tca, size_class, AWS_TC_BATCH_SIZE, &single)) {
+        return NULL;
+    }
+    block = s_free_list_pop(&single);
+    s_central_flush(tca, size_class, &single, single.count);
+    return block;
+}
+
+static void s_tc_mem_release(struct aws_allocator *allocator, void *ptr) {
+    struct thread_cache_allocator *tca = allocator->impl;
+    struct block_header *block = s_payload_to_block(ptr);
+
+    const size_t size_class = block->size_class;
+    if (size_class == AWS_TC_LARGE_CLASS) {
+        aws_mem_release(tca->allocator, block);
+        return;
+    }
+    AWS_FATAL_ASSERT(size_class < AWS_TC_CLASS_COUNT);
+
+    struct thread_cache *cache = s_get_thread_cache(tca);
+    if (cache) {
+        struct free_list *local = &cache->classes[size_class];
+        s_free_list_push(local, ptr);
+        if (AWS_UNLIKELY(local->count > AWS_TC_HIGH_WATER_MARK)) {
+            s_central_flush(tca, size_class, local, AWS_TC_BATCH_SIZE);
+        }
+        return;
+    }
+
+    struct central_class *central = &tca->classes[size_class];
+    aws_mutex_lock(&central->mutex);
+    s_free_list_push(&central->blocks, ptr);
+    aws_mutex_unlock(&central->mutex);
+}
+
+static void *s_tc_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size) {
+    struct thread_cache_allocator *tca = allocator->impl;
+
+    if (new_size == 0) {
+        s_tc_mem_release(allocator, old_ptr);
+        return NULL;
+    }
+
+    if (old_ptr) {
+        struct block_header *block = s_payload_to_block(old_ptr);
+        if (block->size_class == AWS_TC_LARGE_CLASS && new_size > s_max_class_size) {
+            /* both live in the backing allocator, let it do the work */
+            void *raw = block;
+            if (aws_mem_realloc(
+                    tca->allocator,
+                    &raw,
+                    sizeof(struct block_header) + old_size,
+                    sizeof(struct block_header) + new_size)) {
+                return NULL;
+            }
+            return s_block_to_payload(raw);
+        }
+
+        /* the existing block may already be big enough */
+        if (block->size_class != AWS_TC_LARGE_CLASS && new_size <= s_class_sizes[block->size_class]) {
+            return old_ptr;
+        }
+    }
+
+    void *new_mem = s_tc_mem_acquire(allocator, new_size);
+    if (!new_mem) {
+        return NULL;
+    }
+
+    if (old_ptr && old_size) {
+        memcpy(new_mem, old_ptr, old_size < new_size ? old_size : new_size);
+        s_tc_mem_release(allocator, old_ptr);
+    }
+
+    return new_mem;
+}
+
+/*
+ * Batches are served from the calling thread's cache first, then from the central list under a single lock, and
+ * whatever is still missing is carved from one chunk sized for exactly that many blocks.
+ */
+static size_t s_tc_mem_acquire_batch(struct aws_allocator *allocator, size_t size, size_t count, void **ptrs) {
+    struct thread_cache_allocator *tca = allocator->impl;
+    if (size > s_max_class_size) {
+        /* nothing to gain, let the caller acquire them one by one */
+        return 0;
+    }
+
+    const size_t size_class = s_find_class(size);
+    size_t acquired = 0;
+
+    struct thread_cache *cache = s_get_thread_cache(tca);
+    if (cache) {
+        struct free_list *local = &cache->classes[size_class];
+        while (acquired < count && local->head) {
+            ptrs[acquired++] = s_free_list_pop(local);
+        }
+    }
+
+    if (acquired < count) {
+        struct central_class *central = &tca->classes[size_class];
+        aws_mutex_lock(&central->mutex);
+        while (acquired < count && central->blocks.head) {
+            ptrs[acquired++] = s_free_list_pop(&central->blocks);
+        }
+        aws_mutex_unlock(&central->mutex);
+    }
+
+    if (acquired < count) {
+        struct free_list fresh = {.head = NULL, .count = 0};
+        if (s_carve_blocks(tca, size_class, count - acquired, &fresh)) {
+            aws_reset_error();
+            return acquired;
+        }
+        while (fresh.head) {
+            ptrs[acquired++] = s_free_list_pop(&fresh);
+        }
+    }
+
+    return acquired;
+}
+
+/* Batches go straight back to the central list under a single lock, they would only overflow the thread cache */
+static void s_tc_mem_release_batch(struct aws_allocator *allocator, void **ptrs, size_t count, size_t size) {
+    struct thread_cache_allocator *tca = allocator->impl;
+    if (size > s_max_class_size) {
+        for (size_t idx = 0; idx < count; ++idx) {
+            if (ptrs[idx]) {
+                s_tc_mem_release(allocator, ptrs[idx]);
+            }
+        }
+        return;
+    }
+
+    const size_t size_class = s_find_class(size);
+    struct central_class *central = &tca->classes[size_class];
+
+    aws_mutex_lock(&central->mutex);
+    for (size_t idx = 0; idx < count; ++idx) {
+        if (!ptrs[idx]) {
+            continue;
+        }
+        AWS_FATAL_ASSERT(s_payload_to_block(ptrs[idx])->size_class == size_class);
+        s_free_list_push(&central->blocks, ptrs[idx]);
+    }
+    aws_mutex_unlock(&central->mutex);
+}
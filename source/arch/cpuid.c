@@ -34,6 +34,7 @@
 #define CPUID_AVAILABLE 0
 #define CPUID_UNAVAILABLE 1
 static int cpuid_state = 2;
+static int sse42_cpuid_state = 2;
 
 #ifndef HAVE_BUILTIN_CPU_SUPPORTS
 #    ifdef HAVE_MSVC_CPUIDEX
@@ -57,6 +58,16 @@ static bool msvc_check_avx2(void) {
     /* EBX bit 5: AVX2 support */
     return cpuInfo[1] & (1 << 5);
 }
+
+static bool msvc_check_sse42(void) {
+    int cpuInfo[4];
+
+    /* CPUID: Processor info and feature bits */
+    __cpuidex(cpuInfo, 1, 0);
+
+    /* ECX bit 20: SSE4.2 support */
+    return cpuInfo[2] & (1 << 20);
+}
 #    endif
 #endif
 
@@ -89,3 +100,33 @@ bool aws_common_private_has_avx2(void) {
 
     return available;
 }
+
+bool aws_common_private_has_sse42(void) {
+    if (AWS_LIKELY(sse42_cpuid_state == CPUID_AVAILABLE)) {
+        return true;
+    }
+    if (AWS_LIKELY(sse42_cpuid_state == CPUID_UNAVAILABLE)) {
+        return false;
+    }
+
+    /* Provide a hook for testing fallbacks and benchmarking */
+    const char *env_sse42_enabled = getenv("AWS_COMMON_SSE42");
+    if (env_sse42_enabled) {
+        int is_enabled = atoi(env_sse42_enabled);
+        sse42_cpuid_state = !is_enabled;
+        return is_enabled;
+    }
+
+#ifdef HAVE_BUILTIN_CPU_SUPPORTS
+    bool available = __builtin_cpu_supports("sse4.2");
+#elif defined(HAVE_MAY_I_USE)
+    bool available = _may_i_use_cpu_feature(_FEATURE_SSE4_2);
+#elif defined(HAVE_MSVC_CPUIDEX)
+    bool available = msvc_check_sse42();
+#else
+#    error No CPUID probe mechanism available
+#endif
+    sse42_cpuid_state = available ? CPUID_AVAILABLE : CPUID_UNAVAILABLE;
+
+    return available;
+}
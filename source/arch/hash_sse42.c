@@ -0,0 +1,65 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <nmmintrin.h>
+
+#include <string.h>
+
+#include <aws/common/common.h>
+
+static inline uint64_t s_read_u64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+ * Hashes len bytes with the SSE4.2 CRC32C instruction. Two independent CRC streams take alternate 8 byte words, so
+ * that the instruction's latency is overlapped, giving 64 bits of state which a multiply-xorshift finalizer then
+ * spreads across the whole result. CRC alone is linear, which is fine for error detection but would make similar
+ * keys land in similar buckets; the finalizer (and multiplying short keys into the second stream) takes care of that.
+ */
+uint64_t aws_common_private_hash_crc32c(const uint8_t *data, size_t len, uint64_t seed) {
+    uint64_t crc0 = (uint32_t)seed;
+    uint64_t crc1 = seed >> 32;
+    size_t remaining = len;
+
+    while (remaining >= 16) {
+        crc0 = _mm_crc32_u64(crc0, s_read_u64(data));
+        crc1 = _mm_crc32_u64(crc1, s_read_u64(data + 8));
+        data += 16;
+        remaining -= 16;
+    }
+
+    if (remaining > 8) {
+        /* the second read overlaps the first, rather than reading the 1-7 trailing bytes one at a time */
+        crc0 = _mm_crc32_u64(crc0, s_read_u64(data));
+        crc1 = _mm_crc32_u64(crc1, s_read_u64(data + remaining - 8));
+    } else if (remaining > 0) {
+        uint64_t tail = 0;
+        memcpy(&tail, data, remaining);
+        crc0 = _mm_crc32_u64(crc0, tail);
+        crc1 = _mm_crc32_u64(crc1, tail * 0x9E3779B97F4A7C15ULL);
+    }
+
+    /* fmix64 from MurmurHash3 */
+    uint64_t hash = ((crc1 << 32) | crc0) ^ ((uint64_t)len * 0xC2B2AE3D27D4EB4FULL);
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
@@ -54,7 +54,7 @@ int aws_array_list_shrink_to_fit(struct aws_array_list *AWS_RESTRICT list) {
                 }
 
                 memcpy(raw_data, list->data, ideal_size);
-                aws_mem_release(list->alloc, list->data);
+                aws_mem_release_sized(list->alloc, list->data, list->current_size);
             }
             list->data = raw_data;
             list->current_size = ideal_size;
@@ -101,7 +101,7 @@ int aws_array_list_copy(const struct aws_array_list *AWS_RESTRICT from, struct a
 
         memcpy(tmp, from->data, copy_size);
         if (to->data) {
-            aws_mem_release(to->alloc, to->data);
+            aws_mem_release_sized(to->alloc, to->data, to->current_size);
         }
 
         to->data = tmp;
@@ -166,7 +166,7 @@ int aws_array_list_ensure_capacity(struct aws_array_list *AWS_RESTRICT list, siz
                 AWS_ARRAY_LIST_DEBUG_FILL,
                 new_size - list->current_size);
 #endif
-            aws_mem_release(list->alloc, list->data);
+            aws_mem_release_sized(list->alloc, list->data, list->current_size);
         }
         list->data = temp;
         list->current_size = new_size;
@@ -84,7 +84,7 @@ void aws_byte_buf_reset(struct aws_byte_buf *buf, bool zero_contents) {
 void aws_byte_buf_clean_up(struct aws_byte_buf *buf) {
     AWS_PRECONDITION(aws_byte_buf_is_valid(buf));
     if (buf->allocator && buf->buffer) {
-        aws_mem_release(buf->allocator, (void *)buf->buffer);
+        aws_mem_release_sized(buf->allocator, (void *)buf->buffer, buf->capacity);
     }
     buf->allocator = NULL;
     buf->buffer = NULL;
@@ -604,7 +604,7 @@ int aws_byte_buf_append_dynamic(struct aws_byte_buf *to, const struct aws_byte_c
         /*
          * Get rid of the old buffer
          */
-        aws_mem_release(to->allocator, to->buffer);
+        aws_mem_release_sized(to->allocator, to->buffer, to->capacity);
 
         /*
          * Switch to the new buffer
@@ -241,6 +241,7 @@ static struct aws_log_subject_info s_common_log_subject_infos[] = {
         AWS_LS_COMMON_TASK_SCHEDULER,
         "task-scheduler",
         "Subject for task scheduler or task specific logging."),
+    DEFINE_LOG_SUBJECT_INFO(AWS_LS_COMMON_MEMTRACE, "memtrace", "Output from the aws_mem_tracer allocator."),
 };
 
 static struct aws_log_subject_info_list s_common_log_subject_list = {
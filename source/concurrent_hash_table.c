@@ -0,0 +1,454 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/concurrent_hash_table.h>
+
+#include <aws/common/atomics.h>
+#include <aws/common/math.h>
+#include <aws/common/mutex.h>
+#include <aws/common/system_info.h>
+#include <aws/common/thread.h>
+
+/*
+ * Each shard holds two copies of its elements. Readers register in readers[version], then look in tables[active].
+ * With the lock held, tables[!active] never has readers, so a writer can change it freely; publishing it flips
+ * active, and then the writer waits until every reader that might still be looking at the old copy has left before
+ * touching that one. The two reader counters let the writer tell readers which arrived before the flip (and may be
+ * in the old copy) from those which arrived after, so a steady stream of new readers can't starve it.
+ */
+struct aws_concurrent_hash_table_shard {
+    struct aws_atomic_var readers[2];
+    struct aws_atomic_var version;
+    struct aws_atomic_var active;
+    struct aws_atomic_var entry_count;
+    struct aws_mutex lock;
+    /* the destroy callbacks are run by the concurrent table, never by these */
+    struct aws_hash_table tables[2];
+};
+
+/* shards are a whole number of cache lines apart, so that readers of one don't slow down readers of the next */
+static const size_t s_shard_stride =
+    (sizeof(struct aws_concurrent_hash_table_shard) + AWS_CACHE_LINE - 1) & ~(size_t)(AWS_CACHE_LINE - 1);
+
+/* a writer spins this many times before yielding to the readers it is waiting for */
+#define AWS_CONCURRENT_HASH_TABLE_SPIN_COUNT 100
+
+static struct aws_concurrent_hash_table_shard *s_shard_at(const struct aws_concurrent_hash_table *table, size_t idx) {
+    return (struct aws_concurrent_hash_table_shard *)((uint8_t *)table->shards + idx * s_shard_stride);
+}
+
+static struct aws_concurrent_hash_table_shard *s_shard_for(
+    const struct aws_concurrent_hash_table *table,
+    const void *key) {
+    if (table->shard_count == 1) {
+        return s_shard_at(table, 0);
+    }
+
+    /* same convention as aws_hash_table for NULL keys */
+    uint64_t hash_code = key ? table->hash_fn(key) : 42;
+    /* the shard tables index by the low bits, so pick the shard from the high bits of a multiplicative mix */
+    hash_code *= 0x9E3779B97F4A7C15ULL;
+    return s_shard_at(table, (size_t)(hash_code >> table->shard_shift));
+}
+
+static size_t s_read_begin(struct aws_concurrent_hash_table_shard *shard) {
+    size_t version = aws_atomic_load_int(&shard->version);
+    aws_atomic_fetch_add(&shard->readers[version], 1);
+    return version;
+}
+
+static void s_read_end(struct aws_concurrent_hash_table_shard *shard, size_t version) {
+    aws_atomic_fetch_sub(&shard->readers[version], 1);
+}
+
+static void s_wait_for_readers(struct aws_atomic_var *readers) {
+    for (size_t spins = 0; aws_atomic_load_int(readers) != 0; ++spins) {
+        if (spins >= AWS_CONCURRENT_HASH_TABLE_SPIN_COUNT) {
+            /* the reader may have been preempted, let it run */
+            aws_thread_current_sleep(0);
+        }
+    }
+}
+
+/* Must be called with the lock held. Returns the copy which the writer is free to modify. */
+static struct aws_hash_table *s_inactive_table(struct aws_concurrent_hash_table_shard *shard) {
+    return &shard->tables[!aws_atomic_load_int(&shard->active)];
+}
+
+/*
+ * Must be called with the lock held. Publishes the copy which was just modified, and waits until no reader can be
+ * looking at the other one, which becomes the inactive table.
+ */
+static void s_publish(struct aws_concurrent_hash_table_shard *shard) {
+    aws_atomic_store_int(&shard->active, !aws_atomic_load_int(&shard->active));
+
+    size_t version = aws_atomic_load_int(&shard->version);
+    s_wait_for_readers(&shard->readers[!version]);
+    aws_atomic_store_int(&shard->version, !version);
+    s_wait_for_readers(&shard->readers[version]);
+}
+
+static void s_destroy_element(const struct aws_concurrent_hash_table *table, struct aws_hash_element *element) {
+    if (table->destroy_key_fn) {
+        table->destroy_key_fn((void *)element->key);
+    }
+    if (table->destroy_value_fn) {
+        table->destroy_value_fn(element->value);
+    }
+}
+
+static void s_destroy_all_elements(const struct aws_concurrent_hash_table *table, struct aws_hash_table *map) {
+    if (!table->destroy_key_fn && !table->destroy_value_fn) {
+        return;
+    }
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(map); !aws_hash_iter_done(&iter); aws_hash_iter_next(&iter)) {
+        s_destroy_element(table, &iter.element);
+    }
+}
+
+int aws_concurrent_hash_table_init(
+    struct aws_concurrent_hash_table *table,
+    struct aws_allocator *alloc,
+    size_t size,
+    size_t shard_count,
+    aws_hash_fn *hash_fn,
+    aws_hash_callback_eq_fn *equals_fn,
+    aws_hash_callback_destroy_fn *destroy_key_fn,
+    aws_hash_callback_destroy_fn *destroy_value_fn) {
+    AWS_PRECONDITION(table != NULL);
+    AWS_PRECONDITION(alloc != NULL);
+    AWS_PRECONDITION(hash_fn != NULL);
+    AWS_PRECONDITION(equals_fn != NULL);
+
+    AWS_ZERO_STRUCT(*table);
+
+    if (shard_count == 0) {
+        /* enough shards that threads rarely land on the same one */
+        shard_count = aws_system_info_processor_count() * 4;
+    }
+    if (aws_round_up_to_power_of_two(shard_count, &shard_count)) {
+        return AWS_OP_ERR;
+    }
+
+    size_t shards_size = 0;
+    if (aws_mul_size_checked(shard_count, s_shard_stride, &shards_size)) {
+        return AWS_OP_ERR;
+    }
+    table->shards = aws_mem_calloc(alloc, 1, shards_size);
+    if (!table->shards) {
+        return AWS_OP_ERR;
+    }
+
+    table->alloc = alloc;
+    table->hash_fn = hash_fn;
+    table->destroy_key_fn = destroy_key_fn;
+    table->destroy_value_fn = destroy_value_fn;
+    table->shard_count = shard_count;
+    table->shard_shift = 64;
+    for (size_t count = shard_count; count > 1; count >>= 1) {
+        --table->shard_shift;
+    }
+
+    const size_t shard_size = size / shard_count;
+    size_t shard_idx = 0;
+    for (; shard_idx < shard_count; ++shard_idx) {
+        struct aws_concurrent_hash_table_shard *shard = s_shard_at(table, shard_idx);
+        aws_atomic_init_int(&shard->readers[0], 0);
+        aws_atomic_init_int(&shard->readers[1], 0);
+        aws_atomic_init_int(&shard->version, 0);
+        aws_atomic_init_int(&shard->active, 0);
+        aws_atomic_init_int(&shard->entry_count, 0);
+
+        if (aws_mutex_init(&shard->lock)) {
+            goto error;
+        }
+        if (aws_hash_table_init(&shard->tables[0], alloc, shard_size, hash_fn, equals_fn, NULL, NULL)) {
+            aws_mutex_clean_up(&shard->lock);
+            goto error;
+        }
+        if (aws_hash_table_init(&shard->tables[1], alloc, shard_size, hash_fn, equals_fn, NULL, NULL)) {
+            aws_hash_table_clean_up(&shard->tables[0]);
+            aws_mutex_clean_up(&shard->lock);
+            goto error;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+
+error:
+    while (shard_idx-- > 0) {
+        struct aws_concurrent_hash_table_shard *shard = s_shard_at(table, shard_idx);
+        aws_hash_table_clean_up(&shard->tables[0]);
+        aws_hash_table_clean_up(&shard->tables[1]);
+        aws_mutex_clean_up(&shard->lock);
+    }
+    aws_mem_release(alloc, table->shards);
+    AWS_ZERO_STRUCT(*table);
+    return AWS_OP_ERR;
+}
+
+void aws_concurrent_hash_table_clean_up(struct aws_concurrent_hash_table *table) {
+    AWS_PRECONDITION(table != NULL);
+
+    /* Ensure that we're idempotent */
+    if (!table->shards) {
+        return;
+    }
+
+    for (size_t shard_idx = 0; shard_idx < table->shard_count; ++shard_idx) {
+        struct aws_concurrent_hash_table_shard *shard = s_shard_at(table, shard_idx);
+        s_destroy_all_elements(table, &shard->tables[0]);
+        aws_hash_table_clean_up(&shard->tables[0]);
+        aws_hash_table_clean_up(&shard->tables[1]);
+        aws_mutex_clean_up(&shard->lock);
+    }
+
+    aws_mem_release(table->alloc, table->shards);
+    AWS_ZERO_STRUCT(*table);
+}
+
+size_t aws_concurrent_hash_table_get_entry_count(const struct aws_concurrent_hash_table *table) {
+    size_t entry_count = 0;
+    for (size_t shard_idx = 0; shard_idx < table->shard_count; ++shard_idx) {
+        struct aws_concurrent_hash_table_shard *shard = s_shard_at(table, shard_idx);
+        entry_count += aws_atomic_load_int_explicit(&shard->entry_count, aws_memory_order_relaxed);
+    }
+    return entry_count;
+}
+
+int aws_concurrent_hash_table_find(
+    const struct aws_concurrent_hash_table *table,
+    const void *key,
+    struct aws_hash_element *p_elem,
+    int *was_present) {
+    AWS_PRECONDITION(table != NULL && table->shards != NULL);
+    AWS_PRECONDITION(was_present != NULL);
+
+    struct aws_concurrent_hash_table_shard *shard = s_shard_for(table, key);
+
+    size_t version = s_read_begin(shard);
+    struct aws_hash_element *elem = NULL;
+    aws_hash_table_find(&shard->tables[aws_atomic_load_int(&shard->active)], key, &elem);
+    if (elem && p_elem) {
+        *p_elem = *elem;
+    }
+    s_read_end(shard, version);
+
+    *was_present = elem != NULL;
+    return AWS_OP_SUCCESS;
+}
+
+int aws_concurrent_hash_table_put(
+    struct aws_concurrent_hash_table *table,
+    const void *key,
+    void *value,
+    int *was_created) {
+    AWS_PRECONDITION(table != NULL && table->shards != NULL);
+
+    struct aws_concurrent_hash_table_shard *shard = s_shard_for(table, key);
+    int created = 0;
+
+    aws_mutex_lock(&shard->lock);
+
+    struct aws_hash_table *inactive = s_inactive_table(shard);
+    struct aws_hash_element *elem = NULL;
+    aws_hash_table_find(inactive, key, &elem);
+    struct aws_hash_element replaced;
+    AWS_ZERO_STRUCT(replaced);
+    if (elem) {
+        replaced = *elem;
+    }
+
+    if (aws_hash_table_put(inactive, key, value, &created)) {
+        aws_mutex_unlock(&shard->lock);
+        return AWS_OP_ERR;
+    }
+
+    s_publish(shard);
+
+    struct aws_hash_table *other = s_inactive_table(shard);
+    if (aws_hash_table_put(other, key, value, NULL)) {
+        /* the second copy couldn't grow: put the untouched copy back in front and undo the change to the first */
+        s_publish(shard);
+        if (created) {
+            aws_hash_table_remove(inactive, key, NULL, NULL);
+        } else {
+            /* overwriting an existing key never allocates */
+            aws_hash_table_put(inactive, replaced.key, replaced.value, NULL);
+        }
+        aws_mutex_unlock(&shard->lock);
+        return AWS_OP_ERR;
+    }
+
+    if (created) {
+        aws_atomic_fetch_add(&shard->entry_count, 1);
+    }
+
+    aws_mutex_unlock(&shard->lock);
+
+    /* neither copy refers to the replaced element any more, and every reader that might have seen it has left */
+    if (!created) {
+        if (replaced.key != key && table->destroy_key_fn) {
+            table->destroy_key_fn((void *)replaced.key);
+        }
+        if (table->destroy_value_fn) {
+            table->destroy_value_fn(replaced.value);
+        }
+    }
+
+    if (was_created) {
+        *was_created = created;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+int aws_concurrent_hash_table_remove(
+    struct aws_concurrent_hash_table *table,
+    const void *key,
+    struct aws_hash_element *p_value,
+    int *was_present) {
+    AWS_PRECONDITION(table != NULL && table->shards != NULL);
+
+    struct aws_concurrent_hash_table_shard *shard = s_shard_for(table, key);
+    struct aws_hash_element removed;
+    int present = 0;
+
+    aws_mutex_lock(&shard->lock);
+
+    aws_hash_table_remove(s_inactive_table(shard), key, &removed, &present);
+    if (present) {
+        s_publish(shard);
+        aws_hash_table_remove(s_inactive_table(shard), key, NULL, NULL);
+        aws_atomic_fetch_sub(&shard->entry_count, 1);
+    }
+
+    aws_mutex_unlock(&shard->lock);
+
+    if (present) {
+        if (p_value) {
+            *p_value = removed;
+        } else {
+            s_destroy_element(table, &removed);
+        }
+    }
+
+    if (was_present) {
+        *was_present = present;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Must be called with the lock held, after changing a copy in foreach and publishing it. Deletes the same elements
+ * from the other copy, which is now the inactive one, and gives the rest the values they now have.
+ */
+static void s_sync_changes(struct aws_concurrent_hash_table_shard *shard) {
+    struct aws_hash_table *active = &shard->tables[aws_atomic_load_int(&shard->active)];
+    struct aws_hash_table *inactive = s_inactive_table(shard);
+
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(inactive); !aws_hash_iter_done(&iter);
+         aws_hash_iter_next(&iter)) {
+        struct aws_hash_element *elem = NULL;
+        aws_hash_table_find(active, iter.element.key, &elem);
+        if (!elem) {
+            aws_hash_iter_delete(&iter, false);
+        } else {
+            /* the iterator's element is a copy, so write through to the table's own */
+            struct aws_hash_element *inactive_elem = NULL;
+            aws_hash_table_find(inactive, iter.element.key, &inactive_elem);
+            inactive_elem->value = elem->value;
+        }
+    }
+
+    aws_atomic_store_int(&shard->entry_count, aws_hash_table_get_entry_count(active));
+}
+
+struct foreach_context {
+    int (*callback)(void *context, struct aws_hash_element *p_element);
+    void *context;
+    struct aws_hash_table *map;
+    bool changed;
+    bool stopped;
+};
+
+static int s_foreach_callback(void *context, struct aws_hash_element *p_element) {
+    struct foreach_context *foreach_context = context;
+    void *value = p_element->value;
+    int rv = foreach_context->callback(foreach_context->context, p_element);
+    if (rv & AWS_COMMON_HASH_TABLE_ITER_DELETE) {
+        foreach_context->changed = true;
+    } else if (p_element->value != value) {
+        /* p_element is the iterator's copy of the element, so write the new value through to the table */
+        struct aws_hash_element *elem = NULL;
+        aws_hash_table_find(foreach_context->map, p_element->key, &elem);
+        elem->value = p_element->value;
+        foreach_context->changed = true;
+    }
+    if (!(rv & AWS_COMMON_HASH_TABLE_ITER_CONTINUE)) {
+        foreach_context->stopped = true;
+    }
+    return rv;
+}
+
+int aws_concurrent_hash_table_foreach(
+    struct aws_concurrent_hash_table *table,
+    int (*callback)(void *context, struct aws_hash_element *p_element),
+    void *context) {
+    AWS_PRECONDITION(table != NULL && table->shards != NULL);
+    AWS_PRECONDITION(callback != NULL);
+
+    struct foreach_context foreach_context = {
+        .callback = callback,
+        .context = context,
+    };
+
+    for (size_t shard_idx = 0; shard_idx < table->shard_count && !foreach_context.stopped; ++shard_idx) {
+        struct aws_concurrent_hash_table_shard *shard = s_shard_at(table, shard_idx);
+        foreach_context.changed = false;
+
+        aws_mutex_lock(&shard->lock);
+
+        /* deletions and new values go to the inactive copy, which no reader can see until it is published */
+        foreach_context.map = s_inactive_table(shard);
+        aws_hash_table_foreach(foreach_context.map, s_foreach_callback, &foreach_context);
+        if (foreach_context.changed) {
+            s_publish(shard);
+            s_sync_changes(shard);
+        }
+
+        aws_mutex_unlock(&shard->lock);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+void aws_concurrent_hash_table_clear(struct aws_concurrent_hash_table *table) {
+    AWS_PRECONDITION(table != NULL && table->shards != NULL);
+
+    for (size_t shard_idx = 0; shard_idx < table->shard_count; ++shard_idx) {
+        struct aws_concurrent_hash_table_shard *shard = s_shard_at(table, shard_idx);
+
+        aws_mutex_lock(&shard->lock);
+
+        aws_hash_table_clear(s_inactive_table(shard));
+        s_publish(shard);
+        struct aws_hash_table *other = s_inactive_table(shard);
+        s_destroy_all_elements(table, other);
+        aws_hash_table_clear(other);
+        aws_atomic_store_int(&shard->entry_count, 0);
+
+        aws_mutex_unlock(&shard->lock);
+    }
+}
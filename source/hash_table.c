@@ -31,6 +31,26 @@
  * macro. */
 #include <aws/common/private/lookup3.inl>
 
+#ifdef USE_SIMD_HASHING
+uint64_t aws_common_private_hash_crc32c(const uint8_t *data, size_t len, uint64_t seed);
+bool aws_common_private_has_sse42(void);
+#else
+/*
+ * When SSE4.2 compilation is unavailable, we use these stubs to fall back to the portable hash.
+ * Since we force aws_common_private_has_sse42 to return false, the CRC32C hash should not be called.
+ */
+static inline uint64_t aws_common_private_hash_crc32c(const uint8_t *data, size_t len, uint64_t seed) {
+    (void)data;
+    (void)len;
+    (void)seed;
+    AWS_ASSERT(false);
+    return 0; /* unreachable */
+}
+static inline bool aws_common_private_has_sse42(void) {
+    return false;
+}
+#endif
+
 static void s_suppress_unused_lookup3_func_warnings(void) {
     /* We avoid making changes to lookup3 if we can avoid it, but since it has functions
      * we're not using, reference them somewhere to suppress the unused function warning.
@@ -118,56 +138,11 @@ void hash_dump(struct aws_hash_table *tbl) {
 }
 #endif
 
-#if 0
-/* Not currently exposed as an API. Should we have something like this? Useful for benchmarks */
-AWS_COMMON_API
-void aws_hash_table_print_stats(struct aws_hash_table *table) {
-    struct hash_table_state *state = table->p_impl;
-    uint64_t total_disp = 0;
-    uint64_t max_disp = 0;
-
-    printf("\n=== Hash table statistics ===\n");
-    printf("Table size: %zu/%zu (max load %zu, remaining %zu)\n", state->entry_count, state->size, state->max_load, state->max_load - state->entry_count);
-    printf("Load factor: %02.2lf%% (max %02.2lf%%)\n",
-        100.0 * ((double)state->entry_count / (double)state->size),
-        state->max_load_factor);
-
-    for (size_t i = 0; i < state->size; i++) {
-        if (state->slots[i].hash_code) {
-            int displacement = distance(state, i);
-            total_disp += displacement;
-            if (displacement > max_disp) {
-                max_disp = displacement;
-            }
-        }
-    }
-
-    size_t *disp_counts = calloc(sizeof(*disp_counts), max_disp + 1);
-
-    for (size_t i = 0; i < state->size; i++) {
-        if (state->slots[i].hash_code) {
-            disp_counts[distance(state, i)]++;
-        }
-    }
-
-    uint64_t median = 0;
-    uint64_t passed = 0;
-    for (uint64_t i = 0; i <= max_disp && passed < total_disp / 2; i++) {
-        median = i;
-        passed += disp_counts[i];
-    }
-
-    printf("Displacement statistics: Avg %02.2lf max %llu median %llu\n", (double)total_disp / (double)state->entry_count, max_disp, median);
-    for (uint64_t i = 0; i <= max_disp; i++) {
-        printf("Displacement %2lld: %zu entries\n", i, disp_counts[i]);
-    }
-    free(disp_counts);
-    printf("\n");
-}
-#endif
-
 size_t aws_hash_table_get_entry_count(const struct aws_hash_table *map) {
     struct hash_table_state *state = map->p_impl;
+    if (state->old_state) {
+        return state->entry_count + state->old_state->entry_count;
+    }
     return state->entry_count;
 }
 
@@ -192,6 +167,14 @@ static struct hash_table_state *s_alloc_state(const struct hash_table_state *tem
     return state;
 }
 
+/* Releases a state allocated by s_alloc_state. */
+static void s_free_state(struct hash_table_state *state) {
+    size_t required_bytes = 0;
+    /* this can't fail, since it didn't when the state was allocated */
+    hash_table_state_required_bytes(state->size, &required_bytes);
+    aws_mem_release_sized(state->alloc, state, required_bytes);
+}
+
 /* Computes the correct size and max_load based on a requested size. */
 static int s_update_template_size(struct hash_table_state *template, size_t expected_elements) {
     size_t min_size = expected_elements;
@@ -242,6 +225,9 @@ int aws_hash_table_init(
 
     template.entry_count = 0;
     template.max_load_factor = 0.95; /* TODO - make configurable? */
+    template.old_state = NULL;
+    template.migrate_cursor = 0;
+    template.incremental_resize = false;
 
     if (s_update_template_size(&template, size)) {
         return AWS_OP_ERR;
@@ -269,7 +255,7 @@ void aws_hash_table_clean_up(struct aws_hash_table *map) {
     }
 
     aws_hash_table_clear(map);
-    aws_mem_release(map->p_impl->alloc, map->p_impl);
+    s_free_state(map->p_impl);
 
     map->p_impl = NULL;
     AWS_POSTCONDITION(map->p_impl == NULL);
@@ -414,6 +400,9 @@ int aws_hash_table_find(const struct aws_hash_table *map, const void *key, struc
     struct hash_table_entry *entry;
 
     int rv = s_find_entry(state, hash_code, key, &entry, NULL);
+    if (rv != AWS_ERROR_SUCCESS && state->old_state) {
+        rv = s_find_entry(state->old_state, hash_code, key, &entry, NULL);
+    }
 
     if (rv == AWS_ERROR_SUCCESS) {
         *p_elem = &entry->element;
@@ -486,15 +475,26 @@ static struct hash_table_entry *s_emplace_item(
         "Output hash_table_entry pointer [rval] must point in the slots of [state].");
 }
 
-static int s_expand_table(struct aws_hash_table *map) {
+/* Number of slots of the old table looked at by each put or remove during an incremental resize */
+#define AWS_HASH_TABLE_MIGRATE_STEP 16
+
+static void s_migrate(struct hash_table_state *state, size_t max_slots);
+
+/*
+ * Moves the table's entries into a new table of (at least) new_size slots. If incremental is true, the old table is
+ * kept and drained by s_migrate; otherwise every entry is moved now.
+ */
+static int s_resize_table(struct aws_hash_table *map, size_t new_size, bool incremental) {
     struct hash_table_state *old_state = map->p_impl;
-    struct hash_table_state template = *old_state;
 
-    size_t new_size;
-    if (aws_mul_size_checked(template.size, 2, &new_size)) {
-        return AWS_OP_ERR;
+    if (old_state->old_state) {
+        /* The previous resize hasn't finished. When growing this can't happen at the default step size, since the new
+         * table fills up far slower than it drains the old one, but be safe. */
+        s_migrate(old_state, SIZE_MAX);
     }
 
+    struct hash_table_state template = *old_state;
+
     if (s_update_template_size(&template, new_size)) {
         return AWS_OP_ERR;
     }
@@ -504,6 +504,15 @@ static int s_expand_table(struct aws_hash_table *map) {
         return AWS_OP_ERR;
     }
 
+    if (incremental) {
+        /* Keep the old table around; s_migrate moves its entries over a few at a time */
+        new_state->entry_count = 0;
+        new_state->old_state = old_state;
+        new_state->migrate_cursor = 0;
+        map->p_impl = new_state;
+        return AWS_OP_SUCCESS;
+    }
+
     for (size_t i = 0; i < old_state->size; i++) {
         struct hash_table_entry entry = old_state->slots[i];
         if (entry.hash_code) {
@@ -513,19 +522,46 @@ static int s_expand_table(struct aws_hash_table *map) {
     }
 
     map->p_impl = new_state;
-    aws_mem_release(new_state->alloc, old_state);
+    s_free_state(old_state);
 
     return AWS_OP_SUCCESS;
 }
 
-int aws_hash_table_create(
+static int s_expand_table(struct aws_hash_table *map) {
+    struct hash_table_state *state = map->p_impl;
+
+    size_t new_size;
+    if (aws_mul_size_checked(state->size, 2, &new_size)) {
+        return AWS_OP_ERR;
+    }
+
+    return s_resize_table(map, new_size, state->incremental_resize);
+}
+
+/* Computes the number of slots needed to hold entry_count entries without exceeding the max load factor */
+static int s_size_for_entries(const struct hash_table_state *state, size_t entry_count, size_t *size) {
+    /* +1 so that rounding down max_load can't leave it short */
+    const double min_size = (double)entry_count / state->max_load_factor + 1;
+    if (min_size >= (double)SIZE_MAX) {
+        return aws_raise_error(AWS_ERROR_OVERFLOW_DETECTED);
+    }
+    *size = (size_t)min_size;
+    return AWS_OP_SUCCESS;
+}
+
+/* aws_hash_table_create(), for a key whose hash code has already been computed */
+static int s_create_with_hash(
     struct aws_hash_table *map,
     const void *key,
+    uint64_t hash_code,
     struct aws_hash_element **p_elem,
     int *was_created) {
 
     struct hash_table_state *state = map->p_impl;
-    uint64_t hash_code = s_hash_for(state, key);
+    if (state->old_state) {
+        s_migrate(state, AWS_HASH_TABLE_MIGRATE_STEP);
+    }
+
     struct hash_table_entry *entry;
     size_t probe_idx;
     int ignored;
@@ -535,6 +571,15 @@ int aws_hash_table_create(
 
     int rv = s_find_entry(state, hash_code, key, &entry, &probe_idx);
 
+    if (rv != AWS_ERROR_SUCCESS && state->old_state) {
+        /* entry and probe_idx still describe where the key goes in the new table if it isn't in the old one */
+        struct hash_table_entry *old_entry;
+        if (s_find_entry(state->old_state, hash_code, key, &old_entry, NULL) == AWS_ERROR_SUCCESS) {
+            entry = old_entry;
+            rv = AWS_ERROR_SUCCESS;
+        }
+    }
+
     if (rv == AWS_ERROR_SUCCESS) {
         if (p_elem) {
             *p_elem = &entry->element;
@@ -545,7 +590,7 @@ int aws_hash_table_create(
 
     /* Okay, we need to add an entry. Check the load factor first. */
     size_t incr_entry_count;
-    if (aws_add_size_checked(state->entry_count, 1, &incr_entry_count)) {
+    if (aws_add_size_checked(aws_hash_table_get_entry_count(map), 1, &incr_entry_count)) {
         return AWS_OP_ERR;
     }
     if (incr_entry_count > state->max_load) {
@@ -582,8 +627,22 @@ int aws_hash_table_create(
     return AWS_OP_SUCCESS;
 }
 
-AWS_COMMON_API
-int aws_hash_table_put(struct aws_hash_table *map, const void *key, void *value, int *was_created) {
+int aws_hash_table_create(
+    struct aws_hash_table *map,
+    const void *key,
+    struct aws_hash_element **p_elem,
+    int *was_created) {
+
+    return s_create_with_hash(map, key, s_hash_for(map->p_impl, key), p_elem, was_created);
+}
+
+/* aws_hash_table_put(), for a key whose hash code has already been computed */
+static int s_put_with_hash(
+    struct aws_hash_table *map,
+    const void *key,
+    uint64_t hash_code,
+    void *value,
+    int *was_created) {
     struct aws_hash_element *p_elem;
     int was_created_fallback;
 
@@ -591,7 +650,7 @@ int aws_hash_table_put(struct aws_hash_table *map, const void *key, void *value,
         was_created = &was_created_fallback;
     }
 
-    if (aws_hash_table_create(map, key, &p_elem, was_created)) {
+    if (s_create_with_hash(map, key, hash_code, &p_elem, was_created)) {
         return AWS_OP_ERR;
     }
 
@@ -617,6 +676,106 @@ int aws_hash_table_put(struct aws_hash_table *map, const void *key, void *value,
     return AWS_OP_SUCCESS;
 }
 
+AWS_COMMON_API
+int aws_hash_table_put(struct aws_hash_table *map, const void *key, void *value, int *was_created) {
+    return s_put_with_hash(map, key, s_hash_for(map->p_impl, key), value, was_created);
+}
+
+/* Number of keys the batch operations hash and prefetch ahead of looking them up: enough outstanding misses to cover
+ * memory latency, few enough that the prefetched lines are still in L1 when they are used. */
+#define AWS_HASH_TABLE_BATCH_SIZE 16
+
+#if defined(__GNUC__) || defined(__clang__)
+#    define AWS_HASH_TABLE_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#    define AWS_HASH_TABLE_PREFETCH(addr) (void)(addr)
+#endif
+
+/* Hashes a batch of keys, and starts loading the home slot of each */
+static void s_hash_and_prefetch(
+    struct hash_table_state *state,
+    const void *const *keys,
+    size_t count,
+    uint64_t *hash_codes) {
+
+    for (size_t i = 0; i < count; ++i) {
+        hash_codes[i] = s_hash_for(state, keys[i]);
+        AWS_HASH_TABLE_PREFETCH(&state->slots[hash_codes[i] & state->mask]);
+        if (state->old_state) {
+            AWS_HASH_TABLE_PREFETCH(&state->old_state->slots[hash_codes[i] & state->old_state->mask]);
+        }
+    }
+}
+
+int aws_hash_table_find_many(
+    const struct aws_hash_table *map,
+    const void *const *keys,
+    size_t count,
+    struct aws_hash_element **p_elems) {
+    AWS_PRECONDITION(aws_hash_table_is_valid(map));
+    AWS_PRECONDITION(count == 0 || (keys != NULL && p_elems != NULL));
+
+    struct hash_table_state *state = map->p_impl;
+    uint64_t hash_codes[AWS_HASH_TABLE_BATCH_SIZE];
+
+    for (size_t batch_start = 0; batch_start < count; batch_start += AWS_HASH_TABLE_BATCH_SIZE) {
+        const size_t batch_count =
+            count - batch_start < AWS_HASH_TABLE_BATCH_SIZE ? count - batch_start : AWS_HASH_TABLE_BATCH_SIZE;
+        const void *const *batch_keys = keys + batch_start;
+
+        s_hash_and_prefetch(state, batch_keys, batch_count, hash_codes);
+
+        /* By now the first home slots have arrived. Where a slot's hash code matches, its key is about to be compared,
+         * which for keys that point to their data (such as strings) is another miss: start that one too. */
+        for (size_t i = 0; i < batch_count; ++i) {
+            struct hash_table_entry *entry = &state->slots[hash_codes[i] & state->mask];
+            if (entry->hash_code == hash_codes[i]) {
+                AWS_HASH_TABLE_PREFETCH(entry->element.key);
+            }
+        }
+
+        for (size_t i = 0; i < batch_count; ++i) {
+            struct hash_table_entry *entry;
+            int rv = s_find_entry(state, hash_codes[i], batch_keys[i], &entry, NULL);
+            if (rv != AWS_ERROR_SUCCESS && state->old_state) {
+                rv = s_find_entry(state->old_state, hash_codes[i], batch_keys[i], &entry, NULL);
+            }
+            p_elems[batch_start + i] = rv == AWS_ERROR_SUCCESS ? &entry->element : NULL;
+        }
+    }
+
+    AWS_SUCCEED_WITH_POSTCONDITION(aws_hash_table_is_valid(map));
+}
+
+int aws_hash_table_put_many(
+    struct aws_hash_table *map,
+    const void *const *keys,
+    void *const *values,
+    size_t count,
+    int *was_created) {
+    AWS_PRECONDITION(aws_hash_table_is_valid(map));
+    AWS_PRECONDITION(count == 0 || (keys != NULL && values != NULL));
+
+    uint64_t hash_codes[AWS_HASH_TABLE_BATCH_SIZE];
+
+    for (size_t batch_start = 0; batch_start < count; batch_start += AWS_HASH_TABLE_BATCH_SIZE) {
+        const size_t batch_count =
+            count - batch_start < AWS_HASH_TABLE_BATCH_SIZE ? count - batch_start : AWS_HASH_TABLE_BATCH_SIZE;
+
+        /* If a put in the batch grows the table, the remaining prefetches were wasted, but the hash codes are not */
+        s_hash_and_prefetch(map->p_impl, keys + batch_start, batch_count, hash_codes);
+
+        for (size_t i = 0; i < batch_count; ++i) {
+            const size_t idx = batch_start + i;
+            if (s_put_with_hash(map, keys[idx], hash_codes[i], values[idx], was_created ? &was_created[idx] : NULL)) {
+                return AWS_OP_ERR;
+            }
+        }
+    }
+
+    AWS_SUCCEED_WITH_POSTCONDITION(aws_hash_table_is_valid(map));
+}
+
 /* Clears an entry. Does _not_ invoke destructor callbacks.
  * Returns the last slot touched (note that if we wrap, we'll report an index
  * lower than the original entry's index)
@@ -661,6 +820,157 @@ static size_t s_remove_entry(struct hash_table_state *state, struct hash_table_e
     AWS_RETURN_WITH_POSTCONDITION(index, hash_table_state_is_valid(state) && index <= state->size);
 }
 
+/* Moves entries from the old table of an incremental resize into state, looking at no more than max_slots slots.
+ * Frees the old table once it is empty.
+ */
+static void s_migrate(struct hash_table_state *state, size_t max_slots) {
+    struct hash_table_state *old_state = state->old_state;
+
+    while (max_slots-- > 0 && state->migrate_cursor < old_state->size) {
+        struct hash_table_entry *entry = &old_state->slots[state->migrate_cursor];
+        if (!entry->hash_code) {
+            state->migrate_cursor++;
+            continue;
+        }
+
+        /* Removing the entry may shift a later one back into this slot, so don't advance the cursor. Nothing is ever
+         * shifted into the slots before the cursor, since they're all empty and removal only shifts entries back.
+         */
+        s_emplace_item(state, *entry, 0);
+        state->entry_count++;
+        s_remove_entry(old_state, entry);
+    }
+
+    if (state->migrate_cursor == old_state->size) {
+        AWS_ASSERT(old_state->entry_count == 0);
+        s_free_state(old_state);
+        state->old_state = NULL;
+        state->migrate_cursor = 0;
+    }
+}
+
+void aws_hash_table_set_incremental_resize(struct aws_hash_table *map, bool enabled) {
+    AWS_PRECONDITION(aws_hash_table_is_valid(map));
+    struct hash_table_state *state = map->p_impl;
+
+    state->incremental_resize = enabled;
+    if (!enabled && state->old_state) {
+        s_migrate(state, SIZE_MAX);
+    }
+    AWS_POSTCONDITION(aws_hash_table_is_valid(map));
+}
+
+int aws_hash_table_reserve(struct aws_hash_table *map, size_t entry_count) {
+    AWS_PRECONDITION(aws_hash_table_is_valid(map));
+    struct hash_table_state *state = map->p_impl;
+
+    if (entry_count <= state->max_load) {
+        return AWS_OP_SUCCESS;
+    }
+
+    size_t new_size = 0;
+    if (s_size_for_entries(state, entry_count, &new_size)) {
+        return AWS_OP_ERR;
+    }
+    if (s_resize_table(map, new_size, false)) {
+        return AWS_OP_ERR;
+    }
+    AWS_SUCCEED_WITH_POSTCONDITION(aws_hash_table_is_valid(map));
+}
+
+int aws_hash_table_shrink_to_fit(struct aws_hash_table *map) {
+    AWS_PRECONDITION(aws_hash_table_is_valid(map));
+    struct hash_table_state *state = map->p_impl;
+
+    size_t new_size = 0;
+    if (s_size_for_entries(state, aws_hash_table_get_entry_count(map), &new_size)) {
+        return AWS_OP_ERR;
+    }
+
+    /* s_update_template_size would round new_size up to this power of 2 */
+    size_t rounded_size = 0;
+    if (aws_round_up_to_power_of_two(new_size < 2 ? 2 : new_size, &rounded_size)) {
+        return AWS_OP_ERR;
+    }
+    if (rounded_size >= state->size) {
+        /* Already as small as it can be, apart from the old table of a resize in progress, which can go now */
+        if (state->old_state) {
+            s_migrate(state, SIZE_MAX);
+        }
+        return AWS_OP_SUCCESS;
+    }
+
+    return s_resize_table(map, rounded_size, false);
+}
+
+int aws_hash_table_set_max_load_factor(struct aws_hash_table *map, double max_load_factor) {
+    AWS_PRECONDITION(aws_hash_table_is_valid(map));
+
+    if (!(max_load_factor > 0 && max_load_factor <= 1)) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    struct hash_table_state *state = map->p_impl;
+    if (state->old_state) {
+        s_migrate(state, SIZE_MAX);
+    }
+
+    const double old_max_load_factor = state->max_load_factor;
+    const size_t old_max_load = state->max_load;
+    state->max_load_factor = max_load_factor;
+    if (s_update_template_size(state, state->size)) {
+        goto error;
+    }
+
+    if (state->entry_count > state->max_load) {
+        size_t new_size = 0;
+        if (s_size_for_entries(state, state->entry_count, &new_size) || s_resize_table(map, new_size, false)) {
+            goto error;
+        }
+    }
+
+    AWS_SUCCEED_WITH_POSTCONDITION(aws_hash_table_is_valid(map));
+
+error:
+    /* the table wasn't resized, so it keeps the limits it has room for */
+    state->max_load_factor = old_max_load_factor;
+    state->max_load = old_max_load;
+    AWS_RETURN_WITH_POSTCONDITION(AWS_OP_ERR, aws_hash_table_is_valid(map));
+}
+
+/* Adds the probe lengths of state's entries to stats */
+static void s_accumulate_stats(const struct hash_table_state *state, struct aws_hash_table_stats *stats) {
+    stats->slot_count += state->size;
+    for (size_t i = 0; i < state->size; ++i) {
+        if (state->slots[i].hash_code) {
+            const size_t probe_length = (size_t)(i - state->slots[i].hash_code) & state->mask;
+            stats->mean_probe_length += (double)probe_length;
+            if (probe_length > stats->max_probe_length) {
+                stats->max_probe_length = probe_length;
+            }
+        }
+    }
+}
+
+void aws_hash_table_get_stats(const struct aws_hash_table *map, struct aws_hash_table_stats *stats) {
+    AWS_PRECONDITION(aws_hash_table_is_valid(map));
+    AWS_PRECONDITION(stats != NULL);
+    const struct hash_table_state *state = map->p_impl;
+
+    AWS_ZERO_STRUCT(*stats);
+    stats->entry_count = aws_hash_table_get_entry_count(map);
+    stats->max_load_factor = state->max_load_factor;
+
+    /* mean_probe_length holds the total until it is divided below */
+    s_accumulate_stats(state, stats);
+    if (state->old_state) {
+        s_accumulate_stats(state->old_state, stats);
+    }
+    if (stats->entry_count) {
+        stats->mean_probe_length /= (double)stats->entry_count;
+    }
+}
+
 int aws_hash_table_remove(
     struct aws_hash_table *map,
     const void *key,
@@ -674,6 +984,10 @@ int aws_hash_table_remove(
         "Input pointer [was_present] must be NULL or writable.");
 
     struct hash_table_state *state = map->p_impl;
+    if (state->old_state) {
+        s_migrate(state, AWS_HASH_TABLE_MIGRATE_STEP);
+    }
+
     uint64_t hash_code = s_hash_for(state, key);
     struct hash_table_entry *entry;
     int ignored;
@@ -683,6 +997,12 @@ int aws_hash_table_remove(
     }
 
     int rv = s_find_entry(state, hash_code, key, &entry, NULL);
+    if (rv != AWS_ERROR_SUCCESS && state->old_state) {
+        rv = s_find_entry(state->old_state, hash_code, key, &entry, NULL);
+        if (rv == AWS_ERROR_SUCCESS) {
+            state = state->old_state;
+        }
+    }
 
     if (rv != AWS_ERROR_SUCCESS) {
         *was_present = 0;
@@ -713,6 +1033,10 @@ int aws_hash_table_remove_element(struct aws_hash_table *map, struct aws_hash_el
     struct hash_table_state *state = map->p_impl;
     struct hash_table_entry *entry = AWS_CONTAINER_OF(p_value, struct hash_table_entry, element);
 
+    if (state->old_state && entry >= &state->old_state->slots[0] &&
+        entry < &state->old_state->slots[state->old_state->size]) {
+        state = state->old_state;
+    }
     s_remove_entry(state, entry);
 
     AWS_SUCCEED_WITH_POSTCONDITION(aws_hash_table_is_valid(map));
@@ -755,22 +1079,18 @@ bool aws_hash_table_eq(
      * entries, we can simply iterate one and compare against the same key in
      * the other.
      */
-    for (size_t i = 0; i < a->p_impl->size; ++i) {
-        const struct hash_table_entry *const a_entry = &a->p_impl->slots[i];
-        if (a_entry->hash_code == 0) {
-            continue;
-        }
-
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(a); !aws_hash_iter_done(&iter); aws_hash_iter_next(&iter)) {
+        const struct aws_hash_element *const a_element = &iter.element;
         struct aws_hash_element *b_element = NULL;
 
-        aws_hash_table_find(b, a_entry->element.key, &b_element);
+        aws_hash_table_find(b, a_element->key, &b_element);
 
         if (!b_element) {
             /* Key is present in A only */
             AWS_RETURN_WITH_POSTCONDITION(false, aws_hash_table_is_valid(a) && aws_hash_table_is_valid(b));
         }
 
-        if (!s_safe_eq_check(value_eq, a_entry->element.value, b_element->value)) {
+        if (!s_safe_eq_check(value_eq, a_element->value, b_element->value)) {
             AWS_RETURN_WITH_POSTCONDITION(false, aws_hash_table_is_valid(a) && aws_hash_table_is_valid(b));
         }
     }
@@ -786,21 +1106,37 @@ bool aws_hash_table_eq(
  * Note that calling this on an iterator which is "done" is idempotent: it will return another
  * iterator which is "done".
  */
+static inline struct hash_table_state *s_iter_state(const struct aws_hash_iter *iter) {
+    struct hash_table_state *state = iter->map->p_impl;
+    return iter->in_old_table ? state->old_state : state;
+}
+
 static inline void s_get_next_element(struct aws_hash_iter *iter, size_t start_slot) {
     AWS_PRECONDITION(iter != NULL);
     AWS_PRECONDITION(aws_hash_table_is_valid(iter->map));
-    struct hash_table_state *state = iter->map->p_impl;
-    size_t limit = iter->limit;
 
-    for (size_t i = start_slot; i < limit; i++) {
-        struct hash_table_entry *entry = &state->slots[i];
+    while (1) {
+        struct hash_table_state *state = s_iter_state(iter);
+        size_t limit = iter->limit;
+
+        for (size_t i = start_slot; i < limit; i++) {
+            struct hash_table_entry *entry = &state->slots[i];
+
+            if (entry->hash_code) {
+                iter->element = entry->element;
+                iter->slot = i;
+                iter->status = AWS_HASH_ITER_STATUS_READY_FOR_USE;
+                return;
+            }
+        }
 
-        if (entry->hash_code) {
-            iter->element = entry->element;
-            iter->slot = i;
-            iter->status = AWS_HASH_ITER_STATUS_READY_FOR_USE;
-            return;
+        /* After the new table, go through what is left in the old one of an incremental resize */
+        if (iter->in_old_table || !iter->map->p_impl->old_state) {
+            break;
         }
+        iter->in_old_table = 1;
+        iter->limit = iter->map->p_impl->old_state->size;
+        start_slot = 0;
     }
     iter->element.key = NULL;
     iter->element.value = NULL;
@@ -867,10 +1203,10 @@ void aws_hash_iter_delete(struct aws_hash_iter *iter, bool destroy_contents) {
         iter->status == AWS_HASH_ITER_STATUS_READY_FOR_USE, "Input aws_hash_iter [iter] must be ready for use.");
     AWS_PRECONDITION(aws_hash_iter_is_valid(iter));
     AWS_PRECONDITION(
-        iter->map->p_impl->entry_count > 0,
+        s_iter_state(iter)->entry_count > 0,
         "The hash_table_state pointed by input [iter] must contain at least one entry.");
 
-    struct hash_table_state *state = iter->map->p_impl;
+    struct hash_table_state *state = s_iter_state(iter);
     if (destroy_contents) {
         if (state->destroy_key_fn) {
             state->destroy_key_fn((void *)iter->element.key);
@@ -946,6 +1282,28 @@ void aws_hash_table_clear(struct aws_hash_table *map) {
     memset(state->slots, 0, sizeof(*state->slots) * state->size);
 
     state->entry_count = 0;
+
+    /* Whatever an incremental resize hadn't moved yet goes too */
+    struct hash_table_state *old_state = state->old_state;
+    if (old_state) {
+        if (state->destroy_key_fn || state->destroy_value_fn) {
+            for (size_t i = state->migrate_cursor; i < old_state->size; ++i) {
+                struct hash_table_entry *entry = &old_state->slots[i];
+                if (!entry->hash_code) {
+                    continue;
+                }
+                if (state->destroy_key_fn) {
+                    state->destroy_key_fn((void *)entry->element.key);
+                }
+                if (state->destroy_value_fn) {
+                    state->destroy_value_fn(entry->element.value);
+                }
+            }
+        }
+        s_free_state(old_state);
+        state->old_state = NULL;
+        state->migrate_cursor = 0;
+    }
     AWS_POSTCONDITION(aws_hash_table_is_valid(map));
 }
 
@@ -991,6 +1349,131 @@ uint64_t aws_hash_ptr(const void *item) {
     return ((uint64_t)b << 32) | c;
 }
 
+/*
+ * Portable fast hash, following wyhash (https://github.com/wangyi-fudan/wyhash, public domain): reads 16 bytes per
+ * step, and mixes them into the state with a 64x64->128 bit multiply whose halves are folded together.
+ */
+static const uint64_t s_wyhash_secret[4] = {
+    0xa0761d6478bd642fULL,
+    0xe7037ed1a0b428dbULL,
+    0x8ebc6af09c88c6e3ULL,
+    0x589965cc75374cc3ULL,
+};
+
+/* seed for aws_hash_bytes_fast: first digits of sqrt(2) in hex */
+static const uint64_t s_hash_fast_seed = 0x6a09e667f3bcc908ULL;
+
+static inline void s_wymum(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    *a = lo;
+    *b = hi;
+#endif
+}
+
+static inline uint64_t s_wymix(uint64_t a, uint64_t b) {
+    s_wymum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t s_wyr8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t s_wyr4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t s_wyr3(const uint8_t *p, size_t k) {
+    return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+static uint64_t s_wyhash(const uint8_t *p, size_t len, uint64_t seed) {
+    const uint64_t *secret = s_wyhash_secret;
+    seed ^= s_wymix(seed ^ secret[0], secret[1]);
+    uint64_t a;
+    uint64_t b;
+
+    if (AWS_LIKELY(len <= 16)) {
+        if (AWS_LIKELY(len >= 4)) {
+            a = (s_wyr4(p) << 32) | s_wyr4(p + ((len >> 3) << 2));
+            b = (s_wyr4(p + len - 4) << 32) | s_wyr4(p + len - 4 - ((len >> 3) << 2));
+        } else if (AWS_LIKELY(len > 0)) {
+            a = s_wyr3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (AWS_UNLIKELY(i > 48)) {
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+            do {
+                seed = s_wymix(s_wyr8(p) ^ secret[1], s_wyr8(p + 8) ^ seed);
+                see1 = s_wymix(s_wyr8(p + 16) ^ secret[2], s_wyr8(p + 24) ^ see1);
+                see2 = s_wymix(s_wyr8(p + 32) ^ secret[3], s_wyr8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (AWS_LIKELY(i > 48));
+            seed ^= see1 ^ see2;
+        }
+        while (AWS_UNLIKELY(i > 16)) {
+            seed = s_wymix(s_wyr8(p) ^ secret[1], s_wyr8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = s_wyr8(p + i - 16);
+        b = s_wyr8(p + i - 8);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+    s_wymum(&a, &b);
+    return s_wymix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+uint64_t aws_hash_bytes_fast(const void *data, size_t len) {
+    AWS_PRECONDITION(AWS_MEM_IS_READABLE(data, len));
+
+    if (aws_common_private_has_sse42()) {
+        return aws_common_private_hash_crc32c(data, len, s_hash_fast_seed);
+    }
+    return s_wyhash(data, len, s_hash_fast_seed);
+}
+
+uint64_t aws_hash_c_string_fast(const void *item) {
+    AWS_PRECONDITION(aws_c_string_is_valid(item));
+    const char *str = item;
+    return aws_hash_bytes_fast(str, strlen(str));
+}
+
+uint64_t aws_hash_string_fast(const void *item) {
+    AWS_PRECONDITION(aws_string_is_valid(item));
+    const struct aws_string *str = item;
+    return aws_hash_bytes_fast(aws_string_bytes(str), str->len);
+}
+
+uint64_t aws_hash_byte_cursor_ptr_fast(const void *item) {
+    AWS_PRECONDITION(aws_byte_cursor_is_valid(item));
+    const struct aws_byte_cursor *cur = item;
+    return aws_hash_bytes_fast(cur->ptr, cur->len);
+}
+
 bool aws_hash_callback_c_str_eq(const void *a, const void *b) {
     AWS_PRECONDITION(aws_c_string_is_valid(a));
     AWS_PRECONDITION(aws_c_string_is_valid(b));
@@ -1041,7 +1524,7 @@ bool hash_table_state_is_valid(const struct hash_table_state *map) {
     bool entry_count = (map->entry_count <= map->max_load);
     bool max_load = (map->max_load < map->size);
     bool mask_is_correct = (map->mask == (map->size - 1));
-    bool max_load_factor_bounded = map->max_load_factor == 0.95; //(map->max_load_factor < 1.0);
+    bool max_load_factor_bounded = map->max_load_factor > 0 && map->max_load_factor <= 1.0;
     bool slots_allocated = AWS_MEM_IS_WRITABLE(&map->slots[0], sizeof(map->slots[0]) * map->size);
 
     return hash_fn_nonnull && equals_fn_nonnull && alloc_nonnull && size_at_least_two && size_is_power_of_two &&
@@ -1061,7 +1544,10 @@ bool aws_hash_iter_is_valid(const struct aws_hash_iter *iter) {
     if (!aws_hash_table_is_valid(iter->map)) {
         return false;
     }
-    if (iter->limit > iter->map->p_impl->size) {
+    if (iter->in_old_table && !iter->map->p_impl->old_state) {
+        return false;
+    }
+    if (iter->limit > s_iter_state(iter)->size) {
         return false;
     }
 
@@ -1075,7 +1561,7 @@ bool aws_hash_iter_is_valid(const struct aws_hash_iter *iter) {
             return iter->slot <= iter->limit || iter->slot == SIZE_MAX;
         case AWS_HASH_ITER_STATUS_READY_FOR_USE:
             /* A slot must point to a valid location (i.e. hash_code != 0) */
-            return iter->slot < iter->limit && iter->map->p_impl->slots[iter->slot].hash_code != 0;
+            return iter->slot < iter->limit && s_iter_state(iter)->slots[iter->slot].hash_code != 0;
     }
     /* Invalid status code */
     return false;
@@ -0,0 +1,471 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* The probing and deletion scheme is the same Robin Hood hashing with backward shift deletion as hash_table.c; see
+ * there for details.
+ */
+
+#include <aws/common/inline_hash_table.h>
+#include <aws/common/math.h>
+
+#include <string.h>
+
+/* Same load factor as aws_hash_table */
+#define MAX_LOAD_FACTOR 0.95
+
+/* the strictest alignment a field of this size may need, up to that of the 8 byte hash code */
+static size_t s_alignment_for(size_t size) {
+    size_t lowest_bit = size & (~size + 1);
+    return lowest_bit == 0 || lowest_bit > 8 ? 8 : lowest_bit;
+}
+
+static size_t s_round_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static uint8_t *s_slot(const struct aws_inline_hash_table *table, size_t idx) {
+    return table->slots + idx * table->slot_size;
+}
+
+/* slots are 8 byte aligned, since the allocation is and slot_size is a multiple of 8 */
+static uint64_t *s_slot_hash(uint8_t *slot) {
+    return (uint64_t *)(void *)slot;
+}
+
+static uint8_t *s_slot_key(uint8_t *slot) {
+    return slot + sizeof(uint64_t);
+}
+
+static uint8_t *s_slot_value(const struct aws_inline_hash_table *table, uint8_t *slot) {
+    return slot + table->value_offset;
+}
+
+/* fmix64 from MurmurHash3; the table masks off the low bits, so every input bit has to reach them */
+static uint64_t s_mix64(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+/*
+ * The find path is written once, and instantiated below for 4 and 8 byte keys without callbacks. key_size and
+ * has_callbacks are then constants, so hashing and comparing a key become a load, a multiply-xorshift and a compare.
+ */
+AWS_FORCE_INLINE static inline uint64_t s_hash_key(
+    const struct aws_inline_hash_table *table,
+    const void *key,
+    size_t key_size,
+    bool has_callbacks) {
+
+    uint64_t hash;
+    if (has_callbacks) {
+        hash = table->hash_fn(key);
+    } else if (key_size == sizeof(uint64_t)) {
+        uint64_t int_key;
+        memcpy(&int_key, key, sizeof(int_key));
+        hash = s_mix64(int_key);
+    } else if (key_size == sizeof(uint32_t)) {
+        uint32_t int_key;
+        memcpy(&int_key, key, sizeof(int_key));
+        hash = s_mix64(int_key);
+    } else {
+        hash = aws_hash_bytes_fast(key, key_size);
+    }
+
+    /* 0 marks an empty slot */
+    return hash ? hash : 1;
+}
+
+AWS_FORCE_INLINE static inline bool s_keys_eq(
+    const struct aws_inline_hash_table *table,
+    const void *a,
+    const void *b,
+    size_t key_size,
+    bool has_callbacks) {
+
+    if (has_callbacks) {
+        return table->equals_fn(a, b);
+    }
+    return memcmp(a, b, key_size) == 0;
+}
+
+/*
+ * Returns the index of key's slot, or SIZE_MAX if it isn't in the table. *p_hash is set to the key's hash either way.
+ */
+AWS_FORCE_INLINE static inline size_t s_find_index_impl(
+    const struct aws_inline_hash_table *table,
+    const void *key,
+    uint64_t *p_hash,
+    size_t key_size,
+    bool has_callbacks) {
+
+    const uint64_t hash = s_hash_key(table, key, key_size, has_callbacks);
+    *p_hash = hash;
+
+    for (size_t probe_idx = 0;; ++probe_idx) {
+        const size_t idx = (size_t)(hash + probe_idx) & table->mask;
+        uint8_t *slot = s_slot(table, idx);
+        const uint64_t slot_hash = *s_slot_hash(slot);
+
+        if (!slot_hash) {
+            return SIZE_MAX;
+        }
+        if (slot_hash == hash && s_keys_eq(table, key, s_slot_key(slot), key_size, has_callbacks)) {
+            return idx;
+        }
+        /* an element living closer to its home slot than we are to ours means the key isn't here */
+        if (((idx - slot_hash) & table->mask) < probe_idx) {
+            return SIZE_MAX;
+        }
+    }
+}
+
+static size_t s_find_index_u32(const struct aws_inline_hash_table *table, const void *key, uint64_t *p_hash) {
+    return s_find_index_impl(table, key, p_hash, sizeof(uint32_t), false);
+}
+
+static size_t s_find_index_u64(const struct aws_inline_hash_table *table, const void *key, uint64_t *p_hash) {
+    return s_find_index_impl(table, key, p_hash, sizeof(uint64_t), false);
+}
+
+static size_t s_find_index(const struct aws_inline_hash_table *table, const void *key, uint64_t *p_hash) {
+    if (!table->equals_fn) {
+        if (table->key_size == sizeof(uint64_t)) {
+            return s_find_index_u64(table, key, p_hash);
+        }
+        if (table->key_size == sizeof(uint32_t)) {
+            return s_find_index_u32(table, key, p_hash);
+        }
+        return s_find_index_impl(table, key, p_hash, table->key_size, false);
+    }
+    return s_find_index_impl(table, key, p_hash, table->key_size, true);
+}
+
+/*
+ * Places the element in the first scratch slot, displacing richer elements as it goes (see s_emplace_item() in
+ * hash_table.c). Returns the index the element itself ended up at. There must be at least one empty slot.
+ */
+static size_t s_emplace_scratch(struct aws_inline_hash_table *table) {
+    uint8_t *carried = s_slot(table, table->size);
+    uint8_t *swap = s_slot(table, table->size + 1);
+    size_t result = SIZE_MAX;
+    size_t probe_idx = 0;
+
+    /* there is always at least one empty slot, so this terminates */
+    while (1) {
+        const size_t idx = (size_t)(*s_slot_hash(carried) + probe_idx) & table->mask;
+        uint8_t *victim = s_slot(table, idx);
+        const uint64_t victim_hash = *s_slot_hash(victim);
+        const size_t victim_probe_idx = (idx - victim_hash) & table->mask;
+
+        if (!victim_hash) {
+            memcpy(victim, carried, table->slot_size);
+            return result == SIZE_MAX ? idx : result;
+        }
+
+        if (victim_probe_idx < probe_idx) {
+            if (result == SIZE_MAX) {
+                result = idx;
+            }
+            memcpy(swap, victim, table->slot_size);
+            memcpy(victim, carried, table->slot_size);
+            memcpy(carried, swap, table->slot_size);
+            probe_idx = victim_probe_idx + 1;
+        } else {
+            probe_idx++;
+        }
+    }
+}
+
+static int s_required_bytes(const struct aws_inline_hash_table *table, size_t size, size_t *required_bytes) {
+    /* 2 extra slots of scratch space */
+    size_t slot_count = 0;
+    if (aws_add_size_checked(size, 2, &slot_count)) {
+        return AWS_OP_ERR;
+    }
+    return aws_mul_size_checked(slot_count, table->slot_size, required_bytes);
+}
+
+/* Moves every element into a fresh allocation of new_size slots */
+static int s_resize(struct aws_inline_hash_table *table, size_t new_size) {
+    size_t required_bytes = 0;
+    if (s_required_bytes(table, new_size, &required_bytes)) {
+        return AWS_OP_ERR;
+    }
+
+    uint8_t *slots = aws_mem_calloc(table->alloc, 1, required_bytes);
+    if (!slots) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_inline_hash_table old = *table;
+    table->slots = slots;
+    table->size = new_size;
+    table->mask = new_size - 1;
+    table->max_load = (size_t)(MAX_LOAD_FACTOR * (double)new_size);
+    /* Ensure that there is always at least one empty slot in the hash table */
+    if (table->max_load >= new_size) {
+        table->max_load = new_size - 1;
+    }
+
+    if (old.slots) {
+        for (size_t idx = 0; idx < old.size; ++idx) {
+            uint8_t *slot = s_slot(&old, idx);
+            if (*s_slot_hash(slot)) {
+                memcpy(s_slot(table, table->size), slot, table->slot_size);
+                s_emplace_scratch(table);
+            }
+        }
+        aws_mem_release(table->alloc, old.slots);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Removes the element at idx by shifting the elements after it back, as hash_table.c's s_remove_entry() does.
+ * Returns the last slot touched.
+ */
+static size_t s_remove_at(struct aws_inline_hash_table *table, size_t idx) {
+    table->entry_count--;
+
+    while (1) {
+        const size_t next_idx = (idx + 1) & table->mask;
+        uint8_t *next = s_slot(table, next_idx);
+        const uint64_t next_hash = *s_slot_hash(next);
+
+        /* stop at an empty slot, or at an element which is already in its home slot */
+        if (!next_hash || (next_hash & table->mask) == next_idx) {
+            break;
+        }
+
+        memcpy(s_slot(table, idx), next, table->slot_size);
+        idx = next_idx;
+    }
+
+    memset(s_slot(table, idx), 0, table->slot_size);
+    return idx;
+}
+
+int aws_inline_hash_table_init(
+    struct aws_inline_hash_table *table,
+    struct aws_allocator *alloc,
+    size_t size,
+    size_t key_size,
+    size_t value_size,
+    aws_hash_fn *hash_fn,
+    aws_hash_callback_eq_fn *equals_fn) {
+    AWS_PRECONDITION(table != NULL);
+    AWS_PRECONDITION(alloc != NULL);
+    AWS_PRECONDITION(key_size > 0);
+    AWS_PRECONDITION((hash_fn == NULL) == (equals_fn == NULL));
+
+    AWS_ZERO_STRUCT(*table);
+    table->alloc = alloc;
+    table->hash_fn = hash_fn;
+    table->equals_fn = equals_fn;
+    table->key_size = key_size;
+    table->value_size = value_size;
+
+    /* keys and values are small, the limit just keeps the slot size arithmetic from overflowing */
+    if (key_size > SIZE_MAX / 4 || value_size > SIZE_MAX / 4) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+    table->value_offset = s_round_up(sizeof(uint64_t) + key_size, s_alignment_for(value_size));
+    table->slot_size = s_round_up(table->value_offset + value_size, sizeof(uint64_t));
+
+    /* room for size elements without growing, at our load factor */
+    size_t min_size = (size_t)((double)size / MAX_LOAD_FACTOR) + 1;
+    if (min_size < 2) {
+        min_size = 2;
+    }
+    size_t table_size = 0;
+    if (aws_round_up_to_power_of_two(min_size, &table_size)) {
+        return AWS_OP_ERR;
+    }
+
+    return s_resize(table, table_size);
+}
+
+void aws_inline_hash_table_clean_up(struct aws_inline_hash_table *table) {
+    AWS_PRECONDITION(table != NULL);
+
+    if (!table->slots) {
+        return;
+    }
+
+    aws_mem_release(table->alloc, table->slots);
+    table->slots = NULL;
+    table->size = 0;
+    table->mask = 0;
+    table->entry_count = 0;
+    table->max_load = 0;
+}
+
+size_t aws_inline_hash_table_get_entry_count(const struct aws_inline_hash_table *table) {
+    AWS_PRECONDITION(table != NULL);
+    return table->entry_count;
+}
+
+int aws_inline_hash_table_find(const struct aws_inline_hash_table *table, const void *key, void **p_value) {
+    AWS_PRECONDITION(table != NULL && table->slots != NULL);
+    AWS_PRECONDITION(key != NULL);
+    AWS_PRECONDITION(p_value != NULL);
+
+    uint64_t hash = 0;
+    const size_t idx = s_find_index(table, key, &hash);
+    *p_value = idx == SIZE_MAX ? NULL : s_slot_value(table, s_slot(table, idx));
+    return AWS_OP_SUCCESS;
+}
+
+int aws_inline_hash_table_create(
+    struct aws_inline_hash_table *table,
+    const void *key,
+    void **p_value,
+    int *was_created) {
+    AWS_PRECONDITION(table != NULL && table->slots != NULL);
+    AWS_PRECONDITION(key != NULL);
+
+    int ignored;
+    if (!was_created) {
+        was_created = &ignored;
+    }
+
+    uint64_t hash = 0;
+    size_t idx = s_find_index(table, key, &hash);
+    if (idx != SIZE_MAX) {
+        if (p_value) {
+            *p_value = s_slot_value(table, s_slot(table, idx));
+        }
+        *was_created = 0;
+        return AWS_OP_SUCCESS;
+    }
+
+    if (table->entry_count + 1 > table->max_load) {
+        size_t new_size = 0;
+        if (aws_mul_size_checked(table->size, 2, &new_size) || s_resize(table, new_size)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    uint8_t *scratch = s_slot(table, table->size);
+    memset(scratch, 0, table->slot_size);
+    *s_slot_hash(scratch) = hash;
+    memcpy(s_slot_key(scratch), key, table->key_size);
+
+    idx = s_emplace_scratch(table);
+    table->entry_count++;
+
+    if (p_value) {
+        *p_value = s_slot_value(table, s_slot(table, idx));
+    }
+    *was_created = 1;
+    return AWS_OP_SUCCESS;
+}
+
+int aws_inline_hash_table_put(
+    struct aws_inline_hash_table *table,
+    const void *key,
+    const void *value,
+    int *was_created) {
+    AWS_PRECONDITION(table->value_size == 0 || value != NULL);
+
+    void *stored_value = NULL;
+    if (aws_inline_hash_table_create(table, key, &stored_value, was_created)) {
+        return AWS_OP_ERR;
+    }
+
+    if (table->value_size) {
+        memcpy(stored_value, value, table->value_size);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+int aws_inline_hash_table_remove(
+    struct aws_inline_hash_table *table,
+    const void *key,
+    void *p_value,
+    int *was_present) {
+    AWS_PRECONDITION(table != NULL && table->slots != NULL);
+    AWS_PRECONDITION(key != NULL);
+
+    int ignored;
+    if (!was_present) {
+        was_present = &ignored;
+    }
+
+    uint64_t hash = 0;
+    const size_t idx = s_find_index(table, key, &hash);
+    if (idx == SIZE_MAX) {
+        *was_present = 0;
+        return AWS_OP_SUCCESS;
+    }
+
+    if (p_value && table->value_size) {
+        memcpy(p_value, s_slot_value(table, s_slot(table, idx)), table->value_size);
+    }
+    s_remove_at(table, idx);
+    *was_present = 1;
+    return AWS_OP_SUCCESS;
+}
+
+int aws_inline_hash_table_foreach(
+    struct aws_inline_hash_table *table,
+    int (*callback)(void *context, const void *key, void *value),
+    void *context) {
+    AWS_PRECONDITION(table != NULL);
+    AWS_PRECONDITION(callback != NULL);
+
+    size_t limit = table->size;
+    size_t idx = 0;
+    while (idx < limit) {
+        uint8_t *slot = s_slot(table, idx);
+        if (!*s_slot_hash(slot)) {
+            ++idx;
+            continue;
+        }
+
+        int rv = callback(context, s_slot_key(slot), s_slot_value(table, slot));
+
+        if (rv & AWS_COMMON_HASH_TABLE_ITER_DELETE) {
+            /* The next element may have shifted into this slot, so look at it again. If the shift wrapped around, an
+             * element we already visited was moved into the last slot; stop before reaching it again. */
+            const size_t last_idx = s_remove_at(table, idx);
+            if (last_idx < idx || last_idx >= limit) {
+                --limit;
+            }
+        } else {
+            ++idx;
+        }
+
+        if (!(rv & AWS_COMMON_HASH_TABLE_ITER_CONTINUE)) {
+            break;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+void aws_inline_hash_table_clear(struct aws_inline_hash_table *table) {
+    AWS_PRECONDITION(table != NULL);
+
+    if (table->slots) {
+        memset(table->slots, 0, table->size * table->slot_size);
+    }
+    table->entry_count = 0;
+}
@@ -14,12 +14,23 @@
  */
 #include <aws/common/lru_cache.h>
 
-struct cache_node {
-    struct aws_linked_list_node node;
-    struct aws_lru_cache *cache;
-    const void *key;
-    void *value;
-};
+#include <aws/common/clock.h>
+
+#include <aws/common/private/lru_cache_impl.h>
+
+static int s_compare_expiry(const void *a, const void *b) {
+    uint64_t a_expiry = (*(struct cache_node **)a)->expiry;
+    uint64_t b_expiry = (*(struct cache_node **)b)->expiry;
+    return a_expiry > b_expiry; /* min-heap */
+}
+
+static void s_unqueue_expiry(struct aws_lru_cache *cache, struct cache_node *cache_node) {
+    if (cache_node->expiry) {
+        struct cache_node *removed = NULL;
+        aws_priority_queue_remove(&cache->expiry_queue, &removed, &cache_node->expiry_node);
+        cache_node->expiry = 0;
+    }
+}
 
 static void s_element_destroy(void *value) {
     struct cache_node *cache_node = value;
@@ -28,6 +39,11 @@ static void s_element_destroy(void *value) {
         cache_node->cache->user_on_value_destroy(cache_node->value);
     }
 
+    cache_node->cache->total_cost -= cache_node->cost;
+    s_unqueue_expiry(cache_node->cache, cache_node);
+    if (cache_node->cache->policy_state) {
+        lru_cache_policy_on_destroy(cache_node->cache, cache_node);
+    }
     aws_linked_list_remove(&cache_node->node);
     aws_mem_release(cache_node->cache->allocator, cache_node);
 }
@@ -40,22 +56,114 @@ int aws_lru_cache_init(
     aws_hash_callback_destroy_fn *destroy_key_fn,
     aws_hash_callback_destroy_fn *destroy_value_fn,
     size_t max_items) {
+
+    struct aws_lru_cache_options options = {
+        .hash_fn = hash_fn,
+        .equals_fn = equals_fn,
+        .destroy_key_fn = destroy_key_fn,
+        .destroy_value_fn = destroy_value_fn,
+        .max_items = max_items,
+        .policy = AWS_LRU_CACHE_POLICY_EXACT,
+    };
+    return aws_lru_cache_init_with_options(cache, allocator, &options);
+}
+
+static void s_purge_task(struct aws_task *task, void *arg, enum aws_task_status status);
+
+int aws_lru_cache_init_with_options(
+    struct aws_lru_cache *cache,
+    struct aws_allocator *allocator,
+    const struct aws_lru_cache_options *options) {
     AWS_ASSERT(allocator);
-    AWS_ASSERT(max_items);
+    AWS_ASSERT(options);
+
+    if ((unsigned)options->policy > AWS_LRU_CACHE_POLICY_TINY_LFU) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    bool uses_policy_state =
+        options->policy != AWS_LRU_CACHE_POLICY_EXACT && options->policy != AWS_LRU_CACHE_POLICY_CLOCK;
+    /* the other policies size their queues by element count */
+    if (!options->max_items && (!options->max_cost || uses_policy_state)) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
 
     cache->allocator = allocator;
-    cache->max_items = max_items;
-    cache->user_on_value_destroy = destroy_value_fn;
+    cache->max_items = options->max_items;
+    cache->user_on_value_destroy = options->destroy_value_fn;
+    cache->policy = options->policy;
+    cache->eviction_count = 0;
+    cache->max_cost = options->max_cost;
+    cache->total_cost = 0;
+    cache->cost_fn = options->cost_fn;
+    cache->hit_count = 0;
+    cache->miss_count = 0;
+    cache->clock_fn = options->clock_fn ? options->clock_fn : aws_high_res_clock_get_ticks;
+    cache->ttl = options->ttl;
+    cache->expiration_count = 0;
+    cache->purge_scheduler = options->purge_scheduler;
+    cache->purge_interval = options->purge_interval;
+    aws_task_init(&cache->purge_task, s_purge_task, cache, "lru_cache_purge_expired");
+    cache->purge_scheduled = false;
+    cache->policy_state = NULL;
 
     aws_linked_list_init(&cache->list);
-    return aws_hash_table_init(
-        &cache->table, allocator, max_items, hash_fn, equals_fn, destroy_key_fn, s_element_destroy);
+    if (aws_hash_table_init(
+            &cache->table,
+            allocator,
+            options->max_items ? options->max_items : 16,
+            options->hash_fn,
+            options->equals_fn,
+            options->destroy_key_fn,
+            s_element_destroy)) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_priority_queue_init_dynamic(
+            &cache->expiry_queue, allocator, 0, sizeof(struct cache_node *), s_compare_expiry)) {
+        aws_hash_table_clean_up(&cache->table);
+        return AWS_OP_ERR;
+    }
+
+    if (uses_policy_state && lru_cache_policy_init(cache, options->hash_fn)) {
+        aws_priority_queue_clean_up(&cache->expiry_queue);
+        aws_hash_table_clean_up(&cache->table);
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * AWS_LRU_CACHE_POLICY_CLOCK: advances the clock hand (the back of the list) past every element used since it was
+ * last passed, clearing their bits and moving them to the front, and returns the node it stops on. Stops within one
+ * lap, as every bit it passes is cleared.
+ */
+static struct cache_node *s_clock_advance(struct aws_lru_cache *cache) {
+    while (true) {
+        struct aws_linked_list_node *back = aws_linked_list_back(&cache->list);
+        struct cache_node *cache_node = AWS_CONTAINER_OF(back, struct cache_node, node);
+        if (!aws_atomic_load_int_explicit(&cache_node->referenced, aws_memory_order_relaxed)) {
+            return cache_node;
+        }
+
+        aws_atomic_store_int_explicit(&cache_node->referenced, 0, aws_memory_order_relaxed);
+        aws_linked_list_remove(back);
+        aws_linked_list_push_front(&cache->list, back);
+    }
 }
 
 void aws_lru_cache_clean_up(struct aws_lru_cache *cache) {
+    if (cache->purge_scheduled) {
+        aws_task_scheduler_cancel_task(cache->purge_scheduler, &cache->purge_task);
+    }
+
     /* clearing the table will remove all elements. That will also deallocate
      * any cache entries we currently have. */
     aws_hash_table_clean_up(&cache->table);
+    aws_priority_queue_clean_up(&cache->expiry_queue);
+    if (cache->policy_state) {
+        lru_cache_policy_clean_up(cache);
+    }
     AWS_ZERO_STRUCT(*cache);
 }
 
@@ -66,12 +174,48 @@ int aws_lru_cache_find(struct aws_lru_cache *cache, const void *key, void **p_va
 
     if (err_val || !cache_element) {
         *p_value = NULL;
+        if (!err_val && cache->policy != AWS_LRU_CACHE_POLICY_CLOCK) {
+            ++cache->miss_count;
+            if (cache->policy_state) {
+                lru_cache_policy_on_miss(cache, key);
+            }
+        }
         return err_val;
     }
 
     struct cache_node *cache_node = cache_element->value;
+    uint64_t now = 0;
+    if (cache_node->expiry && !cache->clock_fn(&now) && now >= cache_node->expiry) {
+        *p_value = NULL;
+        if (cache->policy == AWS_LRU_CACHE_POLICY_CLOCK) {
+            return AWS_OP_SUCCESS;
+        }
+
+        ++cache->miss_count;
+        ++cache->expiration_count;
+        aws_hash_table_remove(&cache->table, key, NULL, NULL);
+        if (cache->policy_state) {
+            lru_cache_policy_on_miss(cache, key);
+        }
+        return AWS_OP_SUCCESS;
+    }
+
     *p_value = cache_node->value;
 
+    if (cache->policy == AWS_LRU_CACHE_POLICY_CLOCK) {
+        /* only write if the bit is clear, so hits on a hot element leave its cache line shared between readers */
+        if (!aws_atomic_load_int_explicit(&cache_node->referenced, aws_memory_order_relaxed)) {
+            aws_atomic_store_int_explicit(&cache_node->referenced, 1, aws_memory_order_relaxed);
+        }
+        return AWS_OP_SUCCESS;
+    }
+
+    ++cache->hit_count;
+    if (cache->policy_state) {
+        lru_cache_policy_on_hit(cache, cache_node);
+        return AWS_OP_SUCCESS;
+    }
+
     /* on access, remove from current place in list and move it to the head. */
     aws_linked_list_remove(&cache_node->node);
     aws_linked_list_push_front(&cache->list, &cache_node->node);
@@ -79,7 +223,168 @@ int aws_lru_cache_find(struct aws_lru_cache *cache, const void *key, void **p_va
     return AWS_OP_SUCCESS;
 }
 
-int aws_lru_cache_put(struct aws_lru_cache *cache, const void *key, void *p_value) {
+/*
+ * Evicts elements in the order the policy would, until the total cost is within max_cost. May evict the element just
+ * added or updated, if the policy ranks it last.
+ */
+static void s_policy_enforce_max_cost(struct aws_lru_cache *cache) {
+    while (cache->max_cost && cache->total_cost > cache->max_cost) {
+        struct cache_node *victim = lru_cache_policy_next_victim(cache);
+        AWS_ASSUME(victim);
+        aws_hash_table_remove(&cache->table, victim->key, NULL, NULL);
+        ++cache->eviction_count;
+    }
+}
+
+/*
+ * aws_lru_cache_put() for the policies with a policy_state. An existing element is updated in place and counts as a
+ * use, rather than being replaced by a new one.
+ */
+static int s_policy_put(
+    struct aws_lru_cache *cache,
+    const void *key,
+    void *p_value,
+    size_t cost,
+    struct aws_hash_element *element,
+    int was_added,
+    struct cache_node *cache_node) {
+
+    if (!was_added) {
+        struct cache_node *new_node = cache_node;
+        cache_node = element->value;
+        if (cache->user_on_value_destroy) {
+            cache->user_on_value_destroy(cache_node->value);
+        }
+        cache_node->value = p_value;
+        cache_node->key = key;
+        cache->total_cost = cache->total_cost - cache_node->cost + cost;
+        cache_node->cost = cost;
+
+        /* the existing node takes the new one's place on the expiry queue. As that has just been removed, the push
+         * doesn't need more memory and can't fail. */
+        const uint64_t expiry = new_node->expiry;
+        s_unqueue_expiry(cache, new_node);
+        aws_mem_release(cache->allocator, new_node);
+        s_unqueue_expiry(cache, cache_node);
+        if (expiry) {
+            cache_node->expiry = expiry;
+            int err = aws_priority_queue_push_ref(&cache->expiry_queue, &cache_node, &cache_node->expiry_node);
+            AWS_ASSERT(!err);
+            (void)err;
+        }
+
+        lru_cache_policy_on_hit(cache, cache_node);
+        s_policy_enforce_max_cost(cache);
+        return AWS_OP_SUCCESS;
+    }
+
+    cache_node->value = p_value;
+    cache_node->key = key;
+    cache_node->cache = cache;
+    cache_node->cost = cost;
+    aws_atomic_init_int(&cache_node->referenced, 0);
+    cache_node->hash_code = lru_cache_policy_hash(cache, key);
+    element->value = cache_node;
+    cache->total_cost += cost;
+
+    /* this may evict elements, invalidating element */
+    lru_cache_policy_insert(cache, cache_node);
+    s_policy_enforce_max_cost(cache);
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * AWS_LRU_CACHE_POLICY_EXACT and _CLOCK: evicts from the back of the list (once the clock hand has moved past any
+ * recently used) until the element count is within max_items and adding an element of `cost` would keep the total
+ * cost within max_cost. The element being added isn't in the list yet, so it can't be chosen.
+ */
+static void s_make_room(struct aws_lru_cache *cache, size_t cost) {
+    while (!aws_linked_list_empty(&cache->list)) {
+        bool over_count = cache->max_items && aws_hash_table_get_entry_count(&cache->table) > cache->max_items;
+        bool over_cost = cache->max_cost && cache->total_cost > cache->max_cost - cost;
+        if (!over_count && !over_cost) {
+            return;
+        }
+
+        struct cache_node *entry_to_remove = NULL;
+        if (cache->policy == AWS_LRU_CACHE_POLICY_CLOCK) {
+            entry_to_remove = s_clock_advance(cache);
+        } else {
+            struct aws_linked_list_node *node_to_remove = aws_linked_list_back(&cache->list);
+            entry_to_remove = AWS_CONTAINER_OF(node_to_remove, struct cache_node, node);
+        }
+        /*the callback will unlink and deallocate the node */
+        aws_hash_table_remove(&cache->table, entry_to_remove->key, NULL, NULL);
+        ++cache->eviction_count;
+    }
+}
+
+/*
+ * With a purge_scheduler, makes sure the purge task will run by the time an element expiring at `expiry` should be
+ * removed, moving it earlier if need be.
+ */
+static void s_schedule_purge(struct aws_lru_cache *cache, uint64_t expiry) {
+    if (!cache->purge_scheduler) {
+        return;
+    }
+
+    uint64_t purge_time = expiry;
+    if (cache->purge_interval && expiry % cache->purge_interval) {
+        purge_time = aws_add_u64_saturating(expiry, cache->purge_interval - expiry % cache->purge_interval);
+    }
+
+    if (cache->purge_scheduled) {
+        if (cache->purge_task.timestamp <= purge_time) {
+            return;
+        }
+        aws_task_scheduler_cancel_task(cache->purge_scheduler, &cache->purge_task);
+    }
+
+    cache->purge_scheduled = true;
+    aws_task_scheduler_schedule_future(cache->purge_scheduler, &cache->purge_task, purge_time);
+}
+
+/* Removes everything expired by now (if the task runs late, that's more than it was scheduled for), then schedules
+ * itself for the next expiry */
+static void s_purge_task(struct aws_task *task, void *arg, enum aws_task_status status) {
+    struct aws_lru_cache *cache = arg;
+    cache->purge_scheduled = false;
+    if (status != AWS_TASK_STATUS_RUN_READY) {
+        return;
+    }
+
+    uint64_t now = 0;
+    if (cache->clock_fn(&now) || now < task->timestamp) {
+        now = task->timestamp;
+    }
+    aws_lru_cache_purge_expired(cache, now, 0);
+
+    uint64_t next_expiry = 0;
+    if (aws_lru_cache_get_next_expiry(cache, &next_expiry)) {
+        s_schedule_purge(cache, next_expiry);
+    }
+}
+
+/* The time an element added now should expire, or 0 if the cache has no ttl */
+static int s_default_expiry(struct aws_lru_cache *cache, uint64_t *expiry) {
+    *expiry = 0;
+    if (!cache->ttl) {
+        return AWS_OP_SUCCESS;
+    }
+
+    uint64_t now = 0;
+    if (cache->clock_fn(&now)) {
+        return AWS_OP_ERR;
+    }
+    *expiry = aws_add_u64_saturating(now, cache->ttl);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_put(struct aws_lru_cache *cache, const void *key, void *p_value, size_t cost, uint64_t expiry) {
+
+    if (cache->max_cost && cost > cache->max_cost) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
 
     struct cache_node *cache_node = aws_mem_acquire(cache->allocator, sizeof(struct cache_node));
 
@@ -87,15 +392,32 @@ int aws_lru_cache_put(struct aws_lru_cache *cache, const void *key, void *p_valu
         return AWS_OP_ERR;
     }
 
+    /* queue the expiry first, as it is the one step which can fail and is simple to undo */
+    cache_node->expiry = expiry;
+    cache_node->expiry_node.current_index = SIZE_MAX;
+    if (expiry && aws_priority_queue_push_ref(&cache->expiry_queue, &cache_node, &cache_node->expiry_node)) {
+        aws_mem_release(cache->allocator, cache_node);
+        return AWS_OP_ERR;
+    }
+
     struct aws_hash_element *element = NULL;
     int was_added = 0;
     int err_val = aws_hash_table_create(&cache->table, key, &element, &was_added);
 
     if (err_val) {
+        s_unqueue_expiry(cache, cache_node);
         aws_mem_release(cache->allocator, cache_node);
         return err_val;
     }
 
+    if (expiry) {
+        s_schedule_purge(cache, expiry);
+    }
+
+    if (cache->policy_state) {
+        return s_policy_put(cache, key, p_value, cost, element, was_added, cache_node);
+    }
+
     if (element->value) {
         s_element_destroy(element->value);
     }
@@ -103,23 +425,58 @@ int aws_lru_cache_put(struct aws_lru_cache *cache, const void *key, void *p_valu
     cache_node->value = p_value;
     cache_node->key = key;
     cache_node->cache = cache;
+    cache_node->cost = cost;
+    aws_atomic_init_int(&cache_node->referenced, 0);
     element->value = cache_node;
 
+    /* a replaced element has already been destroyed, so this only evicts when over the size limit or the budget */
+    s_make_room(cache, cost);
+
+    cache->total_cost += cost;
     aws_linked_list_push_front(&cache->list, &cache_node->node);
 
-    /* we only want to manage the space if we actually added a new element. */
-    if (was_added && aws_hash_table_get_entry_count(&cache->table) > cache->max_items) {
+    return AWS_OP_SUCCESS;
+}
 
-        /* we're over the cache size limit. Remove whatever is in the back of
-         * the list. */
-        struct aws_linked_list_node *node_to_remove = aws_linked_list_back(&cache->list);
-        AWS_ASSUME(node_to_remove);
-        struct cache_node *entry_to_remove = AWS_CONTAINER_OF(node_to_remove, struct cache_node, node);
-        /*the callback will unlink and deallocate the node */
-        aws_hash_table_remove(&cache->table, entry_to_remove->key, NULL, NULL);
+int aws_lru_cache_put(struct aws_lru_cache *cache, const void *key, void *p_value) {
+    size_t cost = cache->cost_fn ? cache->cost_fn(key, p_value) : 0;
+    return aws_lru_cache_put_with_cost(cache, key, p_value, cost);
+}
+
+int aws_lru_cache_put_with_cost(struct aws_lru_cache *cache, const void *key, void *p_value, size_t cost) {
+    uint64_t expiry = 0;
+    if (s_default_expiry(cache, &expiry)) {
+        return AWS_OP_ERR;
     }
+    return s_put(cache, key, p_value, cost, expiry);
+}
 
-    return AWS_OP_SUCCESS;
+int aws_lru_cache_put_with_expiry(struct aws_lru_cache *cache, const void *key, void *p_value, uint64_t expiry_time) {
+    size_t cost = cache->cost_fn ? cache->cost_fn(key, p_value) : 0;
+    return s_put(cache, key, p_value, cost, expiry_time);
+}
+
+size_t aws_lru_cache_purge_expired(struct aws_lru_cache *cache, uint64_t current_time, size_t max_count) {
+    size_t purged = 0;
+    struct cache_node **next = NULL;
+    while ((!max_count || purged < max_count) &&
+           aws_priority_queue_top(&cache->expiry_queue, (void **)&next) == AWS_OP_SUCCESS &&
+           (*next)->expiry <= current_time) {
+        /* the callback will unlink the node from the queue and deallocate it */
+        aws_hash_table_remove(&cache->table, (*next)->key, NULL, NULL);
+        ++cache->expiration_count;
+        ++purged;
+    }
+    return purged;
+}
+
+bool aws_lru_cache_get_next_expiry(const struct aws_lru_cache *cache, uint64_t *expiry_time) {
+    struct cache_node **next = NULL;
+    if (aws_priority_queue_top(&cache->expiry_queue, (void **)&next)) {
+        return false;
+    }
+    *expiry_time = (*next)->expiry;
+    return true;
 }
 
 int aws_lru_cache_remove(struct aws_lru_cache *cache, const void *key) {
@@ -132,13 +489,29 @@ void aws_lru_cache_clear(struct aws_lru_cache *cache) {
     /* clearing the table will remove all elements. That will also deallocate
      * any cache entries we currently have. */
     aws_hash_table_clear(&cache->table);
+    if (cache->policy_state) {
+        lru_cache_policy_clear(cache);
+    }
 }
 
 void *aws_lru_cache_use_lru_element(struct aws_lru_cache *cache) {
+    if (cache->policy_state) {
+        struct cache_node *victim = lru_cache_policy_next_victim(cache);
+        if (!victim) {
+            return NULL;
+        }
+        lru_cache_policy_on_hit(cache, victim);
+        return victim->value;
+    }
+
     if (aws_linked_list_empty(&cache->list)) {
         return NULL;
     }
 
+    if (cache->policy == AWS_LRU_CACHE_POLICY_CLOCK) {
+        s_clock_advance(cache);
+    }
+
     struct aws_linked_list_node *lru_node = aws_linked_list_back(&cache->list);
 
     aws_linked_list_remove(lru_node);
@@ -148,6 +521,11 @@ void *aws_lru_cache_use_lru_element(struct aws_lru_cache *cache) {
 }
 
 void *aws_lru_cache_get_mru_element(const struct aws_lru_cache *cache) {
+    if (cache->policy_state) {
+        struct cache_node *mru = lru_cache_policy_mru(cache);
+        return mru ? mru->value : NULL;
+    }
+
     if (aws_linked_list_empty(&cache->list)) {
         return NULL;
     }
@@ -161,3 +539,18 @@ void *aws_lru_cache_get_mru_element(const struct aws_lru_cache *cache) {
 size_t aws_lru_cache_get_element_count(const struct aws_lru_cache *cache) {
     return aws_hash_table_get_entry_count(&cache->table);
 }
+
+size_t aws_lru_cache_get_total_cost(const struct aws_lru_cache *cache) {
+    return cache->total_cost;
+}
+
+void aws_lru_cache_get_stats(const struct aws_lru_cache *cache, struct aws_lru_cache_stats *stats) {
+    AWS_PRECONDITION(stats != NULL);
+
+    stats->element_count = aws_hash_table_get_entry_count(&cache->table);
+    stats->total_cost = cache->total_cost;
+    stats->hits = cache->hit_count;
+    stats->misses = cache->miss_count;
+    stats->evictions = cache->eviction_count;
+    stats->expirations = cache->expiration_count;
+}
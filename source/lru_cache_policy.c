@@ -0,0 +1,546 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/private/lru_cache_impl.h>
+
+#include <aws/common/math.h>
+
+#include <string.h>
+
+/*
+ * Which queue a node is on. Each is ordered most recently used first.
+ *   2Q:      RECENT is A1in (FIFO), FREQUENT is Am.
+ *   ARC:     RECENT is T1, FREQUENT is T2.
+ *   TinyLFU: RECENT is the window, PROBATION and FREQUENT (protected) are the main cache's segments.
+ */
+enum lru_cache_queue {
+    QUEUE_RECENT,
+    QUEUE_PROBATION,
+    QUEUE_FREQUENT,
+    QUEUE_COUNT,
+};
+
+/* The hash of an element evicted recently. Only the hash is kept, so the key can be destroyed. */
+struct ghost_node {
+    struct aws_linked_list_node node;
+    uint64_t hash_code;
+};
+
+/* Hashes of evicted elements, most recent first, with a table from hash to node for lookups */
+struct ghost_list {
+    struct aws_linked_list list;
+    struct aws_hash_table table;
+    size_t size;
+};
+
+#define SKETCH_DEPTH 4
+#define SKETCH_MAX_COUNT 15
+/* requests counted before every counter is halved, per counter in a row */
+#define SKETCH_SAMPLE_FACTOR 10
+
+struct aws_lru_cache_policy_state {
+    aws_hash_fn *hash_fn;
+    struct aws_linked_list queues[QUEUE_COUNT];
+    size_t queue_sizes[QUEUE_COUNT];
+    /* 2Q: ghosts[0] is A1out. ARC: ghosts[0] is B1 and ghosts[1] is B2. */
+    struct ghost_list ghosts[2];
+    size_t ghost_count;
+    /* 2Q: the size A1in may grow to before it is evicted from (Kin). TinyLFU: the window size. */
+    size_t recent_limit;
+    /* 2Q: the size of A1out (Kout). ARC: the size of each of B1 and B2. */
+    size_t ghost_limit;
+    /* TinyLFU: the size of the protected segment */
+    size_t frequent_limit;
+    /* ARC: the target size of T1 (p) */
+    size_t recent_target;
+    /* TinyLFU: a count-min sketch of SKETCH_DEPTH rows of sketch_mask + 1 saturating counters */
+    uint8_t *sketch;
+    size_t sketch_mask;
+    size_t sketch_additions;
+    size_t sketch_sample_size;
+    /* the node most recently added or used, NULL once it has been removed */
+    struct cache_node *mru;
+};
+
+/* multipliers giving each row of the sketch an independent-looking index */
+static const uint64_t s_sketch_seeds[SKETCH_DEPTH] = {
+    0x9E3779B97F4A7C15ULL,
+    0xC2B2AE3D27D4EB4FULL,
+    0x165667B19E3779F9ULL,
+    0xD6E8FEB86659FD93ULL,
+};
+
+static int s_ghost_init(struct ghost_list *ghosts, struct aws_allocator *allocator, size_t size) {
+    aws_linked_list_init(&ghosts->list);
+    ghosts->size = 0;
+    return aws_hash_table_init(&ghosts->table, allocator, size, aws_hash_ptr, aws_ptr_eq, NULL, NULL);
+}
+
+static void s_ghost_unlink(struct aws_lru_cache *cache, struct ghost_list *ghosts, struct ghost_node *ghost) {
+    aws_hash_table_remove(&ghosts->table, (void *)(uintptr_t)ghost->hash_code, NULL, NULL);
+    aws_linked_list_remove(&ghost->node);
+    --ghosts->size;
+    aws_mem_release(cache->allocator, ghost);
+}
+
+/* Forgets hash_code, returning whether it was remembered */
+static bool s_ghost_take(struct aws_lru_cache *cache, struct ghost_list *ghosts, uint64_t hash_code) {
+    struct aws_hash_element *elem = NULL;
+    aws_hash_table_find(&ghosts->table, (void *)(uintptr_t)hash_code, &elem);
+    if (!elem) {
+        return false;
+    }
+    s_ghost_unlink(cache, ghosts, elem->value);
+    return true;
+}
+
+static void s_ghost_drop_oldest(struct aws_lru_cache *cache, struct ghost_list *ghosts) {
+    if (!aws_linked_list_empty(&ghosts->list)) {
+        s_ghost_unlink(cache, ghosts, AWS_CONTAINER_OF(aws_linked_list_back(&ghosts->list), struct ghost_node, node));
+    }
+}
+
+/* Remembers hash_code, forgetting the oldest if there are limit already. Best effort: fails silently. */
+static void s_ghost_add(struct aws_lru_cache *cache, struct ghost_list *ghosts, uint64_t hash_code, size_t limit) {
+    /* two keys may share a hash */
+    s_ghost_take(cache, ghosts, hash_code);
+    if (limit == 0) {
+        return;
+    }
+    while (ghosts->size >= limit) {
+        s_ghost_drop_oldest(cache, ghosts);
+    }
+
+    struct ghost_node *ghost = aws_mem_acquire(cache->allocator, sizeof(struct ghost_node));
+    if (!ghost) {
+        return;
+    }
+    ghost->hash_code = hash_code;
+    if (aws_hash_table_put(&ghosts->table, (void *)(uintptr_t)hash_code, ghost, NULL)) {
+        aws_mem_release(cache->allocator, ghost);
+        return;
+    }
+    aws_linked_list_push_front(&ghosts->list, &ghost->node);
+    ++ghosts->size;
+}
+
+static void s_ghost_clear(struct aws_lru_cache *cache, struct ghost_list *ghosts) {
+    while (!aws_linked_list_empty(&ghosts->list)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&ghosts->list);
+        aws_mem_release(cache->allocator, AWS_CONTAINER_OF(node, struct ghost_node, node));
+    }
+    aws_hash_table_clear(&ghosts->table);
+    ghosts->size = 0;
+}
+
+static size_t s_sketch_index(const struct aws_lru_cache_policy_state *state, uint64_t hash_code, size_t row) {
+    const uint64_t mixed = hash_code * s_sketch_seeds[row];
+    return row * (state->sketch_mask + 1) + ((size_t)(mixed >> 32) & state->sketch_mask);
+}
+
+static uint8_t s_sketch_frequency(const struct aws_lru_cache_policy_state *state, uint64_t hash_code) {
+    uint8_t frequency = SKETCH_MAX_COUNT;
+    for (size_t row = 0; row < SKETCH_DEPTH; ++row) {
+        const uint8_t count = state->sketch[s_sketch_index(state, hash_code, row)];
+        frequency = count < frequency ? count : frequency;
+    }
+    return frequency;
+}
+
+/*
+ * Counts a request, with the conservative update: only the counters at the current estimate are incremented. Once
+ * enough requests have been counted, every counter is halved, so the sketch follows changes in popularity.
+ */
+static void s_sketch_increment(struct aws_lru_cache_policy_state *state, uint64_t hash_code) {
+    const uint8_t frequency = s_sketch_frequency(state, hash_code);
+    if (frequency < SKETCH_MAX_COUNT) {
+        for (size_t row = 0; row < SKETCH_DEPTH; ++row) {
+            uint8_t *count = &state->sketch[s_sketch_index(state, hash_code, row)];
+            if (*count == frequency) {
+                ++*count;
+            }
+        }
+    }
+
+    if (++state->sketch_additions >= state->sketch_sample_size) {
+        for (size_t idx = 0; idx < SKETCH_DEPTH * (state->sketch_mask + 1); ++idx) {
+            state->sketch[idx] >>= 1;
+        }
+        state->sketch_additions /= 2;
+    }
+}
+
+static struct cache_node *s_queue_back(const struct aws_lru_cache_policy_state *state, int queue) {
+    if (aws_linked_list_empty(&state->queues[queue])) {
+        return NULL;
+    }
+    return AWS_CONTAINER_OF(aws_linked_list_back(&state->queues[queue]), struct cache_node, node);
+}
+
+static struct cache_node *s_queue_front(const struct aws_lru_cache_policy_state *state, int queue) {
+    if (aws_linked_list_empty(&state->queues[queue])) {
+        return NULL;
+    }
+    return AWS_CONTAINER_OF(aws_linked_list_front(&state->queues[queue]), struct cache_node, node);
+}
+
+static void s_queue_push_front(struct aws_lru_cache_policy_state *state, struct cache_node *node, int queue) {
+    node->queue = queue;
+    aws_linked_list_push_front(&state->queues[queue], &node->node);
+    ++state->queue_sizes[queue];
+}
+
+static void s_queue_move_front(struct aws_lru_cache_policy_state *state, struct cache_node *node, int queue) {
+    aws_linked_list_remove(&node->node);
+    --state->queue_sizes[node->queue];
+    s_queue_push_front(state, node, queue);
+}
+
+/* Evicts node, remembering its hash in ghosts if that is non-NULL */
+static void s_evict(struct aws_lru_cache *cache, struct cache_node *node, struct ghost_list *ghosts) {
+    const uint64_t hash_code = node->hash_code;
+    /* the table's destroy callback unlinks and frees the node */
+    aws_hash_table_remove(&cache->table, node->key, NULL, NULL);
+    ++cache->eviction_count;
+
+    if (ghosts) {
+        s_ghost_add(cache, ghosts, hash_code, cache->policy_state->ghost_limit);
+    }
+}
+
+int lru_cache_policy_init(struct aws_lru_cache *cache, aws_hash_fn *hash_fn) {
+    struct aws_lru_cache_policy_state *state =
+        aws_mem_calloc(cache->allocator, 1, sizeof(struct aws_lru_cache_policy_state));
+    if (!state) {
+        return AWS_OP_ERR;
+    }
+
+    state->hash_fn = hash_fn;
+    for (size_t queue = 0; queue < QUEUE_COUNT; ++queue) {
+        aws_linked_list_init(&state->queues[queue]);
+    }
+
+    const size_t capacity = cache->max_items;
+    switch (cache->policy) {
+        case AWS_LRU_CACHE_POLICY_2Q:
+            /* the sizes recommended by the paper */
+            state->ghost_count = 1;
+            state->recent_limit = capacity / 4 ? capacity / 4 : 1;
+            state->ghost_limit = capacity / 2 ? capacity / 2 : 1;
+            break;
+        case AWS_LRU_CACHE_POLICY_ARC:
+            state->ghost_count = 2;
+            state->ghost_limit = capacity;
+            break;
+        case AWS_LRU_CACHE_POLICY_TINY_LFU: {
+            /* a 1% window, and 80% of the main cache protected, as Caffeine starts out with */
+            state->recent_limit = capacity / 100 ? capacity / 100 : 1;
+            state->frequent_limit = (capacity - (capacity > state->recent_limit ? state->recent_limit : 0)) * 4 / 5;
+
+            size_t width = 0;
+            if (aws_round_up_to_power_of_two(capacity < 16 ? 16 : capacity, &width)) {
+                goto error;
+            }
+            state->sketch = aws_mem_calloc(cache->allocator, SKETCH_DEPTH * width, sizeof(uint8_t));
+            if (!state->sketch) {
+                goto error;
+            }
+            state->sketch_mask = width - 1;
+            state->sketch_sample_size = SKETCH_SAMPLE_FACTOR * width;
+            break;
+        }
+        default:
+            AWS_FATAL_ASSERT(!"policy has no state");
+    }
+
+    size_t ghost_idx = 0;
+    for (; ghost_idx < state->ghost_count; ++ghost_idx) {
+        if (s_ghost_init(&state->ghosts[ghost_idx], cache->allocator, state->ghost_limit)) {
+            while (ghost_idx-- > 0) {
+                aws_hash_table_clean_up(&state->ghosts[ghost_idx].table);
+            }
+            goto error;
+        }
+    }
+
+    cache->policy_state = state;
+    return AWS_OP_SUCCESS;
+
+error:
+    if (state->sketch) {
+        aws_mem_release(cache->allocator, state->sketch);
+    }
+    aws_mem_release(cache->allocator, state);
+    return AWS_OP_ERR;
+}
+
+void lru_cache_policy_clean_up(struct aws_lru_cache *cache) {
+    struct aws_lru_cache_policy_state *state = cache->policy_state;
+    for (size_t ghost_idx = 0; ghost_idx < state->ghost_count; ++ghost_idx) {
+        s_ghost_clear(cache, &state->ghosts[ghost_idx]);
+        aws_hash_table_clean_up(&state->ghosts[ghost_idx].table);
+    }
+    if (state->sketch) {
+        aws_mem_release(cache->allocator, state->sketch);
+    }
+    aws_mem_release(cache->allocator, state);
+    cache->policy_state = NULL;
+}
+
+void lru_cache_policy_clear(struct aws_lru_cache *cache) {
+    struct aws_lru_cache_policy_state *state = cache->policy_state;
+    for (size_t ghost_idx = 0; ghost_idx < state->ghost_count; ++ghost_idx) {
+        s_ghost_clear(cache, &state->ghosts[ghost_idx]);
+    }
+    if (state->sketch) {
+        memset(state->sketch, 0, SKETCH_DEPTH * (state->sketch_mask + 1));
+        state->sketch_additions = 0;
+    }
+    state->recent_target = 0;
+    state->mru = NULL;
+}
+
+uint64_t lru_cache_policy_hash(const struct aws_lru_cache *cache, const void *key) {
+    /* same convention as aws_hash_table for NULL keys */
+    return (key ? cache->policy_state->hash_fn(key) : 42) | 1;
+}
+
+void lru_cache_policy_on_hit(struct aws_lru_cache *cache, struct cache_node *node) {
+    struct aws_lru_cache_policy_state *state = cache->policy_state;
+    state->mru = node;
+
+    switch (cache->policy) {
+        case AWS_LRU_CACHE_POLICY_2Q:
+            /*
+             * The paper leaves a hit in A1in where it is, but then elements which arrived while the cache was filling
+             * up, and were used heavily since, would still be the first evicted once it is full.
+             */
+            s_queue_move_front(state, node, QUEUE_FREQUENT);
+            break;
+        case AWS_LRU_CACHE_POLICY_ARC:
+            s_queue_move_front(state, node, QUEUE_FREQUENT);
+            break;
+        case AWS_LRU_CACHE_POLICY_TINY_LFU:
+            s_sketch_increment(state, node->hash_code);
+            if (node->queue == QUEUE_RECENT) {
+                s_queue_move_front(state, node, QUEUE_RECENT);
+                break;
+            }
+            s_queue_move_front(state, node, QUEUE_FREQUENT);
+            if (state->queue_sizes[QUEUE_FREQUENT] > state->frequent_limit) {
+                s_queue_move_front(state, s_queue_back(state, QUEUE_FREQUENT), QUEUE_PROBATION);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void lru_cache_policy_on_miss(struct aws_lru_cache *cache, const void *key) {
+    if (cache->policy == AWS_LRU_CACHE_POLICY_TINY_LFU) {
+        s_sketch_increment(cache->policy_state, lru_cache_policy_hash(cache, key));
+    }
+}
+
+static size_t s_resident_count(const struct aws_lru_cache_policy_state *state) {
+    return state->queue_sizes[QUEUE_RECENT] + state->queue_sizes[QUEUE_PROBATION] +
+           state->queue_sizes[QUEUE_FREQUENT];
+}
+
+static void s_2q_reclaim(struct aws_lru_cache *cache) {
+    struct aws_lru_cache_policy_state *state = cache->policy_state;
+    if (state->queue_sizes[QUEUE_RECENT] > state->recent_limit || state->queue_sizes[QUEUE_FREQUENT] == 0) {
+        s_evict(cache, s_queue_back(state, QUEUE_RECENT), &state->ghosts[0]);
+    } else {
+        s_evict(cache, s_queue_back(state, QUEUE_FREQUENT), NULL);
+    }
+}
+
+static void s_2q_insert(struct aws_lru_cache *cache, struct cache_node *node) {
+    struct aws_lru_cache_policy_state *state = cache->policy_state;
+    const bool remembered = s_ghost_take(cache, &state->ghosts[0], node->hash_code);
+    if (s_resident_count(state) >= cache->max_items) {
+        s_2q_reclaim(cache);
+    }
+    s_queue_push_front(state, node, remembered ? QUEUE_FREQUENT : QUEUE_RECENT);
+}
+
+/* ARC's REPLACE: evicts from T1 or T2 according to the target size of T1, remembering the victim in B1 or B2 */
+static void s_arc_replace(struct aws_lru_cache *cache, bool in_b2) {
+    struct aws_lru_cache_policy_state *state = cache->policy_state;
+    const size_t t1_size = state->queue_sizes[QUEUE_RECENT];
+    if (t1_size > 0 &&
+        (t1_size > state->recent_target || (in_b2 && t1_size == state->recent_target) ||
+         state->queue_sizes[QUEUE_FREQUENT] == 0)) {
+        s_evict(cache, s_queue_back(state, QUEUE_RECENT), &state->ghosts[0]);
+    } else {
+        s_evict(cache, s_queue_back(state, QUEUE_FREQUENT), &state->ghosts[1]);
+    }
+}
+
+static void s_arc_insert(struct aws_lru_cache *cache, struct cache_node *node) {
+    struct aws_lru_cache_policy_state *state = cache->policy_state;
+    const size_t capacity = cache->max_items;
+    const size_t b1_size = state->ghosts[0].size;
+    const size_t b2_size = state->ghosts[1].size;
+    const bool full = s_resident_count(state) >= capacity;
+
+    if (s_ghost_take(cache, &state->ghosts[0], node->hash_code)) {
+        /* evicted from T1 too soon: T1 should be larger */
+        const size_t delta = b1_size >= b2_size ? 1 : b2_size / b1_size;
+        state->recent_target = state->recent_target + delta < capacity ? state->recent_target + delta : capacity;
+        if (full) {
+            s_arc_replace(cache, false);
+        }
+        s_queue_push_front(state, node, QUEUE_FREQUENT);
+        return;
+    }
+
+    if (s_ghost_take(cache, &state->ghosts[1], node->hash_code)) {
+        /* evicted from T2 too soon: T1 should be smaller */
+        const size_t delta = b2_size >= b1_size ? 1 : b1_size / b2_size;
+        state->recent_target = state->recent_target > delta ? state->recent_target - delta : 0;
+        if (full) {
+            s_arc_replace(cache, true);
+        }
+        s_queue_push_front(state, node, QUEUE_FREQUENT);
+        return;
+    }
+
+    const size_t t1_size = state->queue_sizes[QUEUE_RECENT];
+    if (t1_size + b1_size >= capacity) {
+        if (t1_size < capacity) {
+            s_ghost_drop_oldest(cache, &state->ghosts[0]);
+            if (full) {
+                s_arc_replace(cache, false);
+            }
+        } else {
+            s_evict(cache, s_queue_back(state, QUEUE_RECENT), NULL);
+        }
+    } else if (s_resident_count(state) + b1_size + b2_size >= capacity) {
+        if (s_resident_count(state) + b1_size + b2_size >= 2 * capacity) {
+            s_ghost_drop_oldest(cache, &state->ghosts[1]);
+        }
+        if (full) {
+            s_arc_replace(cache, false);
+        }
+    }
+    s_queue_push_front(state, node, QUEUE_RECENT);
+}
+
+static bool s_more_frequent(
+    const struct aws_lru_cache_policy_state *state,
+    const struct cache_node *a,
+    const struct cache_node *b) {
+    return s_sketch_frequency(state, a->hash_code) > s_sketch_frequency(state, b->hash_code);
+}
+
+static void s_tiny_lfu_insert(struct aws_lru_cache *cache, struct cache_node *node) {
+    struct aws_lru_cache_policy_state *state = cache->policy_state;
+    s_sketch_increment(state, node->hash_code);
+    s_queue_push_front(state, node, QUEUE_RECENT);
+
+    /* the element pushed out of the window becomes a candidate for the main cache */
+    struct cache_node *candidate = NULL;
+    if (state->queue_sizes[QUEUE_RECENT] > state->recent_limit) {
+        candidate = s_queue_back(state, QUEUE_RECENT);
+        s_queue_move_front(state, candidate, QUEUE_PROBATION);
+    }
+
+    while (s_resident_count(state) > cache->max_items) {
+        struct cache_node *victim = s_queue_back(state, QUEUE_PROBATION);
+        if (!victim || victim == candidate) {
+            victim = s_queue_back(state, QUEUE_FREQUENT);
+        }
+        /* the candidate must have been requested more often than the victim to replace it */
+        if (candidate && (!victim || !s_more_frequent(state, candidate, victim))) {
+            victim = candidate;
+        }
+        if (!victim) {
+            victim = s_queue_back(state, QUEUE_RECENT);
+        }
+        if (victim == candidate) {
+            candidate = NULL;
+        }
+        s_evict(cache, victim, NULL);
+    }
+}
+
+void lru_cache_policy_insert(struct aws_lru_cache *cache, struct cache_node *node) {
+    cache->policy_state->mru = node;
+
+    switch (cache->policy) {
+        case AWS_LRU_CACHE_POLICY_2Q:
+            s_2q_insert(cache, node);
+            break;
+        case AWS_LRU_CACHE_POLICY_ARC:
+            s_arc_insert(cache, node);
+            break;
+        case AWS_LRU_CACHE_POLICY_TINY_LFU:
+            s_tiny_lfu_insert(cache, node);
+            break;
+        default:
+            AWS_FATAL_ASSERT(!"policy has no state");
+    }
+}
+
+void lru_cache_policy_on_destroy(struct aws_lru_cache *cache, struct cache_node *node) {
+    struct aws_lru_cache_policy_state *state = cache->policy_state;
+    --state->queue_sizes[node->queue];
+    if (state->mru == node) {
+        state->mru = NULL;
+    }
+}
+
+struct cache_node *lru_cache_policy_next_victim(const struct aws_lru_cache *cache) {
+    const struct aws_lru_cache_policy_state *state = cache->policy_state;
+    struct cache_node *recent = s_queue_back(state, QUEUE_RECENT);
+    struct cache_node *frequent = s_queue_back(state, QUEUE_FREQUENT);
+
+    switch (cache->policy) {
+        case AWS_LRU_CACHE_POLICY_2Q:
+            return state->queue_sizes[QUEUE_RECENT] > state->recent_limit || !frequent ? recent : frequent;
+        case AWS_LRU_CACHE_POLICY_ARC:
+            if (recent && (state->queue_sizes[QUEUE_RECENT] > state->recent_target || !frequent)) {
+                return recent;
+            }
+            return frequent;
+        case AWS_LRU_CACHE_POLICY_TINY_LFU: {
+            /* the window's oldest element against the main cache's victim, as in s_tiny_lfu_insert() */
+            struct cache_node *victim = s_queue_back(state, QUEUE_PROBATION);
+            victim = victim ? victim : frequent;
+            if (!victim || (recent && !s_more_frequent(state, recent, victim))) {
+                return recent;
+            }
+            return victim;
+        }
+        default:
+            return NULL;
+    }
+}
+
+struct cache_node *lru_cache_policy_mru(const struct aws_lru_cache *cache) {
+    const struct aws_lru_cache_policy_state *state = cache->policy_state;
+    if (state->mru) {
+        return state->mru;
+    }
+    for (int queue = QUEUE_FREQUENT; queue >= 0; --queue) {
+        struct cache_node *front = s_queue_front(state, queue);
+        if (front) {
+            return front;
+        }
+    }
+    return NULL;
+}
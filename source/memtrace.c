@@ -0,0 +1,485 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/allocator.h>
+#include <aws/common/atomics.h>
+#include <aws/common/byte_buf.h>
+#include <aws/common/hash_table.h>
+#include <aws/common/logging.h>
+#include <aws/common/mutex.h>
+#include <aws/common/system_info.h>
+
+#include <stdlib.h>
+
+/*
+ * Every traced allocation is prefixed by a header recording its size and, if its call stack was captured, the
+ * record for that stack. That keeps release O(1) with no lookups, and means the BYTES level needs nothing but
+ * atomic counters. Stack records are shared by every allocation from the same call stack, and live in a hash table
+ * keyed on the frames so that they can be found when capturing.
+ */
+
+/*
+ * Frames belonging to the allocator API and the tracer itself, for each entry point that can capture a stack. Each
+ * entry point captures its own backtrace, so that these don't depend on what the compiler inlines.
+ */
+/* aws_mem_acquire() -> s_trace_mem_acquire() */
+#define ACQUIRE_FRAMES_TO_SKIP 2
+/* aws_mem_realloc() -> s_trace_mem_realloc() */
+#define REALLOC_FRAMES_TO_SKIP 2
+
+struct alloc_header {
+    size_t size;
+    struct stack_record *stack;
+};
+
+/* keep allocations aligned the same as aws_mem_acquire_many() promises */
+static const size_t s_header_size = (sizeof(struct alloc_header) + sizeof(intmax_t) - 1) & ~(sizeof(intmax_t) - 1);
+
+struct stack_record {
+    uint64_t hash;
+    size_t live_bytes;
+    size_t live_allocs;
+    size_t total_allocs;
+    size_t depth;
+    void *frames[AWS_MEM_TRACE_MAX_FRAMES];
+};
+
+struct alloc_tracer {
+    struct aws_allocator *allocator; /* underlying allocator */
+    enum aws_mem_trace_level level;
+    size_t sample_rate;
+    size_t frames_per_stack;
+    struct aws_atomic_var live_bytes;
+    struct aws_atomic_var peak_bytes;
+    struct aws_atomic_var live_allocs;
+    struct aws_atomic_var total_allocs;
+    struct aws_atomic_var total_releases;
+    struct aws_atomic_var sample_counter;
+    struct aws_mutex mutex;       /* protects stacks, and the counters in each stack_record */
+    struct aws_hash_table stacks; /* struct stack_record * -> itself */
+};
+
+static uint64_t s_stack_hash(const void *item) {
+    const struct stack_record *stack = item;
+    return stack->hash;
+}
+
+static bool s_stack_eq(const void *a, const void *b) {
+    const struct stack_record *stack_a = a;
+    const struct stack_record *stack_b = b;
+    return stack_a->depth == stack_b->depth &&
+           memcmp(stack_a->frames, stack_b->frames, stack_a->depth * sizeof(void *)) == 0;
+}
+
+static void *s_trace_mem_acquire(struct aws_allocator *allocator, size_t size);
+static void s_trace_mem_release(struct aws_allocator *allocator, void *ptr);
+static void *s_trace_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size);
+static void s_trace_mem_release_sized(struct aws_allocator *allocator, void *ptr, size_t size);
+static void s_trace_mem_stats(struct aws_allocator *allocator, struct aws_allocator_stats *stats);
+
+static struct aws_allocator s_trace_allocator = {
+    .mem_acquire = s_trace_mem_acquire,
+    .mem_release = s_trace_mem_release,
+    .mem_realloc = s_trace_mem_realloc,
+    .mem_release_sized = s_trace_mem_release_sized,
+    .mem_stats = s_trace_mem_stats,
+};
+
+struct aws_allocator *aws_mem_tracer_new(
+    struct aws_allocator *allocator,
+    enum aws_mem_trace_level level,
+    size_t sample_rate,
+    size_t frames_per_stack) {
+    AWS_PRECONDITION(aws_allocator_is_valid(allocator));
+
+    struct alloc_tracer *tracer = NULL;
+    struct aws_allocator *trace_allocator = NULL;
+    aws_mem_acquire_many(
+        allocator, 2, &tracer, sizeof(struct alloc_tracer), &trace_allocator, sizeof(struct aws_allocator));
+
+    if (!tracer || !trace_allocator) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*tracer);
+    *trace_allocator = s_trace_allocator;
+    trace_allocator->impl = tracer;
+
+    tracer->allocator = allocator;
+    tracer->level = level;
+    tracer->sample_rate = (level == AWS_MEMTRACE_SAMPLED_STACKS && sample_rate > 0) ? sample_rate : 1;
+    tracer->frames_per_stack =
+        (frames_per_stack > 0 && frames_per_stack < AWS_MEM_TRACE_MAX_FRAMES) ? frames_per_stack
+                                                                              : AWS_MEM_TRACE_MAX_FRAMES;
+    aws_atomic_init_int(&tracer->live_bytes, 0);
+    aws_atomic_init_int(&tracer->peak_bytes, 0);
+    aws_atomic_init_int(&tracer->live_allocs, 0);
+    aws_atomic_init_int(&tracer->total_allocs, 0);
+    aws_atomic_init_int(&tracer->total_releases, 0);
+    aws_atomic_init_int(&tracer->sample_counter, 0);
+
+    if (level >= AWS_MEMTRACE_SAMPLED_STACKS) {
+        if (aws_mutex_init(&tracer->mutex)) {
+            goto error;
+        }
+        if (aws_hash_table_init(&tracer->stacks, allocator, 64, s_stack_hash, s_stack_eq, NULL, NULL)) {
+            aws_mutex_clean_up(&tracer->mutex);
+            goto error;
+        }
+    }
+
+    return trace_allocator;
+
+error:
+    aws_mem_release(allocator, tracer);
+    return NULL;
+}
+
+static int s_free_stack_record(void *context, struct aws_hash_element *item) {
+    struct alloc_tracer *tracer = context;
+    aws_mem_release(tracer->allocator, (void *)item->key);
+    return AWS_COMMON_HASH_TABLE_ITER_CONTINUE;
+}
+
+struct aws_allocator *aws_mem_tracer_destroy(struct aws_allocator *trace_allocator) {
+    struct alloc_tracer *tracer = trace_allocator->impl;
+    struct aws_allocator *allocator = tracer->allocator;
+
+    if (tracer->level >= AWS_MEMTRACE_SAMPLED_STACKS) {
+        aws_hash_table_foreach(&tracer->stacks, s_free_stack_record, tracer);
+        aws_hash_table_clean_up(&tracer->stacks);
+        aws_mutex_clean_up(&tracer->mutex);
+    }
+
+    aws_mem_release(allocator, tracer);
+    return allocator;
+}
+
+static void s_update_peak(struct alloc_tracer *tracer, size_t live_bytes) {
+    size_t peak = aws_atomic_load_int(&tracer->peak_bytes);
+    while (live_bytes > peak && !aws_atomic_compare_exchange_int(&tracer->peak_bytes, &peak, live_bytes)) {
+        /* peak was reloaded by the failed exchange */
+    }
+}
+
+/* Returns the record for the calling thread's current stack, creating it if needed. Expects tracer->mutex held. */
+static struct stack_record *s_find_stack(struct alloc_tracer *tracer, void **frames, size_t depth) {
+    struct stack_record key;
+    key.depth = depth;
+    memcpy(key.frames, frames, depth * sizeof(void *));
+    struct aws_byte_cursor frame_bytes = aws_byte_cursor_from_array(frames, depth * sizeof(void *));
+    key.hash = aws_hash_byte_cursor_ptr(&frame_bytes);
+
+    struct aws_hash_element *elem = NULL;
+    aws_hash_table_find(&tracer->stacks, &key, &elem);
+    if (elem) {
+        return elem->value;
+    }
+
+    struct stack_record *stack = aws_mem_calloc(tracer->allocator, 1, sizeof(struct stack_record));
+    if (!stack) {
+        return NULL;
+    }
+    stack->hash = key.hash;
+    stack->depth = depth;
+    memcpy(stack->frames, frames, depth * sizeof(void *));
+    if (aws_hash_table_put(&tracer->stacks, stack, stack, NULL)) {
+        aws_mem_release(tracer->allocator, stack);
+        return NULL;
+    }
+    return stack;
+}
+
+static bool s_should_capture_stack(struct alloc_tracer *tracer) {
+    if (tracer->level < AWS_MEMTRACE_SAMPLED_STACKS) {
+        return false;
+    }
+    return tracer->sample_rate == 1 || aws_atomic_fetch_add(&tracer->sample_counter, 1) % tracer->sample_rate == 0;
+}
+
+/* Attributes an allocation of size bytes to the stack captured in frames, past its first frames_to_skip frames */
+static struct stack_record *s_record_stack(
+    struct alloc_tracer *tracer,
+    void **frames,
+    size_t depth,
+    size_t frames_to_skip,
+    size_t size) {
+    if (depth <= frames_to_skip) {
+        return NULL;
+    }
+
+    aws_mutex_lock(&tracer->mutex);
+    struct stack_record *stack = s_find_stack(tracer, frames + frames_to_skip, depth - frames_to_skip);
+    if (stack) {
+        stack->live_bytes += size;
+        ++stack->live_allocs;
+        ++stack->total_allocs;
+    }
+    aws_mutex_unlock(&tracer->mutex);
+
+    return stack;
+}
+
+static void s_track_release(struct alloc_tracer *tracer, struct alloc_header *header) {
+    aws_atomic_fetch_sub(&tracer->live_bytes, header->size);
+    aws_atomic_fetch_sub(&tracer->live_allocs, 1);
+    aws_atomic_fetch_add(&tracer->total_releases, 1);
+
+    if (header->stack) {
+        aws_mutex_lock(&tracer->mutex);
+        header->stack->live_bytes -= header->size;
+        --header->stack->live_allocs;
+        aws_mutex_unlock(&tracer->mutex);
+    }
+}
+
+/*
+ * Takes a new traced allocation of size bytes. frames and depth are the backtrace captured by the entry point, with
+ * depth 0 if none was, and its first frames_to_skip frames belong to the allocator API and the tracer.
+ */
+static void *s_acquire_traced(
+    struct alloc_tracer *tracer,
+    size_t size,
+    void **frames,
+    size_t depth,
+    size_t frames_to_skip) {
+    struct alloc_header *header = aws_mem_acquire(tracer->allocator, s_header_size + size);
+    if (!header) {
+        return NULL;
+    }
+
+    header->size = size;
+    header->stack = s_record_stack(tracer, frames, depth, frames_to_skip, size);
+
+    size_t live_bytes = aws_atomic_fetch_add(&tracer->live_bytes, size) + size;
+    s_update_peak(tracer, live_bytes);
+    aws_atomic_fetch_add(&tracer->live_allocs, 1);
+    aws_atomic_fetch_add(&tracer->total_allocs, 1);
+
+    return (uint8_t *)header + s_header_size;
+}
+
+static void *s_trace_mem_acquire(struct aws_allocator *allocator, size_t size) {
+    struct alloc_tracer *tracer = allocator->impl;
+    if (tracer->level == AWS_MEMTRACE_NONE) {
+        return aws_mem_acquire(tracer->allocator, size);
+    }
+
+    void *frames[AWS_MEM_TRACE_MAX_FRAMES + ACQUIRE_FRAMES_TO_SKIP];
+    size_t depth = 0;
+    if (s_should_capture_stack(tracer)) {
+        depth = aws_backtrace(frames, tracer->frames_per_stack + ACQUIRE_FRAMES_TO_SKIP);
+    }
+
+    return s_acquire_traced(tracer, size, frames, depth, ACQUIRE_FRAMES_TO_SKIP);
+}
+
+static void s_trace_mem_release(struct aws_allocator *allocator, void *ptr) {
+    struct alloc_tracer *tracer = allocator->impl;
+    if (tracer->level == AWS_MEMTRACE_NONE) {
+        aws_mem_release(tracer->allocator, ptr);
+        return;
+    }
+
+    struct alloc_header *header = (struct alloc_header *)((uint8_t *)ptr - s_header_size);
+    s_track_release(tracer, header);
+    aws_mem_release(tracer->allocator, header);
+}
+
+static void s_trace_mem_release_sized(struct aws_allocator *allocator, void *ptr, size_t size) {
+    struct alloc_tracer *tracer = allocator->impl;
+    if (tracer->level == AWS_MEMTRACE_NONE) {
+        aws_mem_release_sized(tracer->allocator, ptr, size);
+        return;
+    }
+
+    struct alloc_header *header = (struct alloc_header *)((uint8_t *)ptr - s_header_size);
+    s_track_release(tracer, header);
+    aws_mem_release_sized(tracer->allocator, header, s_header_size + size);
+}
+
+static void *s_trace_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size) {
+    struct alloc_tracer *tracer = allocator->impl;
+    if (tracer->level == AWS_MEMTRACE_NONE) {
+        void *ptr = old_ptr;
+        if (aws_mem_realloc(tracer->allocator, &ptr, old_size, new_size)) {
+            return NULL;
+        }
+        return ptr;
+    }
+
+    if (!old_ptr) {
+        void *frames[AWS_MEM_TRACE_MAX_FRAMES + REALLOC_FRAMES_TO_SKIP];
+        size_t depth = 0;
+        if (s_should_capture_stack(tracer)) {
+            depth = aws_backtrace(frames, tracer->frames_per_stack + REALLOC_FRAMES_TO_SKIP);
+        }
+
+        return s_acquire_traced(tracer, new_size, frames, depth, REALLOC_FRAMES_TO_SKIP);
+    }
+
+    void *raw = (uint8_t *)old_ptr - s_header_size;
+    if (aws_mem_realloc(tracer->allocator, &raw, s_header_size + old_size, s_header_size + new_size)) {
+        return NULL;
+    }
+
+    /* the allocation keeps the call stack it was originally acquired from */
+    struct alloc_header *header = raw;
+    const size_t prev_size = header->size;
+    header->size = new_size;
+    if (new_size >= prev_size) {
+        size_t live_bytes = aws_atomic_fetch_add(&tracer->live_bytes, new_size - prev_size) + new_size - prev_size;
+        s_update_peak(tracer, live_bytes);
+    } else {
+        aws_atomic_fetch_sub(&tracer->live_bytes, prev_size - new_size);
+    }
+
+    if (header->stack) {
+        aws_mutex_lock(&tracer->mutex);
+        header->stack->live_bytes = header->stack->live_bytes - prev_size + new_size;
+        aws_mutex_unlock(&tracer->mutex);
+    }
+
+    return (uint8_t *)header + s_header_size;
+}
+
+void aws_mem_tracer_get_stats(struct aws_allocator *trace_allocator, struct aws_mem_trace_stats *stats) {
+    struct alloc_tracer *tracer = trace_allocator->impl;
+    stats->live_bytes = aws_atomic_load_int(&tracer->live_bytes);
+    stats->peak_bytes = aws_atomic_load_int(&tracer->peak_bytes);
+    stats->live_allocs = aws_atomic_load_int(&tracer->live_allocs);
+    stats->total_allocs = aws_atomic_load_int(&tracer->total_allocs);
+    stats->total_releases = aws_atomic_load_int(&tracer->total_releases);
+}
+
+static void s_trace_mem_stats(struct aws_allocator *allocator, struct aws_allocator_stats *stats) {
+    struct alloc_tracer *tracer = allocator->impl;
+    if (tracer->level == AWS_MEMTRACE_NONE) {
+        /* nothing is tracked, everything goes straight through to the wrapped allocator */
+        if (aws_allocator_get_stats(tracer->allocator, stats)) {
+            aws_reset_error();
+        }
+        return;
+    }
+
+    struct aws_mem_trace_stats trace_stats;
+    aws_mem_tracer_get_stats(allocator, &trace_stats);
+    stats->bytes_in_use = trace_stats.live_bytes;
+    stats->bytes_reserved = trace_stats.live_bytes + trace_stats.live_allocs * s_header_size;
+    stats->bytes_in_use_peak = trace_stats.peak_bytes;
+    stats->acquire_count = trace_stats.total_allocs;
+    stats->release_count = trace_stats.total_releases;
+}
+
+struct top_stacks {
+    struct aws_mem_trace_stack_stats *stacks;
+    size_t max_stacks;
+    size_t count;
+};
+
+/* Insertion sort into a fixed size array, largest live_bytes first */
+static int s_collect_top_stack(void *context, struct aws_hash_element *item) {
+    struct top_stacks *top = context;
+    const struct stack_record *stack = item->value;
+
+    size_t idx = top->count;
+    while (idx > 0 && top->stacks[idx - 1].live_bytes < stack->live_bytes) {
+        if (idx < top->max_stacks) {
+            top->stacks[idx] = top->stacks[idx - 1];
+        }
+        --idx;
+    }
+
+    if (idx < top->max_stacks) {
+        struct aws_mem_trace_stack_stats *out = &top->stacks[idx];
+        out->live_bytes = stack->live_bytes;
+        out->live_allocs = stack->live_allocs;
+        out->total_allocs = stack->total_allocs;
+        out->depth = stack->depth;
+        memcpy(out->frames, stack->frames, stack->depth * sizeof(void *));
+        if (top->count < top->max_stacks) {
+            ++top->count;
+        }
+    }
+
+    return AWS_COMMON_HASH_TABLE_ITER_CONTINUE;
+}
+
+size_t aws_mem_tracer_top_stacks(
+    struct aws_allocator *trace_allocator,
+    struct aws_mem_trace_stack_stats *stacks,
+    size_t max_stacks) {
+    struct alloc_tracer *tracer = trace_allocator->impl;
+    if (tracer->level < AWS_MEMTRACE_SAMPLED_STACKS || max_stacks == 0) {
+        return 0;
+    }
+
+    struct top_stacks top = {.stacks = stacks, .max_stacks = max_stacks, .count = 0};
+    aws_mutex_lock(&tracer->mutex);
+    aws_hash_table_foreach(&tracer->stacks, s_collect_top_stack, &top);
+    aws_mutex_unlock(&tracer->mutex);
+
+    return top.count;
+}
+
+#define DUMP_STACK_COUNT 10
+
+void aws_mem_tracer_dump(struct aws_allocator *trace_allocator) {
+    struct alloc_tracer *tracer = trace_allocator->impl;
+
+    struct aws_mem_trace_stats stats;
+    aws_mem_tracer_get_stats(trace_allocator, &stats);
+    AWS_LOGF_TRACE(
+        AWS_LS_COMMON_MEMTRACE,
+        "live: %zu bytes in %zu allocations, peak: %zu bytes, totals: %zu acquired %zu released",
+        stats.live_bytes,
+        stats.live_allocs,
+        stats.peak_bytes,
+        stats.total_allocs,
+        stats.total_releases);
+
+    if (tracer->level < AWS_MEMTRACE_SAMPLED_STACKS) {
+        return;
+    }
+
+    struct aws_mem_trace_stack_stats *stacks =
+        aws_mem_calloc(tracer->allocator, DUMP_STACK_COUNT, sizeof(struct aws_mem_trace_stack_stats));
+    if (!stacks) {
+        return;
+    }
+
+    size_t count = aws_mem_tracer_top_stacks(trace_allocator, stacks, DUMP_STACK_COUNT);
+    for (size_t idx = 0; idx < count; ++idx) {
+        const struct aws_mem_trace_stack_stats *stack = &stacks[idx];
+        AWS_LOGF_TRACE(
+            AWS_LS_COMMON_MEMTRACE,
+            "%zu bytes live in %zu allocations (%zu total) from:",
+            stack->live_bytes,
+            stack->live_allocs,
+            stack->total_allocs);
+
+        char **symbols = aws_backtrace_symbols(stack->frames, stack->depth);
+        for (size_t frame = 0; frame < stack->depth; ++frame) {
+            if (symbols) {
+                AWS_LOGF_TRACE(AWS_LS_COMMON_MEMTRACE, "  %s", symbols[frame]);
+            } else {
+                AWS_LOGF_TRACE(AWS_LS_COMMON_MEMTRACE, "  %p", stack->frames[frame]);
+            }
+        }
+        free(symbols);
+    }
+
+    aws_mem_release(tracer->allocator, stacks);
+}
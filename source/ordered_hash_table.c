@@ -0,0 +1,535 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/ordered_hash_table.h>
+
+#include <aws/common/math.h>
+
+#include <string.h>
+
+struct aws_ordered_hash_entry {
+    struct aws_hash_element element;
+    uint64_t hash_code; /* 0 for a tombstone */
+    uint64_t seq;       /* order of insertion, kept by tombstones, so it increases along the array */
+};
+
+/* Index slot values: otherwise 1 + the position of an entry */
+#define INDEX_EMPTY 0
+#define INDEX_DELETED UINT32_MAX
+
+/* so that 1 + the last position never reaches INDEX_DELETED */
+#define MAX_ENTRIES ((size_t)UINT32_MAX - 1)
+
+#define MIN_ENTRIES 4
+
+/* Ensures a reasonable semantics for null keys, and that no key hashes to 0, which marks a tombstone */
+static uint64_t s_hash_for(const struct aws_ordered_hash_table *table, const void *key) {
+    if (key == NULL) {
+        return 42;
+    }
+    uint64_t hash_code = table->hash_fn(key);
+    return hash_code ? hash_code : 1;
+}
+
+static bool s_keys_eq(const struct aws_ordered_hash_table *table, const void *a, const void *b) {
+    if (a == b) {
+        return true;
+    }
+    if (a == NULL || b == NULL) {
+        return false;
+    }
+    return table->equals_fn(a, b);
+}
+
+/*
+ * The index is kept at most 2/3 full, counting deleted markers. Every index slot in use (including deleted markers)
+ * corresponds to one of the entries_used entries, so sizing it for entries_capacity is enough for every probe to end
+ * at an empty slot.
+ */
+static int s_index_size_for(size_t entries_capacity, size_t *index_size) {
+    size_t min_size = 0;
+    if (aws_add_size_checked(entries_capacity, entries_capacity / 2 + 1, &min_size)) {
+        return AWS_OP_ERR;
+    }
+    return aws_round_up_to_power_of_two(min_size, index_size);
+}
+
+/* Points a free index slot for hash_code at position */
+static void s_index_insert(struct aws_ordered_hash_table *table, uint64_t hash_code, size_t position) {
+    size_t slot = (size_t)hash_code & table->index_mask;
+    while (table->index[slot] != INDEX_EMPTY && table->index[slot] != INDEX_DELETED) {
+        slot = (slot + 1) & table->index_mask;
+    }
+    table->index[slot] = (uint32_t)(position + 1);
+}
+
+/* Fills the (cleared) index from the live entries */
+static void s_index_fill(struct aws_ordered_hash_table *table) {
+    for (size_t position = 0; position < table->entries_used; ++position) {
+        if (table->entries[position].hash_code) {
+            s_index_insert(table, table->entries[position].hash_code, position);
+        }
+    }
+}
+
+/* Replaces the index with a new one of index_size slots. Doesn't touch the entries. */
+static int s_rebuild_index(struct aws_ordered_hash_table *table, size_t index_size) {
+    uint32_t *index = aws_mem_calloc(table->alloc, index_size, sizeof(uint32_t));
+    if (!index) {
+        return AWS_OP_ERR;
+    }
+
+    if (table->index) {
+        aws_mem_release(table->alloc, table->index);
+    }
+    table->index = index;
+    table->index_mask = index_size - 1;
+    s_index_fill(table);
+    return AWS_OP_SUCCESS;
+}
+
+/* Returns the position of key's entry, or SIZE_MAX if it isn't in the table. If found, *p_slot is its index slot. */
+static size_t s_find_position(
+    const struct aws_ordered_hash_table *table,
+    const void *key,
+    uint64_t hash_code,
+    size_t *p_slot) {
+
+    for (size_t slot = (size_t)hash_code & table->index_mask;; slot = (slot + 1) & table->index_mask) {
+        const uint32_t value = table->index[slot];
+        if (value == INDEX_EMPTY) {
+            return SIZE_MAX;
+        }
+        if (value == INDEX_DELETED) {
+            continue;
+        }
+
+        const struct aws_ordered_hash_entry *entry = &table->entries[value - 1];
+        if (entry->hash_code == hash_code && s_keys_eq(table, key, entry->element.key)) {
+            if (p_slot) {
+                *p_slot = slot;
+            }
+            return value - 1;
+        }
+    }
+}
+
+/* Returns the index slot pointing at the live entry at position */
+static size_t s_index_slot_of(const struct aws_ordered_hash_table *table, size_t position) {
+    size_t slot = (size_t)table->entries[position].hash_code & table->index_mask;
+    while (table->index[slot] != position + 1) {
+        slot = (slot + 1) & table->index_mask;
+    }
+    return slot;
+}
+
+/* Turns the live entry at position, whose index slot is slot, into a tombstone. Doesn't run destroy callbacks. */
+static void s_remove_at(struct aws_ordered_hash_table *table, size_t position, size_t slot) {
+    table->index[slot] = INDEX_DELETED;
+    AWS_ZERO_STRUCT(table->entries[position].element);
+    table->entries[position].hash_code = 0;
+    table->entry_count--;
+}
+
+/* Slides the live entries down over the tombstones, keeping their order, and rebuilds the index in place */
+static void s_compact(struct aws_ordered_hash_table *table) {
+    if (table->entries_used == table->entry_count) {
+        return;
+    }
+
+    size_t live = 0;
+    for (size_t position = 0; position < table->entries_used; ++position) {
+        if (table->entries[position].hash_code) {
+            table->entries[live++] = table->entries[position];
+        }
+    }
+    AWS_ASSERT(live == table->entry_count);
+    table->entries_used = live;
+
+    memset(table->index, 0, (table->index_mask + 1) * sizeof(uint32_t));
+    s_index_fill(table);
+    table->compactions++;
+}
+
+/* Doubles the entries array, and the index along with it */
+static int s_grow(struct aws_ordered_hash_table *table) {
+    size_t new_capacity = 0;
+    if (aws_mul_size_checked(table->entries_capacity, 2, &new_capacity)) {
+        return AWS_OP_ERR;
+    }
+    if (new_capacity > MAX_ENTRIES) {
+        new_capacity = MAX_ENTRIES;
+        if (new_capacity == table->entries_capacity) {
+            return aws_raise_error(AWS_ERROR_OVERFLOW_DETECTED);
+        }
+    }
+
+    /* The index goes first: if growing the entries then fails, a larger index than needed is harmless */
+    size_t index_size = 0;
+    if (s_index_size_for(new_capacity, &index_size) || s_rebuild_index(table, index_size)) {
+        return AWS_OP_ERR;
+    }
+
+    void *entries = table->entries;
+    if (aws_mem_realloc(
+            table->alloc,
+            &entries,
+            table->entries_capacity * sizeof(struct aws_ordered_hash_entry),
+            new_capacity * sizeof(struct aws_ordered_hash_entry))) {
+        return AWS_OP_ERR;
+    }
+    table->entries = entries;
+    table->entries_capacity = new_capacity;
+    return AWS_OP_SUCCESS;
+}
+
+int aws_ordered_hash_table_init(
+    struct aws_ordered_hash_table *table,
+    struct aws_allocator *alloc,
+    size_t size,
+    aws_hash_fn *hash_fn,
+    aws_hash_callback_eq_fn *equals_fn,
+    aws_hash_callback_destroy_fn *destroy_key_fn,
+    aws_hash_callback_destroy_fn *destroy_value_fn) {
+    AWS_PRECONDITION(table != NULL);
+    AWS_PRECONDITION(alloc != NULL);
+    AWS_PRECONDITION(hash_fn != NULL);
+    AWS_PRECONDITION(equals_fn != NULL);
+
+    AWS_ZERO_STRUCT(*table);
+    table->alloc = alloc;
+    table->hash_fn = hash_fn;
+    table->equals_fn = equals_fn;
+    table->destroy_key_fn = destroy_key_fn;
+    table->destroy_value_fn = destroy_value_fn;
+
+    if (size > MAX_ENTRIES) {
+        return aws_raise_error(AWS_ERROR_OVERFLOW_DETECTED);
+    }
+    const size_t capacity = size < MIN_ENTRIES ? MIN_ENTRIES : size;
+
+    size_t index_size = 0;
+    if (s_index_size_for(capacity, &index_size) || s_rebuild_index(table, index_size)) {
+        return AWS_OP_ERR;
+    }
+
+    table->entries = aws_mem_calloc(alloc, capacity, sizeof(struct aws_ordered_hash_entry));
+    if (!table->entries) {
+        aws_mem_release(alloc, table->index);
+        table->index = NULL;
+        return AWS_OP_ERR;
+    }
+    table->entries_capacity = capacity;
+    return AWS_OP_SUCCESS;
+}
+
+void aws_ordered_hash_table_clean_up(struct aws_ordered_hash_table *table) {
+    AWS_PRECONDITION(table != NULL);
+
+    if (!table->entries) {
+        return;
+    }
+
+    aws_ordered_hash_table_clear(table);
+    aws_mem_release(table->alloc, table->entries);
+    aws_mem_release(table->alloc, table->index);
+    table->entries = NULL;
+    table->index = NULL;
+    table->entries_capacity = 0;
+    table->index_mask = 0;
+}
+
+size_t aws_ordered_hash_table_get_entry_count(const struct aws_ordered_hash_table *table) {
+    AWS_PRECONDITION(table != NULL);
+    return table->entry_count;
+}
+
+int aws_ordered_hash_table_find(
+    const struct aws_ordered_hash_table *table,
+    const void *key,
+    struct aws_hash_element **p_elem) {
+    AWS_PRECONDITION(table != NULL && table->entries != NULL);
+    AWS_PRECONDITION(p_elem != NULL);
+
+    const size_t position = s_find_position(table, key, s_hash_for(table, key), NULL);
+    *p_elem = position == SIZE_MAX ? NULL : &table->entries[position].element;
+    return AWS_OP_SUCCESS;
+}
+
+int aws_ordered_hash_table_create(
+    struct aws_ordered_hash_table *table,
+    const void *key,
+    struct aws_hash_element **p_elem,
+    int *was_created) {
+    AWS_PRECONDITION(table != NULL && table->entries != NULL);
+
+    int ignored;
+    if (!was_created) {
+        was_created = &ignored;
+    }
+
+    const uint64_t hash_code = s_hash_for(table, key);
+    size_t position = s_find_position(table, key, hash_code, NULL);
+    if (position != SIZE_MAX) {
+        if (p_elem) {
+            *p_elem = &table->entries[position].element;
+        }
+        *was_created = 0;
+        return AWS_OP_SUCCESS;
+    }
+
+    /*
+     * Out of room: reclaim the tombstones if they are at least half the array, so that compacting costs at most two
+     * moves per removal since the last time; grow otherwise. This is the only place elements ever move.
+     */
+    if (table->entries_used == table->entries_capacity) {
+        const size_t tombstones = table->entries_used - table->entry_count;
+        if (tombstones && tombstones >= table->entry_count) {
+            s_compact(table);
+        } else if (s_grow(table)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    position = table->entries_used++;
+    struct aws_ordered_hash_entry *entry = &table->entries[position];
+    entry->element.key = key;
+    entry->element.value = NULL;
+    entry->hash_code = hash_code;
+    entry->seq = table->next_seq++;
+    s_index_insert(table, hash_code, position);
+    table->entry_count++;
+
+    if (p_elem) {
+        *p_elem = &entry->element;
+    }
+    *was_created = 1;
+    return AWS_OP_SUCCESS;
+}
+
+int aws_ordered_hash_table_put(struct aws_ordered_hash_table *table, const void *key, void *value, int *was_created) {
+    struct aws_hash_element *p_elem = NULL;
+    int was_created_fallback;
+    if (!was_created) {
+        was_created = &was_created_fallback;
+    }
+
+    if (aws_ordered_hash_table_create(table, key, &p_elem, was_created)) {
+        return AWS_OP_ERR;
+    }
+
+    if (!*was_created) {
+        if (p_elem->key != key && table->destroy_key_fn) {
+            table->destroy_key_fn((void *)p_elem->key);
+        }
+        if (table->destroy_value_fn) {
+            table->destroy_value_fn(p_elem->value);
+        }
+    }
+
+    p_elem->key = key;
+    p_elem->value = value;
+    return AWS_OP_SUCCESS;
+}
+
+int aws_ordered_hash_table_remove(
+    struct aws_ordered_hash_table *table,
+    const void *key,
+    struct aws_hash_element *p_value,
+    int *was_present) {
+    AWS_PRECONDITION(table != NULL && table->entries != NULL);
+
+    int ignored;
+    if (!was_present) {
+        was_present = &ignored;
+    }
+
+    size_t slot = 0;
+    const size_t position = s_find_position(table, key, s_hash_for(table, key), &slot);
+    if (position == SIZE_MAX) {
+        *was_present = 0;
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_hash_element *elem = &table->entries[position].element;
+    if (p_value) {
+        *p_value = *elem;
+    } else {
+        if (table->destroy_key_fn) {
+            table->destroy_key_fn((void *)elem->key);
+        }
+        if (table->destroy_value_fn) {
+            table->destroy_value_fn(elem->value);
+        }
+    }
+
+    s_remove_at(table, position, slot);
+    *was_present = 1;
+    return AWS_OP_SUCCESS;
+}
+
+int aws_ordered_hash_table_foreach(
+    struct aws_ordered_hash_table *table,
+    int (*callback)(void *context, struct aws_hash_element *p_element),
+    void *context) {
+    AWS_PRECONDITION(table != NULL);
+    AWS_PRECONDITION(callback != NULL);
+
+    /* the iterator finds its place again if an element the callback inserts compacts the table */
+    for (struct aws_ordered_hash_iter iter = aws_ordered_hash_iter_begin(table); !aws_ordered_hash_iter_done(&iter);
+         aws_ordered_hash_iter_next(&iter)) {
+        int rv = callback(context, aws_ordered_hash_iter_get_element(&iter));
+
+        if (rv & AWS_COMMON_HASH_TABLE_ITER_DELETE) {
+            aws_ordered_hash_iter_delete(&iter, false);
+        }
+
+        if (!(rv & AWS_COMMON_HASH_TABLE_ITER_CONTINUE)) {
+            break;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+void aws_ordered_hash_table_clear(struct aws_ordered_hash_table *table) {
+    AWS_PRECONDITION(table != NULL);
+
+    if (!table->entries) {
+        return;
+    }
+
+    if (table->destroy_key_fn || table->destroy_value_fn) {
+        for (size_t position = 0; position < table->entries_used; ++position) {
+            struct aws_ordered_hash_entry *entry = &table->entries[position];
+            if (!entry->hash_code) {
+                continue;
+            }
+            if (table->destroy_key_fn) {
+                table->destroy_key_fn((void *)entry->element.key);
+            }
+            if (table->destroy_value_fn) {
+                table->destroy_value_fn(entry->element.value);
+            }
+        }
+    }
+
+    memset(table->index, 0, (table->index_mask + 1) * sizeof(uint32_t));
+    table->entries_used = 0;
+    table->entry_count = 0;
+    /* iterators have to find their place again, as after compacting */
+    table->compactions++;
+}
+
+/* Returns the position of the first entry inserted at or after seq, or entries_used if there is none */
+static size_t s_position_of_seq(const struct aws_ordered_hash_table *table, uint64_t seq) {
+    size_t low = 0;
+    size_t high = table->entries_used;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        if (table->entries[mid].seq < seq) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * Returns the iterator's position. If the table has been compacted since the iterator last moved, that is where its
+ * entry went or, if it was removed, where the next one went.
+ */
+static size_t s_iter_position(const struct aws_ordered_hash_iter *iter) {
+    if (iter->compactions == iter->table->compactions) {
+        return iter->position;
+    }
+    return s_position_of_seq(iter->table, iter->seq);
+}
+
+/* Whether the iterator's own entry is at position, and live */
+static bool s_iter_is_on_element(const struct aws_ordered_hash_iter *iter, size_t position) {
+    const struct aws_ordered_hash_table *table = iter->table;
+    return position < table->entries_used && table->entries[position].seq == iter->seq &&
+           table->entries[position].hash_code;
+}
+
+/* Puts the iterator on the first live entry at or after position */
+static void s_iter_settle(struct aws_ordered_hash_iter *iter, size_t position) {
+    const struct aws_ordered_hash_table *table = iter->table;
+    while (position < table->entries_used && !table->entries[position].hash_code) {
+        ++position;
+    }
+
+    iter->position = position;
+    /* past the end, the sequence number of the next element inserted, so that the iterator moves on to it */
+    iter->seq = position < table->entries_used ? table->entries[position].seq : table->next_seq;
+    iter->compactions = table->compactions;
+}
+
+struct aws_ordered_hash_iter aws_ordered_hash_iter_begin(struct aws_ordered_hash_table *table) {
+    AWS_PRECONDITION(table != NULL);
+
+    struct aws_ordered_hash_iter iter = {.table = table};
+    s_iter_settle(&iter, 0);
+    return iter;
+}
+
+bool aws_ordered_hash_iter_done(const struct aws_ordered_hash_iter *iter) {
+    AWS_PRECONDITION(iter != NULL);
+    return s_iter_position(iter) >= iter->table->entries_used;
+}
+
+void aws_ordered_hash_iter_next(struct aws_ordered_hash_iter *iter) {
+    AWS_PRECONDITION(iter != NULL);
+
+    size_t position = s_iter_position(iter);
+    if (position >= iter->table->entries_used) {
+        return;
+    }
+    /* after compacting, an iterator whose element was removed is already on the next one */
+    if (iter->table->entries[position].seq == iter->seq) {
+        ++position;
+    }
+    s_iter_settle(iter, position);
+}
+
+struct aws_hash_element *aws_ordered_hash_iter_get_element(const struct aws_ordered_hash_iter *iter) {
+    AWS_PRECONDITION(iter != NULL);
+
+    const size_t position = s_iter_position(iter);
+    if (!s_iter_is_on_element(iter, position)) {
+        return NULL;
+    }
+    return &iter->table->entries[position].element;
+}
+
+void aws_ordered_hash_iter_delete(struct aws_ordered_hash_iter *iter, bool destroy_contents) {
+    AWS_PRECONDITION(aws_ordered_hash_iter_get_element(iter) != NULL);
+
+    struct aws_ordered_hash_table *table = iter->table;
+    const size_t position = s_iter_position(iter);
+    struct aws_hash_element *elem = &table->entries[position].element;
+    if (destroy_contents) {
+        if (table->destroy_key_fn) {
+            table->destroy_key_fn((void *)elem->key);
+        }
+        if (table->destroy_value_fn) {
+            table->destroy_value_fn(elem->value);
+        }
+    }
+
+    s_remove_at(table, position, s_index_slot_of(table, position));
+}
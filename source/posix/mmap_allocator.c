@@ -0,0 +1,264 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#if defined(__linux__)
+/* mremap, MAP_ANONYMOUS, MAP_HUGETLB, MAP_POPULATE and MADV_HUGEPAGE are all Linux extensions */
+#    define _GNU_SOURCE
+#endif
+
+#include <aws/common/common.h>
+#include <aws/common/hash_table.h>
+#include <aws/common/math.h>
+#include <aws/common/mutex.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#    define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* explicit huge pages are assumed to be the common 2MB x86-64/arm64 size, mappings are rounded up to match */
+#define AWS_MMAP_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+/*
+ * Mappings are handed out whole, so that they are exactly a page (or huge page) multiple and the memory starts on a
+ * page boundary. Their lengths are kept to the side, in a table from start address to length allocated from the
+ * parent. Smaller allocations are passed straight through to the parent, and are told apart on release by not being
+ * in the table.
+ */
+struct mmap_allocator {
+    struct aws_allocator *allocator; /* parent, for small allocations and the mappings table */
+    size_t min_mmap_size;
+    size_t page_size;
+    enum aws_mmap_huge_pages huge_pages;
+    bool populate;
+    struct aws_mutex lock;
+    struct aws_hash_table mappings; /* protected by lock */
+};
+
+static void *s_mmap_mem_acquire(struct aws_allocator *allocator, size_t size);
+static void s_mmap_mem_release(struct aws_allocator *allocator, void *ptr);
+static void *s_mmap_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size);
+
+static struct aws_allocator s_mmap_allocator = {
+    .mem_acquire = s_mmap_mem_acquire,
+    .mem_release = s_mmap_mem_release,
+    .mem_realloc = s_mmap_mem_realloc,
+};
+
+struct aws_allocator *aws_mmap_allocator_new(
+    struct aws_allocator *allocator,
+    const struct aws_mmap_allocator_options *options) {
+    AWS_PRECONDITION(aws_allocator_is_valid(allocator));
+
+    struct mmap_allocator *impl = NULL;
+    struct aws_allocator *mmap_allocator = NULL;
+    aws_mem_acquire_many(
+        allocator, 2, &impl, sizeof(struct mmap_allocator), &mmap_allocator, sizeof(struct aws_allocator));
+
+    if (!impl || !mmap_allocator) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*impl);
+    *mmap_allocator = s_mmap_allocator;
+    mmap_allocator->impl = impl;
+
+    impl->allocator = allocator;
+    impl->min_mmap_size = AWS_MMAP_ALLOCATOR_DEFAULT_MIN_SIZE;
+    if (options) {
+        impl->min_mmap_size = options->min_mmap_size ? options->min_mmap_size : impl->min_mmap_size;
+        impl->huge_pages = options->huge_pages;
+        impl->populate = options->populate;
+    }
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    impl->page_size = page_size > 0 ? (size_t)page_size : 4096;
+
+    if (aws_hash_table_init(&impl->mappings, allocator, 16, aws_hash_ptr, aws_ptr_eq, NULL, NULL)) {
+        aws_mem_release(allocator, impl);
+        return NULL;
+    }
+    aws_mutex_init(&impl->lock);
+
+    return mmap_allocator;
+}
+
+void aws_mmap_allocator_destroy(struct aws_allocator *mmap_allocator) {
+    if (!mmap_allocator) {
+        return;
+    }
+    struct mmap_allocator *impl = mmap_allocator->impl;
+    aws_mutex_clean_up(&impl->lock);
+    aws_hash_table_clean_up(&impl->mappings);
+    aws_mem_release(impl->allocator, impl);
+}
+
+/* Rounds size up to a power of 2 alignment, raising AWS_ERROR_OOM if that doesn't fit in a size_t */
+static int s_round_up(size_t size, size_t alignment, size_t *rounded) {
+    if (aws_add_size_checked(size, alignment - 1, rounded)) {
+        return aws_raise_error(AWS_ERROR_OOM);
+    }
+    *rounded &= ~(alignment - 1);
+    return AWS_OP_SUCCESS;
+}
+
+/* Returns the length of the mapping starting at ptr, or 0 if ptr came from the parent. Removes it if remove is set */
+static size_t s_find_mapping(struct mmap_allocator *impl, void *ptr, bool remove) {
+    /* mappings always start on a page, so anything else is from the parent and needn't take the lock */
+    if ((uintptr_t)ptr & (impl->page_size - 1)) {
+        return 0;
+    }
+
+    struct aws_hash_element elem = {.key = NULL, .value = NULL};
+    aws_mutex_lock(&impl->lock);
+    if (remove) {
+        aws_hash_table_remove(&impl->mappings, ptr, &elem, NULL);
+    } else {
+        struct aws_hash_element *found = NULL;
+        aws_hash_table_find(&impl->mappings, ptr, &found);
+        if (found) {
+            elem = *found;
+        }
+    }
+    aws_mutex_unlock(&impl->lock);
+
+    return (size_t)(uintptr_t)elem.value;
+}
+
+/* Maps at least size bytes, or returns NULL */
+static void *s_map(struct mmap_allocator *impl, size_t size) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_POPULATE)
+    if (impl->populate) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+
+    void *mapping = MAP_FAILED;
+    size_t mapping_size = 0;
+
+#if defined(MAP_HUGETLB)
+    if (impl->huge_pages == AWS_MMAP_HUGE_PAGES_EXPLICIT &&
+        !s_round_up(size, AWS_MMAP_HUGE_PAGE_SIZE, &mapping_size)) {
+        mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+    }
+#endif
+
+    if (mapping == MAP_FAILED) {
+        if (s_round_up(size, impl->page_size, &mapping_size)) {
+            return NULL;
+        }
+        mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (mapping == MAP_FAILED) {
+            aws_raise_error(AWS_ERROR_OOM);
+            return NULL;
+        }
+#if defined(MADV_HUGEPAGE)
+        if (impl->huge_pages != AWS_MMAP_HUGE_PAGES_NONE) {
+            /* advisory only, the kernel may not have transparent huge pages enabled */
+            madvise(mapping, mapping_size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    aws_mutex_lock(&impl->lock);
+    int result = aws_hash_table_put(&impl->mappings, mapping, (void *)(uintptr_t)mapping_size, NULL);
+    aws_mutex_unlock(&impl->lock);
+    if (result) {
+        munmap(mapping, mapping_size);
+        return NULL;
+    }
+
+    return mapping;
+}
+
+static void *s_mmap_mem_acquire(struct aws_allocator *allocator, size_t size) {
+    struct mmap_allocator *impl = allocator->impl;
+
+    if (size < impl->min_mmap_size) {
+        return aws_mem_acquire(impl->allocator, size);
+    }
+    return s_map(impl, size);
+}
+
+static void s_mmap_mem_release(struct aws_allocator *allocator, void *ptr) {
+    struct mmap_allocator *impl = allocator->impl;
+
+    size_t mapping_size = s_find_mapping(impl, ptr, true);
+    if (mapping_size) {
+        munmap(ptr, mapping_size);
+    } else {
+        aws_mem_release(impl->allocator, ptr);
+    }
+}
+
+static void *s_mmap_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size) {
+    struct mmap_allocator *impl = allocator->impl;
+
+    if (!old_ptr) {
+        return s_mmap_mem_acquire(allocator, new_size);
+    }
+
+    size_t old_mapping_size = s_find_mapping(impl, old_ptr, false);
+    if (old_mapping_size) {
+        /* the mapping may already be big enough, it was rounded up to a page */
+        if (new_size <= old_mapping_size) {
+            return old_ptr;
+        }
+
+#if defined(__linux__)
+        /*
+         * Grow the mapping; the kernel moves the pages rather than copying their contents. This fails for a mapping
+         * of explicit huge pages, which then falls through to copying.
+         */
+        size_t mapping_size = 0;
+        if (!s_round_up(new_size, impl->page_size, &mapping_size)) {
+            void *mapping = mremap(old_ptr, old_mapping_size, mapping_size, MREMAP_MAYMOVE);
+            if (mapping != MAP_FAILED) {
+#    if defined(MADV_HUGEPAGE)
+                if (impl->huge_pages != AWS_MMAP_HUGE_PAGES_NONE) {
+                    madvise(mapping, mapping_size, MADV_HUGEPAGE);
+                }
+#    endif
+                /* this replaces the entry just removed, so the table never has to grow and the put can't fail */
+                aws_mutex_lock(&impl->lock);
+                aws_hash_table_remove(&impl->mappings, old_ptr, NULL, NULL);
+                int result = aws_hash_table_put(&impl->mappings, mapping, (void *)(uintptr_t)mapping_size, NULL);
+                aws_mutex_unlock(&impl->lock);
+                AWS_FATAL_ASSERT(result == AWS_OP_SUCCESS);
+                return mapping;
+            }
+        }
+#endif
+    } else if (new_size < impl->min_mmap_size) {
+        /* still small, let the parent deal with it */
+        void *ptr = old_ptr;
+        if (aws_mem_realloc(impl->allocator, &ptr, old_size, new_size)) {
+            return NULL;
+        }
+        return ptr;
+    }
+
+    void *new_mem = s_mmap_mem_acquire(allocator, new_size);
+    if (!new_mem) {
+        return NULL;
+    }
+
+    memcpy(new_mem, old_ptr, old_size < new_size ? old_size : new_size);
+    s_mmap_mem_release(allocator, old_ptr);
+    return new_mem;
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#if defined(__linux__)
+/* mremap, MAP_ANONYMOUS and the mbind/getcpu syscalls are Linux extensions */
+#    define _GNU_SOURCE
+#endif
+
+#include <aws/common/common.h>
+#include <aws/common/math.h>
+#include <aws/common/system_info.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#    include <sys/syscall.h>
+#endif
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#    define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* Defined in system_info.c */
+int32_t aws_common_private_numa_node_for_cpu_group(uint16_t group_idx);
+
+/*
+ * Every allocation is its own anonymous mapping. The memory policy is set with mbind() before the pages are first
+ * touched, so they are faulted in on the requested node. libnuma isn't a dependency, the syscall is made directly.
+ */
+#define AWS_MPOL_PREFERRED 1
+
+struct block_header {
+    size_t mapping_size;
+};
+
+/* keep allocations aligned the same as aws_mem_acquire_many() promises */
+static const size_t s_header_size = (sizeof(struct block_header) + sizeof(intmax_t) - 1) & ~(sizeof(intmax_t) - 1);
+
+struct numa_allocator {
+    struct aws_allocator *allocator; /* parent, for the allocator itself */
+    size_t page_size;
+    int32_t node; /* or one of the sentinels below */
+};
+
+/* bind each allocation to the node of the calling thread */
+#define NUMA_NODE_CURRENT (-1)
+/* the group has no NUMA node to bind to */
+#define NUMA_NODE_NONE (-2)
+
+static void *s_numa_mem_acquire(struct aws_allocator *allocator, size_t size);
+static void s_numa_mem_release(struct aws_allocator *allocator, void *ptr);
+static void *s_numa_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size);
+
+static struct aws_allocator s_numa_allocator = {
+    .mem_acquire = s_numa_mem_acquire,
+    .mem_release = s_numa_mem_release,
+    .mem_realloc = s_numa_mem_realloc,
+};
+
+struct aws_allocator *aws_numa_allocator_new(struct aws_allocator *allocator, int32_t cpu_group) {
+    AWS_PRECONDITION(aws_allocator_is_valid(allocator));
+
+    struct numa_allocator *impl = NULL;
+    struct aws_allocator *numa_allocator = NULL;
+    aws_mem_acquire_many(
+        allocator, 2, &impl, sizeof(struct numa_allocator), &numa_allocator, sizeof(struct aws_allocator));
+
+    if (!impl || !numa_allocator) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*impl);
+    *numa_allocator = s_numa_allocator;
+    numa_allocator->impl = impl;
+
+    impl->allocator = allocator;
+    impl->node = NUMA_NODE_CURRENT;
+    if (cpu_group != AWS_NUMA_CPU_GROUP_CURRENT) {
+        if (cpu_group < 0 || cpu_group >= (int32_t)aws_get_cpu_group_count()) {
+            aws_mem_release(allocator, impl);
+            aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+            return NULL;
+        }
+        /* a platform without NUMA information still has group 0, which binds nothing */
+        const int32_t node = aws_common_private_numa_node_for_cpu_group((uint16_t)cpu_group);
+        impl->node = node >= 0 ? node : NUMA_NODE_NONE;
+    }
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    impl->page_size = page_size > 0 ? (size_t)page_size : 4096;
+
+    return numa_allocator;
+}
+
+void aws_numa_allocator_destroy(struct aws_allocator *numa_allocator) {
+    if (!numa_allocator) {
+        return;
+    }
+    struct numa_allocator *impl = numa_allocator->impl;
+    aws_mem_release(impl->allocator, impl);
+}
+
+/* Computes the whole number of pages holding the header and size bytes, raising AWS_ERROR_OOM if it overflows */
+static int s_mapping_size(const struct numa_allocator *impl, size_t size, size_t *mapping_size) {
+    size_t padded_size = 0;
+    if (aws_add_size_checked(s_header_size, size, &padded_size) ||
+        aws_add_size_checked(padded_size, impl->page_size - 1, &padded_size)) {
+        return aws_raise_error(AWS_ERROR_OOM);
+    }
+    *mapping_size = padded_size & ~(impl->page_size - 1);
+    return AWS_OP_SUCCESS;
+}
+
+/* Sets the memory policy of [addr, addr + len) to prefer node. Failure is not fatal, the pages just land elsewhere */
+static void s_bind(struct numa_allocator *impl, void *addr, size_t len) {
+#if defined(__linux__) && defined(SYS_mbind)
+    int32_t node = impl->node;
+    if (node == NUMA_NODE_NONE) {
+        return;
+    }
+    if (node == NUMA_NODE_CURRENT) {
+        unsigned cpu = 0;
+        unsigned current_node = 0;
+        if (syscall(SYS_getcpu, &cpu, &current_node, NULL) != 0) {
+            return;
+        }
+        node = (int32_t)current_node;
+    }
+
+    enum { NODEMASK_BITS = sizeof(unsigned long) * 8 * 16 };
+    if (node >= NODEMASK_BITS) {
+        return;
+    }
+
+    unsigned long nodemask[16];
+    AWS_ZERO_ARRAY(nodemask);
+    nodemask[node / (sizeof(unsigned long) * 8)] = 1UL << (node % (sizeof(unsigned long) * 8));
+    syscall(SYS_mbind, addr, len, AWS_MPOL_PREFERRED, nodemask, (unsigned long)NODEMASK_BITS + 1, 0);
+#else
+    (void)impl;
+    (void)addr;
+    (void)len;
+#endif
+}
+
+static void *s_numa_mem_acquire(struct aws_allocator *allocator, size_t size) {
+    struct numa_allocator *impl = allocator->impl;
+
+    size_t mapping_size = 0;
+    if (s_mapping_size(impl, size, &mapping_size)) {
+        return NULL;
+    }
+    void *mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        aws_raise_error(AWS_ERROR_OOM);
+        return NULL;
+    }
+
+    /* must happen before the header write faults in the first page */
+    s_bind(impl, mapping, mapping_size);
+
+    struct block_header *header = mapping;
+    header->mapping_size = mapping_size;
+    return (uint8_t *)header + s_header_size;
+}
+
+static struct block_header *s_get_header(void *ptr) {
+    return (struct block_header *)((uint8_t *)ptr - s_header_size);
+}
+
+static void s_numa_mem_release(struct aws_allocator *allocator, void *ptr) {
+    (void)allocator;
+    struct block_header *header = s_get_header(ptr);
+    munmap(header, header->mapping_size);
+}
+
+static void *s_numa_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size) {
+    struct numa_allocator *impl = allocator->impl;
+
+    if (!old_ptr) {
+        return s_numa_mem_acquire(allocator, new_size);
+    }
+
+    struct block_header *header = s_get_header(old_ptr);
+    if (new_size <= header->mapping_size - s_header_size) {
+        return old_ptr;
+    }
+
+#if defined(__linux__)
+    /* the memory policy of a mapping moves with it, only the new tail needs binding */
+    size_t mapping_size = 0;
+    if (s_mapping_size(impl, new_size, &mapping_size)) {
+        return NULL;
+    }
+    const size_t old_mapping_size = header->mapping_size;
+    void *mapping = mremap(header, old_mapping_size, mapping_size, MREMAP_MAYMOVE);
+    if (mapping != MAP_FAILED) {
+        s_bind(impl, (uint8_t *)mapping + old_mapping_size, mapping_size - old_mapping_size);
+        header = mapping;
+        header->mapping_size = mapping_size;
+        return (uint8_t *)header + s_header_size;
+    }
+#else
+    (void)impl;
+#endif
+
+    void *new_mem = s_numa_mem_acquire(allocator, new_size);
+    if (!new_mem) {
+        return NULL;
+    }
+
+    memcpy(new_mem, old_ptr, old_size < new_size ? old_size : new_size);
+    s_numa_mem_release(allocator, old_ptr);
+    return new_mem;
+}
@@ -13,6 +13,11 @@
  * permissions and limitations under the License.
  */
 
+#if defined(__linux__)
+/* needed for the getcpu syscall */
+#    define _GNU_SOURCE
+#endif
+
 #include <aws/common/system_info.h>
 
 #if defined(__FreeBSD__) || defined(__NetBSD__)
@@ -45,6 +50,213 @@ size_t aws_system_info_processor_count(void) {
 #include <ctype.h>
 #include <fcntl.h>
 
+#if defined(__linux__)
+#    include <sys/syscall.h>
+
+#    define AWS_SYSFS_NODE_PATH "/sys/devices/system/node"
+
+/* Reads a small sysfs file into buf as a NUL terminated string */
+static int s_read_sysfs_file(const char *path, char *buf, size_t buf_len) {
+    const int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return AWS_OP_ERR;
+    }
+    const ssize_t num_read = read(fd, buf, buf_len - 1);
+    close(fd);
+    if (num_read <= 0) {
+        return AWS_OP_ERR;
+    }
+    buf[num_read] = '\0';
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Parses a sysfs id list such as "0-3,8-11\n". Calls on_id for each id in ascending order, stopping early if
+ * it returns false. Returns the number of ids visited.
+ */
+static size_t s_parse_id_list(const char *list, bool (*on_id)(int32_t id, void *user_data), void *user_data) {
+    size_t count = 0;
+    const char *cur = list;
+    while (*cur && isdigit(*cur)) {
+        char *end = NULL;
+        long first = strtol(cur, &end, 10);
+        long last = first;
+        if (*end == '-') {
+            last = strtol(end + 1, &end, 10);
+        }
+        for (long id = first; id <= last; ++id) {
+            ++count;
+            if (on_id && !on_id((int32_t)id, user_data)) {
+                return count;
+            }
+        }
+        cur = (*end == ',') ? end + 1 : end;
+    }
+    return count;
+}
+
+struct nth_id {
+    size_t n;
+    int32_t id;
+};
+
+static bool s_find_nth_id(int32_t id, void *user_data) {
+    struct nth_id *nth = user_data;
+    if (nth->n == 0) {
+        nth->id = id;
+        return false;
+    }
+    --nth->n;
+    return true;
+}
+
+/* Maps a cpu group index to the id of the NUMA node it represents, or -1 if there is no NUMA information */
+int32_t aws_common_private_numa_node_for_cpu_group(uint16_t group_idx) {
+    char buf[256];
+    if (s_read_sysfs_file(AWS_SYSFS_NODE_PATH "/online", buf, sizeof(buf))) {
+        return -1;
+    }
+    struct nth_id nth = {.n = group_idx, .id = -1};
+    s_parse_id_list(buf, s_find_nth_id, &nth);
+    return nth.id;
+}
+
+/* Reads the cpu list of the node backing group_idx into buf */
+static int s_read_group_cpu_list(uint16_t group_idx, char *buf, size_t buf_len) {
+    int32_t node = aws_common_private_numa_node_for_cpu_group(group_idx);
+    if (node < 0) {
+        return AWS_OP_ERR;
+    }
+    char path[128];
+    snprintf(path, sizeof(path), AWS_SYSFS_NODE_PATH "/node%d/cpulist", (int)node);
+    return s_read_sysfs_file(path, buf, buf_len);
+}
+
+static bool s_is_suspected_hyper_thread(int32_t cpu_id) {
+    char path[128];
+    char buf[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", (int)cpu_id);
+    if (s_read_sysfs_file(path, buf, sizeof(buf))) {
+        return false;
+    }
+    /* the first sibling is considered the "real" core */
+    struct nth_id first = {.n = 0, .id = cpu_id};
+    s_parse_id_list(buf, s_find_nth_id, &first);
+    return first.id != cpu_id;
+}
+
+uint16_t aws_get_cpu_group_count(void) {
+    char buf[256];
+    if (s_read_sysfs_file(AWS_SYSFS_NODE_PATH "/online", buf, sizeof(buf))) {
+        return 1;
+    }
+    size_t count = s_parse_id_list(buf, NULL, NULL);
+    return count ? (uint16_t)count : 1;
+}
+
+size_t aws_get_cpu_count_for_group(uint16_t group_idx) {
+    char buf[1024];
+    if (s_read_group_cpu_list(group_idx, buf, sizeof(buf))) {
+        return group_idx == 0 ? aws_system_info_processor_count() : 0;
+    }
+    return s_parse_id_list(buf, NULL, NULL);
+}
+
+struct cpu_info_array {
+    struct aws_cpu_info *cpus;
+    size_t length;
+    size_t count;
+};
+
+static bool s_fill_cpu_info(int32_t id, void *user_data) {
+    struct cpu_info_array *array = user_data;
+    if (array->count == array->length) {
+        return false;
+    }
+    array->cpus[array->count].cpu_id = id;
+    array->cpus[array->count].suspected_hyper_thread = s_is_suspected_hyper_thread(id);
+    ++array->count;
+    return true;
+}
+
+void aws_get_cpu_ids_for_group(uint16_t group_idx, struct aws_cpu_info *cpu_ids_array, size_t cpu_ids_array_length) {
+    AWS_PRECONDITION(cpu_ids_array || cpu_ids_array_length == 0);
+
+    for (size_t idx = 0; idx < cpu_ids_array_length; ++idx) {
+        cpu_ids_array[idx].cpu_id = -1;
+        cpu_ids_array[idx].suspected_hyper_thread = false;
+    }
+
+    struct cpu_info_array array = {.cpus = cpu_ids_array, .length = cpu_ids_array_length, .count = 0};
+    char buf[1024];
+    if (s_read_group_cpu_list(group_idx, buf, sizeof(buf))) {
+        if (group_idx == 0) {
+            /* no NUMA information, everything is in one group */
+            const size_t processor_count = aws_system_info_processor_count();
+            for (size_t cpu = 0; cpu < processor_count; ++cpu) {
+                if (!s_fill_cpu_info((int32_t)cpu, &array)) {
+                    break;
+                }
+            }
+        }
+        return;
+    }
+    s_parse_id_list(buf, s_fill_cpu_info, &array);
+}
+
+uint16_t aws_get_current_cpu_group(void) {
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+        return 0;
+    }
+
+    /* translate the node id back into a group index */
+    char buf[256];
+    if (s_read_sysfs_file(AWS_SYSFS_NODE_PATH "/online", buf, sizeof(buf))) {
+        return 0;
+    }
+    const size_t group_count = s_parse_id_list(buf, NULL, NULL);
+    for (uint16_t group = 0; group < group_count; ++group) {
+        struct nth_id nth = {.n = group, .id = -1};
+        s_parse_id_list(buf, s_find_nth_id, &nth);
+        if (nth.id == (int32_t)node) {
+            return group;
+        }
+    }
+    return 0;
+}
+
+#else
+/* No NUMA information on this platform: a single group with every processor */
+int32_t aws_common_private_numa_node_for_cpu_group(uint16_t group_idx) {
+    (void)group_idx;
+    return -1;
+}
+
+uint16_t aws_get_cpu_group_count(void) {
+    return 1;
+}
+
+size_t aws_get_cpu_count_for_group(uint16_t group_idx) {
+    return group_idx == 0 ? aws_system_info_processor_count() : 0;
+}
+
+void aws_get_cpu_ids_for_group(uint16_t group_idx, struct aws_cpu_info *cpu_ids_array, size_t cpu_ids_array_length) {
+    AWS_PRECONDITION(cpu_ids_array || cpu_ids_array_length == 0);
+
+    const size_t cpu_count = aws_get_cpu_count_for_group(group_idx);
+    for (size_t idx = 0; idx < cpu_ids_array_length; ++idx) {
+        cpu_ids_array[idx].cpu_id = idx < cpu_count ? (int32_t)idx : -1;
+        cpu_ids_array[idx].suspected_hyper_thread = false;
+    }
+}
+
+uint16_t aws_get_current_cpu_group(void) {
+    return 0;
+}
+#endif /* __linux__ */
+
 bool aws_is_debugger_present(void) {
     /* Open the status file */
     const int status_fd = open("/proc/self/status", O_RDONLY);
@@ -236,6 +448,28 @@ void s_resolve_cmd(char *cmd, size_t len, struct aws_stack_frame_info *frame) {
 }
 #    endif
 
+size_t aws_backtrace(void **stack_frames, size_t num_frames) {
+    if (num_frames == 0) {
+        return 0;
+    }
+
+    /* capture one extra frame, so this function can be skipped */
+    void *frames[AWS_BACKTRACE_DEPTH + 1];
+    if (num_frames > AWS_BACKTRACE_DEPTH) {
+        num_frames = AWS_BACKTRACE_DEPTH;
+    }
+    int stack_depth = backtrace(frames, (int)num_frames + 1);
+    if (stack_depth <= 1) {
+        return 0;
+    }
+    memcpy(stack_frames, frames + 1, (size_t)(stack_depth - 1) * sizeof(void *));
+    return (size_t)(stack_depth - 1);
+}
+
+char **aws_backtrace_symbols(void *const *stack_frames, size_t stack_depth) {
+    return backtrace_symbols(stack_frames, (int)stack_depth);
+}
+
 void aws_backtrace_print(FILE *fp, void *call_site_data) {
     siginfo_t *siginfo = call_site_data;
     if (siginfo) {
@@ -288,6 +522,18 @@ void aws_backtrace_print(FILE *fp, void *call_site_data) {
 }
 
 #else
+size_t aws_backtrace(void **stack_frames, size_t num_frames) {
+    (void)stack_frames;
+    (void)num_frames;
+    return 0;
+}
+
+char **aws_backtrace_symbols(void *const *stack_frames, size_t stack_depth) {
+    (void)stack_frames;
+    (void)stack_depth;
+    return NULL;
+}
+
 void aws_backtrace_print(FILE *fp, void *call_site_data) {
     fprintf(fp, "No call stack information available\n");
 }
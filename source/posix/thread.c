@@ -13,12 +13,19 @@
  * permissions and limitations under the License.
  */
 
+#if defined(__linux__)
+/* needed for pthread_setaffinity_np */
+#    define _GNU_SOURCE
+#endif
+
 #include <aws/common/thread.h>
 
 #include <aws/common/clock.h>
+#include <aws/common/system_info.h>
 
 #include <errno.h>
 #include <limits.h>
+#include <sched.h>
 #include <time.h>
 
 static struct aws_thread_options s_default_options = {
@@ -238,3 +245,32 @@ int aws_thread_current_at_exit(aws_thread_atexit_fn *callback, void *user_data)
     tl_wrapper->atexit = cb;
     return AWS_OP_SUCCESS;
 }
+
+#if defined(__linux__)
+int aws_thread_current_bind_to_cpu_group(uint16_t cpu_group) {
+    const size_t cpu_count = aws_get_cpu_count_for_group(cpu_group);
+    if (cpu_count == 0) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    struct aws_cpu_info cpus[CPU_SETSIZE];
+    aws_get_cpu_ids_for_group(cpu_group, cpus, AWS_ARRAY_SIZE(cpus));
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (size_t idx = 0; idx < AWS_ARRAY_SIZE(cpus) && cpus[idx].cpu_id >= 0; ++idx) {
+        CPU_SET(cpus[idx].cpu_id, &cpu_set);
+    }
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (err) {
+        return aws_raise_error(err == EINVAL ? AWS_ERROR_INVALID_ARGUMENT : AWS_ERROR_SYS_CALL_FAILURE);
+    }
+    return AWS_OP_SUCCESS;
+}
+#else
+int aws_thread_current_bind_to_cpu_group(uint16_t cpu_group) {
+    (void)cpu_group;
+    return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+}
+#endif
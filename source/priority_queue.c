@@ -17,9 +17,21 @@
 
 #include <string.h>
 
-#define PARENT_OF(index) (((index)&1) ? (index) >> 1 : (index) > 1 ? ((index)-2) >> 1 : 0)
-#define LEFT_OF(index) (((index) << 1) + 1)
-#define RIGHT_OF(index) (((index) << 1) + 2)
+#define PARENT_OF(queue, index) (((index)-1) >> (queue)->arity_shift)
+#define FIRST_CHILD_OF(queue, index) (((index) << (queue)->arity_shift) + 1)
+
+/* The container element at index. In keyed mode, it starts with the item's priority. */
+static void *s_element_at(const struct aws_priority_queue *queue, size_t index) {
+    return (uint8_t *)queue->container.data + index * queue->container.item_size;
+}
+
+/* Whether the element b has a higher priority than the element a, and so belongs nearer the top of the heap */
+static bool s_is_higher(const struct aws_priority_queue *queue, const void *a, const void *b) {
+    if (queue->key_size) {
+        return *(const uint64_t *)b < *(const uint64_t *)a;
+    }
+    return queue->pred(a, b) > 0;
+}
 
 static void s_swap(struct aws_priority_queue *queue, size_t a, size_t b) {
     AWS_PRECONDITION(aws_priority_queue_is_valid(queue));
@@ -64,28 +76,20 @@ static bool s_sift_down(struct aws_priority_queue *queue, size_t root) {
     bool did_move = false;
 
     size_t len = aws_array_list_length(&queue->container);
+    const size_t arity = (size_t)1 << queue->arity_shift;
 
-    while (LEFT_OF(root) < len) {
-        size_t left = LEFT_OF(root);
-        size_t right = RIGHT_OF(root);
+    while (FIRST_CHILD_OF(queue, root) < len) {
+        size_t child = FIRST_CHILD_OF(queue, root);
+        size_t end = len - child > arity ? child + arity : len;
         size_t first = root;
-        void *first_item = NULL, *other_item = NULL;
-
-        aws_array_list_get_at_ptr(&queue->container, &first_item, root);
-        aws_array_list_get_at_ptr(&queue->container, &other_item, left);
-
-        if (queue->pred(first_item, other_item) > 0) {
-            first = left;
-            first_item = other_item;
-        }
-
-        if (right < len) {
-            aws_array_list_get_at_ptr(&queue->container, &other_item, right);
-
-            /* choose the larger/smaller of the two in case of a max/min heap
-             * respectively */
-            if (queue->pred(first_item, other_item) > 0) {
-                first = right;
+        void *first_item = s_element_at(queue, root);
+
+        /* choose the largest/smallest of the children in case of a max/min heap
+         * respectively. They are adjacent, so usually on one or two cache lines. */
+        for (; child < end; ++child) {
+            void *other_item = s_element_at(queue, child);
+            if (s_is_higher(queue, first_item, other_item)) {
+                first = child;
                 first_item = other_item;
             }
         }
@@ -110,24 +114,15 @@ static bool s_sift_up(struct aws_priority_queue *queue, size_t index) {
 
     bool did_move = false;
 
-    void *parent_item, *child_item;
-    size_t parent = PARENT_OF(index);
     while (index) {
-        /*
-         * These get_ats are guaranteed to be successful; if they are not, we have
-         * serious state corruption, so just abort.
-         */
-
-        if (aws_array_list_get_at_ptr(&queue->container, &parent_item, parent) ||
-            aws_array_list_get_at_ptr(&queue->container, &child_item, index)) {
-            abort();
-        }
+        size_t parent = PARENT_OF(queue, index);
+        void *parent_item = s_element_at(queue, parent);
+        void *child_item = s_element_at(queue, index);
 
-        if (queue->pred(parent_item, child_item) > 0) {
+        if (s_is_higher(queue, parent_item, child_item)) {
             s_swap(queue, index, parent);
             did_move = true;
             index = parent;
-            parent = PARENT_OF(index);
         } else {
             break;
         }
@@ -165,6 +160,9 @@ int aws_priority_queue_init_dynamic(
 
     queue->pred = pred;
     AWS_ZERO_STRUCT(queue->backpointers);
+    queue->arity_shift = 1;
+    queue->key_size = 0;
+    queue->item_size = item_size;
 
     int ret = aws_array_list_init_dynamic(&queue->container, alloc, default_size, item_size);
     if (ret == AWS_OP_SUCCESS) {
@@ -190,12 +188,71 @@ void aws_priority_queue_init_static(
 
     queue->pred = pred;
     AWS_ZERO_STRUCT(queue->backpointers);
+    queue->arity_shift = 1;
+    queue->key_size = 0;
+    queue->item_size = item_size;
 
     aws_array_list_init_static(&queue->container, heap, item_count, item_size);
 
     AWS_POSTCONDITION(aws_priority_queue_is_valid(queue));
 }
 
+int aws_priority_queue_init_dynamic_with_options(
+    struct aws_priority_queue *queue,
+    struct aws_allocator *alloc,
+    const struct aws_priority_queue_options *options) {
+
+    AWS_FATAL_PRECONDITION(queue != NULL);
+    AWS_FATAL_PRECONDITION(alloc != NULL);
+    AWS_FATAL_PRECONDITION(options != NULL);
+    AWS_FATAL_PRECONDITION(options->item_size > 0);
+
+    size_t arity_shift = 0;
+    switch (options->arity) {
+        case 0:
+        case 2:
+            arity_shift = 1;
+            break;
+        case 4:
+            arity_shift = 2;
+            break;
+        case 8:
+            arity_shift = 3;
+            break;
+        default:
+            return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    if (!options->keyed && !options->pred) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    /* in keyed mode, items are padded so that every priority is aligned */
+    size_t key_size = options->keyed ? sizeof(uint64_t) : 0;
+    size_t element_size = options->item_size;
+    if (options->keyed) {
+        if (aws_add_size_checked(options->item_size, key_size + sizeof(uint64_t) - 1, &element_size)) {
+            return AWS_OP_ERR;
+        }
+        element_size &= ~(sizeof(uint64_t) - 1);
+    }
+
+    queue->pred = options->pred;
+    AWS_ZERO_STRUCT(queue->backpointers);
+    queue->arity_shift = arity_shift;
+    queue->key_size = key_size;
+    queue->item_size = options->item_size;
+
+    int ret = aws_array_list_init_dynamic(&queue->container, alloc, options->initial_size, element_size);
+    if (ret == AWS_OP_SUCCESS) {
+        AWS_POSTCONDITION(aws_priority_queue_is_valid(queue));
+    } else {
+        AWS_POSTCONDITION(AWS_IS_ZEROED(queue->container));
+        AWS_POSTCONDITION(AWS_IS_ZEROED(queue->backpointers));
+    }
+    return ret;
+}
+
 bool aws_priority_queue_backpointer_index_valid(const struct aws_priority_queue *const queue, size_t index) {
     if (AWS_IS_ZEROED(queue->backpointers)) {
         return true;
@@ -258,11 +315,13 @@ bool aws_priority_queue_is_valid(const struct aws_priority_queue *const queue) {
     if (!queue) {
         return false;
     }
-    bool pred_is_valid = (queue->pred != NULL);
+    bool pred_is_valid = (queue->pred != NULL || queue->key_size != 0);
     bool container_is_valid = aws_array_list_is_valid(&queue->container);
+    bool layout_is_valid = queue->arity_shift >= 1 && queue->arity_shift <= 3 && queue->item_size > 0 &&
+                           queue->key_size + queue->item_size <= queue->container.item_size;
 
     bool backpointers_valid = aws_priority_queue_backpointers_valid(queue);
-    return pred_is_valid && container_is_valid && backpointers_valid;
+    return pred_is_valid && container_is_valid && layout_is_valid && backpointers_valid;
 }
 
 void aws_priority_queue_clean_up(struct aws_priority_queue *queue) {
@@ -274,25 +333,39 @@ void aws_priority_queue_clean_up(struct aws_priority_queue *queue) {
 
 int aws_priority_queue_push(struct aws_priority_queue *queue, void *item) {
     AWS_PRECONDITION(aws_priority_queue_is_valid(queue));
-    AWS_PRECONDITION(item && AWS_MEM_IS_READABLE(item, queue->container.item_size));
+    AWS_PRECONDITION(item && AWS_MEM_IS_READABLE(item, queue->item_size));
     int rval = aws_priority_queue_push_ref(queue, item, NULL);
     AWS_POSTCONDITION(aws_priority_queue_is_valid(queue));
     return rval;
 }
 
-int aws_priority_queue_push_ref(
+/* Adds the element to the end of the container, sets up its backpointer, and sifts it up to its place */
+static int s_push_element(
     struct aws_priority_queue *queue,
+    uint64_t priority,
     void *item,
     struct aws_priority_queue_node *backpointer) {
     AWS_PRECONDITION(aws_priority_queue_is_valid(queue));
-    AWS_PRECONDITION(item && AWS_MEM_IS_READABLE(item, queue->container.item_size));
-
-    int err = aws_array_list_push_back(&queue->container, item);
-    if (err) {
-        AWS_POSTCONDITION(aws_priority_queue_is_valid(queue));
-        return err;
+    AWS_PRECONDITION(item && AWS_MEM_IS_READABLE(item, queue->item_size));
+
+    size_t index = aws_array_list_length(&queue->container);
+    if (queue->key_size) {
+        /* the item is only part of the element, so write the element in place */
+        if (aws_array_list_ensure_capacity(&queue->container, index)) {
+            AWS_POSTCONDITION(aws_priority_queue_is_valid(queue));
+            return AWS_OP_ERR;
+        }
+        uint8_t *element = s_element_at(queue, index);
+        memcpy(element, &priority, sizeof(priority));
+        memcpy(element + queue->key_size, item, queue->item_size);
+        queue->container.length = index + 1;
+    } else {
+        int err = aws_array_list_push_back(&queue->container, item);
+        if (err) {
+            AWS_POSTCONDITION(aws_priority_queue_is_valid(queue));
+            return err;
+        }
     }
-    size_t index = aws_array_list_length(&queue->container) - 1;
 
     if (backpointer && !queue->backpointers.alloc) {
         if (!queue->container.alloc) {
@@ -336,14 +409,42 @@ backpointer_update_failed:
     return AWS_OP_ERR;
 }
 
+int aws_priority_queue_push_ref(
+    struct aws_priority_queue *queue,
+    void *item,
+    struct aws_priority_queue_node *backpointer) {
+    AWS_PRECONDITION(aws_priority_queue_is_valid(queue));
+    AWS_PRECONDITION(item && AWS_MEM_IS_READABLE(item, queue->item_size));
+
+    if (queue->key_size) {
+        return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+    }
+    return s_push_element(queue, 0, item, backpointer);
+}
+
+int aws_priority_queue_push_keyed(
+    struct aws_priority_queue *queue,
+    uint64_t priority,
+    void *item,
+    struct aws_priority_queue_node *backpointer) {
+    AWS_PRECONDITION(aws_priority_queue_is_valid(queue));
+    AWS_PRECONDITION(item && AWS_MEM_IS_READABLE(item, queue->item_size));
+
+    if (!queue->key_size) {
+        return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+    }
+    return s_push_element(queue, priority, item, backpointer);
+}
+
 static int s_remove_node(struct aws_priority_queue *queue, void *item, size_t item_index) {
     AWS_PRECONDITION(aws_priority_queue_is_valid(queue));
-    AWS_PRECONDITION(item && AWS_MEM_IS_WRITABLE(item, queue->container.item_size));
-    if (aws_array_list_get_at(&queue->container, item, item_index)) {
-        /* shouldn't happen, but if it does we've already raised an error... */
+    AWS_PRECONDITION(item && AWS_MEM_IS_WRITABLE(item, queue->item_size));
+    if (item_index >= aws_array_list_length(&queue->container)) {
+        /* shouldn't happen, but if it does raise an error as aws_array_list_get_at() would */
         AWS_POSTCONDITION(aws_priority_queue_is_valid(queue));
-        return AWS_OP_ERR;
+        return aws_raise_error(AWS_ERROR_INVALID_INDEX);
     }
+    memcpy(item, (uint8_t *)s_element_at(queue, item_index) + queue->key_size, queue->item_size);
 
     size_t swap_with = aws_array_list_length(&queue->container) - 1;
     struct aws_priority_queue_node *backpointer = NULL;
@@ -375,7 +476,7 @@ int aws_priority_queue_remove(
     void *item,
     const struct aws_priority_queue_node *node) {
     AWS_PRECONDITION(aws_priority_queue_is_valid(queue));
-    AWS_PRECONDITION(item && AWS_MEM_IS_WRITABLE(item, queue->container.item_size));
+    AWS_PRECONDITION(item && AWS_MEM_IS_WRITABLE(item, queue->item_size));
     AWS_PRECONDITION(node && AWS_MEM_IS_READABLE(node, sizeof(struct aws_priority_queue_node)));
     AWS_ERROR_PRECONDITION(
         node->current_index < aws_array_list_length(&queue->container), AWS_ERROR_PRIORITY_QUEUE_BAD_NODE);
@@ -386,9 +487,39 @@ int aws_priority_queue_remove(
     return rval;
 }
 
+int aws_priority_queue_update(struct aws_priority_queue *queue, const struct aws_priority_queue_node *node) {
+    AWS_PRECONDITION(aws_priority_queue_is_valid(queue));
+    AWS_PRECONDITION(node && AWS_MEM_IS_READABLE(node, sizeof(struct aws_priority_queue_node)));
+    AWS_ERROR_PRECONDITION(queue->key_size == 0, AWS_ERROR_UNSUPPORTED_OPERATION);
+    AWS_ERROR_PRECONDITION(
+        node->current_index < aws_array_list_length(&queue->container), AWS_ERROR_PRIORITY_QUEUE_BAD_NODE);
+    AWS_ERROR_PRECONDITION(queue->backpointers.data, AWS_ERROR_PRIORITY_QUEUE_BAD_NODE);
+
+    s_sift_either(queue, node->current_index);
+    AWS_POSTCONDITION(aws_priority_queue_is_valid(queue));
+    return AWS_OP_SUCCESS;
+}
+
+int aws_priority_queue_update_keyed(
+    struct aws_priority_queue *queue,
+    uint64_t priority,
+    const struct aws_priority_queue_node *node) {
+    AWS_PRECONDITION(aws_priority_queue_is_valid(queue));
+    AWS_PRECONDITION(node && AWS_MEM_IS_READABLE(node, sizeof(struct aws_priority_queue_node)));
+    AWS_ERROR_PRECONDITION(queue->key_size != 0, AWS_ERROR_UNSUPPORTED_OPERATION);
+    AWS_ERROR_PRECONDITION(
+        node->current_index < aws_array_list_length(&queue->container), AWS_ERROR_PRIORITY_QUEUE_BAD_NODE);
+    AWS_ERROR_PRECONDITION(queue->backpointers.data, AWS_ERROR_PRIORITY_QUEUE_BAD_NODE);
+
+    memcpy(s_element_at(queue, node->current_index), &priority, sizeof(priority));
+    s_sift_either(queue, node->current_index);
+    AWS_POSTCONDITION(aws_priority_queue_is_valid(queue));
+    return AWS_OP_SUCCESS;
+}
+
 int aws_priority_queue_pop(struct aws_priority_queue *queue, void *item) {
     AWS_PRECONDITION(aws_priority_queue_is_valid(queue));
-    AWS_PRECONDITION(item && AWS_MEM_IS_WRITABLE(item, queue->container.item_size));
+    AWS_PRECONDITION(item && AWS_MEM_IS_WRITABLE(item, queue->item_size));
     AWS_ERROR_PRECONDITION(aws_array_list_length(&queue->container) != 0, AWS_ERROR_PRIORITY_QUEUE_EMPTY);
 
     int rval = s_remove_node(queue, item, 0);
@@ -398,7 +529,15 @@ int aws_priority_queue_pop(struct aws_priority_queue *queue, void *item) {
 
 int aws_priority_queue_top(const struct aws_priority_queue *queue, void **item) {
     AWS_ERROR_PRECONDITION(aws_array_list_length(&queue->container) != 0, AWS_ERROR_PRIORITY_QUEUE_EMPTY);
-    return aws_array_list_get_at_ptr(&queue->container, item, 0);
+    *item = (uint8_t *)s_element_at(queue, 0) + queue->key_size;
+    return AWS_OP_SUCCESS;
+}
+
+int aws_priority_queue_top_priority(const struct aws_priority_queue *queue, uint64_t *priority) {
+    AWS_ERROR_PRECONDITION(queue->key_size != 0, AWS_ERROR_UNSUPPORTED_OPERATION);
+    AWS_ERROR_PRECONDITION(aws_array_list_length(&queue->container) != 0, AWS_ERROR_PRIORITY_QUEUE_EMPTY);
+    *priority = *(const uint64_t *)s_element_at(queue, 0);
+    return AWS_OP_SUCCESS;
 }
 
 size_t aws_priority_queue_size(const struct aws_priority_queue *queue) {
@@ -0,0 +1,288 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/sharded_lru_cache.h>
+
+#include <aws/common/math.h>
+#include <aws/common/mutex.h>
+#include <aws/common/system_info.h>
+
+/* hits and misses are only touched with the lock held */
+struct aws_sharded_lru_cache_shard {
+    struct aws_mutex lock;
+    struct aws_lru_cache cache;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/* shards are a whole number of cache lines apart, so that a thread locking one doesn't slow down users of the next */
+static const size_t s_shard_stride =
+    (sizeof(struct aws_sharded_lru_cache_shard) + AWS_CACHE_LINE - 1) & ~(size_t)(AWS_CACHE_LINE - 1);
+
+static struct aws_sharded_lru_cache_shard *s_shard_at(const struct aws_sharded_lru_cache *cache, size_t idx) {
+    return (struct aws_sharded_lru_cache_shard *)((uint8_t *)cache->shards + idx * s_shard_stride);
+}
+
+static struct aws_sharded_lru_cache_shard *s_shard_for(const struct aws_sharded_lru_cache *cache, const void *key) {
+    if (cache->shard_count == 1) {
+        return s_shard_at(cache, 0);
+    }
+
+    /* same convention as aws_hash_table for NULL keys */
+    uint64_t hash_code = key ? cache->hash_fn(key) : 42;
+    /* the shard tables index by the low bits, so pick the shard from the high bits of a multiplicative mix */
+    hash_code *= 0x9E3779B97F4A7C15ULL;
+    return s_shard_at(cache, (size_t)(hash_code >> cache->shard_shift));
+}
+
+int aws_sharded_lru_cache_init(
+    struct aws_sharded_lru_cache *cache,
+    struct aws_allocator *allocator,
+    const struct aws_sharded_lru_cache_options *options) {
+    AWS_PRECONDITION(cache != NULL);
+    AWS_PRECONDITION(allocator != NULL);
+    AWS_PRECONDITION(options != NULL);
+    AWS_PRECONDITION(options->hash_fn != NULL);
+    AWS_PRECONDITION(options->max_items > 0 || options->max_cost > 0);
+
+    AWS_ZERO_STRUCT(*cache);
+
+    size_t shard_count = options->shard_count;
+    if (shard_count == 0) {
+        shard_count = aws_system_info_processor_count();
+    }
+    if (aws_round_up_to_power_of_two(shard_count, &shard_count)) {
+        return AWS_OP_ERR;
+    }
+
+    size_t shards_size = 0;
+    if (aws_mul_size_checked(shard_count, s_shard_stride, &shards_size)) {
+        return AWS_OP_ERR;
+    }
+    cache->shards = aws_mem_calloc(allocator, 1, shards_size);
+    if (!cache->shards) {
+        return AWS_OP_ERR;
+    }
+
+    cache->allocator = allocator;
+    cache->hash_fn = options->hash_fn;
+    cache->acquire_value_fn = options->acquire_value_fn;
+    cache->max_cost = options->max_cost;
+    cache->shard_count = shard_count;
+    cache->shard_shift = 64;
+    for (size_t count = shard_count; count > 1; count >>= 1) {
+        --cache->shard_shift;
+    }
+
+    struct aws_lru_cache_options shard_options = {
+        .hash_fn = options->hash_fn,
+        .equals_fn = options->equals_fn,
+        .destroy_key_fn = options->destroy_key_fn,
+        .destroy_value_fn = options->destroy_value_fn,
+        .max_items = options->max_items / shard_count + (options->max_items % shard_count != 0),
+        .policy = options->policy,
+        .max_cost = options->max_cost / shard_count + (options->max_cost % shard_count != 0),
+        .cost_fn = options->cost_fn,
+        .ttl = options->ttl,
+        .clock_fn = options->clock_fn,
+    };
+
+    size_t shard_idx = 0;
+    for (; shard_idx < shard_count; ++shard_idx) {
+        struct aws_sharded_lru_cache_shard *shard = s_shard_at(cache, shard_idx);
+        if (aws_mutex_init(&shard->lock)) {
+            goto error;
+        }
+        if (aws_lru_cache_init_with_options(&shard->cache, allocator, &shard_options)) {
+            aws_mutex_clean_up(&shard->lock);
+            goto error;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+
+error:
+    while (shard_idx-- > 0) {
+        struct aws_sharded_lru_cache_shard *shard = s_shard_at(cache, shard_idx);
+        aws_lru_cache_clean_up(&shard->cache);
+        aws_mutex_clean_up(&shard->lock);
+    }
+    aws_mem_release(allocator, cache->shards);
+    AWS_ZERO_STRUCT(*cache);
+    return AWS_OP_ERR;
+}
+
+void aws_sharded_lru_cache_clean_up(struct aws_sharded_lru_cache *cache) {
+    AWS_PRECONDITION(cache != NULL);
+
+    /* Ensure that we're idempotent */
+    if (!cache->shards) {
+        return;
+    }
+
+    for (size_t shard_idx = 0; shard_idx < cache->shard_count; ++shard_idx) {
+        struct aws_sharded_lru_cache_shard *shard = s_shard_at(cache, shard_idx);
+        aws_lru_cache_clean_up(&shard->cache);
+        aws_mutex_clean_up(&shard->lock);
+    }
+
+    aws_mem_release(cache->allocator, cache->shards);
+    AWS_ZERO_STRUCT(*cache);
+}
+
+int aws_sharded_lru_cache_find(struct aws_sharded_lru_cache *cache, const void *key, void **p_value) {
+    AWS_PRECONDITION(cache != NULL && cache->shards != NULL);
+    AWS_PRECONDITION(p_value != NULL);
+
+    struct aws_sharded_lru_cache_shard *shard = s_shard_for(cache, key);
+
+    aws_mutex_lock(&shard->lock);
+    int err_val = aws_lru_cache_find(&shard->cache, key, p_value);
+    if (!err_val) {
+        if (*p_value) {
+            ++shard->hits;
+            if (cache->acquire_value_fn) {
+                cache->acquire_value_fn(*p_value);
+            }
+        } else {
+            ++shard->misses;
+        }
+    }
+    aws_mutex_unlock(&shard->lock);
+
+    return err_val;
+}
+
+/*
+ * Puts an element with the shard's lock held. An element over the shard's budget but within the cache's is admitted
+ * alone: the shard's budget is raised to its cost for the put, so everything else in the shard is evicted, and then
+ * lowered again, so the shard's next put evicts it in turn if the two don't fit together.
+ */
+static int s_put_locked(
+    struct aws_sharded_lru_cache *cache,
+    struct aws_sharded_lru_cache_shard *shard,
+    const void *key,
+    void *p_value,
+    size_t cost) {
+
+    size_t shard_max_cost = shard->cache.max_cost;
+    if (!cache->max_cost || cost <= shard_max_cost) {
+        return aws_lru_cache_put_with_cost(&shard->cache, key, p_value, cost);
+    }
+    if (cost > cache->max_cost) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    shard->cache.max_cost = cost;
+    int err_val = aws_lru_cache_put_with_cost(&shard->cache, key, p_value, cost);
+    shard->cache.max_cost = shard_max_cost;
+    return err_val;
+}
+
+int aws_sharded_lru_cache_put(struct aws_sharded_lru_cache *cache, const void *key, void *p_value) {
+    AWS_PRECONDITION(cache != NULL && cache->shards != NULL);
+
+    struct aws_sharded_lru_cache_shard *shard = s_shard_for(cache, key);
+
+    aws_mutex_lock(&shard->lock);
+    size_t cost = shard->cache.cost_fn ? shard->cache.cost_fn(key, p_value) : 0;
+    int err_val = s_put_locked(cache, shard, key, p_value, cost);
+    aws_mutex_unlock(&shard->lock);
+
+    return err_val;
+}
+
+int aws_sharded_lru_cache_put_with_cost(
+    struct aws_sharded_lru_cache *cache,
+    const void *key,
+    void *p_value,
+    size_t cost) {
+    AWS_PRECONDITION(cache != NULL && cache->shards != NULL);
+
+    struct aws_sharded_lru_cache_shard *shard = s_shard_for(cache, key);
+
+    aws_mutex_lock(&shard->lock);
+    int err_val = s_put_locked(cache, shard, key, p_value, cost);
+    aws_mutex_unlock(&shard->lock);
+
+    return err_val;
+}
+
+int aws_sharded_lru_cache_remove(struct aws_sharded_lru_cache *cache, const void *key) {
+    AWS_PRECONDITION(cache != NULL && cache->shards != NULL);
+
+    struct aws_sharded_lru_cache_shard *shard = s_shard_for(cache, key);
+
+    aws_mutex_lock(&shard->lock);
+    int err_val = aws_lru_cache_remove(&shard->cache, key);
+    aws_mutex_unlock(&shard->lock);
+
+    return err_val;
+}
+
+size_t aws_sharded_lru_cache_purge_expired(struct aws_sharded_lru_cache *cache, uint64_t current_time) {
+    AWS_PRECONDITION(cache != NULL && cache->shards != NULL);
+
+    size_t purged = 0;
+    for (size_t shard_idx = 0; shard_idx < cache->shard_count; ++shard_idx) {
+        struct aws_sharded_lru_cache_shard *shard = s_shard_at(cache, shard_idx);
+        aws_mutex_lock(&shard->lock);
+        purged += aws_lru_cache_purge_expired(&shard->cache, current_time, 0);
+        aws_mutex_unlock(&shard->lock);
+    }
+    return purged;
+}
+
+void aws_sharded_lru_cache_clear(struct aws_sharded_lru_cache *cache) {
+    AWS_PRECONDITION(cache != NULL && cache->shards != NULL);
+
+    for (size_t shard_idx = 0; shard_idx < cache->shard_count; ++shard_idx) {
+        struct aws_sharded_lru_cache_shard *shard = s_shard_at(cache, shard_idx);
+        aws_mutex_lock(&shard->lock);
+        aws_lru_cache_clear(&shard->cache);
+        aws_mutex_unlock(&shard->lock);
+    }
+}
+
+size_t aws_sharded_lru_cache_get_element_count(struct aws_sharded_lru_cache *cache) {
+    AWS_PRECONDITION(cache != NULL);
+
+    size_t element_count = 0;
+    for (size_t shard_idx = 0; shard_idx < cache->shard_count; ++shard_idx) {
+        struct aws_sharded_lru_cache_shard *shard = s_shard_at(cache, shard_idx);
+        aws_mutex_lock(&shard->lock);
+        element_count += aws_lru_cache_get_element_count(&shard->cache);
+        aws_mutex_unlock(&shard->lock);
+    }
+    return element_count;
+}
+
+void aws_sharded_lru_cache_get_stats(struct aws_sharded_lru_cache *cache, struct aws_sharded_lru_cache_stats *stats) {
+    AWS_PRECONDITION(cache != NULL);
+    AWS_PRECONDITION(stats != NULL);
+
+    AWS_ZERO_STRUCT(*stats);
+    for (size_t shard_idx = 0; shard_idx < cache->shard_count; ++shard_idx) {
+        struct aws_sharded_lru_cache_shard *shard = s_shard_at(cache, shard_idx);
+        aws_mutex_lock(&shard->lock);
+        stats->element_count += aws_lru_cache_get_element_count(&shard->cache);
+        stats->total_cost += aws_lru_cache_get_total_cost(&shard->cache);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->cache.eviction_count;
+        stats->expirations += shard->cache.expiration_count;
+        aws_mutex_unlock(&shard->lock);
+    }
+}
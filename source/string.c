@@ -47,7 +47,7 @@ struct aws_string *aws_string_new_from_string(struct aws_allocator *allocator, c
 void aws_string_destroy(struct aws_string *str) {
     AWS_PRECONDITION(!str || aws_string_is_valid(str));
     if (str && str->allocator) {
-        aws_mem_release(str->allocator, str);
+        aws_mem_release_sized(str->allocator, str, sizeof(struct aws_string) + 1 + str->len);
     }
 }
 
@@ -56,7 +56,7 @@ void aws_string_destroy_secure(struct aws_string *str) {
     if (str) {
         aws_secure_zero((void *)aws_string_bytes(str), str->len);
         if (str->allocator) {
-            aws_mem_release(str->allocator, str);
+            aws_mem_release_sized(str->allocator, str, sizeof(struct aws_string) + 1 + str->len);
         }
     }
 }
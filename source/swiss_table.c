@@ -0,0 +1,487 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* For more information on the layout and probing scheme, see the design notes for Abseil's flat_hash_map:
+ * https://abseil.io/about/design/swisstables
+ */
+
+#include <aws/common/math.h>
+#include <aws/common/swiss_table.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define AWS_SWISS_TABLE_SSE2 1
+#endif
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+/* Control byte values. Full slots hold the low 7 bits of the hash, so only the special values have the top bit set */
+#define CTRL_EMPTY ((int8_t)-128)
+#define CTRL_DELETED ((int8_t)-2)
+
+/* one slot in 8 is always kept empty, so that every probe sequence ends */
+#define MAX_LOAD(capacity) ((capacity) - (capacity) / 8)
+
+/* Ensures a reasonable semantics for null keys, the same as aws_hash_table */
+static uint64_t s_hash_for(const struct aws_swiss_table *table, const void *key) {
+    return key ? table->hash_fn(key) : 42;
+}
+
+static size_t s_h1(uint64_t hash) {
+    return (size_t)(hash >> 7);
+}
+
+static int8_t s_h2(uint64_t hash) {
+    return (int8_t)(hash & 0x7f);
+}
+
+static bool s_keys_eq(const struct aws_swiss_table *table, const void *a, const void *b) {
+    if (a == b) {
+        return true;
+    }
+    if (a == NULL || b == NULL) {
+        return false;
+    }
+    return table->equals_fn(a, b);
+}
+
+/* Index of the lowest set bit, mask must not be 0 */
+static unsigned s_trailing_zeros(uint32_t mask) {
+    AWS_PRECONDITION(mask != 0);
+#if defined(_MSC_VER)
+    unsigned long idx = 0;
+    _BitScanForward(&idx, mask);
+    return (unsigned)idx;
+#elif defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctz(mask);
+#else
+    unsigned idx = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++idx;
+    }
+    return idx;
+#endif
+}
+
+/* Number of clear bits above the highest set bit of a group-wide mask */
+static unsigned s_group_leading_zeros(uint32_t mask) {
+    unsigned count = 0;
+    for (uint32_t bit = 1u << (AWS_SWISS_TABLE_GROUP_WIDTH - 1); bit && !(mask & bit); bit >>= 1) {
+        ++count;
+    }
+    return count;
+}
+
+/*
+ * Group operations: each returns a bitmask with bit i set if control byte i of the group (starting at group)
+ * matches.
+ */
+#ifdef AWS_SWISS_TABLE_SSE2
+static uint32_t s_group_match(const int8_t *group, int8_t h2) {
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+}
+
+static uint32_t s_group_match_empty(const int8_t *group) {
+    return s_group_match(group, CTRL_EMPTY);
+}
+
+static uint32_t s_group_match_empty_or_deleted(const int8_t *group) {
+    /* both special values have the sign bit set, which is exactly what movemask collects */
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+}
+#else
+static uint32_t s_group_match(const int8_t *group, int8_t h2) {
+    uint32_t mask = 0;
+    for (unsigned idx = 0; idx < AWS_SWISS_TABLE_GROUP_WIDTH; ++idx) {
+        mask |= (uint32_t)(group[idx] == h2) << idx;
+    }
+    return mask;
+}
+
+static uint32_t s_group_match_empty(const int8_t *group) {
+    return s_group_match(group, CTRL_EMPTY);
+}
+
+static uint32_t s_group_match_empty_or_deleted(const int8_t *group) {
+    uint32_t mask = 0;
+    for (unsigned idx = 0; idx < AWS_SWISS_TABLE_GROUP_WIDTH; ++idx) {
+        mask |= (uint32_t)(group[idx] < 0) << idx;
+    }
+    return mask;
+}
+#endif
+
+/* The control bytes for the first group are repeated after the last slot, so a group can be loaded from any slot
+ * without wrapping */
+static void s_set_ctrl(struct aws_swiss_table *table, size_t idx, int8_t value) {
+    table->ctrl[idx] = value;
+    if (idx < AWS_SWISS_TABLE_GROUP_WIDTH) {
+        table->ctrl[table->capacity + idx] = value;
+    }
+}
+
+/* The slots, a control byte for each, and the copy of the first group's. Raises AWS_ERROR_OOM if that doesn't fit in a
+ * size_t */
+static int s_required_bytes(size_t capacity, size_t *required) {
+    size_t slot_bytes = 0;
+    if (aws_mul_size_checked(capacity, sizeof(struct aws_hash_element), &slot_bytes) ||
+        aws_add_size_checked(slot_bytes, capacity, required) ||
+        aws_add_size_checked(*required, AWS_SWISS_TABLE_GROUP_WIDTH, required)) {
+        return aws_raise_error(AWS_ERROR_OOM);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* Releases the allocation for capacity slots, whose size was checked when it was acquired */
+static void s_release_slots(struct aws_allocator *alloc, struct aws_hash_element *slots, size_t capacity) {
+    const size_t bytes = capacity * sizeof(struct aws_hash_element) + capacity + AWS_SWISS_TABLE_GROUP_WIDTH;
+    aws_mem_release_sized(alloc, slots, bytes);
+}
+
+/* Probes groups in triangular steps (pos, pos + 16, pos + 48, ...), which visits every group when the number of
+ * groups is a power of 2. Returns the first slot which is empty or deleted; there is always one. */
+static size_t s_find_first_non_full(const struct aws_swiss_table *table, uint64_t hash) {
+    const size_t mask = table->capacity - 1;
+    size_t pos = s_h1(hash) & mask;
+    size_t stride = 0;
+    for (;;) {
+        uint32_t match = s_group_match_empty_or_deleted(table->ctrl + pos);
+        if (match) {
+            return (pos + s_trailing_zeros(match)) & mask;
+        }
+        stride += AWS_SWISS_TABLE_GROUP_WIDTH;
+        pos = (pos + stride) & mask;
+    }
+}
+
+/* Returns the index of key's slot, or SIZE_MAX if it isn't in the table */
+static size_t s_find_index(const struct aws_swiss_table *table, const void *key, uint64_t hash) {
+    if (!table->capacity) {
+        return SIZE_MAX;
+    }
+
+    const size_t mask = table->capacity - 1;
+    const int8_t h2 = s_h2(hash);
+    size_t pos = s_h1(hash) & mask;
+    size_t stride = 0;
+    for (;;) {
+        const int8_t *group = table->ctrl + pos;
+        for (uint32_t match = s_group_match(group, h2); match; match &= match - 1) {
+            const size_t idx = (pos + s_trailing_zeros(match)) & mask;
+            if (AWS_LIKELY(s_keys_eq(table, table->slots[idx].key, key))) {
+                return idx;
+            }
+        }
+        /* the key would have gone in the first empty slot of its probe sequence, so it can't be any further */
+        if (s_group_match_empty(group)) {
+            return SIZE_MAX;
+        }
+        stride += AWS_SWISS_TABLE_GROUP_WIDTH;
+        pos = (pos + stride) & mask;
+    }
+}
+
+/* Moves every element into a fresh allocation with new_capacity slots, also dropping all tombstones */
+static int s_resize(struct aws_swiss_table *table, size_t new_capacity) {
+    AWS_PRECONDITION(new_capacity >= AWS_SWISS_TABLE_GROUP_WIDTH);
+
+    size_t required = 0;
+    if (s_required_bytes(new_capacity, &required)) {
+        return AWS_OP_ERR;
+    }
+
+    uint8_t *mem = aws_mem_acquire(table->alloc, required);
+    if (!mem) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_swiss_table old = *table;
+    table->slots = (struct aws_hash_element *)mem;
+    table->ctrl = (int8_t *)(mem + new_capacity * sizeof(struct aws_hash_element));
+    table->capacity = new_capacity;
+    memset(table->ctrl, CTRL_EMPTY, new_capacity + AWS_SWISS_TABLE_GROUP_WIDTH);
+
+    for (size_t idx = 0; idx < old.capacity; ++idx) {
+        if (old.ctrl[idx] < 0) {
+            continue;
+        }
+        const uint64_t hash = s_hash_for(table, old.slots[idx].key);
+        const size_t new_idx = s_find_first_non_full(table, hash);
+        s_set_ctrl(table, new_idx, s_h2(hash));
+        table->slots[new_idx] = old.slots[idx];
+    }
+
+    table->growth_left = MAX_LOAD(new_capacity) - table->entry_count;
+
+    if (old.slots) {
+        s_release_slots(table->alloc, old.slots, old.capacity);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* Computes the capacity which holds size elements without growing */
+static int s_capacity_for(size_t size, size_t *capacity) {
+    size_t min_capacity = 0;
+    if (aws_add_size_checked(size, size / 7 + 1, &min_capacity)) {
+        return AWS_OP_ERR;
+    }
+    if (min_capacity < AWS_SWISS_TABLE_GROUP_WIDTH) {
+        min_capacity = AWS_SWISS_TABLE_GROUP_WIDTH;
+    }
+    return aws_round_up_to_power_of_two(min_capacity, capacity);
+}
+
+int aws_swiss_table_init(
+    struct aws_swiss_table *table,
+    struct aws_allocator *alloc,
+    size_t size,
+    aws_hash_fn *hash_fn,
+    aws_hash_callback_eq_fn *equals_fn,
+    aws_hash_callback_destroy_fn *destroy_key_fn,
+    aws_hash_callback_destroy_fn *destroy_value_fn) {
+    AWS_PRECONDITION(table != NULL);
+    AWS_PRECONDITION(alloc != NULL);
+    AWS_PRECONDITION(hash_fn != NULL);
+    AWS_PRECONDITION(equals_fn != NULL);
+
+    AWS_ZERO_STRUCT(*table);
+    table->alloc = alloc;
+    table->hash_fn = hash_fn;
+    table->equals_fn = equals_fn;
+    table->destroy_key_fn = destroy_key_fn;
+    table->destroy_value_fn = destroy_value_fn;
+
+    if (size == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    size_t capacity = 0;
+    if (s_capacity_for(size, &capacity)) {
+        return AWS_OP_ERR;
+    }
+    return s_resize(table, capacity);
+}
+
+void aws_swiss_table_clean_up(struct aws_swiss_table *table) {
+    AWS_PRECONDITION(table != NULL);
+
+    if (!table->slots) {
+        return;
+    }
+
+    aws_swiss_table_clear(table);
+    s_release_slots(table->alloc, table->slots, table->capacity);
+    table->slots = NULL;
+    table->ctrl = NULL;
+    table->capacity = 0;
+    table->growth_left = 0;
+}
+
+size_t aws_swiss_table_get_entry_count(const struct aws_swiss_table *table) {
+    AWS_PRECONDITION(table != NULL);
+    return table->entry_count;
+}
+
+int aws_swiss_table_find(const struct aws_swiss_table *table, const void *key, struct aws_hash_element **p_elem) {
+    AWS_PRECONDITION(table != NULL);
+    AWS_PRECONDITION(p_elem != NULL);
+
+    const size_t idx = s_find_index(table, key, s_hash_for(table, key));
+    *p_elem = idx == SIZE_MAX ? NULL : &table->slots[idx];
+    return AWS_OP_SUCCESS;
+}
+
+int aws_swiss_table_create(
+    struct aws_swiss_table *table,
+    const void *key,
+    struct aws_hash_element **p_elem,
+    int *was_created) {
+    AWS_PRECONDITION(table != NULL);
+    AWS_PRECONDITION(p_elem != NULL);
+
+    const uint64_t hash = s_hash_for(table, key);
+    size_t idx = s_find_index(table, key, hash);
+    if (idx != SIZE_MAX) {
+        *p_elem = &table->slots[idx];
+        if (was_created) {
+            *was_created = 0;
+        }
+        return AWS_OP_SUCCESS;
+    }
+
+    idx = table->capacity ? s_find_first_non_full(table, hash) : 0;
+    /* re-using a tombstone doesn't take up any of the empty slots probing relies on, so it needs no room */
+    if (!table->capacity || (table->growth_left == 0 && table->ctrl[idx] == CTRL_EMPTY)) {
+        size_t new_capacity = AWS_SWISS_TABLE_GROUP_WIDTH;
+        if (table->capacity) {
+            /* if more than half the load is tombstones, rehashing in place is enough */
+            new_capacity = table->capacity;
+            if (table->entry_count * 2 > MAX_LOAD(table->capacity) &&
+                aws_mul_size_checked(table->capacity, 2, &new_capacity)) {
+                return aws_raise_error(AWS_ERROR_OOM);
+            }
+        }
+        if (s_resize(table, new_capacity)) {
+            return AWS_OP_ERR;
+        }
+        idx = s_find_first_non_full(table, hash);
+    }
+
+    table->growth_left -= table->ctrl[idx] == CTRL_EMPTY;
+    s_set_ctrl(table, idx, s_h2(hash));
+    ++table->entry_count;
+
+    struct aws_hash_element *elem = &table->slots[idx];
+    elem->key = key;
+    elem->value = NULL;
+    *p_elem = elem;
+    if (was_created) {
+        *was_created = 1;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+int aws_swiss_table_put(struct aws_swiss_table *table, const void *key, void *value, int *was_created) {
+    struct aws_hash_element *p_elem = NULL;
+    int was_created_fallback = 0;
+
+    if (!was_created) {
+        was_created = &was_created_fallback;
+    }
+
+    if (aws_swiss_table_create(table, key, &p_elem, was_created)) {
+        return AWS_OP_ERR;
+    }
+
+    if (!*was_created) {
+        if (p_elem->key != key && table->destroy_key_fn) {
+            table->destroy_key_fn((void *)p_elem->key);
+        }
+        if (table->destroy_value_fn) {
+            table->destroy_value_fn(p_elem->value);
+        }
+    }
+
+    p_elem->key = key;
+    p_elem->value = value;
+    return AWS_OP_SUCCESS;
+}
+
+/* Empties the slot at idx. Does _not_ invoke destructor callbacks. */
+static void s_erase_at(struct aws_swiss_table *table, size_t idx) {
+    AWS_PRECONDITION(table->entry_count > 0);
+
+    /* If there is an empty slot on both sides of idx within one group's reach, no probe sequence can ever have
+     * found this group full, so nothing can have been placed beyond it because of this slot and it can go back to
+     * being empty rather than becoming a tombstone. */
+    const size_t mask = table->capacity - 1;
+    const uint32_t empty_before = s_group_match_empty(table->ctrl + ((idx - AWS_SWISS_TABLE_GROUP_WIDTH) & mask));
+    const uint32_t empty_after = s_group_match_empty(table->ctrl + idx);
+    const bool was_never_full = empty_before && empty_after &&
+                                s_trailing_zeros(empty_after) + s_group_leading_zeros(empty_before) <
+                                    AWS_SWISS_TABLE_GROUP_WIDTH;
+
+    s_set_ctrl(table, idx, was_never_full ? CTRL_EMPTY : CTRL_DELETED);
+    table->growth_left += was_never_full;
+    --table->entry_count;
+}
+
+int aws_swiss_table_remove(
+    struct aws_swiss_table *table,
+    const void *key,
+    struct aws_hash_element *p_value,
+    int *was_present) {
+    AWS_PRECONDITION(table != NULL);
+
+    const size_t idx = s_find_index(table, key, s_hash_for(table, key));
+    if (was_present) {
+        *was_present = idx != SIZE_MAX;
+    }
+    if (idx == SIZE_MAX) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_hash_element *elem = &table->slots[idx];
+    if (p_value) {
+        *p_value = *elem;
+    } else {
+        if (table->destroy_key_fn) {
+            table->destroy_key_fn((void *)elem->key);
+        }
+        if (table->destroy_value_fn) {
+            table->destroy_value_fn(elem->value);
+        }
+    }
+
+    s_erase_at(table, idx);
+    return AWS_OP_SUCCESS;
+}
+
+int aws_swiss_table_foreach(
+    struct aws_swiss_table *table,
+    int (*callback)(void *context, struct aws_hash_element *p_element),
+    void *context) {
+    AWS_PRECONDITION(table != NULL);
+    AWS_PRECONDITION(callback != NULL);
+
+    /* erasing never moves other elements, so iteration can simply carry on past a delete */
+    for (size_t idx = 0; idx < table->capacity; ++idx) {
+        if (table->ctrl[idx] < 0) {
+            continue;
+        }
+
+        int rv = callback(context, &table->slots[idx]);
+
+        if (rv & AWS_COMMON_HASH_TABLE_ITER_DELETE) {
+            s_erase_at(table, idx);
+        }
+
+        if (!(rv & AWS_COMMON_HASH_TABLE_ITER_CONTINUE)) {
+            break;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+void aws_swiss_table_clear(struct aws_swiss_table *table) {
+    AWS_PRECONDITION(table != NULL);
+
+    if (!table->capacity) {
+        return;
+    }
+
+    if (table->destroy_key_fn || table->destroy_value_fn) {
+        for (size_t idx = 0; idx < table->capacity; ++idx) {
+            if (table->ctrl[idx] < 0) {
+                continue;
+            }
+            if (table->destroy_key_fn) {
+                table->destroy_key_fn((void *)table->slots[idx].key);
+            }
+            if (table->destroy_value_fn) {
+                table->destroy_value_fn(table->slots[idx].value);
+            }
+        }
+    }
+
+    memset(table->ctrl, CTRL_EMPTY, table->capacity + AWS_SWISS_TABLE_GROUP_WIDTH);
+    table->entry_count = 0;
+    table->growth_left = MAX_LOAD(table->capacity);
+}
@@ -16,9 +16,14 @@
 #include <aws/common/task_scheduler.h>
 
 #include <aws/common/logging.h>
+#include <aws/common/math.h>
 
 #include <inttypes.h>
 
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
 static const size_t DEFAULT_QUEUE_SIZE = 7;
 
 void aws_task_init(struct aws_task *task, aws_task_fn *fn, void *arg, const char *type_tag) {
@@ -26,6 +31,8 @@ void aws_task_init(struct aws_task *task, aws_task_fn *fn, void *arg, const char
     task->fn = fn;
     task->arg = arg;
     task->type_tag = type_tag;
+    /* not in the timed_queue; index 0 would be its first slot */
+    task->priority_queue_node.current_index = SIZE_MAX;
 }
 
 const char *aws_task_status_to_c_str(enum aws_task_status status) {
@@ -53,24 +60,139 @@ void aws_task_run(struct aws_task *task, enum aws_task_status status) {
     task->fn(task, task->arg, status);
 }
 
-static int s_compare_timestamps(const void *a, const void *b) {
-    uint64_t a_time = (*(struct aws_task **)a)->timestamp;
-    uint64_t b_time = (*(struct aws_task **)b)->timestamp;
-    return a_time > b_time; /* min-heap */
+static void s_run_all(struct aws_task_scheduler *scheduler, uint64_t current_time, enum aws_task_status status);
+
+#define TIMER_WHEEL_LEVELS 6
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+
+static const uint64_t DEFAULT_WHEEL_TICK = 1000000; /* 1ms, in nanoseconds */
+
+/*
+ * Level L of the wheel holds the tasks due in the same span of 64^(L+1) ticks as the current tick, but in a later span
+ * of 64^L ticks, in the slot for that span. So every task on a level is due before any task on the levels above it,
+ * and a slot only needs looking at again once run_all reaches the span it covers: then its tasks are either all due,
+ * and go into the heap, or are spread over the levels below.
+ */
+struct aws_task_scheduler_timer_wheel {
+    uint64_t tick;
+    /* The tick of the latest run_all(). Tasks due by the end of it are in the heap. */
+    uint64_t current_tick;
+    /* Whether run_all() has set current_tick yet. Until it has, tasks go into the heap. */
+    bool started;
+    /* Bit i of occupied[L] is set if slots[L][i] may be non-empty: cancelling a task doesn't clear it */
+    uint64_t occupied[TIMER_WHEEL_LEVELS];
+    struct aws_linked_list slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+static unsigned s_trailing_zeros(uint64_t mask) {
+    AWS_PRECONDITION(mask != 0);
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long idx = 0;
+    _BitScanForward64(&idx, mask);
+    return (unsigned)idx;
+#elif defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctzll(mask);
+#else
+    unsigned idx = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++idx;
+    }
+    return idx;
+#endif
+}
+
+static unsigned s_wheel_shift(size_t level) {
+    return (unsigned)(level * TIMER_WHEEL_SLOT_BITS);
 }
 
-static void s_run_all(struct aws_task_scheduler *scheduler, uint64_t current_time, enum aws_task_status status);
+/*
+ * Puts a task on the wheel, unless it is due by the end of the current tick or beyond the wheel's span, or the wheel
+ * hasn't started turning yet
+ */
+static bool s_wheel_insert(struct aws_task_scheduler_timer_wheel *wheel, struct aws_task *task) {
+    uint64_t tick = task->timestamp / wheel->tick;
+    if (!wheel->started || tick <= wheel->current_tick) {
+        return false;
+    }
+
+    size_t level = 0;
+    while ((tick >> s_wheel_shift(level + 1)) != (wheel->current_tick >> s_wheel_shift(level + 1))) {
+        if (++level == TIMER_WHEEL_LEVELS) {
+            return false;
+        }
+    }
+
+    size_t slot = (size_t)(tick >> s_wheel_shift(level)) & (TIMER_WHEEL_SLOTS - 1);
+    aws_linked_list_push_back(&wheel->slots[level][slot], &task->node);
+    wheel->occupied[level] |= (uint64_t)1 << slot;
+    return true;
+}
+
+/* Whether the wheel holds any tasks, and if so the earliest time one may be due */
+static bool s_wheel_next_time(const struct aws_task_scheduler_timer_wheel *wheel, uint64_t *next_time) {
+    for (size_t level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        for (uint64_t mask = wheel->occupied[level]; mask; mask &= mask - 1) {
+            unsigned slot = s_trailing_zeros(mask);
+            if (!aws_linked_list_empty(&wheel->slots[level][slot])) {
+                uint64_t span_start = wheel->current_tick >> s_wheel_shift(level + 1) << s_wheel_shift(level + 1);
+                uint64_t slot_start = span_start | ((uint64_t)slot << s_wheel_shift(level));
+                *next_time = aws_mul_u64_saturating(slot_start, wheel->tick);
+                return true;
+            }
+        }
+    }
+    return false;
+}
 
 int aws_task_scheduler_init(struct aws_task_scheduler *scheduler, struct aws_allocator *alloc) {
+    struct aws_task_scheduler_options options = {.timer_backend = AWS_TASK_SCHEDULER_TIMER_HEAP};
+    return aws_task_scheduler_init_with_options(scheduler, alloc, &options);
+}
+
+int aws_task_scheduler_init_with_options(
+    struct aws_task_scheduler *scheduler,
+    struct aws_allocator *alloc,
+    const struct aws_task_scheduler_options *options) {
     AWS_ASSERT(alloc);
+    AWS_ASSERT(options);
 
     AWS_ZERO_STRUCT(*scheduler);
 
-    if (aws_priority_queue_init_dynamic(
-            &scheduler->timed_queue, alloc, DEFAULT_QUEUE_SIZE, sizeof(struct aws_task *), &s_compare_timestamps)) {
+    if (options->timer_backend != AWS_TASK_SCHEDULER_TIMER_HEAP &&
+        options->timer_backend != AWS_TASK_SCHEDULER_TIMER_WHEEL) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    /* keyed by timestamp, so that sifting never has to dereference a task, and 4-ary, so that it visits fewer levels */
+    struct aws_priority_queue_options timed_queue_options = {
+        .initial_size = DEFAULT_QUEUE_SIZE,
+        .item_size = sizeof(struct aws_task *),
+        .arity = 4,
+        .keyed = true,
+    };
+    if (aws_priority_queue_init_dynamic_with_options(&scheduler->timed_queue, alloc, &timed_queue_options)) {
         return AWS_OP_ERR;
     };
 
+    if (options->timer_backend == AWS_TASK_SCHEDULER_TIMER_WHEEL) {
+        struct aws_task_scheduler_timer_wheel *wheel = aws_mem_calloc(alloc, 1, sizeof(*wheel));
+        if (!wheel) {
+            aws_priority_queue_clean_up(&scheduler->timed_queue);
+            AWS_ZERO_STRUCT(*scheduler);
+            return AWS_OP_ERR;
+        }
+
+        wheel->tick = options->wheel_tick ? options->wheel_tick : DEFAULT_WHEEL_TICK;
+        for (size_t level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+            for (size_t slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot) {
+                aws_linked_list_init(&wheel->slots[level][slot]);
+            }
+        }
+        scheduler->timer_wheel = wheel;
+    }
+
     scheduler->alloc = alloc;
     aws_linked_list_init(&scheduler->timed_list);
     aws_linked_list_init(&scheduler->asap_list);
@@ -90,13 +212,17 @@ void aws_task_scheduler_clean_up(struct aws_task_scheduler *scheduler) {
         }
     }
 
+    if (scheduler->timer_wheel) {
+        aws_mem_release(scheduler->alloc, scheduler->timer_wheel);
+    }
     aws_priority_queue_clean_up(&scheduler->timed_queue);
     AWS_ZERO_STRUCT(*scheduler);
 }
 
 bool aws_task_scheduler_is_valid(const struct aws_task_scheduler *scheduler) {
     return scheduler && scheduler->alloc && aws_priority_queue_is_valid(&scheduler->timed_queue) &&
-           aws_linked_list_is_valid(&scheduler->asap_list) && aws_linked_list_is_valid(&scheduler->timed_list);
+           aws_linked_list_is_valid(&scheduler->asap_list) && aws_linked_list_is_valid(&scheduler->timed_list) &&
+           (!scheduler->timer_wheel || scheduler->timer_wheel->tick);
 }
 
 bool aws_task_scheduler_has_tasks(const struct aws_task_scheduler *scheduler, uint64_t *next_task_time) {
@@ -125,6 +251,16 @@ bool aws_task_scheduler_has_tasks(const struct aws_task_scheduler *scheduler, ui
             }
             has_tasks = true;
         }
+
+        if (scheduler->timer_wheel) {
+            uint64_t wheel_time = 0;
+            if (s_wheel_next_time(scheduler->timer_wheel, &wheel_time)) {
+                if (wheel_time < timestamp) {
+                    timestamp = wheel_time;
+                }
+                has_tasks = true;
+            }
+        }
     }
 
     if (next_task_time) {
@@ -133,6 +269,75 @@ bool aws_task_scheduler_has_tasks(const struct aws_task_scheduler *scheduler, ui
     return has_tasks;
 }
 
+/* Files a task by its timestamp: on the wheel if there is one and it fits, otherwise into the heap */
+static void s_schedule_timed(struct aws_task_scheduler *scheduler, struct aws_task *task) {
+    if (scheduler->timer_wheel && s_wheel_insert(scheduler->timer_wheel, task)) {
+        return;
+    }
+
+    uint64_t time_to_run = task->timestamp;
+    int err = aws_priority_queue_push_keyed(&scheduler->timed_queue, time_to_run, &task, &task->priority_queue_node);
+    if (AWS_UNLIKELY(err)) {
+        /* In the (very unlikely) case that we can't push into the timed_queue,
+         * perform a sorted insertion into timed_list. */
+        struct aws_linked_list_node *node_i;
+        for (node_i = aws_linked_list_begin(&scheduler->timed_list);
+             node_i != aws_linked_list_end(&scheduler->timed_list);
+             node_i = aws_linked_list_next(node_i)) {
+
+            struct aws_task *task_i = AWS_CONTAINER_OF(node_i, struct aws_task, node);
+            if (task_i->timestamp > time_to_run) {
+                break;
+            }
+        }
+        aws_linked_list_insert_before(node_i, &task->node);
+    }
+}
+
+/*
+ * Turns the wheel to the tick of current_time. On each level, the slots run_all has now reached or passed are emptied
+ * back through s_schedule_timed(), which sends due tasks into the heap and the rest to the level below. Going from the
+ * bottom level up means no task is looked at twice.
+ */
+static void s_wheel_advance(struct aws_task_scheduler *scheduler, uint64_t current_time) {
+    struct aws_task_scheduler_timer_wheel *wheel = scheduler->timer_wheel;
+    uint64_t old_tick = wheel->current_tick;
+    uint64_t new_tick = current_time / wheel->tick;
+    if (!wheel->started) {
+        /* nothing is on the wheel yet, so there is nothing to turn */
+        wheel->current_tick = new_tick;
+        wheel->started = true;
+        return;
+    }
+    if (new_tick <= old_tick) {
+        return;
+    }
+
+    wheel->current_tick = new_tick;
+    for (size_t level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        uint64_t reached = UINT64_MAX;
+        if ((new_tick >> s_wheel_shift(level + 1)) == (old_tick >> s_wheel_shift(level + 1))) {
+            /* Same span as before: only the slots up to the new tick's */
+            unsigned new_slot = (unsigned)(new_tick >> s_wheel_shift(level)) & (TIMER_WHEEL_SLOTS - 1);
+            reached = new_slot == TIMER_WHEEL_SLOTS - 1 ? UINT64_MAX : ((uint64_t)1 << (new_slot + 1)) - 1;
+        }
+
+        for (uint64_t mask = wheel->occupied[level] & reached; mask; mask &= mask - 1) {
+            unsigned slot = s_trailing_zeros(mask);
+            struct aws_linked_list tasks;
+            aws_linked_list_init(&tasks);
+            aws_linked_list_swap_contents(&tasks, &wheel->slots[level][slot]);
+
+            while (!aws_linked_list_empty(&tasks)) {
+                struct aws_linked_list_node *node = aws_linked_list_pop_front(&tasks);
+                aws_linked_list_node_reset(node);
+                s_schedule_timed(scheduler, AWS_CONTAINER_OF(node, struct aws_task, node));
+            }
+        }
+        wheel->occupied[level] &= ~reached;
+    }
+}
+
 void aws_task_scheduler_schedule_now(struct aws_task_scheduler *scheduler, struct aws_task *task) {
     AWS_ASSERT(scheduler);
     AWS_ASSERT(task);
@@ -171,22 +376,41 @@ void aws_task_scheduler_schedule_future(
 
     task->priority_queue_node.current_index = SIZE_MAX;
     aws_linked_list_node_reset(&task->node);
-    int err = aws_priority_queue_push_ref(&scheduler->timed_queue, &task, &task->priority_queue_node);
-    if (AWS_UNLIKELY(err)) {
-        /* In the (very unlikely) case that we can't push into the timed_queue,
-         * perform a sorted insertion into timed_list. */
-        struct aws_linked_list_node *node_i;
-        for (node_i = aws_linked_list_begin(&scheduler->timed_list);
-             node_i != aws_linked_list_end(&scheduler->timed_list);
-             node_i = aws_linked_list_next(node_i)) {
+    s_schedule_timed(scheduler, task);
+}
 
-            struct aws_task *task_i = AWS_CONTAINER_OF(node_i, struct aws_task, node);
-            if (task_i->timestamp > time_to_run) {
-                break;
-            }
-        }
-        aws_linked_list_insert_before(node_i, &task->node);
+void aws_task_scheduler_reschedule_future(
+    struct aws_task_scheduler *scheduler,
+    struct aws_task *task,
+    uint64_t time_to_run) {
+
+    AWS_ASSERT(scheduler);
+    AWS_ASSERT(task);
+    AWS_ASSERT(task->fn);
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_COMMON_TASK_SCHEDULER,
+        "id=%p: Rescheduling %s task for future execution at time %" PRIu64,
+        (void *)task,
+        task->type_tag,
+        time_to_run);
+
+    task->timestamp = time_to_run;
+
+    if (!task->node.next && task->priority_queue_node.current_index != SIZE_MAX) {
+        /* Still in timed_queue, so move it there */
+        int err = aws_priority_queue_update_keyed(&scheduler->timed_queue, time_to_run, &task->priority_queue_node);
+        AWS_ASSERT(!err);
+        (void)err;
+        return;
     }
+
+    /* Every other place a task waits is a linked list */
+    if (task->node.next) {
+        aws_linked_list_remove(&task->node);
+    }
+    task->priority_queue_node.current_index = SIZE_MAX;
+    s_schedule_timed(scheduler, task);
 }
 
 void aws_task_scheduler_run_all(struct aws_task_scheduler *scheduler, uint64_t current_time) {
@@ -203,6 +427,11 @@ static void s_run_all(struct aws_task_scheduler *scheduler, uint64_t current_tim
     struct aws_linked_list running_list;
     aws_linked_list_init(&running_list);
 
+    /* Tasks on the wheel that are now due go into the heap, and are taken from there in order below */
+    if (scheduler->timer_wheel) {
+        s_wheel_advance(scheduler, current_time);
+    }
+
     /* First move everything from asap_list */
     aws_linked_list_swap_contents(&running_list, &scheduler->asap_list);
 
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/common.h>
+#include <aws/common/hash_table.h>
+#include <aws/common/math.h>
+#include <aws/common/mutex.h>
+
+#include <Windows.h>
+
+/*
+ * Windows counterpart of source/posix/mmap_allocator.c, built on VirtualAlloc. Large pages need the
+ * SeLockMemoryPrivilege, so AWS_MMAP_HUGE_PAGES_EXPLICIT falls back to regular pages when they can't be had, and
+ * AWS_MMAP_HUGE_PAGES_TRANSPARENT has no equivalent. There is no mremap, so realloc copies.
+ * As there, mappings are handed out whole and their lengths are kept in a table to the side.
+ */
+struct mmap_allocator {
+    struct aws_allocator *allocator; /* parent, for small allocations and the mappings table */
+    size_t min_mmap_size;
+    size_t page_size;
+    size_t large_page_size;
+    enum aws_mmap_huge_pages huge_pages;
+    bool populate;
+    struct aws_mutex lock;
+    struct aws_hash_table mappings; /* protected by lock */
+};
+
+static void *s_mmap_mem_acquire(struct aws_allocator *allocator, size_t size);
+static void s_mmap_mem_release(struct aws_allocator *allocator, void *ptr);
+static void *s_mmap_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size);
+
+static struct aws_allocator s_mmap_allocator = {
+    .mem_acquire = s_mmap_mem_acquire,
+    .mem_release = s_mmap_mem_release,
+    .mem_realloc = s_mmap_mem_realloc,
+};
+
+struct aws_allocator *aws_mmap_allocator_new(
+    struct aws_allocator *allocator,
+    const struct aws_mmap_allocator_options *options) {
+    AWS_PRECONDITION(aws_allocator_is_valid(allocator));
+
+    struct mmap_allocator *impl = NULL;
+    struct aws_allocator *mmap_allocator = NULL;
+    aws_mem_acquire_many(
+        allocator, 2, &impl, sizeof(struct mmap_allocator), &mmap_allocator, sizeof(struct aws_allocator));
+
+    if (!impl || !mmap_allocator) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*impl);
+    *mmap_allocator = s_mmap_allocator;
+    mmap_allocator->impl = impl;
+
+    impl->allocator = allocator;
+    impl->min_mmap_size = AWS_MMAP_ALLOCATOR_DEFAULT_MIN_SIZE;
+    if (options) {
+        impl->min_mmap_size = options->min_mmap_size ? options->min_mmap_size : impl->min_mmap_size;
+        impl->huge_pages = options->huge_pages;
+        impl->populate = options->populate;
+    }
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    impl->page_size = info.dwPageSize;
+    impl->large_page_size = GetLargePageMinimum();
+
+    if (aws_hash_table_init(&impl->mappings, allocator, 16, aws_hash_ptr, aws_ptr_eq, NULL, NULL)) {
+        aws_mem_release(allocator, impl);
+        return NULL;
+    }
+    aws_mutex_init(&impl->lock);
+
+    return mmap_allocator;
+}
+
+void aws_mmap_allocator_destroy(struct aws_allocator *mmap_allocator) {
+    if (!mmap_allocator) {
+        return;
+    }
+    struct mmap_allocator *impl = mmap_allocator->impl;
+    aws_mutex_clean_up(&impl->lock);
+    aws_hash_table_clean_up(&impl->mappings);
+    aws_mem_release(impl->allocator, impl);
+}
+
+/* Rounds size up to a power of 2 alignment, raising AWS_ERROR_OOM if that doesn't fit in a size_t */
+static int s_round_up(size_t size, size_t alignment, size_t *rounded) {
+    if (aws_add_size_checked(size, alignment - 1, rounded)) {
+        return aws_raise_error(AWS_ERROR_OOM);
+    }
+    *rounded &= ~(alignment - 1);
+    return AWS_OP_SUCCESS;
+}
+
+/* Returns the length of the mapping starting at ptr, or 0 if ptr came from the parent. Removes it if remove is set */
+static size_t s_find_mapping(struct mmap_allocator *impl, void *ptr, bool remove) {
+    /* mappings always start on a page, so anything else is from the parent and needn't take the lock */
+    if ((uintptr_t)ptr & (impl->page_size - 1)) {
+        return 0;
+    }
+
+    struct aws_hash_element elem = {.key = NULL, .value = NULL};
+    aws_mutex_lock(&impl->lock);
+    if (remove) {
+        aws_hash_table_remove(&impl->mappings, ptr, &elem, NULL);
+    } else {
+        struct aws_hash_element *found = NULL;
+        aws_hash_table_find(&impl->mappings, ptr, &found);
+        if (found) {
+            elem = *found;
+        }
+    }
+    aws_mutex_unlock(&impl->lock);
+
+    return (size_t)(uintptr_t)elem.value;
+}
+
+/* Maps at least size bytes, or returns NULL */
+static void *s_map(struct mmap_allocator *impl, size_t size) {
+    void *mapping = NULL;
+    size_t mapping_size = 0;
+
+    if (impl->huge_pages == AWS_MMAP_HUGE_PAGES_EXPLICIT && impl->large_page_size &&
+        !s_round_up(size, impl->large_page_size, &mapping_size)) {
+        mapping = VirtualAlloc(NULL, mapping_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    }
+
+    if (!mapping) {
+        if (s_round_up(size, impl->page_size, &mapping_size)) {
+            return NULL;
+        }
+        mapping = VirtualAlloc(NULL, mapping_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (!mapping) {
+            aws_raise_error(AWS_ERROR_OOM);
+            return NULL;
+        }
+    }
+
+    if (impl->populate) {
+        WIN32_MEMORY_RANGE_ENTRY range = {.VirtualAddress = mapping, .NumberOfBytes = mapping_size};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+
+    aws_mutex_lock(&impl->lock);
+    int result = aws_hash_table_put(&impl->mappings, mapping, (void *)(uintptr_t)mapping_size, NULL);
+    aws_mutex_unlock(&impl->lock);
+    if (result) {
+        VirtualFree(mapping, 0, MEM_RELEASE);
+        return NULL;
+    }
+
+    return mapping;
+}
+
+static void *s_mmap_mem_acquire(struct aws_allocator *allocator, size_t size) {
+    struct mmap_allocator *impl = allocator->impl;
+
+    if (size < impl->min_mmap_size) {
+        return aws_mem_acquire(impl->allocator, size);
+    }
+    return s_map(impl, size);
+}
+
+static void s_mmap_mem_release(struct aws_allocator *allocator, void *ptr) {
+    struct mmap_allocator *impl = allocator->impl;
+
+    if (s_find_mapping(impl, ptr, true)) {
+        VirtualFree(ptr, 0, MEM_RELEASE);
+    } else {
+        aws_mem_release(impl->allocator, ptr);
+    }
+}
+
+static void *s_mmap_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size) {
+    struct mmap_allocator *impl = allocator->impl;
+
+    if (!old_ptr) {
+        return s_mmap_mem_acquire(allocator, new_size);
+    }
+
+    size_t old_mapping_size = s_find_mapping(impl, old_ptr, false);
+    if (old_mapping_size) {
+        if (new_size <= old_mapping_size) {
+            return old_ptr;
+        }
+    } else if (new_size < impl->min_mmap_size) {
+        void *ptr = old_ptr;
+        if (aws_mem_realloc(impl->allocator, &ptr, old_size, new_size)) {
+            return NULL;
+        }
+        return ptr;
+    }
+
+    void *new_mem = s_mmap_mem_acquire(allocator, new_size);
+    if (!new_mem) {
+        return NULL;
+    }
+
+    memcpy(new_mem, old_ptr, old_size < new_size ? old_size : new_size);
+    s_mmap_mem_release(allocator, old_ptr);
+    return new_mem;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/common.h>
+#include <aws/common/math.h>
+#include <aws/common/system_info.h>
+
+#include <Windows.h>
+
+/* Defined in system_info.c */
+int32_t aws_common_private_numa_node_for_cpu_group(uint16_t group_idx);
+
+/*
+ * Windows counterpart of source/posix/numa_allocator.c, built on VirtualAllocExNuma. There is no way to grow an
+ * allocation in place, so realloc copies.
+ */
+struct block_header {
+    size_t mapping_size;
+};
+
+static const size_t s_header_size = (sizeof(struct block_header) + sizeof(intmax_t) - 1) & ~(sizeof(intmax_t) - 1);
+
+struct numa_allocator {
+    struct aws_allocator *allocator; /* parent, for the allocator itself */
+    size_t page_size;
+    int32_t node; /* or one of the sentinels below */
+};
+
+/* bind each allocation to the node of the calling thread */
+#define NUMA_NODE_CURRENT (-1)
+/* the group has no NUMA node to bind to */
+#define NUMA_NODE_NONE (-2)
+
+static void *s_numa_mem_acquire(struct aws_allocator *allocator, size_t size);
+static void s_numa_mem_release(struct aws_allocator *allocator, void *ptr);
+static void *s_numa_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size);
+
+static struct aws_allocator s_numa_allocator = {
+    .mem_acquire = s_numa_mem_acquire,
+    .mem_release = s_numa_mem_release,
+    .mem_realloc = s_numa_mem_realloc,
+};
+
+struct aws_allocator *aws_numa_allocator_new(struct aws_allocator *allocator, int32_t cpu_group) {
+    AWS_PRECONDITION(aws_allocator_is_valid(allocator));
+
+    struct numa_allocator *impl = NULL;
+    struct aws_allocator *numa_allocator = NULL;
+    aws_mem_acquire_many(
+        allocator, 2, &impl, sizeof(struct numa_allocator), &numa_allocator, sizeof(struct aws_allocator));
+
+    if (!impl || !numa_allocator) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*impl);
+    *numa_allocator = s_numa_allocator;
+    numa_allocator->impl = impl;
+
+    impl->allocator = allocator;
+    impl->node = NUMA_NODE_CURRENT;
+    if (cpu_group != AWS_NUMA_CPU_GROUP_CURRENT) {
+        if (cpu_group < 0 || cpu_group >= (int32_t)aws_get_cpu_group_count()) {
+            aws_mem_release(allocator, impl);
+            aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+            return NULL;
+        }
+        /* a platform without NUMA information still has group 0, which binds nothing */
+        const int32_t node = aws_common_private_numa_node_for_cpu_group((uint16_t)cpu_group);
+        impl->node = node >= 0 ? node : NUMA_NODE_NONE;
+    }
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    impl->page_size = info.dwPageSize;
+
+    return numa_allocator;
+}
+
+void aws_numa_allocator_destroy(struct aws_allocator *numa_allocator) {
+    if (!numa_allocator) {
+        return;
+    }
+    struct numa_allocator *impl = numa_allocator->impl;
+    aws_mem_release(impl->allocator, impl);
+}
+
+/* Computes the whole number of pages holding the header and size bytes, raising AWS_ERROR_OOM if it overflows */
+static int s_mapping_size(const struct numa_allocator *impl, size_t size, size_t *mapping_size) {
+    size_t padded_size = 0;
+    if (aws_add_size_checked(s_header_size, size, &padded_size) ||
+        aws_add_size_checked(padded_size, impl->page_size - 1, &padded_size)) {
+        return aws_raise_error(AWS_ERROR_OOM);
+    }
+    *mapping_size = padded_size & ~(impl->page_size - 1);
+    return AWS_OP_SUCCESS;
+}
+
+static void *s_numa_mem_acquire(struct aws_allocator *allocator, size_t size) {
+    struct numa_allocator *impl = allocator->impl;
+
+    DWORD node = NUMA_NO_PREFERRED_NODE;
+    if (impl->node >= 0) {
+        node = (DWORD)impl->node;
+    } else if (impl->node == NUMA_NODE_CURRENT) {
+        UCHAR current_node = 0;
+        if (GetNumaProcessorNode((UCHAR)GetCurrentProcessorNumber(), &current_node) && current_node != 0xFF) {
+            node = current_node;
+        }
+    }
+
+    size_t mapping_size = 0;
+    if (s_mapping_size(impl, size, &mapping_size)) {
+        return NULL;
+    }
+    void *mapping =
+        VirtualAllocExNuma(GetCurrentProcess(), NULL, mapping_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+    if (!mapping) {
+        aws_raise_error(AWS_ERROR_OOM);
+        return NULL;
+    }
+
+    struct block_header *header = mapping;
+    header->mapping_size = mapping_size;
+    return (uint8_t *)header + s_header_size;
+}
+
+static struct block_header *s_get_header(void *ptr) {
+    return (struct block_header *)((uint8_t *)ptr - s_header_size);
+}
+
+static void s_numa_mem_release(struct aws_allocator *allocator, void *ptr) {
+    (void)allocator;
+    VirtualFree(s_get_header(ptr), 0, MEM_RELEASE);
+}
+
+static void *s_numa_mem_realloc(struct aws_allocator *allocator, void *old_ptr, size_t old_size, size_t new_size) {
+    if (!old_ptr) {
+        return s_numa_mem_acquire(allocator, new_size);
+    }
+
+    struct block_header *header = s_get_header(old_ptr);
+    if (new_size <= header->mapping_size - s_header_size) {
+        return old_ptr;
+    }
+
+    void *new_mem = s_numa_mem_acquire(allocator, new_size);
+    if (!new_mem) {
+        return NULL;
+    }
+
+    memcpy(new_mem, old_ptr, old_size < new_size ? old_size : new_size);
+    s_numa_mem_release(allocator, old_ptr);
+    return new_mem;
+}
@@ -23,6 +23,65 @@ size_t aws_system_info_processor_count(void) {
     return info.dwNumberOfProcessors;
 }
 
+/* NUMA nodes map directly onto cpu groups. Only processors in the calling process's processor group are reported. */
+int32_t aws_common_private_numa_node_for_cpu_group(uint16_t group_idx) {
+    ULONG highest_node = 0;
+    if (!GetNumaHighestNodeNumber(&highest_node) || group_idx > highest_node) {
+        return -1;
+    }
+    return (int32_t)group_idx;
+}
+
+uint16_t aws_get_cpu_group_count(void) {
+    ULONG highest_node = 0;
+    if (!GetNumaHighestNodeNumber(&highest_node)) {
+        return 1;
+    }
+    return (uint16_t)(highest_node + 1);
+}
+
+static ULONGLONG s_get_group_mask(uint16_t group_idx) {
+    ULONGLONG mask = 0;
+    if (aws_common_private_numa_node_for_cpu_group(group_idx) < 0 || !GetNumaNodeProcessorMask((UCHAR)group_idx, &mask)) {
+        return 0;
+    }
+    return mask;
+}
+
+size_t aws_get_cpu_count_for_group(uint16_t group_idx) {
+    ULONGLONG mask = s_get_group_mask(group_idx);
+    size_t count = 0;
+    for (; mask; mask &= mask - 1) {
+        ++count;
+    }
+    return count;
+}
+
+void aws_get_cpu_ids_for_group(uint16_t group_idx, struct aws_cpu_info *cpu_ids_array, size_t cpu_ids_array_length) {
+    AWS_PRECONDITION(cpu_ids_array || cpu_ids_array_length == 0);
+
+    for (size_t idx = 0; idx < cpu_ids_array_length; ++idx) {
+        cpu_ids_array[idx].cpu_id = -1;
+        cpu_ids_array[idx].suspected_hyper_thread = false;
+    }
+
+    ULONGLONG mask = s_get_group_mask(group_idx);
+    size_t count = 0;
+    for (int32_t cpu = 0; cpu < 64 && count < cpu_ids_array_length; ++cpu) {
+        if (mask & (1ULL << cpu)) {
+            cpu_ids_array[count++].cpu_id = cpu;
+        }
+    }
+}
+
+uint16_t aws_get_current_cpu_group(void) {
+    UCHAR node = 0;
+    if (!GetNumaProcessorNode((UCHAR)GetCurrentProcessorNumber(), &node) || node == 0xFF) {
+        return 0;
+    }
+    return node;
+}
+
 bool aws_is_debugger_present(void) {
     return IsDebuggerPresent();
 }
@@ -135,3 +194,48 @@ done:
         FreeLibrary(dbghelp);
     }
 }
+
+size_t aws_backtrace(void **stack_frames, size_t num_frames) {
+    /* skip this function's frame */
+    return (size_t)CaptureStackBackTrace(1, (ULONG)num_frames, stack_frames, NULL);
+}
+
+char **aws_backtrace_symbols(void *const *stack_frames, size_t stack_depth) {
+    enum { SYMBOL_LEN = 256 };
+    /* pointers and strings live in a single allocation, so a single free() releases everything */
+    char **symbols = malloc(stack_depth * (sizeof(char *) + SYMBOL_LEN));
+    if (!symbols) {
+        return NULL;
+    }
+
+    SymFromAddr_fn *p_SymFromAddr = NULL;
+    HMODULE dbghelp = LoadLibraryA("DbgHelp.dll");
+    if (dbghelp) {
+        SymInitialize_fn *p_SymInitialize = (SymInitialize_fn *)GetProcAddress(dbghelp, "SymInitialize");
+        p_SymFromAddr = (SymFromAddr_fn *)GetProcAddress(dbghelp, "SymFromAddr");
+        if (p_SymInitialize) {
+            p_SymInitialize(GetCurrentProcess(), NULL, TRUE);
+        }
+    }
+
+    char *strings = (char *)(symbols + stack_depth);
+    for (size_t i = 0; i < stack_depth; ++i) {
+        symbols[i] = strings + i * SYMBOL_LEN;
+        uintptr_t address = (uintptr_t)stack_frames[i];
+        struct win_symbol_data sym_info;
+        AWS_ZERO_STRUCT(sym_info);
+        sym_info.sym_info.MaxNameLen = sizeof(sym_info.symbol_name);
+        sym_info.sym_info.SizeOfStruct = sizeof(struct _SYMBOL_INFO);
+        DWORD64 displacement = 0;
+        if (p_SymFromAddr && p_SymFromAddr(GetCurrentProcess(), address, &displacement, &sym_info.sym_info)) {
+            snprintf(symbols[i], SYMBOL_LEN, "%s+0x%llX [0x%p]", sym_info.sym_info.Name, displacement, (void *)address);
+        } else {
+            snprintf(symbols[i], SYMBOL_LEN, "[0x%p]", (void *)address);
+        }
+    }
+
+    if (dbghelp) {
+        FreeLibrary(dbghelp);
+    }
+    return symbols;
+}
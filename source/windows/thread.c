@@ -174,3 +174,15 @@ int aws_thread_current_at_exit(aws_thread_atexit_fn *callback, void *user_data)
     tl_wrapper->atexit = cb;
     return AWS_OP_SUCCESS;
 }
+
+int aws_thread_current_bind_to_cpu_group(uint16_t cpu_group) {
+    ULONGLONG mask = 0;
+    if (!GetNumaNodeProcessorMask((UCHAR)cpu_group, &mask) || mask == 0) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    if (!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)mask)) {
+        return aws_raise_error(AWS_ERROR_SYS_CALL_FAILURE);
+    }
+    return AWS_OP_SUCCESS;
+}
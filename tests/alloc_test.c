@@ -15,13 +15,21 @@
 
 #include <aws/common/common.h>
 
+#include <aws/common/array_list.h>
 #include <aws/common/assert.h>
+#include <aws/common/byte_buf.h>
+#include <aws/common/hash_table.h>
+#include <aws/common/string.h>
+#include <aws/common/system_info.h>
+#include <aws/common/thread.h>
 #include <aws/testing/aws_test_harness.h>
 
 #ifdef __MACH__
 #    include <CoreFoundation/CoreFoundation.h>
 #endif
 
+#include "benchmark_test_utilities.h"
+
 static void *s_test_alloc_acquire(struct aws_allocator *allocator, size_t size) {
     (void)allocator;
     return (size > 0) ? malloc(size) : NULL;
@@ -67,3 +75,868 @@ static int s_test_alloc_nothing_fn(struct aws_allocator *allocator, void *ctx) {
     ASSERT_NULL(p);
     return 0;
 }
+
+static int s_sba_exercise(struct aws_allocator *sba) {
+    /* fill several pages of every bin, plus some pass-through allocs, and make sure nothing overlaps */
+    enum { NUM_ALLOCS = 2048 };
+    void **allocs = aws_mem_calloc(aws_default_allocator(), NUM_ALLOCS, sizeof(void *));
+    ASSERT_NOT_NULL(allocs);
+
+    for (size_t idx = 0; idx < NUM_ALLOCS; ++idx) {
+        size_t size = (idx % 1024) + 1;
+        allocs[idx] = aws_mem_acquire(sba, size);
+        ASSERT_NOT_NULL(allocs[idx]);
+        memset(allocs[idx], (int)(idx & 0xff), size);
+    }
+
+    for (size_t idx = 0; idx < NUM_ALLOCS; ++idx) {
+        size_t size = (idx % 1024) + 1;
+        uint8_t *bytes = allocs[idx];
+        for (size_t byte = 0; byte < size; ++byte) {
+            ASSERT_UINT_EQUALS(idx & 0xff, bytes[byte]);
+        }
+    }
+
+    /* release every other one, then re-acquire to exercise the free lists */
+    for (size_t idx = 0; idx < NUM_ALLOCS; idx += 2) {
+        aws_mem_release(sba, allocs[idx]);
+    }
+    for (size_t idx = 0; idx < NUM_ALLOCS; idx += 2) {
+        allocs[idx] = aws_mem_acquire(sba, (idx % 1024) + 1);
+        ASSERT_NOT_NULL(allocs[idx]);
+    }
+    for (size_t idx = 0; idx < NUM_ALLOCS; ++idx) {
+        aws_mem_release(sba, allocs[idx]);
+    }
+
+    aws_mem_release(aws_default_allocator(), allocs);
+    return 0;
+}
+
+AWS_TEST_CASE(sba_acquire_release, s_sba_acquire_release)
+static int s_sba_acquire_release(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_allocator *sba = aws_small_block_allocator_new(allocator, false);
+    ASSERT_NOT_NULL(sba);
+    ASSERT_SUCCESS(s_sba_exercise(sba));
+    aws_small_block_allocator_destroy(sba);
+
+    sba = aws_small_block_allocator_new(allocator, true);
+    ASSERT_NOT_NULL(sba);
+    ASSERT_SUCCESS(s_sba_exercise(sba));
+    aws_small_block_allocator_destroy(sba);
+
+    return 0;
+}
+
+AWS_TEST_CASE(sba_realloc, s_sba_realloc)
+static int s_sba_realloc(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_allocator *sba = aws_small_block_allocator_new(allocator, false);
+    ASSERT_NOT_NULL(sba);
+
+    uint8_t *ptr = aws_mem_acquire(sba, 10);
+    ASSERT_NOT_NULL(ptr);
+    memset(ptr, 0xab, 10);
+
+    /* growing within the same size class should not move the allocation */
+    void *orig = ptr;
+    ASSERT_SUCCESS(aws_mem_realloc(sba, (void **)&ptr, 10, 16));
+    ASSERT_PTR_EQUALS(orig, ptr);
+
+    /* growing through the bins and out to the parent must preserve contents */
+    const size_t sizes[] = {100, 512, 4000, 8000, 300};
+    size_t old_size = 16;
+    for (size_t idx = 0; idx < AWS_ARRAY_SIZE(sizes); ++idx) {
+        ASSERT_SUCCESS(aws_mem_realloc(sba, (void **)&ptr, old_size, sizes[idx]));
+        ASSERT_NOT_NULL(ptr);
+        for (size_t byte = 0; byte < 10; ++byte) {
+            ASSERT_UINT_EQUALS(0xab, ptr[byte]);
+        }
+        old_size = sizes[idx];
+    }
+
+    uint8_t *zeroed = aws_mem_calloc(sba, 7, 9);
+    ASSERT_NOT_NULL(zeroed);
+    for (size_t byte = 0; byte < 63; ++byte) {
+        ASSERT_UINT_EQUALS(0, zeroed[byte]);
+    }
+
+    aws_mem_release(sba, zeroed);
+    aws_mem_release(sba, ptr);
+    aws_small_block_allocator_destroy(sba);
+    return 0;
+}
+
+AWS_TEST_CASE(sba_destroy_releases_outstanding, s_sba_destroy_releases_outstanding)
+static int s_sba_destroy_releases_outstanding(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_allocator *sba = aws_small_block_allocator_new(allocator, true);
+    ASSERT_NOT_NULL(sba);
+
+    /* small allocs still outstanding at destroy go back to the parent with their pages */
+    for (size_t idx = 0; idx < 1000; ++idx) {
+        ASSERT_NOT_NULL(aws_mem_acquire(sba, (idx % 512) + 1));
+    }
+
+    /* the test harness will fail the test if anything leaked from allocator */
+    aws_small_block_allocator_destroy(sba);
+    return 0;
+}
+
+static long s_alloc_churn(struct aws_allocator *allocator, void **slots, size_t slot_count, size_t iterations) {
+    long start = benchmark_timestamp_us();
+    uint64_t rng = 0x2545F4914F6CDD1DULL;
+    for (size_t iter = 0; iter < iterations; ++iter) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        size_t slot = (size_t)(rng % slot_count);
+        if (slots[slot]) {
+            aws_mem_release(allocator, slots[slot]);
+            slots[slot] = NULL;
+        } else {
+            slots[slot] = aws_mem_acquire(allocator, (size_t)((rng >> 32) % 256) + 1);
+        }
+    }
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        if (slots[slot]) {
+            aws_mem_release(allocator, slots[slot]);
+            slots[slot] = NULL;
+        }
+    }
+    return benchmark_timestamp_us() - start;
+}
+
+AWS_TEST_CASE(sba_churn_benchmark, s_sba_churn_benchmark)
+static int s_sba_churn_benchmark(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    enum { SLOT_COUNT = 4096, ITERATIONS = 1000000 };
+    void **slots = aws_mem_calloc(allocator, SLOT_COUNT, sizeof(void *));
+    ASSERT_NOT_NULL(slots);
+
+    long default_elapsed = s_alloc_churn(aws_default_allocator(), slots, SLOT_COUNT, ITERATIONS);
+
+    struct aws_allocator *sba = aws_small_block_allocator_new(aws_default_allocator(), false);
+    ASSERT_NOT_NULL(sba);
+    long sba_elapsed = s_alloc_churn(sba, slots, SLOT_COUNT, ITERATIONS);
+    aws_small_block_allocator_destroy(sba);
+
+    sba = aws_small_block_allocator_new(aws_default_allocator(), true);
+    ASSERT_NOT_NULL(sba);
+    long sba_mt_elapsed = s_alloc_churn(sba, slots, SLOT_COUNT, ITERATIONS);
+    aws_small_block_allocator_destroy(sba);
+
+    aws_mem_release(allocator, slots);
+
+    printf("default allocator elapsed=%ld us\n", default_elapsed);
+    printf("small block allocator elapsed=%ld us\n", sba_elapsed);
+    printf("small block allocator (multi-threaded) elapsed=%ld us\n", sba_mt_elapsed);
+    return 0;
+}
+
+AWS_TEST_CASE(thread_cache_realloc, s_thread_cache_realloc)
+static int s_thread_cache_realloc(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    /* the main thread isn't an aws_thread, so this exercises the path which bypasses the thread caches */
+    struct aws_allocator *tc_alloc = aws_thread_cache_allocator_new(allocator);
+    ASSERT_NOT_NULL(tc_alloc);
+
+    uint8_t *ptr = aws_mem_acquire(tc_alloc, 10);
+    ASSERT_NOT_NULL(ptr);
+    memset(ptr, 0xab, 10);
+
+    void *orig = ptr;
+    ASSERT_SUCCESS(aws_mem_realloc(tc_alloc, (void **)&ptr, 10, 16));
+    ASSERT_PTR_EQUALS(orig, ptr);
+
+    const size_t sizes[] = {100, 1024, 4000, 8000, 300};
+    size_t old_size = 16;
+    for (size_t idx = 0; idx < AWS_ARRAY_SIZE(sizes); ++idx) {
+        ASSERT_SUCCESS(aws_mem_realloc(tc_alloc, (void **)&ptr, old_size, sizes[idx]));
+        ASSERT_NOT_NULL(ptr);
+        for (size_t byte = 0; byte < 10; ++byte) {
+            ASSERT_UINT_EQUALS(0xab, ptr[byte]);
+        }
+        old_size = sizes[idx];
+    }
+
+    ASSERT_SUCCESS(s_sba_exercise(tc_alloc));
+
+    aws_mem_release(tc_alloc, ptr);
+    aws_thread_cache_allocator_destroy(tc_alloc);
+    return 0;
+}
+
+enum { ALLOC_THREAD_COUNT = 4, ALLOC_THREAD_SLOTS = 1024 };
+
+struct alloc_thread_data {
+    struct aws_allocator *allocator;
+    void *foreign; /* allocated by the main thread, released by the worker */
+    size_t iterations;
+    void *slots[ALLOC_THREAD_SLOTS];
+};
+
+static void s_alloc_thread_churn(void *arg) {
+    struct alloc_thread_data *data = arg;
+    aws_mem_release(data->allocator, data->foreign);
+    s_alloc_churn(data->allocator, data->slots, ALLOC_THREAD_SLOTS, data->iterations);
+}
+
+/* Runs s_alloc_churn on ALLOC_THREAD_COUNT threads at once, returns the wall time in us */
+static long s_alloc_threaded_churn(
+    struct aws_allocator *test_allocator,
+    struct aws_allocator *allocator,
+    size_t iterations) {
+    struct aws_thread threads[ALLOC_THREAD_COUNT];
+    struct alloc_thread_data *data =
+        aws_mem_calloc(test_allocator, ALLOC_THREAD_COUNT, sizeof(struct alloc_thread_data));
+    AWS_FATAL_ASSERT(data);
+
+    long start = benchmark_timestamp_us();
+    for (size_t idx = 0; idx < ALLOC_THREAD_COUNT; ++idx) {
+        data[idx].allocator = allocator;
+        data[idx].iterations = iterations;
+        data[idx].foreign = aws_mem_acquire(allocator, 24);
+        AWS_FATAL_ASSERT(data[idx].foreign);
+        AWS_FATAL_ASSERT(aws_thread_init(&threads[idx], test_allocator) == AWS_OP_SUCCESS);
+        AWS_FATAL_ASSERT(aws_thread_launch(&threads[idx], s_alloc_thread_churn, &data[idx], NULL) == AWS_OP_SUCCESS);
+    }
+    for (size_t idx = 0; idx < ALLOC_THREAD_COUNT; ++idx) {
+        aws_thread_join(&threads[idx]);
+        aws_thread_clean_up(&threads[idx]);
+    }
+    long elapsed = benchmark_timestamp_us() - start;
+
+    aws_mem_release(test_allocator, data);
+    return elapsed;
+}
+
+AWS_TEST_CASE(thread_cache_threaded, s_thread_cache_threaded)
+static int s_thread_cache_threaded(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_allocator *tc_alloc = aws_thread_cache_allocator_new(allocator);
+    ASSERT_NOT_NULL(tc_alloc);
+
+    /* run twice so the second round re-uses blocks drained by the first round's threads */
+    s_alloc_threaded_churn(allocator, tc_alloc, 50000);
+    s_alloc_threaded_churn(allocator, tc_alloc, 50000);
+
+    /* the test harness will fail the test if anything leaked from allocator */
+    aws_thread_cache_allocator_destroy(tc_alloc);
+    return 0;
+}
+
+AWS_TEST_CASE(thread_cache_churn_benchmark, s_thread_cache_churn_benchmark)
+static int s_thread_cache_churn_benchmark(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+
+    const size_t iterations = 500000;
+    long default_elapsed = s_alloc_threaded_churn(allocator, aws_default_allocator(), iterations);
+
+    struct aws_allocator *sba = aws_small_block_allocator_new(allocator, true);
+    ASSERT_NOT_NULL(sba);
+    long sba_elapsed = s_alloc_threaded_churn(allocator, sba, iterations);
+    aws_small_block_allocator_destroy(sba);
+
+    struct aws_allocator *tc_alloc = aws_thread_cache_allocator_new(allocator);
+    ASSERT_NOT_NULL(tc_alloc);
+    long tc_elapsed = s_alloc_threaded_churn(allocator, tc_alloc, iterations);
+    aws_thread_cache_allocator_destroy(tc_alloc);
+
+    printf("default allocator, %d threads elapsed=%ld us\n", ALLOC_THREAD_COUNT, default_elapsed);
+    printf("small block allocator, %d threads elapsed=%ld us\n", ALLOC_THREAD_COUNT, sba_elapsed);
+    printf("thread cache allocator, %d threads elapsed=%ld us\n", ALLOC_THREAD_COUNT, tc_elapsed);
+    return 0;
+}
+
+struct counting_allocator_impl {
+    struct aws_allocator *parent;
+    size_t acquires;
+    size_t releases;
+    size_t acquire_limit; /* acquires fail once this many have been made, 0 means never */
+};
+
+static void *s_counting_acquire(struct aws_allocator *allocator, size_t size) {
+    struct counting_allocator_impl *impl = allocator->impl;
+    if (impl->acquire_limit && impl->acquires == impl->acquire_limit) {
+        return NULL;
+    }
+    ++impl->acquires;
+    return aws_mem_acquire(impl->parent, size);
+}
+
+static void s_counting_release(struct aws_allocator *allocator, void *ptr) {
+    struct counting_allocator_impl *impl = allocator->impl;
+    ++impl->releases;
+    aws_mem_release(impl->parent, ptr);
+}
+
+AWS_TEST_CASE(arena_allocator_acquire_reset, s_arena_allocator_acquire_reset)
+static int s_arena_allocator_acquire_reset(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct counting_allocator_impl counts = {.parent = allocator, .acquires = 0};
+    struct aws_allocator counting = {
+        .mem_acquire = s_counting_acquire, .mem_release = s_counting_release, .impl = &counts};
+
+    uint8_t stack_storage[256];
+    struct aws_arena_allocator arena;
+    ASSERT_SUCCESS(aws_arena_allocator_init(&arena, &counting, stack_storage, sizeof(stack_storage), 1024));
+
+    /* small allocations come out of the stack storage first */
+    void *first = aws_mem_acquire(&arena.allocator, 10);
+    ASSERT_TRUE((uint8_t *)first >= stack_storage && (uint8_t *)first < stack_storage + sizeof(stack_storage));
+    ASSERT_UINT_EQUALS(0, (uintptr_t)first % sizeof(intmax_t));
+    ASSERT_UINT_EQUALS(0, counts.acquires);
+
+    for (int round = 0; round < 3; ++round) {
+        /* spill into chunks, including one larger than the chunk size */
+        for (size_t idx = 0; idx < 64; ++idx) {
+            uint8_t *mem = aws_mem_acquire(&arena.allocator, 100);
+            ASSERT_NOT_NULL(mem);
+            memset(mem, (int)idx, 100);
+            aws_mem_release(&arena.allocator, NULL);
+        }
+        ASSERT_NOT_NULL(aws_mem_acquire(&arena.allocator, 5000));
+
+        /* after the first round, everything is served from retained chunks */
+        if (round == 0) {
+            ASSERT_TRUE(counts.acquires > 0);
+        }
+        size_t warm_acquires = counts.acquires;
+        aws_arena_allocator_reset(&arena);
+        ASSERT_PTR_EQUALS(first, aws_mem_acquire(&arena.allocator, 10));
+        if (round > 0) {
+            ASSERT_UINT_EQUALS(warm_acquires, counts.acquires);
+        }
+    }
+
+    aws_arena_allocator_clean_up(&arena);
+    return 0;
+}
+
+AWS_TEST_CASE(arena_allocator_realloc, s_arena_allocator_realloc)
+static int s_arena_allocator_realloc(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_arena_allocator arena;
+    ASSERT_SUCCESS(aws_arena_allocator_init(&arena, allocator, NULL, 0, 0));
+
+    uint8_t *ptr = aws_mem_acquire(&arena.allocator, 16);
+    ASSERT_NOT_NULL(ptr);
+    memset(ptr, 0xab, 16);
+
+    /* most recent allocation grows in place */
+    void *orig = ptr;
+    ASSERT_SUCCESS(aws_mem_realloc(&arena.allocator, (void **)&ptr, 16, 1000));
+    ASSERT_PTR_EQUALS(orig, ptr);
+
+    /* once something else has been allocated, it has to move */
+    void *other = aws_mem_acquire(&arena.allocator, 8);
+    ASSERT_NOT_NULL(other);
+    ASSERT_SUCCESS(aws_mem_realloc(&arena.allocator, (void **)&ptr, 1000, 2000));
+    ASSERT_FALSE(orig == ptr);
+    for (size_t byte = 0; byte < 16; ++byte) {
+        ASSERT_UINT_EQUALS(0xab, ptr[byte]);
+    }
+
+    /* outgrowing the chunk moves it to a new chunk */
+    ASSERT_SUCCESS(aws_mem_realloc(&arena.allocator, (void **)&ptr, 2000, 3 * AWS_ARENA_DEFAULT_CHUNK_SIZE));
+    for (size_t byte = 0; byte < 16; ++byte) {
+        ASSERT_UINT_EQUALS(0xab, ptr[byte]);
+    }
+
+    /* releasing the most recent allocation gives the space back */
+    void *last = aws_mem_acquire(&arena.allocator, 32);
+    aws_mem_release(&arena.allocator, last);
+    ASSERT_PTR_EQUALS(last, aws_mem_acquire(&arena.allocator, 32));
+
+    /* sizes which would wrap once rounded up or given a chunk header fail cleanly, in place or not */
+    ASSERT_NULL(aws_mem_acquire(&arena.allocator, SIZE_MAX - 1));
+    ASSERT_INT_EQUALS(AWS_ERROR_OOM, aws_last_error());
+    ASSERT_NULL(aws_mem_acquire(&arena.allocator, SIZE_MAX - 8));
+    ASSERT_INT_EQUALS(AWS_ERROR_OOM, aws_last_error());
+    last = aws_mem_acquire(&arena.allocator, 32);
+    ASSERT_ERROR(AWS_ERROR_OOM, aws_mem_realloc(&arena.allocator, &last, 32, SIZE_MAX - 1));
+    ASSERT_NOT_NULL(last);
+
+    /* the test harness will fail the test if the chunks leaked */
+    aws_arena_allocator_clean_up(&arena);
+    return 0;
+}
+
+/* Stores the size of each allocation in front of it, and checks the size passed to mem_release_sized against it */
+struct sized_checking_allocator_impl {
+    struct aws_allocator *parent;
+    size_t sized_releases;
+    size_t unsized_releases;
+    size_t mismatches;
+};
+
+static void *s_sized_checking_acquire(struct aws_allocator *allocator, size_t size) {
+    struct sized_checking_allocator_impl *impl = allocator->impl;
+    size_t *mem = aws_mem_acquire(impl->parent, sizeof(intmax_t) + size);
+    if (!mem) {
+        return NULL;
+    }
+    *mem = size;
+    return (uint8_t *)mem + sizeof(intmax_t);
+}
+
+static void s_sized_checking_release(struct aws_allocator *allocator, void *ptr) {
+    struct sized_checking_allocator_impl *impl = allocator->impl;
+    ++impl->unsized_releases;
+    aws_mem_release(impl->parent, (uint8_t *)ptr - sizeof(intmax_t));
+}
+
+static void s_sized_checking_release_sized(struct aws_allocator *allocator, void *ptr, size_t size) {
+    struct sized_checking_allocator_impl *impl = allocator->impl;
+    size_t *mem = (size_t *)((uint8_t *)ptr - sizeof(intmax_t));
+    ++impl->sized_releases;
+    if (*mem != size) {
+        ++impl->mismatches;
+    }
+    aws_mem_release(impl->parent, mem);
+}
+
+static void *s_sized_checking_realloc(struct aws_allocator *allocator, void *ptr, size_t oldsize, size_t newsize) {
+    void *new_mem = s_sized_checking_acquire(allocator, newsize);
+    if (new_mem && ptr) {
+        memcpy(new_mem, ptr, oldsize < newsize ? oldsize : newsize);
+        s_sized_checking_release_sized(allocator, ptr, oldsize);
+    }
+    return new_mem;
+}
+
+AWS_TEST_CASE(mem_release_sized, s_mem_release_sized)
+static int s_mem_release_sized(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct sized_checking_allocator_impl impl = {.parent = allocator};
+    struct aws_allocator sized = {
+        .mem_acquire = s_sized_checking_acquire,
+        .mem_release = s_sized_checking_release,
+        .mem_realloc = s_sized_checking_realloc,
+        .mem_release_sized = s_sized_checking_release_sized,
+        .impl = &impl,
+    };
+
+    /* containers which know the size of their storage release it through the sized path */
+    struct aws_byte_buf buf;
+    ASSERT_SUCCESS(aws_byte_buf_init(&buf, &sized, 4));
+    struct aws_byte_cursor data = aws_byte_cursor_from_c_str("the quick brown fox jumps over the lazy dog");
+    ASSERT_SUCCESS(aws_byte_buf_append_dynamic(&buf, &data));
+    ASSERT_SUCCESS(aws_byte_buf_reserve(&buf, 200));
+    aws_byte_buf_clean_up(&buf);
+
+    struct aws_string *str = aws_string_new_from_c_str(&sized, "sized");
+    ASSERT_NOT_NULL(str);
+    aws_string_destroy(str);
+
+    struct aws_array_list list;
+    ASSERT_SUCCESS(aws_array_list_init_dynamic(&list, &sized, 1, sizeof(size_t)));
+    for (size_t idx = 0; idx < 100; ++idx) {
+        ASSERT_SUCCESS(aws_array_list_push_back(&list, &idx));
+    }
+    aws_array_list_pop_back(&list);
+    ASSERT_SUCCESS(aws_array_list_shrink_to_fit(&list));
+    aws_array_list_clean_up(&list);
+
+    struct aws_hash_table table;
+    ASSERT_SUCCESS(aws_hash_table_init(&table, &sized, 4, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    for (uintptr_t idx = 1; idx < 100; ++idx) {
+        ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)idx, NULL, NULL));
+    }
+    aws_hash_table_clean_up(&table);
+
+    ASSERT_TRUE(impl.sized_releases > 0);
+    ASSERT_UINT_EQUALS(0, impl.unsized_releases);
+    ASSERT_UINT_EQUALS(0, impl.mismatches);
+
+    /* allocators without mem_release_sized fall back to mem_release */
+    sized.mem_release_sized = NULL;
+    aws_mem_release_sized(&sized, aws_mem_acquire(&sized, 16), 16);
+    ASSERT_UINT_EQUALS(1, impl.unsized_releases);
+
+    /* and the small block allocator takes it either way */
+    struct aws_allocator *sba = aws_small_block_allocator_new(allocator, false);
+    ASSERT_NOT_NULL(sba);
+    aws_mem_release_sized(sba, aws_mem_acquire(sba, 16), 16);
+    aws_mem_release_sized(sba, aws_mem_acquire(sba, 5000), 5000);
+    ASSERT_SUCCESS(s_sba_exercise(sba));
+    aws_small_block_allocator_destroy(sba);
+
+    return 0;
+}
+
+static int s_mmap_allocator_exercise(struct aws_allocator *mmap_alloc) {
+    /* below and above the mmap threshold */
+    const size_t sizes[] = {1, 100, 4096, AWS_MMAP_ALLOCATOR_DEFAULT_MIN_SIZE, 3 * 1024 * 1024 + 7};
+    for (size_t idx = 0; idx < AWS_ARRAY_SIZE(sizes); ++idx) {
+        uint8_t *mem = aws_mem_acquire(mmap_alloc, sizes[idx]);
+        ASSERT_NOT_NULL(mem);
+        ASSERT_UINT_EQUALS(0, (uintptr_t)mem % sizeof(intmax_t));
+        if (sizes[idx] >= AWS_MMAP_ALLOCATOR_DEFAULT_MIN_SIZE) {
+            /* mappings are handed out whole, so they start on a page */
+            ASSERT_UINT_EQUALS(0, (uintptr_t)mem % 4096);
+        }
+        memset(mem, 0x5a, sizes[idx]);
+        ASSERT_UINT_EQUALS(0x5a, mem[sizes[idx] - 1]);
+        aws_mem_release(mmap_alloc, mem);
+    }
+
+    /* grow a buffer from small, through the threshold, to a megabyte and back down */
+    struct aws_byte_buf buf;
+    ASSERT_SUCCESS(aws_byte_buf_init(&buf, mmap_alloc, 16));
+    struct aws_byte_cursor chunk = aws_byte_cursor_from_c_str("0123456789abcdef");
+    for (size_t idx = 0; idx < (1024 * 1024) / chunk.len; ++idx) {
+        ASSERT_SUCCESS(aws_byte_buf_reserve(&buf, buf.len + chunk.len));
+        ASSERT_TRUE(aws_byte_buf_write_from_whole_cursor(&buf, chunk));
+    }
+    for (size_t idx = 0; idx < buf.len; idx += 4099) {
+        ASSERT_UINT_EQUALS(chunk.ptr[idx % chunk.len], buf.buffer[idx]);
+    }
+    ASSERT_SUCCESS(aws_mem_realloc(mmap_alloc, (void **)&buf.buffer, buf.capacity, 64));
+    buf.capacity = 64;
+    buf.len = 64;
+    for (size_t idx = 0; idx < buf.len; ++idx) {
+        ASSERT_UINT_EQUALS(chunk.ptr[idx % chunk.len], buf.buffer[idx]);
+    }
+    aws_byte_buf_clean_up(&buf);
+
+    return 0;
+}
+
+AWS_TEST_CASE(mmap_allocator_acquire_release, s_mmap_allocator_acquire_release)
+static int s_mmap_allocator_acquire_release(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_mmap_allocator_options options_list[] = {
+        {.min_mmap_size = 0},
+        {.min_mmap_size = 4096, .populate = true},
+        {.huge_pages = AWS_MMAP_HUGE_PAGES_TRANSPARENT},
+        /* falls back to regular pages if the huge page pool is empty, as it usually is */
+        {.huge_pages = AWS_MMAP_HUGE_PAGES_EXPLICIT, .populate = true},
+    };
+
+    for (size_t idx = 0; idx < AWS_ARRAY_SIZE(options_list); ++idx) {
+        struct aws_allocator *mmap_alloc = aws_mmap_allocator_new(allocator, &options_list[idx]);
+        ASSERT_NOT_NULL(mmap_alloc);
+        ASSERT_SUCCESS(s_mmap_allocator_exercise(mmap_alloc));
+        aws_mmap_allocator_destroy(mmap_alloc);
+    }
+
+    struct aws_allocator *mmap_alloc = aws_mmap_allocator_new(allocator, NULL);
+    ASSERT_NOT_NULL(mmap_alloc);
+    ASSERT_SUCCESS(s_mmap_allocator_exercise(mmap_alloc));
+
+    /* sizes which would wrap once rounded up to a page, or can't be mapped, fail cleanly */
+    ASSERT_NULL(aws_mem_acquire(mmap_alloc, SIZE_MAX - 1));
+    ASSERT_INT_EQUALS(AWS_ERROR_OOM, aws_last_error());
+    ASSERT_NULL(aws_mem_acquire(mmap_alloc, SIZE_MAX - 4096));
+    ASSERT_INT_EQUALS(AWS_ERROR_OOM, aws_last_error());
+    void *mem = aws_mem_acquire(mmap_alloc, AWS_MMAP_ALLOCATOR_DEFAULT_MIN_SIZE);
+    ASSERT_NOT_NULL(mem);
+    ASSERT_ERROR(AWS_ERROR_OOM, aws_mem_realloc(mmap_alloc, &mem, AWS_MMAP_ALLOCATOR_DEFAULT_MIN_SIZE, SIZE_MAX - 1));
+    ASSERT_NOT_NULL(mem);
+    aws_mem_release(mmap_alloc, mem);
+    aws_mmap_allocator_destroy(mmap_alloc);
+
+    return 0;
+}
+
+/* Doubles a buffer up to 64MB, touching it all each time, like a growing aws_byte_buf */
+static long s_buffer_growth(struct aws_allocator *allocator) {
+    long start = benchmark_timestamp_us();
+    struct aws_byte_buf buf;
+    AWS_FATAL_ASSERT(aws_byte_buf_init(&buf, allocator, 4096) == AWS_OP_SUCCESS);
+    while (buf.capacity < 64 * 1024 * 1024) {
+        AWS_FATAL_ASSERT(aws_byte_buf_reserve(&buf, buf.capacity * 2) == AWS_OP_SUCCESS);
+        memset(buf.buffer + buf.len, 1, buf.capacity - buf.len);
+        buf.len = buf.capacity;
+    }
+    aws_byte_buf_clean_up(&buf);
+    return benchmark_timestamp_us() - start;
+}
+
+AWS_TEST_CASE(mmap_allocator_growth_benchmark, s_mmap_allocator_growth_benchmark)
+static int s_mmap_allocator_growth_benchmark(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+
+    long default_elapsed = s_buffer_growth(allocator);
+
+    struct aws_allocator *mmap_alloc = aws_mmap_allocator_new(allocator, NULL);
+    ASSERT_NOT_NULL(mmap_alloc);
+    long mmap_elapsed = s_buffer_growth(mmap_alloc);
+    aws_mmap_allocator_destroy(mmap_alloc);
+
+    struct aws_mmap_allocator_options options = {.huge_pages = AWS_MMAP_HUGE_PAGES_TRANSPARENT};
+    mmap_alloc = aws_mmap_allocator_new(allocator, &options);
+    ASSERT_NOT_NULL(mmap_alloc);
+    long thp_elapsed = s_buffer_growth(mmap_alloc);
+    aws_mmap_allocator_destroy(mmap_alloc);
+
+    printf("default allocator elapsed=%ld us\n", default_elapsed);
+    printf("mmap allocator elapsed=%ld us\n", mmap_elapsed);
+    printf("mmap allocator (transparent huge pages) elapsed=%ld us\n", thp_elapsed);
+    return 0;
+}
+
+static int s_numa_exercise(struct aws_allocator *numa_alloc) {
+    uint8_t *small = aws_mem_acquire(numa_alloc, 64);
+    ASSERT_NOT_NULL(small);
+    memset(small, 0xab, 64);
+
+    uint8_t *large = aws_mem_acquire(numa_alloc, 3 * 4096 + 17);
+    ASSERT_NOT_NULL(large);
+    memset(large, 0xcd, 3 * 4096 + 17);
+
+    /* grow past the end of the mapping, the contents must survive */
+    void *grown = large;
+    ASSERT_SUCCESS(aws_mem_realloc(numa_alloc, &grown, 3 * 4096 + 17, 64 * 4096));
+    large = grown;
+    for (size_t idx = 0; idx < 3 * 4096 + 17; ++idx) {
+        ASSERT_UINT_EQUALS(0xcd, large[idx]);
+    }
+    memset(large, 0xef, 64 * 4096);
+
+    for (size_t idx = 0; idx < 64; ++idx) {
+        ASSERT_UINT_EQUALS(0xab, small[idx]);
+    }
+
+    aws_mem_release(numa_alloc, large);
+    aws_mem_release(numa_alloc, small);
+    return 0;
+}
+
+AWS_TEST_CASE(numa_allocator_acquire_release, s_numa_allocator_acquire_release)
+static int s_numa_allocator_acquire_release(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    for (uint16_t group = 0; group < aws_get_cpu_group_count(); ++group) {
+        struct aws_allocator *numa_alloc = aws_numa_allocator_new(allocator, group);
+        ASSERT_NOT_NULL(numa_alloc);
+        ASSERT_SUCCESS(s_numa_exercise(numa_alloc));
+        aws_numa_allocator_destroy(numa_alloc);
+    }
+
+    struct aws_allocator *numa_alloc = aws_numa_allocator_new(allocator, AWS_NUMA_CPU_GROUP_CURRENT);
+    ASSERT_NOT_NULL(numa_alloc);
+    ASSERT_SUCCESS(s_numa_exercise(numa_alloc));
+    ASSERT_NULL(aws_mem_acquire(numa_alloc, SIZE_MAX - 1));
+    ASSERT_INT_EQUALS(AWS_ERROR_OOM, aws_last_error());
+
+    /* small objects are meant to come from a small block allocator layered on top */
+    struct aws_allocator *sba = aws_small_block_allocator_new(numa_alloc, false);
+    ASSERT_NOT_NULL(sba);
+    ASSERT_SUCCESS(s_sba_exercise(sba));
+    aws_small_block_allocator_destroy(sba);
+
+    aws_numa_allocator_destroy(numa_alloc);
+
+    ASSERT_NULL(aws_numa_allocator_new(allocator, -2));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_ARGUMENT, aws_last_error());
+    ASSERT_NULL(aws_numa_allocator_new(allocator, aws_get_cpu_group_count()));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_ARGUMENT, aws_last_error());
+    return 0;
+}
+
+static int s_batch_exercise(struct aws_allocator *alloc, size_t size) {
+    enum { BATCH_COUNT = 1000 };
+    void **ptrs = aws_mem_calloc(aws_default_allocator(), BATCH_COUNT, sizeof(void *));
+    ASSERT_NOT_NULL(ptrs);
+
+    ASSERT_SUCCESS(aws_mem_acquire_batch(alloc, size, BATCH_COUNT, ptrs));
+    for (size_t idx = 0; idx < BATCH_COUNT; ++idx) {
+        ASSERT_NOT_NULL(ptrs[idx]);
+        memset(ptrs[idx], (int)(idx & 0xff), size);
+    }
+    /* nothing may overlap */
+    for (size_t idx = 0; idx < BATCH_COUNT; ++idx) {
+        const uint8_t *bytes = ptrs[idx];
+        ASSERT_UINT_EQUALS(idx & 0xff, bytes[0]);
+        ASSERT_UINT_EQUALS(idx & 0xff, bytes[size - 1]);
+    }
+    aws_mem_release_batch(alloc, ptrs, BATCH_COUNT, size);
+
+    void *list = aws_mem_acquire_batch_list(alloc, size, BATCH_COUNT);
+    ASSERT_NOT_NULL(list);
+    size_t list_length = 0;
+    for (void *node = list; node; node = *(void **)node) {
+        ++list_length;
+    }
+    ASSERT_UINT_EQUALS(BATCH_COUNT, list_length);
+    aws_mem_release_batch_list(alloc, list, size);
+
+    aws_mem_release(aws_default_allocator(), ptrs);
+    return 0;
+}
+
+AWS_TEST_CASE(mem_acquire_batch, s_mem_acquire_batch)
+static int s_mem_acquire_batch(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    /* generic fallback */
+    ASSERT_SUCCESS(s_batch_exercise(allocator, 24));
+
+    struct aws_allocator *sba = aws_small_block_allocator_new(allocator, true);
+    ASSERT_NOT_NULL(sba);
+    ASSERT_SUCCESS(s_batch_exercise(sba, 24));
+    ASSERT_SUCCESS(s_batch_exercise(sba, 2000));
+    aws_small_block_allocator_destroy(sba);
+
+    struct aws_allocator *tc_alloc = aws_thread_cache_allocator_new(allocator);
+    ASSERT_NOT_NULL(tc_alloc);
+    ASSERT_SUCCESS(s_batch_exercise(tc_alloc, 24));
+    ASSERT_SUCCESS(s_batch_exercise(tc_alloc, 2000));
+    aws_thread_cache_allocator_destroy(tc_alloc);
+
+    /* a batch that can't be completed is handed back in full */
+    struct counting_allocator_impl counts = {.parent = allocator, .acquire_limit = 10};
+    struct aws_allocator counting = {
+        .mem_acquire = s_counting_acquire, .mem_release = s_counting_release, .impl = &counts};
+    void *ptrs[20];
+    ASSERT_FAILS(aws_mem_acquire_batch(&counting, 16, 20, ptrs));
+    ASSERT_INT_EQUALS(AWS_ERROR_OOM, aws_last_error());
+    ASSERT_UINT_EQUALS(10, counts.acquires);
+    ASSERT_UINT_EQUALS(10, counts.releases);
+    ASSERT_NULL(aws_mem_acquire_batch_list(&counting, 16, 20));
+    ASSERT_UINT_EQUALS(10, counts.releases);
+
+    return 0;
+}
+
+/* Warms up a pool of objects the way a connection pool would: all at once, then all back again */
+static long s_batch_warm_up(struct aws_allocator *alloc, void **ptrs, size_t count, size_t rounds, bool batched) {
+    long start = benchmark_timestamp_us();
+    for (size_t round = 0; round < rounds; ++round) {
+        if (batched) {
+            AWS_FATAL_ASSERT(aws_mem_acquire_batch(alloc, 64, count, ptrs) == AWS_OP_SUCCESS);
+            aws_mem_release_batch(alloc, ptrs, count, 64);
+        } else {
+            for (size_t idx = 0; idx < count; ++idx) {
+                ptrs[idx] = aws_mem_acquire(alloc, 64);
+                AWS_FATAL_ASSERT(ptrs[idx]);
+            }
+            for (size_t idx = 0; idx < count; ++idx) {
+                aws_mem_release(alloc, ptrs[idx]);
+            }
+        }
+    }
+    return benchmark_timestamp_us() - start;
+}
+
+AWS_TEST_CASE(mem_acquire_batch_benchmark, s_mem_acquire_batch_benchmark)
+static int s_mem_acquire_batch_benchmark(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+    enum { POOL_SIZE = 4096, ROUNDS = 100 };
+
+    void **ptrs = aws_mem_calloc(allocator, POOL_SIZE, sizeof(void *));
+    ASSERT_NOT_NULL(ptrs);
+
+    struct aws_allocator *sba = aws_small_block_allocator_new(allocator, true);
+    ASSERT_NOT_NULL(sba);
+    long single_elapsed = s_batch_warm_up(sba, ptrs, POOL_SIZE, ROUNDS, false);
+    long batch_elapsed = s_batch_warm_up(sba, ptrs, POOL_SIZE, ROUNDS, true);
+    aws_small_block_allocator_destroy(sba);
+
+    printf("small block allocator, one at a time elapsed=%ld us\n", single_elapsed);
+    printf("small block allocator, batched elapsed=%ld us\n", batch_elapsed);
+
+    aws_mem_release(allocator, ptrs);
+    return 0;
+}
+
+AWS_TEST_CASE(allocator_get_stats, s_allocator_get_stats)
+static int s_allocator_get_stats(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct aws_allocator_stats before;
+    struct aws_allocator_stats after;
+
+    /* the default allocator keeps no statistics, a tracer over it does */
+    ASSERT_FAILS(aws_allocator_get_stats(aws_default_allocator(), &before));
+    ASSERT_INT_EQUALS(AWS_ERROR_UNSUPPORTED_OPERATION, aws_last_error());
+    struct aws_allocator *counted = aws_mem_tracer_new(aws_default_allocator(), AWS_MEMTRACE_BYTES, 0, 0);
+    ASSERT_NOT_NULL(counted);
+    void *mem = aws_mem_acquire(counted, 1000);
+    ASSERT_NOT_NULL(mem);
+    ASSERT_SUCCESS(aws_mem_realloc(counted, &mem, 1000, 500));
+    ASSERT_SUCCESS(aws_allocator_get_stats(counted, &after));
+    ASSERT_UINT_EQUALS(500, after.bytes_in_use);
+    ASSERT_UINT_EQUALS(1000, after.bytes_in_use_peak);
+    ASSERT_UINT_EQUALS(1, after.acquire_count);
+    aws_mem_release(counted, mem);
+    ASSERT_SUCCESS(aws_allocator_get_stats(counted, &after));
+    ASSERT_UINT_EQUALS(0, after.bytes_in_use);
+    ASSERT_UINT_EQUALS(1, after.release_count);
+    aws_mem_tracer_destroy(counted);
+
+    /* small block allocator */
+    struct aws_allocator *sba = aws_small_block_allocator_new(allocator, true);
+    ASSERT_NOT_NULL(sba);
+    void *ptrs[10];
+    ASSERT_SUCCESS(aws_mem_acquire_batch(sba, 30, 10, ptrs));
+    void *single = aws_mem_acquire(sba, 100);
+    ASSERT_SUCCESS(aws_allocator_get_stats(sba, &after));
+    ASSERT_UINT_EQUALS(10 * 32 + 128, after.bytes_in_use);
+    ASSERT_UINT_EQUALS(11, after.acquire_count);
+    ASSERT_TRUE(after.bytes_reserved >= after.bytes_in_use);
+    aws_mem_release_batch(sba, ptrs, 10, 30);
+    aws_mem_release(sba, single);
+    ASSERT_SUCCESS(aws_allocator_get_stats(sba, &after));
+    ASSERT_UINT_EQUALS(0, after.bytes_in_use);
+    ASSERT_UINT_EQUALS(10 * 32 + 128, after.bytes_in_use_peak);
+    ASSERT_UINT_EQUALS(11, after.release_count);
+    aws_small_block_allocator_destroy(sba);
+
+    /* arena */
+    struct aws_arena_allocator arena;
+    ASSERT_SUCCESS(aws_arena_allocator_init(&arena, allocator, NULL, 0, 256));
+    struct aws_allocator *arena_alloc = &arena.allocator;
+    ASSERT_NOT_NULL(aws_mem_acquire(arena_alloc, 100));
+    void *last = aws_mem_acquire(arena_alloc, 50);
+    ASSERT_NOT_NULL(last);
+    aws_mem_release(arena_alloc, last);
+    ASSERT_SUCCESS(aws_allocator_get_stats(arena_alloc, &after));
+    ASSERT_TRUE(after.bytes_in_use >= 100 && after.bytes_in_use < 150);
+    ASSERT_TRUE(after.bytes_in_use_peak >= 150);
+    ASSERT_TRUE(after.bytes_reserved >= 256);
+    ASSERT_UINT_EQUALS(2, after.acquire_count);
+    ASSERT_UINT_EQUALS(1, after.release_count);
+    aws_arena_allocator_reset(&arena);
+    ASSERT_SUCCESS(aws_allocator_get_stats(arena_alloc, &after));
+    ASSERT_UINT_EQUALS(0, after.bytes_in_use);
+    aws_arena_allocator_clean_up(&arena);
+
+    /* memory tracer */
+    struct aws_allocator *tracer = aws_mem_tracer_new(allocator, AWS_MEMTRACE_BYTES, 0, 0);
+    ASSERT_NOT_NULL(tracer);
+    void *traced = aws_mem_acquire(tracer, 64);
+    ASSERT_SUCCESS(aws_allocator_get_stats(tracer, &after));
+    ASSERT_UINT_EQUALS(64, after.bytes_in_use);
+    ASSERT_UINT_EQUALS(1, after.acquire_count);
+    aws_mem_release(tracer, traced);
+    aws_mem_tracer_destroy(tracer);
+
+    /* allocators without the hook say so */
+    struct counting_allocator_impl counts = {.parent = allocator};
+    struct aws_allocator counting = {
+        .mem_acquire = s_counting_acquire, .mem_release = s_counting_release, .impl = &counts};
+    ASSERT_FAILS(aws_allocator_get_stats(&counting, &after));
+    ASSERT_INT_EQUALS(AWS_ERROR_UNSUPPORTED_OPERATION, aws_last_error());
+
+    return 0;
+}
@@ -0,0 +1,24 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "benchmark_test_utilities.h"
+
+#include <aws/common/clock.h>
+
+long benchmark_timestamp_us(void) {
+    uint64_t time = 0;
+    aws_sys_clock_get_ticks(&time);
+    return (long)aws_timestamp_convert(time, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MICROS, NULL);
+}
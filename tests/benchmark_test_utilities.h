@@ -0,0 +1,27 @@
+/* NOLINTNEXTLINE(llvm-header-guard) */
+#ifndef AWS_COMMON_BENCHMARK_TEST_UTILITIES_H
+#define AWS_COMMON_BENCHMARK_TEST_UTILITIES_H
+
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * The system clock in microseconds, for the benchmark test cases to time themselves with. Benchmarks only print their
+ * timings, and are registered with add_benchmark_test_case() so that they only run with ENABLE_BENCHMARK_TESTS. They
+ * time what they measure on aws_default_allocator(), as the test allocator takes a lock on every call.
+ */
+long benchmark_timestamp_us(void);
+
+#endif /* AWS_COMMON_BENCHMARK_TEST_UTILITIES_H */
@@ -0,0 +1,259 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/concurrent_hash_table.h>
+
+#include <aws/common/atomics.h>
+#include <aws/common/string.h>
+#include <aws/common/thread.h>
+#include <aws/testing/aws_test_harness.h>
+
+static struct aws_atomic_var s_destroyed_values;
+
+static void s_count_destroyed_value(void *value) {
+    (void)value;
+    aws_atomic_fetch_add(&s_destroyed_values, 1);
+}
+
+static int s_delete_even_lengths(void *context, struct aws_hash_element *p_element) {
+    size_t *visited = context;
+    ++*visited;
+    const struct aws_string *key = p_element->key;
+    if (key->len % 2 == 0) {
+        return AWS_COMMON_HASH_TABLE_ITER_CONTINUE | AWS_COMMON_HASH_TABLE_ITER_DELETE;
+    }
+    return AWS_COMMON_HASH_TABLE_ITER_CONTINUE;
+}
+
+static int s_double_values(void *context, struct aws_hash_element *p_element) {
+    (void)context;
+    p_element->value = (void *)((size_t)p_element->value * 2);
+    return AWS_COMMON_HASH_TABLE_ITER_CONTINUE;
+}
+
+AWS_TEST_CASE(concurrent_hash_table_put_find_remove, s_concurrent_hash_table_put_find_remove)
+static int s_concurrent_hash_table_put_find_remove(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_atomic_init_int(&s_destroyed_values, 0);
+
+    struct aws_concurrent_hash_table table;
+    ASSERT_SUCCESS(aws_concurrent_hash_table_init(
+        &table,
+        allocator,
+        0,
+        4,
+        aws_hash_string,
+        aws_hash_callback_string_eq,
+        aws_hash_callback_string_destroy,
+        s_count_destroyed_value));
+    ASSERT_UINT_EQUALS(4, table.shard_count);
+
+    /* keys "k", "kk", ... so that half of them have even lengths */
+    char buf[128];
+    for (size_t len = 1; len < sizeof(buf); ++len) {
+        memset(buf, 'k', len);
+        buf[len] = '\0';
+        int was_created = 0;
+        struct aws_string *key = aws_string_new_from_c_str(allocator, buf);
+        ASSERT_SUCCESS(aws_concurrent_hash_table_put(&table, key, (void *)len, &was_created));
+        ASSERT_INT_EQUALS(1, was_created);
+    }
+    ASSERT_UINT_EQUALS(sizeof(buf) - 1, aws_concurrent_hash_table_get_entry_count(&table));
+
+    /* overwriting with an equal but distinct key destroys the old key and value */
+    struct aws_string *key = aws_string_new_from_c_str(allocator, "kkk");
+    int was_created = 1;
+    ASSERT_SUCCESS(aws_concurrent_hash_table_put(&table, key, (void *)33, &was_created));
+    ASSERT_INT_EQUALS(0, was_created);
+    ASSERT_UINT_EQUALS(1, aws_atomic_load_int(&s_destroyed_values));
+
+    struct aws_hash_element elem;
+    int was_present = 0;
+    ASSERT_SUCCESS(aws_concurrent_hash_table_find(&table, key, &elem, &was_present));
+    ASSERT_INT_EQUALS(1, was_present);
+    ASSERT_PTR_EQUALS(key, elem.key);
+    ASSERT_PTR_EQUALS((void *)33, elem.value);
+
+    struct aws_string *lookup = aws_string_new_from_c_str(allocator, "kk");
+    ASSERT_SUCCESS(aws_concurrent_hash_table_remove(&table, lookup, &elem, &was_present));
+    ASSERT_INT_EQUALS(1, was_present);
+    ASSERT_PTR_EQUALS((void *)2, elem.value);
+    aws_string_destroy((void *)elem.key);
+    ASSERT_SUCCESS(aws_concurrent_hash_table_find(&table, lookup, &elem, &was_present));
+    ASSERT_INT_EQUALS(0, was_present);
+    ASSERT_SUCCESS(aws_concurrent_hash_table_remove(&table, lookup, NULL, &was_present));
+    ASSERT_INT_EQUALS(0, was_present);
+    aws_string_destroy(lookup);
+    ASSERT_UINT_EQUALS(sizeof(buf) - 2, aws_concurrent_hash_table_get_entry_count(&table));
+
+    /* foreach deletes without destroying, so the even length keys have to be freed here */
+    struct aws_string *even_keys[sizeof(buf) / 2];
+    size_t even_key_count = 0;
+    for (size_t len = 4; len < sizeof(buf); len += 2) {
+        memset(buf, 'k', len);
+        buf[len] = '\0';
+        lookup = aws_string_new_from_c_str(allocator, buf);
+        ASSERT_SUCCESS(aws_concurrent_hash_table_find(&table, lookup, &elem, &was_present));
+        ASSERT_INT_EQUALS(1, was_present);
+        even_keys[even_key_count++] = (struct aws_string *)elem.key;
+        aws_string_destroy(lookup);
+    }
+
+    size_t visited = 0;
+    ASSERT_SUCCESS(aws_concurrent_hash_table_foreach(&table, s_delete_even_lengths, &visited));
+    ASSERT_UINT_EQUALS(sizeof(buf) - 2, visited);
+    ASSERT_UINT_EQUALS(sizeof(buf) / 2, aws_concurrent_hash_table_get_entry_count(&table));
+    for (size_t idx = 0; idx < even_key_count; ++idx) {
+        ASSERT_SUCCESS(aws_concurrent_hash_table_find(&table, even_keys[idx], NULL, &was_present));
+        ASSERT_INT_EQUALS(0, was_present);
+        aws_string_destroy(even_keys[idx]);
+    }
+    ASSERT_UINT_EQUALS(1, aws_atomic_load_int(&s_destroyed_values));
+
+    /* new values reach both copies: they are still there once a remove has put the other copy in front */
+    ASSERT_SUCCESS(aws_concurrent_hash_table_foreach(&table, s_double_values, NULL));
+    lookup = aws_string_new_from_c_str(allocator, "k");
+    ASSERT_SUCCESS(aws_concurrent_hash_table_remove(&table, lookup, &elem, &was_present));
+    ASSERT_INT_EQUALS(1, was_present);
+    ASSERT_PTR_EQUALS((void *)2, elem.value);
+    aws_string_destroy((void *)elem.key);
+    aws_string_destroy(lookup);
+    for (size_t len = 3; len < sizeof(buf); len += 2) {
+        memset(buf, 'k', len);
+        buf[len] = '\0';
+        lookup = aws_string_new_from_c_str(allocator, buf);
+        ASSERT_SUCCESS(aws_concurrent_hash_table_find(&table, lookup, &elem, &was_present));
+        ASSERT_INT_EQUALS(1, was_present);
+        ASSERT_PTR_EQUALS((void *)((len == 3 ? 33 : len) * 2), elem.value);
+        aws_string_destroy(lookup);
+    }
+
+    aws_concurrent_hash_table_clear(&table);
+    ASSERT_UINT_EQUALS(0, aws_concurrent_hash_table_get_entry_count(&table));
+    ASSERT_UINT_EQUALS(sizeof(buf) / 2, aws_atomic_load_int(&s_destroyed_values));
+
+    key = aws_string_new_from_c_str(allocator, "after clear");
+    ASSERT_SUCCESS(aws_concurrent_hash_table_put(&table, key, NULL, NULL));
+    aws_concurrent_hash_table_clean_up(&table);
+    aws_concurrent_hash_table_clean_up(&table);
+    ASSERT_UINT_EQUALS(1 + sizeof(buf) / 2, aws_atomic_load_int(&s_destroyed_values));
+
+    return 0;
+}
+
+enum {
+    MT_WRITER_COUNT = 2,
+    MT_READER_COUNT = 2,
+    MT_KEYS_PER_WRITER = 256,
+    MT_ROUNDS = 50,
+};
+
+struct mt_test_data {
+    struct aws_concurrent_hash_table *table;
+    size_t writer_idx;
+    struct aws_atomic_var *writers_done;
+    size_t puts;
+    size_t bad_reads;
+};
+
+/* values encode their key, so that a reader can tell whether it got a torn or foreign element */
+static void *s_mt_value(uintptr_t key, size_t round) {
+    return (void *)((key << 8) | (round & 0xff));
+}
+
+static void s_mt_writer(void *arg) {
+    struct mt_test_data *data = arg;
+    const uintptr_t first_key = 1 + data->writer_idx * MT_KEYS_PER_WRITER;
+
+    for (size_t round = 0; round < MT_ROUNDS; ++round) {
+        for (uintptr_t key = first_key; key < first_key + MT_KEYS_PER_WRITER; ++key) {
+            aws_concurrent_hash_table_put(data->table, (void *)key, s_mt_value(key, round), NULL);
+            ++data->puts;
+        }
+        /* drop every other key each round, so that shards shrink and grow while being read */
+        for (uintptr_t key = first_key + (round & 1); key < first_key + MT_KEYS_PER_WRITER; key += 2) {
+            aws_concurrent_hash_table_remove(data->table, (void *)key, NULL, NULL);
+        }
+    }
+
+    aws_atomic_fetch_add(data->writers_done, 1);
+}
+
+static void s_mt_reader(void *arg) {
+    struct mt_test_data *data = arg;
+    const uintptr_t key_count = MT_WRITER_COUNT * MT_KEYS_PER_WRITER;
+
+    for (uintptr_t key = 1; aws_atomic_load_int(data->writers_done) < MT_WRITER_COUNT; key = key % key_count + 1) {
+        struct aws_hash_element elem;
+        int was_present = 0;
+        aws_concurrent_hash_table_find(data->table, (void *)key, &elem, &was_present);
+        if (was_present && (elem.key != (void *)key || ((uintptr_t)elem.value >> 8) != key)) {
+            ++data->bad_reads;
+        }
+    }
+}
+
+AWS_TEST_CASE(concurrent_hash_table_multi_threaded, s_concurrent_hash_table_multi_threaded)
+static int s_concurrent_hash_table_multi_threaded(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_atomic_init_int(&s_destroyed_values, 0);
+
+    struct aws_concurrent_hash_table table;
+    ASSERT_SUCCESS(aws_concurrent_hash_table_init(
+        &table, allocator, 0, 0, aws_hash_ptr, aws_ptr_eq, NULL, s_count_destroyed_value));
+
+    struct aws_atomic_var writers_done;
+    aws_atomic_init_int(&writers_done, 0);
+
+    struct aws_thread threads[MT_WRITER_COUNT + MT_READER_COUNT];
+    struct mt_test_data data[MT_WRITER_COUNT + MT_READER_COUNT];
+    for (size_t idx = 0; idx < MT_WRITER_COUNT + MT_READER_COUNT; ++idx) {
+        AWS_ZERO_STRUCT(data[idx]);
+        data[idx].table = &table;
+        data[idx].writer_idx = idx;
+        data[idx].writers_done = &writers_done;
+        ASSERT_SUCCESS(aws_thread_init(&threads[idx], allocator));
+        ASSERT_SUCCESS(
+            aws_thread_launch(&threads[idx], idx < MT_WRITER_COUNT ? s_mt_writer : s_mt_reader, &data[idx], 0));
+    }
+
+    size_t puts = 0;
+    for (size_t idx = 0; idx < MT_WRITER_COUNT + MT_READER_COUNT; ++idx) {
+        ASSERT_SUCCESS(aws_thread_join(&threads[idx]));
+        aws_thread_clean_up(&threads[idx]);
+        ASSERT_UINT_EQUALS(0, data[idx].bad_reads);
+        puts += data[idx].puts;
+    }
+
+    /* the last round removed every odd (relative) key of each writer */
+    const size_t remaining = MT_WRITER_COUNT * MT_KEYS_PER_WRITER / 2;
+    ASSERT_UINT_EQUALS(remaining, aws_concurrent_hash_table_get_entry_count(&table));
+    for (uintptr_t key = 1; key <= MT_WRITER_COUNT * MT_KEYS_PER_WRITER; ++key) {
+        struct aws_hash_element elem;
+        int was_present = 0;
+        ASSERT_SUCCESS(aws_concurrent_hash_table_find(&table, (void *)key, &elem, &was_present));
+        ASSERT_INT_EQUALS((key - 1) % 2 == 0, was_present);
+        if (was_present) {
+            ASSERT_PTR_EQUALS(s_mt_value(key, MT_ROUNDS - 1), elem.value);
+        }
+    }
+
+    /* every value but the ones still in the table was destroyed exactly once */
+    ASSERT_UINT_EQUALS(puts - remaining, aws_atomic_load_int(&s_destroyed_values));
+    aws_concurrent_hash_table_clean_up(&table);
+    ASSERT_UINT_EQUALS(puts, aws_atomic_load_int(&s_destroyed_values));
+
+    return 0;
+}
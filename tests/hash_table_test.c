@@ -19,6 +19,9 @@
 #include <aws/common/string.h>
 #include <aws/testing/aws_test_harness.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark_test_utilities.h"
 
 static const char *TEST_STR_1 = "test 1";
 static const char *TEST_STR_2 = "test 2";
@@ -1015,12 +1018,6 @@ static int s_qsort_churn_entry(const void *a, const void *b) {
     return 0;
 }
 
-static long s_timestamp(void) {
-    uint64_t time = 0;
-    aws_sys_clock_get_ticks(&time);
-    return (long)(time / 1000);
-}
-
 AWS_TEST_CASE(test_hash_churn, s_test_hash_churn_fn)
 static int s_test_hash_churn_fn(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
@@ -1074,7 +1071,7 @@ static int s_test_hash_churn_fn(struct aws_allocator *allocator, void *ctx) {
 
     qsort(permuted, nentries, sizeof(*permuted), s_qsort_churn_entry);
 
-    long start = s_timestamp();
+    long start = benchmark_timestamp_us();
 
     for (i = 0; i < nentries; i++) {
         if (!(i % 100000)) {
@@ -1124,7 +1121,7 @@ static int s_test_hash_churn_fn(struct aws_allocator *allocator, void *ctx) {
 
     aws_hash_table_clean_up(&hash_table);
 
-    long end = s_timestamp();
+    long end = benchmark_timestamp_us();
 
     free(entries);
     free(permuted);
@@ -1258,3 +1255,652 @@ static int s_test_hash_table_byte_cursor_create_find_fn(struct aws_allocator *al
 
     return 0;
 }
+
+/* Keys 1..last_key were put with value 2 * key, and every key k with (k + 1) % 3 == 0 was removed again */
+static int s_check_incremental_resize_contents(struct aws_hash_table *table, uintptr_t last_key) {
+    size_t iterated = 0;
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(table); !aws_hash_iter_done(&iter);
+         aws_hash_iter_next(&iter)) {
+        uintptr_t key = (uintptr_t)iter.element.key;
+        ASSERT_TRUE(key >= 1 && key <= last_key);
+        ASSERT_PTR_EQUALS((void *)(key * 2), iter.element.value);
+        iterated++;
+    }
+    ASSERT_UINT_EQUALS(aws_hash_table_get_entry_count(table), iterated);
+
+    size_t expected = 0;
+    for (uintptr_t key = 1; key <= last_key; ++key) {
+        bool removed = (key + 1) % 3 == 0 && key + 1 <= last_key;
+        struct aws_hash_element *elem = NULL;
+        ASSERT_SUCCESS(aws_hash_table_find(table, (void *)key, &elem));
+        ASSERT_TRUE((elem != NULL) != removed);
+        expected += !removed;
+    }
+    ASSERT_UINT_EQUALS(expected, iterated);
+    return 0;
+}
+
+AWS_TEST_CASE(test_hash_table_incremental_resize, s_test_hash_table_incremental_resize_fn)
+static int s_test_hash_table_incremental_resize_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_hash_table table;
+    ASSERT_SUCCESS(aws_hash_table_init(&table, allocator, 4, aws_hash_ptr, aws_ptr_eq, NULL, s_destroy_value_fn));
+    aws_hash_table_set_incremental_resize(&table, true);
+    s_reset_destroy_ck();
+
+    /* check often enough that plenty of checks land in the middle of moving entries to a bigger table */
+    uintptr_t last_key = 0;
+    while (last_key < 3000) {
+        ++last_key;
+        ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)last_key, (void *)(last_key * 2), NULL));
+        if (last_key % 3 == 0) {
+            int was_present = 0;
+            ASSERT_SUCCESS(aws_hash_table_remove(&table, (void *)(last_key - 1), NULL, &was_present));
+            ASSERT_INT_EQUALS(1, was_present);
+        }
+        if (last_key % 7 == 0) {
+            ASSERT_SUCCESS(s_check_incremental_resize_contents(&table, last_key));
+        }
+    }
+    ASSERT_INT_EQUALS(1000, s_value_removal_counter);
+
+    /* a table with the same contents, resized all at once, compares equal */
+    struct aws_hash_table reference;
+    ASSERT_SUCCESS(aws_hash_table_init(&reference, allocator, 4, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(&table); !aws_hash_iter_done(&iter);
+         aws_hash_iter_next(&iter)) {
+        ASSERT_SUCCESS(aws_hash_table_put(&reference, iter.element.key, iter.element.value, NULL));
+    }
+    ASSERT_TRUE(aws_hash_table_eq(&table, &reference, aws_ptr_eq));
+    ASSERT_TRUE(aws_hash_table_eq(&reference, &table, aws_ptr_eq));
+    aws_hash_table_clean_up(&reference);
+
+    /* deleting through an iterator visits each element once, in whichever table it is */
+    s_reset_destroy_ck();
+    size_t remaining = aws_hash_table_get_entry_count(&table);
+    size_t deleted = 0;
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(&table); !aws_hash_iter_done(&iter);
+         aws_hash_iter_next(&iter)) {
+        if ((uintptr_t)iter.element.key % 2) {
+            aws_hash_iter_delete(&iter, true);
+            deleted++;
+        }
+    }
+    ASSERT_INT_EQUALS(deleted, s_value_removal_counter);
+    ASSERT_UINT_EQUALS(remaining - deleted, aws_hash_table_get_entry_count(&table));
+    for (uintptr_t key = 1; key <= last_key; key += 2) {
+        struct aws_hash_element *elem = NULL;
+        ASSERT_SUCCESS(aws_hash_table_find(&table, (void *)key, &elem));
+        ASSERT_NULL(elem);
+    }
+
+    /* clearing part way through a resize destroys what's in both tables */
+    s_reset_destroy_ck();
+    remaining = aws_hash_table_get_entry_count(&table);
+    for (uintptr_t key = last_key + 1; key <= last_key + 1000; ++key) {
+        ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)key, NULL, NULL));
+    }
+    aws_hash_table_clear(&table);
+    ASSERT_INT_EQUALS(remaining + 1000, s_value_removal_counter);
+    ASSERT_UINT_EQUALS(0, aws_hash_table_get_entry_count(&table));
+
+    /* turning it off finishes the resize in progress */
+    for (uintptr_t key = 1; key <= 2000; ++key) {
+        ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)key, NULL, NULL));
+    }
+    aws_hash_table_set_incremental_resize(&table, false);
+    ASSERT_UINT_EQUALS(2000, aws_hash_table_get_entry_count(&table));
+
+    aws_hash_table_clean_up(&table);
+    return 0;
+}
+
+static int s_measure_put_latency(struct aws_allocator *allocator, bool incremental, size_t entry_count) {
+    /* The test allocator has no calloc, so it would memset each new table up front; that costs as much as the rehash
+     * it is meant to be compared with. The default allocator's calloc gets zeroed pages from the OS as they're used.
+     */
+    (void)allocator;
+    allocator = aws_default_allocator();
+
+    struct aws_hash_table table;
+    ASSERT_SUCCESS(aws_hash_table_init(&table, allocator, 16, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    aws_hash_table_set_incremental_resize(&table, incremental);
+
+    uint64_t worst = 0;
+    uint64_t start = 0;
+    aws_high_res_clock_get_ticks(&start);
+    for (uintptr_t key = 1; key <= entry_count; ++key) {
+        uint64_t before = 0;
+        uint64_t after = 0;
+        aws_high_res_clock_get_ticks(&before);
+        ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)key, NULL, NULL));
+        aws_high_res_clock_get_ticks(&after);
+        if (after - before > worst) {
+            worst = after - before;
+        }
+    }
+    uint64_t end = 0;
+    aws_high_res_clock_get_ticks(&end);
+
+    printf(
+        "%s resize: %zu puts elapsed=%ld us, worst put=%ld us\n",
+        incremental ? "incremental" : "all at once",
+        entry_count,
+        (long)((end - start) / 1000),
+        (long)(worst / 1000));
+
+    aws_hash_table_clean_up(&table);
+    return 0;
+}
+
+AWS_TEST_CASE(test_hash_table_incremental_resize_latency, s_test_hash_table_incremental_resize_latency_fn)
+static int s_test_hash_table_incremental_resize_latency_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    /* big enough for the last all-at-once resize to take milliseconds */
+    const size_t entry_count = 1 << 20;
+    ASSERT_SUCCESS(s_measure_put_latency(allocator, false, entry_count));
+    ASSERT_SUCCESS(s_measure_put_latency(allocator, true, entry_count));
+    return 0;
+}
+
+/* passes through to the parent until s_fail_acquires is set */
+static bool s_fail_acquires;
+
+static void *s_failing_acquire(struct aws_allocator *allocator, size_t size) {
+    return s_fail_acquires ? NULL : aws_mem_acquire(allocator->impl, size);
+}
+
+static void s_failing_release(struct aws_allocator *allocator, void *ptr) {
+    aws_mem_release(allocator->impl, ptr);
+}
+
+AWS_TEST_CASE(test_hash_table_set_max_load_factor_oom, s_test_hash_table_set_max_load_factor_oom_fn)
+static int s_test_hash_table_set_max_load_factor_oom_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct aws_allocator failing = {
+        .mem_acquire = s_failing_acquire, .mem_release = s_failing_release, .impl = allocator};
+    s_fail_acquires = false;
+
+    struct aws_hash_table table;
+    ASSERT_SUCCESS(aws_hash_table_init(&table, &failing, 16, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    struct aws_hash_table_stats before;
+    aws_hash_table_get_stats(&table, &before);
+    uintptr_t key = 1;
+    for (; key <= before.slot_count / 2; ++key) {
+        ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)key, NULL, NULL));
+    }
+
+    /* the table can't grow for the lower load factor, so it keeps the old one */
+    s_fail_acquires = true;
+    ASSERT_ERROR(AWS_ERROR_OOM, aws_hash_table_set_max_load_factor(&table, 0.1));
+    struct aws_hash_table_stats after;
+    aws_hash_table_get_stats(&table, &after);
+    ASSERT_TRUE(after.max_load_factor == before.max_load_factor);
+    ASSERT_UINT_EQUALS(before.slot_count, after.slot_count);
+
+    /* and still fills up to it without allocating */
+    for (; key <= before.slot_count * 3 / 4; ++key) {
+        ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)key, NULL, NULL));
+    }
+    ASSERT_UINT_EQUALS(before.slot_count * 3 / 4, aws_hash_table_get_entry_count(&table));
+
+    s_fail_acquires = false;
+    aws_hash_table_clean_up(&table);
+    return 0;
+}
+
+AWS_TEST_CASE(test_hash_table_reserve_shrink, s_test_hash_table_reserve_shrink_fn)
+static int s_test_hash_table_reserve_shrink_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { ENTRY_COUNT = 10000, KEPT_COUNT = 100 };
+
+    struct aws_hash_table table;
+    ASSERT_SUCCESS(aws_hash_table_init(&table, allocator, 4, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    struct aws_hash_table_stats stats;
+
+    /* 10000 / 0.95 rounds up to 16384 slots, which then don't change during the bulk load */
+    ASSERT_SUCCESS(aws_hash_table_reserve(&table, ENTRY_COUNT));
+    aws_hash_table_get_stats(&table, &stats);
+    ASSERT_UINT_EQUALS(16384, stats.slot_count);
+    for (uintptr_t key = 1; key <= ENTRY_COUNT; ++key) {
+        ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)key, (void *)key, NULL));
+    }
+    aws_hash_table_get_stats(&table, &stats);
+    ASSERT_UINT_EQUALS(16384, stats.slot_count);
+    ASSERT_UINT_EQUALS(ENTRY_COUNT, stats.entry_count);
+
+    /* reserving what there's room for already does nothing */
+    ASSERT_SUCCESS(aws_hash_table_reserve(&table, 5));
+    aws_hash_table_get_stats(&table, &stats);
+    ASSERT_UINT_EQUALS(16384, stats.slot_count);
+
+    /* purge, and give the memory back: 100 / 0.95 rounds up to 128 */
+    for (uintptr_t key = KEPT_COUNT + 1; key <= ENTRY_COUNT; ++key) {
+        ASSERT_SUCCESS(aws_hash_table_remove(&table, (void *)key, NULL, NULL));
+    }
+    ASSERT_SUCCESS(aws_hash_table_shrink_to_fit(&table));
+    aws_hash_table_get_stats(&table, &stats);
+    ASSERT_UINT_EQUALS(128, stats.slot_count);
+    ASSERT_UINT_EQUALS(KEPT_COUNT, stats.entry_count);
+    for (uintptr_t key = 1; key <= ENTRY_COUNT; ++key) {
+        struct aws_hash_element *elem = NULL;
+        ASSERT_SUCCESS(aws_hash_table_find(&table, (void *)key, &elem));
+        ASSERT_TRUE((elem != NULL) == (key <= KEPT_COUNT));
+    }
+
+    /* a lower max load factor grows the table straight away */
+    ASSERT_ERROR(AWS_ERROR_INVALID_ARGUMENT, aws_hash_table_set_max_load_factor(&table, 0));
+    ASSERT_ERROR(AWS_ERROR_INVALID_ARGUMENT, aws_hash_table_set_max_load_factor(&table, 1.5));
+    ASSERT_SUCCESS(aws_hash_table_set_max_load_factor(&table, 0.5));
+    aws_hash_table_get_stats(&table, &stats);
+    ASSERT_UINT_EQUALS(256, stats.slot_count);
+    ASSERT_TRUE(stats.max_load_factor == 0.5);
+    struct aws_hash_element *elem = NULL;
+    ASSERT_SUCCESS(aws_hash_table_find(&table, (void *)KEPT_COUNT, &elem));
+    ASSERT_NOT_NULL(elem);
+
+    /* an emptied table shrinks to the minimum size */
+    aws_hash_table_clear(&table);
+    ASSERT_SUCCESS(aws_hash_table_shrink_to_fit(&table));
+    aws_hash_table_get_stats(&table, &stats);
+    ASSERT_UINT_EQUALS(2, stats.slot_count);
+    ASSERT_UINT_EQUALS(0, stats.entry_count);
+    ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)1, NULL, NULL));
+
+    /* shrinking also drops the old table of an incremental resize in progress: at a max load factor of 0.5, the 65th
+     * entry moves the table from 128 slots to 256, and no slots have been migrated yet */
+    aws_hash_table_set_incremental_resize(&table, true);
+    for (uintptr_t key = 2; key <= 65; ++key) {
+        ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)key, NULL, NULL));
+    }
+    aws_hash_table_get_stats(&table, &stats);
+    ASSERT_UINT_EQUALS(65, stats.entry_count);
+    ASSERT_UINT_EQUALS(256 + 128, stats.slot_count);
+    ASSERT_SUCCESS(aws_hash_table_shrink_to_fit(&table));
+    aws_hash_table_get_stats(&table, &stats);
+    ASSERT_UINT_EQUALS(65, stats.entry_count);
+    ASSERT_UINT_EQUALS(256, stats.slot_count);
+
+    aws_hash_table_clean_up(&table);
+    return 0;
+}
+
+/* Probe lengths of a table filled to the same number of entries at two max load factors */
+AWS_TEST_CASE(test_hash_table_probe_stats, s_test_hash_table_probe_stats_fn)
+static int s_test_hash_table_probe_stats_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { ENTRY_COUNT = 70000 };
+    const double load_factors[] = {0.95, 0.5};
+    struct aws_hash_table_stats stats[2];
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(load_factors); ++i) {
+        struct aws_hash_table table;
+        ASSERT_SUCCESS(aws_hash_table_init(&table, allocator, 4, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+        ASSERT_SUCCESS(aws_hash_table_set_max_load_factor(&table, load_factors[i]));
+
+        struct aws_hash_table_stats *table_stats = &stats[i];
+        aws_hash_table_get_stats(&table, table_stats);
+        ASSERT_UINT_EQUALS(0, table_stats->entry_count);
+        ASSERT_TRUE(table_stats->mean_probe_length == 0);
+        ASSERT_UINT_EQUALS(0, table_stats->max_probe_length);
+
+        for (uintptr_t key = 1; key <= ENTRY_COUNT; ++key) {
+            ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)(key * 4096), NULL, NULL));
+        }
+        aws_hash_table_get_stats(&table, table_stats);
+        ASSERT_UINT_EQUALS(ENTRY_COUNT, table_stats->entry_count);
+        ASSERT_TRUE(table_stats->entry_count <= table_stats->max_load_factor * table_stats->slot_count);
+        ASSERT_TRUE(table_stats->mean_probe_length <= table_stats->max_probe_length);
+
+        printf(
+            "max load factor %.2f: %zu entries in %zu slots, mean probe length %.2f, max probe length %zu\n",
+            table_stats->max_load_factor,
+            table_stats->entry_count,
+            table_stats->slot_count,
+            table_stats->mean_probe_length,
+            table_stats->max_probe_length);
+        aws_hash_table_clean_up(&table);
+    }
+
+    /* 70000 entries fit in 2^17 slots at 0.95, but need 2^18 at 0.5 */
+    ASSERT_UINT_EQUALS(1 << 17, stats[0].slot_count);
+    ASSERT_UINT_EQUALS(1 << 18, stats[1].slot_count);
+    ASSERT_TRUE(stats[1].mean_probe_length < stats[0].mean_probe_length);
+
+    return 0;
+}
+
+static int s_check_find_many(struct aws_hash_table *table, const void *const *keys, size_t count) {
+    struct aws_hash_element *elems[64];
+    AWS_FATAL_ASSERT(count <= AWS_ARRAY_SIZE(elems));
+    ASSERT_SUCCESS(aws_hash_table_find_many(table, keys, count, elems));
+    for (size_t i = 0; i < count; ++i) {
+        struct aws_hash_element *elem = NULL;
+        ASSERT_SUCCESS(aws_hash_table_find(table, keys[i], &elem));
+        ASSERT_PTR_EQUALS(elem, elems[i]);
+    }
+    return 0;
+}
+
+AWS_TEST_CASE(test_hash_table_find_put_many, s_test_hash_table_find_put_many_fn)
+static int s_test_hash_table_find_put_many_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { KEY_COUNT = 50 };
+
+    for (int incremental = 0; incremental < 2; ++incremental) {
+        struct aws_hash_table table;
+        ASSERT_SUCCESS(aws_hash_table_init(
+            &table, allocator, 4, aws_hash_string, aws_hash_callback_string_eq, s_destroy_key_fn, s_destroy_value_fn));
+        aws_hash_table_set_incremental_resize(&table, incremental);
+        s_reset_destroy_ck();
+
+        /* more keys than a batch, with the last key repeating the first: it overwrites, destroying the first one */
+        struct aws_string *keys[KEY_COUNT + 1];
+        void *values[KEY_COUNT + 1];
+        int was_created[KEY_COUNT + 1];
+        char buf[32];
+        for (size_t i = 0; i <= KEY_COUNT; ++i) {
+            snprintf(buf, sizeof(buf), "key-%zu", i % KEY_COUNT);
+            keys[i] = aws_string_new_from_c_str(allocator, buf);
+            values[i] = (void *)(uintptr_t)(i + 1);
+        }
+        ASSERT_SUCCESS(aws_hash_table_put_many(&table, (const void **)keys, values, KEY_COUNT + 1, was_created));
+        for (size_t i = 0; i < KEY_COUNT; ++i) {
+            ASSERT_INT_EQUALS(1, was_created[i]);
+        }
+        ASSERT_INT_EQUALS(0, was_created[KEY_COUNT]);
+        ASSERT_INT_EQUALS(1, s_key_removal_counter);
+        ASSERT_PTR_EQUALS(keys[0], s_last_removed_key);
+        ASSERT_PTR_EQUALS(values[0], s_last_removed_value);
+        ASSERT_HASH_TABLE_ENTRY_COUNT(&table, KEY_COUNT);
+
+        /* look up equal but distinct strings, some missing, and a NULL key */
+        struct aws_string *lookups[KEY_COUNT + 2];
+        for (size_t i = 0; i < KEY_COUNT + 1; ++i) {
+            snprintf(buf, sizeof(buf), "key-%zu", i);
+            lookups[i] = aws_string_new_from_c_str(allocator, buf);
+        }
+        lookups[KEY_COUNT + 1] = NULL;
+        ASSERT_SUCCESS(s_check_find_many(&table, (const void **)lookups, KEY_COUNT + 2));
+
+        struct aws_hash_element *elems[KEY_COUNT + 2];
+        ASSERT_SUCCESS(aws_hash_table_find_many(&table, (const void **)lookups, KEY_COUNT + 2, elems));
+        ASSERT_PTR_EQUALS(values[KEY_COUNT], elems[0]->value);
+        for (size_t i = 1; i < KEY_COUNT; ++i) {
+            ASSERT_NOT_NULL(elems[i]);
+            ASSERT_PTR_EQUALS(values[i], elems[i]->value);
+        }
+        ASSERT_NULL(elems[KEY_COUNT]);
+        ASSERT_NULL(elems[KEY_COUNT + 1]);
+
+        /* an empty batch is fine */
+        ASSERT_SUCCESS(aws_hash_table_find_many(&table, NULL, 0, NULL));
+        ASSERT_SUCCESS(aws_hash_table_put_many(&table, NULL, NULL, 0, NULL));
+
+        for (size_t i = 0; i < KEY_COUNT + 1; ++i) {
+            aws_string_destroy(lookups[i]);
+            aws_string_destroy(keys[i]);
+        }
+        /* the destroy callbacks only count, the keys were freed above */
+        aws_hash_table_clean_up(&table);
+    }
+
+    return 0;
+}
+
+/*
+ * Request-sized batches of lookups into a table much larger than the last level cache, so that almost every lookup
+ * misses: one at a time, against aws_hash_table_find_many().
+ */
+AWS_TEST_CASE(test_hash_table_find_many_benchmark, s_test_hash_table_find_many_benchmark_fn)
+static int s_test_hash_table_find_many_benchmark_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    /* 4M entries take 8M slots, 192MB; the test allocator would memset it all up front, see s_measure_put_latency() */
+    (void)allocator;
+    allocator = aws_default_allocator();
+    enum { ENTRY_COUNT = 1 << 22, LOOKUP_COUNT = 1 << 20, BATCH_SIZE = 32 };
+
+    struct aws_hash_table table;
+    ASSERT_SUCCESS(aws_hash_table_init(&table, allocator, ENTRY_COUNT, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    for (uintptr_t key = 1; key <= ENTRY_COUNT; ++key) {
+        ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)key, (void *)key, NULL));
+    }
+
+    const void **lookups = aws_mem_acquire(allocator, LOOKUP_COUNT * sizeof(void *));
+    ASSERT_NOT_NULL(lookups);
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        lookups[i] = (void *)(uintptr_t)(rng % ENTRY_COUNT + 1);
+    }
+
+    struct aws_hash_element *elems[BATCH_SIZE];
+    uint64_t start = 0;
+    uint64_t end = 0;
+    aws_high_res_clock_get_ticks(&start);
+    for (size_t batch = 0; batch < LOOKUP_COUNT; batch += BATCH_SIZE) {
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            aws_hash_table_find(&table, lookups[batch + i], &elems[i]);
+        }
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            ASSERT_PTR_EQUALS(lookups[batch + i], elems[i]->value);
+        }
+    }
+    aws_high_res_clock_get_ticks(&end);
+    const uint64_t one_at_a_time = end - start;
+
+    aws_high_res_clock_get_ticks(&start);
+    for (size_t batch = 0; batch < LOOKUP_COUNT; batch += BATCH_SIZE) {
+        aws_hash_table_find_many(&table, lookups + batch, BATCH_SIZE, elems);
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            ASSERT_PTR_EQUALS(lookups[batch + i], elems[i]->value);
+        }
+    }
+    aws_high_res_clock_get_ticks(&end);
+    const uint64_t batched = end - start;
+
+    printf(
+        "%d lookups in batches of %d into %d entries: aws_hash_table_find elapsed=%ld us, "
+        "aws_hash_table_find_many elapsed=%ld us (%.2fx)\n",
+        LOOKUP_COUNT,
+        BATCH_SIZE,
+        ENTRY_COUNT,
+        (long)(one_at_a_time / 1000),
+        (long)(batched / 1000),
+        (double)one_at_a_time / (double)batched);
+
+    aws_mem_release(allocator, lookups);
+    aws_hash_table_clean_up(&table);
+    return 0;
+}
+
+/* Hashes the same bytes through each of the _fast functions, and at each alignment, expecting the same result */
+static int s_check_fast_hash_consistency(struct aws_allocator *allocator) {
+    uint8_t buf[128 + 8];
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        buf[i] = (uint8_t)('a' + i % 26);
+    }
+
+    uint64_t by_length[129];
+    for (size_t len = 0; len <= 128; ++len) {
+        uint64_t hash = aws_hash_bytes_fast(buf, len);
+        by_length[len] = hash;
+
+        for (size_t offset = 1; offset < 8; ++offset) {
+            uint8_t shifted[128 + 8];
+            memcpy(shifted + offset, buf, len);
+            ASSERT_UINT_EQUALS(hash, aws_hash_bytes_fast(shifted + offset, len));
+        }
+
+        struct aws_byte_cursor cursor = aws_byte_cursor_from_array(buf, len);
+        ASSERT_UINT_EQUALS(hash, aws_hash_byte_cursor_ptr_fast(&cursor));
+
+        struct aws_string *str = aws_string_new_from_array(allocator, buf, len);
+        ASSERT_UINT_EQUALS(hash, aws_hash_string_fast(str));
+        ASSERT_UINT_EQUALS(hash, aws_hash_c_string_fast((const char *)aws_string_bytes(str)));
+        aws_string_destroy(str);
+    }
+
+    /* prefixes of each other must not collide, in particular a key and the same key with trailing zeros */
+    for (size_t len = 0; len <= 128; ++len) {
+        for (size_t other = 0; other < len; ++other) {
+            ASSERT_FALSE(by_length[len] == by_length[other]);
+        }
+    }
+    uint8_t zeros[16] = {0};
+    for (size_t len = 0; len < sizeof(zeros); ++len) {
+        ASSERT_FALSE(aws_hash_bytes_fast(zeros, len) == aws_hash_bytes_fast(zeros, len + 1));
+    }
+
+    return 0;
+}
+
+AWS_TEST_CASE(test_hash_fast_functions, s_test_hash_fast_functions_fn)
+static int s_test_hash_fast_functions_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    return s_check_fast_hash_consistency(allocator);
+}
+
+/* The accelerated path is picked once per process; this forces the portable one, so that both get tested */
+AWS_TEST_CASE(test_hash_fast_functions_portable, s_test_hash_fast_functions_portable_fn)
+static int s_test_hash_fast_functions_portable_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+#ifdef _WIN32
+    _putenv_s("AWS_COMMON_SSE42", "0");
+#else
+    setenv("AWS_COMMON_SSE42", "0", 1);
+#endif
+    return s_check_fast_hash_consistency(allocator);
+}
+
+static const char *s_header_names[] = {
+    "accept", "accept-charset", "accept-encoding", "accept-language", "accept-ranges", "age", "allow", "authorization",
+    "cache-control", "connection", "content-encoding", "content-language", "content-length", "content-location",
+    "content-md5", "content-range", "content-type", "cookie", "date", "etag", "expect", "expires", "from", "host",
+    "if-match", "if-modified-since", "if-none-match", "if-range", "if-unmodified-since", "last-modified", "location",
+    "max-forwards", "pragma", "proxy-authorization", "range", "referer", "retry-after", "server", "set-cookie", "te",
+    "trailer", "transfer-encoding", "upgrade", "user-agent", "vary", "via", "warning", "www-authenticate", "x-amz-date",
+    "x-amz-content-sha256", "x-amz-security-token", "x-amz-request-id", "x-amz-id-2", "x-amz-version-id",
+    "x-amzn-requestid"};
+
+/*
+ * Chi-squared statistic of the hashes' distribution over 2^bucket_bits buckets, taken from the low bits as
+ * aws_hash_table does. For a good hash it is close to the bucket count, with a standard deviation of
+ * sqrt(2 * bucket count).
+ */
+static double s_hash_chi_squared(const uint64_t *hashes, size_t count, size_t bucket_bits, size_t *buckets) {
+    const size_t bucket_count = (size_t)1 << bucket_bits;
+    memset(buckets, 0, bucket_count * sizeof(*buckets));
+    for (size_t i = 0; i < count; ++i) {
+        buckets[hashes[i] & (bucket_count - 1)]++;
+    }
+
+    const double expected = (double)count / (double)bucket_count;
+    double chi_squared = 0;
+    for (size_t i = 0; i < bucket_count; ++i) {
+        double diff = (double)buckets[i] - expected;
+        chi_squared += diff * diff / expected;
+    }
+    return chi_squared;
+}
+
+/* header names, and the kind of short, similar keys user metadata headers produce */
+enum { HASH_KEY_COUNT = 1 << 16, HASH_KEY_SIZE = 32 };
+
+static void s_fill_hash_keys(struct aws_byte_cursor *keys, char *key_storage) {
+    const size_t header_name_count = AWS_ARRAY_SIZE(s_header_names);
+    for (size_t i = 0; i < HASH_KEY_COUNT; ++i) {
+        char *key = key_storage + i * HASH_KEY_SIZE;
+        if (i < header_name_count) {
+            snprintf(key, HASH_KEY_SIZE, "%s", s_header_names[i]);
+        } else {
+            snprintf(key, HASH_KEY_SIZE, "x-amz-meta-%zu", i);
+        }
+        keys[i] = aws_byte_cursor_from_c_str(key);
+    }
+}
+
+static const struct {
+    const char *name;
+    aws_hash_fn *hash_fn;
+} s_hash_functions[] = {
+    {"lookup3 (aws_hash_byte_cursor_ptr)", aws_hash_byte_cursor_ptr},
+    {"fast (aws_hash_byte_cursor_ptr_fast)", aws_hash_byte_cursor_ptr_fast},
+};
+
+AWS_TEST_CASE(test_hash_fast_distribution, s_test_hash_fast_distribution_fn)
+static int s_test_hash_fast_distribution_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    enum { BUCKET_BITS = 13 };
+    struct aws_byte_cursor *keys = aws_mem_calloc(allocator, HASH_KEY_COUNT, sizeof(struct aws_byte_cursor));
+    char *key_storage = aws_mem_calloc(allocator, HASH_KEY_COUNT, HASH_KEY_SIZE);
+    uint64_t *hashes = aws_mem_calloc(allocator, HASH_KEY_COUNT, sizeof(uint64_t));
+    size_t *buckets = aws_mem_calloc(allocator, (size_t)1 << BUCKET_BITS, sizeof(size_t));
+    ASSERT_NOT_NULL(keys);
+    ASSERT_NOT_NULL(key_storage);
+    ASSERT_NOT_NULL(hashes);
+    ASSERT_NOT_NULL(buckets);
+    s_fill_hash_keys(keys, key_storage);
+
+    const double bucket_count = (double)((size_t)1 << BUCKET_BITS);
+    for (size_t f = 0; f < AWS_ARRAY_SIZE(s_hash_functions); ++f) {
+        for (size_t i = 0; i < HASH_KEY_COUNT; ++i) {
+            hashes[i] = s_hash_functions[f].hash_fn(&keys[i]);
+        }
+        double chi_squared = s_hash_chi_squared(hashes, HASH_KEY_COUNT, BUCKET_BITS, buckets);
+
+        /* within 6 standard deviations (sqrt(2 * 8192) = 128) of what a uniformly random hash would give */
+        ASSERT_TRUE(
+            chi_squared < bucket_count + 6 * 128, "%s: chi-squared=%.0f", s_hash_functions[f].name, chi_squared);
+    }
+
+    aws_mem_release(allocator, buckets);
+    aws_mem_release(allocator, hashes);
+    aws_mem_release(allocator, key_storage);
+    aws_mem_release(allocator, keys);
+    return 0;
+}
+
+AWS_TEST_CASE(test_hash_fast_benchmark, s_test_hash_fast_benchmark_fn)
+static int s_test_hash_fast_benchmark_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+
+    enum { ROUNDS = 20 };
+    struct aws_byte_cursor *keys = aws_mem_calloc(allocator, HASH_KEY_COUNT, sizeof(struct aws_byte_cursor));
+    char *key_storage = aws_mem_calloc(allocator, HASH_KEY_COUNT, HASH_KEY_SIZE);
+    ASSERT_NOT_NULL(keys);
+    ASSERT_NOT_NULL(key_storage);
+    s_fill_hash_keys(keys, key_storage);
+
+    for (size_t f = 0; f < AWS_ARRAY_SIZE(s_hash_functions); ++f) {
+        uint64_t sink = 0;
+        uint64_t start = 0;
+        uint64_t end = 0;
+        aws_high_res_clock_get_ticks(&start);
+        for (int round = 0; round < ROUNDS; ++round) {
+            for (size_t i = 0; i < HASH_KEY_COUNT; ++i) {
+                sink += s_hash_functions[f].hash_fn(&keys[i]);
+            }
+        }
+        aws_high_res_clock_get_ticks(&end);
+
+        printf(
+            "%s: %d short keys elapsed=%ld us (%.1f ns/key) (%llx)\n",
+            s_hash_functions[f].name,
+            HASH_KEY_COUNT * ROUNDS,
+            (long)((end - start) / 1000),
+            (double)(end - start) / (HASH_KEY_COUNT * ROUNDS),
+            (unsigned long long)(sink & 0xff));
+    }
+
+    aws_mem_release(allocator, key_storage);
+    aws_mem_release(allocator, keys);
+    return 0;
+}
@@ -0,0 +1,294 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/inline_hash_table.h>
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <stdio.h>
+
+#include "benchmark_test_utilities.h"
+
+static int s_count_and_delete_odd(void *context, const void *key, void *value) {
+    size_t *visited = context;
+    ++*visited;
+
+    uint64_t int_key;
+    memcpy(&int_key, key, sizeof(int_key));
+    /* values may be modified in place */
+    uint32_t *int_value = value;
+    *int_value += 1;
+
+    if (int_key & 1) {
+        return AWS_COMMON_HASH_TABLE_ITER_CONTINUE | AWS_COMMON_HASH_TABLE_ITER_DELETE;
+    }
+    return AWS_COMMON_HASH_TABLE_ITER_CONTINUE;
+}
+
+AWS_TEST_CASE(inline_hash_table_int_keys, s_inline_hash_table_int_keys)
+static int s_inline_hash_table_int_keys(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { ENTRY_COUNT = 10000 };
+
+    /* uint64_t stream IDs to uint32_t values: hash code, key and value make 20 bytes, padded to 24 */
+    struct aws_inline_hash_table table;
+    ASSERT_SUCCESS(aws_inline_hash_table_init(&table, allocator, 4, sizeof(uint64_t), sizeof(uint32_t), NULL, NULL));
+    ASSERT_UINT_EQUALS(24, table.slot_size);
+
+    /* the table starts small, so this grows it several times */
+    for (uint64_t key = 1; key <= ENTRY_COUNT; ++key) {
+        uint32_t value = (uint32_t)(key * 3);
+        int was_created = 0;
+        ASSERT_SUCCESS(aws_inline_hash_table_put(&table, &key, &value, &was_created));
+        ASSERT_INT_EQUALS(1, was_created);
+    }
+    ASSERT_UINT_EQUALS(ENTRY_COUNT, aws_inline_hash_table_get_entry_count(&table));
+
+    for (uint64_t key = 0; key <= ENTRY_COUNT + 1; ++key) {
+        void *value = NULL;
+        ASSERT_SUCCESS(aws_inline_hash_table_find(&table, &key, &value));
+        if (key == 0 || key > ENTRY_COUNT) {
+            ASSERT_NULL(value);
+        } else {
+            ASSERT_NOT_NULL(value);
+            ASSERT_UINT_EQUALS(key * 3, *(uint32_t *)value);
+        }
+    }
+
+    /* overwrite, and update through the pointer create hands back */
+    uint64_t key = 7;
+    uint32_t value = 700;
+    int was_created = 1;
+    ASSERT_SUCCESS(aws_inline_hash_table_put(&table, &key, &value, &was_created));
+    ASSERT_INT_EQUALS(0, was_created);
+    void *stored = NULL;
+    ASSERT_SUCCESS(aws_inline_hash_table_create(&table, &key, &stored, &was_created));
+    ASSERT_INT_EQUALS(0, was_created);
+    ASSERT_UINT_EQUALS(700, *(uint32_t *)stored);
+    *(uint32_t *)stored = 701;
+
+    key = ENTRY_COUNT + 1;
+    ASSERT_SUCCESS(aws_inline_hash_table_create(&table, &key, &stored, &was_created));
+    ASSERT_INT_EQUALS(1, was_created);
+    ASSERT_UINT_EQUALS(0, *(uint32_t *)stored);
+
+    /* remove copies the value out */
+    key = 7;
+    int was_present = 0;
+    value = 0;
+    ASSERT_SUCCESS(aws_inline_hash_table_remove(&table, &key, &value, &was_present));
+    ASSERT_INT_EQUALS(1, was_present);
+    ASSERT_UINT_EQUALS(701, value);
+    ASSERT_SUCCESS(aws_inline_hash_table_remove(&table, &key, &value, &was_present));
+    ASSERT_INT_EQUALS(0, was_present);
+    ASSERT_UINT_EQUALS(ENTRY_COUNT, aws_inline_hash_table_get_entry_count(&table));
+
+    /* 1..ENTRY_COUNT + 1 without 7: the odd keys go, and every value is bumped by one */
+    size_t visited = 0;
+    ASSERT_SUCCESS(aws_inline_hash_table_foreach(&table, s_count_and_delete_odd, &visited));
+    ASSERT_UINT_EQUALS(ENTRY_COUNT, visited);
+    ASSERT_UINT_EQUALS(ENTRY_COUNT / 2, aws_inline_hash_table_get_entry_count(&table));
+    for (key = 1; key <= ENTRY_COUNT; ++key) {
+        ASSERT_SUCCESS(aws_inline_hash_table_find(&table, &key, &stored));
+        ASSERT_TRUE((stored != NULL) == (key % 2 == 0));
+        if (stored) {
+            ASSERT_UINT_EQUALS(key * 3 + 1, *(uint32_t *)stored);
+        }
+    }
+
+    aws_inline_hash_table_clear(&table);
+    ASSERT_UINT_EQUALS(0, aws_inline_hash_table_get_entry_count(&table));
+    key = 2;
+    ASSERT_SUCCESS(aws_inline_hash_table_find(&table, &key, &stored));
+    ASSERT_NULL(stored);
+
+    aws_inline_hash_table_clean_up(&table);
+    aws_inline_hash_table_clean_up(&table);
+    return 0;
+}
+
+/* Random puts and removes with 4 byte keys, checked against aws_hash_table */
+AWS_TEST_CASE(inline_hash_table_churn, s_inline_hash_table_churn)
+static int s_inline_hash_table_churn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { KEY_SPACE = 3000, OPERATIONS = 200000 };
+
+    struct aws_inline_hash_table table;
+    ASSERT_SUCCESS(aws_inline_hash_table_init(&table, allocator, 16, sizeof(uint32_t), sizeof(uint64_t), NULL, NULL));
+    struct aws_hash_table reference;
+    ASSERT_SUCCESS(aws_hash_table_init(&reference, allocator, 16, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    for (uint64_t op = 0; op < OPERATIONS; ++op) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        uint32_t key = (uint32_t)(rng % KEY_SPACE);
+
+        if (rng & (1ULL << 40)) {
+            ASSERT_SUCCESS(aws_inline_hash_table_put(&table, &key, &op, NULL));
+            ASSERT_SUCCESS(aws_hash_table_put(&reference, (void *)(uintptr_t)(key + 1), (void *)(uintptr_t)op, NULL));
+        } else {
+            int was_present = 0;
+            int was_present_reference = 0;
+            ASSERT_SUCCESS(aws_inline_hash_table_remove(&table, &key, NULL, &was_present));
+            ASSERT_SUCCESS(
+                aws_hash_table_remove(&reference, (void *)(uintptr_t)(key + 1), NULL, &was_present_reference));
+            ASSERT_INT_EQUALS(was_present_reference, was_present);
+        }
+        ASSERT_UINT_EQUALS(aws_hash_table_get_entry_count(&reference), aws_inline_hash_table_get_entry_count(&table));
+    }
+
+    for (uint32_t key = 0; key < KEY_SPACE; ++key) {
+        void *value = NULL;
+        struct aws_hash_element *reference_elem = NULL;
+        ASSERT_SUCCESS(aws_inline_hash_table_find(&table, &key, &value));
+        ASSERT_SUCCESS(aws_hash_table_find(&reference, (void *)(uintptr_t)(key + 1), &reference_elem));
+        ASSERT_TRUE((value == NULL) == (reference_elem == NULL));
+        if (value) {
+            ASSERT_UINT_EQUALS((uintptr_t)reference_elem->value, *(uint64_t *)value);
+        }
+    }
+
+    aws_hash_table_clean_up(&reference);
+    aws_inline_hash_table_clean_up(&table);
+    return 0;
+}
+
+/* a key with padding, whose bytes can't be compared directly */
+struct padded_key {
+    uint8_t type;
+    uint32_t id;
+};
+
+static uint64_t s_hash_padded_key(const void *item) {
+    const struct padded_key *key = item;
+    return aws_hash_ptr((void *)(((uintptr_t)key->type << 24) ^ key->id));
+}
+
+static bool s_padded_key_eq(const void *a, const void *b) {
+    const struct padded_key *key_a = a;
+    const struct padded_key *key_b = b;
+    return key_a->type == key_b->type && key_a->id == key_b->id;
+}
+
+AWS_TEST_CASE(inline_hash_table_struct_keys, s_inline_hash_table_struct_keys)
+static int s_inline_hash_table_struct_keys(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    /* raw byte keys of an odd size, and a set (no values at all) */
+    uint8_t bytes[11];
+    struct aws_inline_hash_table set;
+    ASSERT_SUCCESS(aws_inline_hash_table_init(&set, allocator, 0, sizeof(bytes), 0, NULL, NULL));
+    for (int idx = 0; idx < 1000; ++idx) {
+        memset(bytes, 0, sizeof(bytes));
+        bytes[idx % sizeof(bytes)] = (uint8_t)(idx / sizeof(bytes) + 1);
+        ASSERT_SUCCESS(aws_inline_hash_table_put(&set, bytes, NULL, NULL));
+    }
+    ASSERT_UINT_EQUALS(1000, aws_inline_hash_table_get_entry_count(&set));
+    memset(bytes, 0, sizeof(bytes));
+    void *value = NULL;
+    ASSERT_SUCCESS(aws_inline_hash_table_find(&set, bytes, &value));
+    ASSERT_NULL(value);
+    bytes[10] = 1;
+    ASSERT_SUCCESS(aws_inline_hash_table_find(&set, bytes, &value));
+    ASSERT_NOT_NULL(value);
+    aws_inline_hash_table_clean_up(&set);
+
+    /* struct keys with callbacks: keys differing only in their padding are equal */
+    struct aws_inline_hash_table table;
+    ASSERT_SUCCESS(aws_inline_hash_table_init(
+        &table, allocator, 0, sizeof(struct padded_key), sizeof(double), s_hash_padded_key, s_padded_key_eq));
+    struct padded_key key;
+    for (uint32_t id = 0; id < 1000; ++id) {
+        memset(&key, 0xAA, sizeof(key));
+        key.type = (uint8_t)(id % 3);
+        key.id = id;
+        double dvalue = id / 2.0;
+        ASSERT_SUCCESS(aws_inline_hash_table_put(&table, &key, &dvalue, NULL));
+    }
+    for (uint32_t id = 0; id < 1000; ++id) {
+        memset(&key, 0x55, sizeof(key));
+        key.type = (uint8_t)(id % 3);
+        key.id = id;
+        ASSERT_SUCCESS(aws_inline_hash_table_find(&table, &key, &value));
+        ASSERT_NOT_NULL(value);
+        /* values are stored at their natural alignment */
+        ASSERT_UINT_EQUALS(0, (uintptr_t)value % sizeof(double));
+        ASSERT_TRUE(*(double *)value == id / 2.0);
+    }
+    aws_inline_hash_table_clean_up(&table);
+
+    return 0;
+}
+
+/*
+ * Integer keys to integer values: aws_hash_table with the integers cast to pointers (its cheapest possible use)
+ * against the inline table.
+ */
+AWS_TEST_CASE(inline_hash_table_benchmark, s_inline_hash_table_benchmark)
+static int s_inline_hash_table_benchmark(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+    enum { ENTRY_COUNT = 100000, ROUNDS = 10 };
+
+    long hash_table_put = 0;
+    long hash_table_find = 0;
+    long inline_put = 0;
+    long inline_find = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        struct aws_hash_table hash_table;
+        ASSERT_SUCCESS(aws_hash_table_init(&hash_table, allocator, ENTRY_COUNT, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+        long start = benchmark_timestamp_us();
+        for (uint64_t key = 1; key <= ENTRY_COUNT; ++key) {
+            ASSERT_SUCCESS(aws_hash_table_put(&hash_table, (void *)(uintptr_t)(key * 7), (void *)(uintptr_t)key, NULL));
+        }
+        hash_table_put += benchmark_timestamp_us() - start;
+
+        start = benchmark_timestamp_us();
+        for (uint64_t key = 1; key <= ENTRY_COUNT; ++key) {
+            struct aws_hash_element *elem = NULL;
+            aws_hash_table_find(&hash_table, (void *)(uintptr_t)(key * 7), &elem);
+            ASSERT_NOT_NULL(elem);
+        }
+        hash_table_find += benchmark_timestamp_us() - start;
+        aws_hash_table_clean_up(&hash_table);
+
+        struct aws_inline_hash_table inline_table;
+        ASSERT_SUCCESS(aws_inline_hash_table_init(
+            &inline_table, allocator, ENTRY_COUNT, sizeof(uint64_t), sizeof(uint64_t), NULL, NULL));
+        start = benchmark_timestamp_us();
+        for (uint64_t key = 1; key <= ENTRY_COUNT; ++key) {
+            uint64_t stored_key = key * 7;
+            ASSERT_SUCCESS(aws_inline_hash_table_put(&inline_table, &stored_key, &key, NULL));
+        }
+        inline_put += benchmark_timestamp_us() - start;
+
+        start = benchmark_timestamp_us();
+        for (uint64_t key = 1; key <= ENTRY_COUNT; ++key) {
+            uint64_t stored_key = key * 7;
+            void *value = NULL;
+            aws_inline_hash_table_find(&inline_table, &stored_key, &value);
+            ASSERT_NOT_NULL(value);
+        }
+        inline_find += benchmark_timestamp_us() - start;
+        aws_inline_hash_table_clean_up(&inline_table);
+    }
+
+    printf("aws_hash_table: put elapsed=%ld us, find elapsed=%ld us\n", hash_table_put, hash_table_find);
+    printf("aws_inline_hash_table: put elapsed=%ld us, find elapsed=%ld us\n", inline_put, inline_find);
+    return 0;
+}
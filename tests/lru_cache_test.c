@@ -14,8 +14,15 @@
  */
 
 #include <aws/common/lru_cache.h>
+
+#include <aws/common/atomics.h>
+#include <aws/common/thread.h>
 #include <aws/testing/aws_test_harness.h>
 
+#include <stdio.h>
+
+#include "benchmark_test_utilities.h"
+
 static int s_test_lru_cache_overflow_static_members_fn(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
 
@@ -264,3 +271,830 @@ static int s_test_lru_cache_element_access_members_fn(struct aws_allocator *allo
 }
 
 AWS_TEST_CASE(test_lru_cache_element_access_members, s_test_lru_cache_element_access_members_fn)
+
+static int s_test_lru_cache_clock_second_chance_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_lru_cache cache;
+    struct aws_lru_cache_options options = {
+        .hash_fn = aws_hash_c_string,
+        .equals_fn = aws_hash_callback_c_str_eq,
+        .max_items = 3,
+        .policy = AWS_LRU_CACHE_POLICY_CLOCK,
+    };
+    ASSERT_SUCCESS(aws_lru_cache_init_with_options(&cache, allocator, &options));
+
+    const char *keys[] = {"first", "second", "third", "fourth", "fifth", "sixth", "seventh"};
+    int values[] = {1, 2, 3, 4, 5, 6, 7};
+
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[0], &values[0]));
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[1], &values[1]));
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[2], &values[2]));
+
+    int *value = NULL;
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[0], (void **)&value));
+    ASSERT_PTR_EQUALS(&values[0], value);
+
+    /* first was used, so it gets a second chance and second is evicted instead */
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[3], &values[3]));
+    ASSERT_INT_EQUALS(3, aws_lru_cache_get_element_count(&cache));
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[1], (void **)&value));
+    ASSERT_NULL(value);
+
+    /* then third, which was never used */
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[4], &values[4]));
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[2], (void **)&value));
+    ASSERT_NULL(value);
+
+    /* the second chance cleared first's bit and put it ahead of fourth, but it hasn't been used since */
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[5], &values[5]));
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[0], (void **)&value));
+    ASSERT_NULL(value);
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[6], &values[6]));
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[3], (void **)&value));
+    ASSERT_NULL(value);
+
+    /* with every element used, the newly added one is still not evicted */
+    for (size_t i = 4; i < 7; ++i) {
+        ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[i], (void **)&value));
+        ASSERT_PTR_EQUALS(&values[i], value);
+    }
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[0], &values[0]));
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[0], (void **)&value));
+    ASSERT_PTR_EQUALS(&values[0], value);
+    ASSERT_PTR_EQUALS(&values[0], aws_lru_cache_get_mru_element(&cache));
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[4], (void **)&value));
+    ASSERT_NULL(value);
+
+    /* sixth and seventh had their bits cleared by that lap: the next victim is the older of them */
+    value = aws_lru_cache_use_lru_element(&cache);
+    ASSERT_PTR_EQUALS(&values[5], value);
+    ASSERT_PTR_EQUALS(&values[5], aws_lru_cache_get_mru_element(&cache));
+
+    aws_lru_cache_clean_up(&cache);
+    return 0;
+}
+
+AWS_TEST_CASE(test_lru_cache_clock_second_chance, s_test_lru_cache_clock_second_chance_fn)
+
+enum {
+    CLOCK_READER_COUNT = 4,
+    CLOCK_READER_ITEMS = 1000,
+    CLOCK_READER_ROUNDS = 200,
+};
+
+struct clock_reader_data {
+    struct aws_lru_cache *cache;
+    struct aws_atomic_var failures;
+};
+
+static void s_clock_reader(void *arg) {
+    struct clock_reader_data *data = arg;
+    for (int round = 0; round < CLOCK_READER_ROUNDS; ++round) {
+        for (uintptr_t key = 1; key <= CLOCK_READER_ITEMS; ++key) {
+            void *value = NULL;
+            if (aws_lru_cache_find(data->cache, (void *)key, &value) || value != (void *)(key * 2)) {
+                aws_atomic_fetch_add(&data->failures, 1);
+            }
+        }
+    }
+}
+
+/* With AWS_LRU_CACHE_POLICY_CLOCK, finds may run concurrently when nothing modifies the cache */
+static int s_test_lru_cache_clock_concurrent_find_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_lru_cache cache;
+    struct aws_lru_cache_options options = {
+        .hash_fn = aws_hash_ptr,
+        .equals_fn = aws_ptr_eq,
+        .max_items = CLOCK_READER_ITEMS,
+        .policy = AWS_LRU_CACHE_POLICY_CLOCK,
+    };
+    ASSERT_SUCCESS(aws_lru_cache_init_with_options(&cache, allocator, &options));
+    for (uintptr_t key = 1; key <= CLOCK_READER_ITEMS; ++key) {
+        ASSERT_SUCCESS(aws_lru_cache_put(&cache, (void *)key, (void *)(key * 2)));
+    }
+
+    struct clock_reader_data data = {.cache = &cache};
+    aws_atomic_init_int(&data.failures, 0);
+
+    struct aws_thread threads[CLOCK_READER_COUNT];
+    for (size_t i = 0; i < CLOCK_READER_COUNT; ++i) {
+        ASSERT_SUCCESS(aws_thread_init(&threads[i], allocator));
+        ASSERT_SUCCESS(aws_thread_launch(&threads[i], s_clock_reader, &data, NULL));
+    }
+    for (size_t i = 0; i < CLOCK_READER_COUNT; ++i) {
+        ASSERT_SUCCESS(aws_thread_join(&threads[i]));
+        aws_thread_clean_up(&threads[i]);
+    }
+    ASSERT_UINT_EQUALS(0, aws_atomic_load_int(&data.failures));
+
+    /* every element was used, so the next put gives each a second chance and evicts the oldest after a full lap */
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, (void *)(uintptr_t)(CLOCK_READER_ITEMS + 1), NULL));
+    void *value = NULL;
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, (void *)(uintptr_t)1, &value));
+    ASSERT_NULL(value);
+    ASSERT_UINT_EQUALS(CLOCK_READER_ITEMS, aws_lru_cache_get_element_count(&cache));
+
+    aws_lru_cache_clean_up(&cache);
+    return 0;
+}
+
+AWS_TEST_CASE(test_lru_cache_clock_concurrent_find, s_test_lru_cache_clock_concurrent_find_fn)
+
+/*
+ * A skewed workload (key = rng^3 scaled, so small keys are hot) against a policy: misses put the key, as a cache in
+ * front of something slower would.
+ */
+static int s_lru_cache_run_skewed(
+    struct aws_allocator *allocator,
+    enum aws_lru_cache_policy policy,
+    size_t operations,
+    size_t *hits) {
+    enum { CAPACITY = 4096, KEY_SPACE = 65536 };
+
+    struct aws_lru_cache cache;
+    struct aws_lru_cache_options options = {
+        .hash_fn = aws_hash_ptr,
+        .equals_fn = aws_ptr_eq,
+        .max_items = CAPACITY,
+        .policy = policy,
+    };
+    ASSERT_SUCCESS(aws_lru_cache_init_with_options(&cache, allocator, &options));
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    *hits = 0;
+    for (size_t op = 0; op < operations; ++op) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        double unit = (double)(rng >> 11) / (double)(1ULL << 53);
+        uintptr_t key = (uintptr_t)(unit * unit * unit * KEY_SPACE) + 1;
+
+        void *value = NULL;
+        ASSERT_SUCCESS(aws_lru_cache_find(&cache, (void *)key, &value));
+        if (value) {
+            ++*hits;
+        } else {
+            ASSERT_SUCCESS(aws_lru_cache_put(&cache, (void *)key, (void *)key));
+        }
+    }
+
+    aws_lru_cache_clean_up(&cache);
+    return 0;
+}
+
+/* Random hits on a large full cache, where moving elements in the list touches cold neighbouring nodes */
+static int s_lru_cache_time_hits(struct aws_allocator *allocator, enum aws_lru_cache_policy policy, long *elapsed) {
+    enum { CAPACITY = 1 << 20, FINDS = 1 << 22 };
+
+    struct aws_lru_cache cache;
+    struct aws_lru_cache_options options = {
+        .hash_fn = aws_hash_ptr,
+        .equals_fn = aws_ptr_eq,
+        .max_items = CAPACITY,
+        .policy = policy,
+    };
+    ASSERT_SUCCESS(aws_lru_cache_init_with_options(&cache, allocator, &options));
+    for (uintptr_t key = 1; key <= CAPACITY; ++key) {
+        ASSERT_SUCCESS(aws_lru_cache_put(&cache, (void *)key, (void *)key));
+    }
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    long start = benchmark_timestamp_us();
+    for (size_t op = 0; op < FINDS; ++op) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        uintptr_t key = (uintptr_t)(rng % CAPACITY) + 1;
+
+        void *value = NULL;
+        aws_lru_cache_find(&cache, (void *)key, &value);
+        ASSERT_PTR_EQUALS((void *)key, value);
+    }
+    *elapsed = benchmark_timestamp_us() - start;
+
+    aws_lru_cache_clean_up(&cache);
+    return 0;
+}
+
+static int s_test_lru_cache_clock_hit_ratio_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    enum { OPERATIONS = 200000 };
+    size_t exact_hits = 0;
+    size_t clock_hits = 0;
+    ASSERT_SUCCESS(s_lru_cache_run_skewed(allocator, AWS_LRU_CACHE_POLICY_EXACT, OPERATIONS, &exact_hits));
+    ASSERT_SUCCESS(s_lru_cache_run_skewed(allocator, AWS_LRU_CACHE_POLICY_CLOCK, OPERATIONS, &clock_hits));
+
+    /* CLOCK approximates LRU closely on this workload: within 2% of the operations */
+    const size_t tolerance = OPERATIONS / 50;
+    ASSERT_TRUE(clock_hits + tolerance > exact_hits && exact_hits + tolerance > clock_hits);
+    return 0;
+}
+
+AWS_TEST_CASE(test_lru_cache_clock_hit_ratio, s_test_lru_cache_clock_hit_ratio_fn)
+
+static int s_test_lru_cache_clock_benchmark_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+
+    enum { OPERATIONS = 1000000 };
+    size_t exact_hits = 0;
+    size_t clock_hits = 0;
+    ASSERT_SUCCESS(s_lru_cache_run_skewed(allocator, AWS_LRU_CACHE_POLICY_EXACT, OPERATIONS, &exact_hits));
+    ASSERT_SUCCESS(s_lru_cache_run_skewed(allocator, AWS_LRU_CACHE_POLICY_CLOCK, OPERATIONS, &clock_hits));
+
+    long exact_elapsed = 0;
+    long clock_elapsed = 0;
+    ASSERT_SUCCESS(s_lru_cache_time_hits(allocator, AWS_LRU_CACHE_POLICY_EXACT, &exact_elapsed));
+    ASSERT_SUCCESS(s_lru_cache_time_hits(allocator, AWS_LRU_CACHE_POLICY_CLOCK, &clock_elapsed));
+
+    printf("exact LRU: hits=%zu, find elapsed=%ld us\n", exact_hits, exact_elapsed);
+    printf("CLOCK: hits=%zu, find elapsed=%ld us\n", clock_hits, clock_elapsed);
+    return 0;
+}
+
+AWS_TEST_CASE(test_lru_cache_clock_benchmark, s_test_lru_cache_clock_benchmark_fn)
+
+static const enum aws_lru_cache_policy s_all_policies[] = {
+    AWS_LRU_CACHE_POLICY_EXACT,
+    AWS_LRU_CACHE_POLICY_CLOCK,
+    AWS_LRU_CACHE_POLICY_2Q,
+    AWS_LRU_CACHE_POLICY_ARC,
+    AWS_LRU_CACHE_POLICY_TINY_LFU,
+};
+
+static const char *s_policy_names[] = {"exact LRU", "CLOCK", "2Q", "ARC", "W-TinyLFU"};
+
+static size_t s_destroyed_values;
+
+static void s_count_destroyed_value(void *value) {
+    (void)value;
+    ++s_destroyed_values;
+}
+
+/* Random finds, puts and removes against every policy: whatever each evicts, the cache must stay consistent */
+static int s_test_lru_cache_policies_churn_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { CAPACITY = 100, KEY_SPACE = 400, OPERATIONS = 50000 };
+
+    for (size_t policy_idx = 0; policy_idx < AWS_ARRAY_SIZE(s_all_policies); ++policy_idx) {
+        s_destroyed_values = 0;
+        struct aws_lru_cache cache;
+        struct aws_lru_cache_options options = {
+            .hash_fn = aws_hash_ptr,
+            .equals_fn = aws_ptr_eq,
+            .destroy_value_fn = s_count_destroyed_value,
+            .max_items = CAPACITY,
+            .policy = s_all_policies[policy_idx],
+        };
+        ASSERT_SUCCESS(aws_lru_cache_init_with_options(&cache, allocator, &options));
+
+        size_t puts = 0;
+        size_t removes = 0;
+        uint64_t rng = 0x9E3779B97F4A7C15ULL;
+        for (size_t op = 0; op < OPERATIONS; ++op) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            /* skewed, so that some keys are requested often enough for every policy to keep them */
+            const uintptr_t key = (uintptr_t)((rng % KEY_SPACE) * ((rng >> 16) % KEY_SPACE) / KEY_SPACE) + 1;
+
+            void *value = NULL;
+            if ((rng >> 40) % 16 == 0) {
+                ASSERT_SUCCESS(aws_lru_cache_find(&cache, (void *)key, &value));
+                removes += value != NULL;
+                ASSERT_SUCCESS(aws_lru_cache_remove(&cache, (void *)key));
+            } else if ((rng >> 40) % 16 == 1) {
+                ASSERT_SUCCESS(aws_lru_cache_put(&cache, (void *)key, (void *)(key * 2)));
+                ++puts;
+            } else {
+                ASSERT_SUCCESS(aws_lru_cache_find(&cache, (void *)key, &value));
+                if (value) {
+                    ASSERT_PTR_EQUALS((void *)(key * 2), value);
+                } else {
+                    ASSERT_SUCCESS(aws_lru_cache_put(&cache, (void *)key, (void *)(key * 2)));
+                    ++puts;
+                }
+            }
+
+            const size_t count = aws_lru_cache_get_element_count(&cache);
+            ASSERT_TRUE(count <= CAPACITY);
+            ASSERT_TRUE((count == 0) == (aws_lru_cache_get_mru_element(&cache) == NULL));
+            /* every value given to the cache is still in it, or has been destroyed */
+            ASSERT_UINT_EQUALS(puts, count + s_destroyed_values);
+        }
+        ASSERT_UINT_EQUALS(CAPACITY, aws_lru_cache_get_element_count(&cache));
+        ASSERT_TRUE(cache.eviction_count > 0);
+        ASSERT_TRUE(cache.eviction_count <= s_destroyed_values - removes);
+
+        void *value = aws_lru_cache_use_lru_element(&cache);
+        ASSERT_NOT_NULL(value);
+        ASSERT_SUCCESS(aws_lru_cache_find(&cache, (void *)((uintptr_t)value / 2), &value));
+        ASSERT_NOT_NULL(value);
+
+        aws_lru_cache_clear(&cache);
+        ASSERT_UINT_EQUALS(0, aws_lru_cache_get_element_count(&cache));
+        ASSERT_NULL(aws_lru_cache_get_mru_element(&cache));
+        ASSERT_NULL(aws_lru_cache_use_lru_element(&cache));
+        ASSERT_UINT_EQUALS(puts, s_destroyed_values);
+
+        aws_lru_cache_clean_up(&cache);
+    }
+
+    return 0;
+}
+
+AWS_TEST_CASE(test_lru_cache_policies_churn, s_test_lru_cache_policies_churn_fn)
+
+/*
+ * A hot set of half the cache is requested repeatedly, then one-off keys ten times the size of the cache go past.
+ * Exact LRU loses the whole hot set to the scan; the scan-resistant policies keep it.
+ */
+static int s_test_lru_cache_policies_scan_resistance_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { CAPACITY = 1000, HOT_COUNT = CAPACITY / 2, HOT_ROUNDS = 10, SCAN_COUNT = CAPACITY * 10 };
+
+    for (size_t policy_idx = 0; policy_idx < AWS_ARRAY_SIZE(s_all_policies); ++policy_idx) {
+        const enum aws_lru_cache_policy policy = s_all_policies[policy_idx];
+        struct aws_lru_cache cache;
+        struct aws_lru_cache_options options = {
+            .hash_fn = aws_hash_ptr,
+            .equals_fn = aws_ptr_eq,
+            .max_items = CAPACITY,
+            .policy = policy,
+        };
+        ASSERT_SUCCESS(aws_lru_cache_init_with_options(&cache, allocator, &options));
+
+        for (int round = 0; round < HOT_ROUNDS; ++round) {
+            for (uintptr_t key = 1; key <= HOT_COUNT; ++key) {
+                void *value = NULL;
+                ASSERT_SUCCESS(aws_lru_cache_find(&cache, (void *)key, &value));
+                if (!value) {
+                    ASSERT_SUCCESS(aws_lru_cache_put(&cache, (void *)key, (void *)key));
+                }
+            }
+        }
+
+        for (uintptr_t key = HOT_COUNT + 1; key <= HOT_COUNT + SCAN_COUNT; ++key) {
+            void *value = NULL;
+            ASSERT_SUCCESS(aws_lru_cache_find(&cache, (void *)key, &value));
+            ASSERT_NULL(value);
+            ASSERT_SUCCESS(aws_lru_cache_put(&cache, (void *)key, (void *)key));
+        }
+
+        size_t hot_hits = 0;
+        for (uintptr_t key = 1; key <= HOT_COUNT; ++key) {
+            void *value = NULL;
+            ASSERT_SUCCESS(aws_lru_cache_find(&cache, (void *)key, &value));
+            hot_hits += value != NULL;
+        }
+
+        if (policy == AWS_LRU_CACHE_POLICY_EXACT || policy == AWS_LRU_CACHE_POLICY_CLOCK) {
+            ASSERT_UINT_EQUALS(0, hot_hits);
+        } else {
+            ASSERT_TRUE(hot_hits >= HOT_COUNT * 9 / 10);
+        }
+
+        aws_lru_cache_clean_up(&cache);
+    }
+
+    return 0;
+}
+
+AWS_TEST_CASE(test_lru_cache_policies_scan_resistance, s_test_lru_cache_policies_scan_resistance_fn)
+
+/* Key traces for the benchmark, generated rather than recorded so the test is self-contained */
+enum {
+    TRACE_CAPACITY = 2000,
+    TRACE_LENGTH = 400000,
+};
+
+static uint64_t s_trace_next(uint64_t *rng) {
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 7;
+    *rng ^= *rng << 17;
+    return *rng;
+}
+
+/* Zipf-like popularity over 50000 keys (the cube of a uniform variable, so small keys are hot) */
+static uintptr_t s_trace_skewed(uint64_t *rng, size_t idx) {
+    (void)idx;
+    double unit = (double)(s_trace_next(rng) >> 11) / (double)(1ULL << 53);
+    return (uintptr_t)(unit * unit * unit * 50000) + 1;
+}
+
+/* The skewed trace, with a scan of 20000 never-repeated keys every 100000 requests */
+static uintptr_t s_trace_scans(uint64_t *rng, size_t idx) {
+    if (idx % 100000 < 20000) {
+        return 1000000 + idx;
+    }
+    return s_trace_skewed(rng, idx);
+}
+
+/* A loop over 1.5 times the cache size, which defeats LRU entirely */
+static uintptr_t s_trace_loop(uint64_t *rng, size_t idx) {
+    (void)rng;
+    return idx % (TRACE_CAPACITY * 3 / 2) + 1;
+}
+
+static int s_replay_trace(
+    struct aws_allocator *allocator,
+    enum aws_lru_cache_policy policy,
+    uintptr_t (*next_key)(uint64_t *rng, size_t idx),
+    size_t *hits,
+    long *elapsed) {
+
+    struct aws_lru_cache cache;
+    struct aws_lru_cache_options options = {
+        .hash_fn = aws_hash_ptr,
+        .equals_fn = aws_ptr_eq,
+        .max_items = TRACE_CAPACITY,
+        .policy = policy,
+    };
+    ASSERT_SUCCESS(aws_lru_cache_init_with_options(&cache, allocator, &options));
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    *hits = 0;
+    long start = benchmark_timestamp_us();
+    for (size_t idx = 0; idx < TRACE_LENGTH; ++idx) {
+        const uintptr_t key = next_key(&rng, idx);
+        void *value = NULL;
+        ASSERT_SUCCESS(aws_lru_cache_find(&cache, (void *)key, &value));
+        if (value) {
+            ++*hits;
+        } else {
+            ASSERT_SUCCESS(aws_lru_cache_put(&cache, (void *)key, (void *)key));
+        }
+    }
+    *elapsed = benchmark_timestamp_us() - start;
+
+    aws_lru_cache_clean_up(&cache);
+    return 0;
+}
+
+/* Replays each trace against each policy, reporting hit ratio and throughput */
+static int s_test_lru_cache_policy_trace_benchmark_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+
+    struct {
+        const char *name;
+        uintptr_t (*next_key)(uint64_t *rng, size_t idx);
+    } traces[] = {
+        {"skewed", s_trace_skewed},
+        {"skewed with scans", s_trace_scans},
+        {"loop", s_trace_loop},
+    };
+
+    for (size_t trace_idx = 0; trace_idx < AWS_ARRAY_SIZE(traces); ++trace_idx) {
+        size_t exact_hits = 0;
+        size_t best_hits = 0;
+        for (size_t policy_idx = 0; policy_idx < AWS_ARRAY_SIZE(s_all_policies); ++policy_idx) {
+            size_t hits = 0;
+            long elapsed = 0;
+            ASSERT_SUCCESS(
+                s_replay_trace(allocator, s_all_policies[policy_idx], traces[trace_idx].next_key, &hits, &elapsed));
+            printf(
+                "%s trace, %s: hit ratio=%.3f, %.0f ops/s, elapsed=%ld us\n",
+                traces[trace_idx].name,
+                s_policy_names[policy_idx],
+                (double)hits / TRACE_LENGTH,
+                elapsed ? TRACE_LENGTH * 1e6 / (double)elapsed : 0.0,
+                elapsed);
+
+            if (s_all_policies[policy_idx] == AWS_LRU_CACHE_POLICY_EXACT) {
+                exact_hits = hits;
+            }
+            best_hits = hits > best_hits ? hits : best_hits;
+        }
+        ASSERT_TRUE(best_hits >= exact_hits);
+    }
+
+    return 0;
+}
+
+AWS_TEST_CASE(test_lru_cache_policy_trace_benchmark, s_test_lru_cache_policy_trace_benchmark_fn)
+
+/* values in the cost tests point at their cost */
+static size_t s_value_cost(const void *key, const void *value) {
+    (void)key;
+    return *(const size_t *)value;
+}
+
+static int s_test_lru_cache_cost_budget_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_lru_cache cache;
+    struct aws_lru_cache_options options = {
+        .hash_fn = aws_hash_c_string,
+        .equals_fn = aws_hash_callback_c_str_eq,
+        .max_cost = 1000,
+        .cost_fn = s_value_cost,
+    };
+    ASSERT_SUCCESS(aws_lru_cache_init_with_options(&cache, allocator, &options));
+
+    const char *keys[] = {"first", "second", "third", "fourth", "fifth"};
+    size_t costs[] = {300, 300, 300, 600, 1001};
+
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[0], &costs[0]));
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[1], &costs[1]));
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[2], &costs[2]));
+    ASSERT_UINT_EQUALS(900, aws_lru_cache_get_total_cost(&cache));
+
+    size_t *value = NULL;
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[0], (void **)&value));
+    ASSERT_PTR_EQUALS(&costs[0], value);
+
+    /* fourth only fits once the two least recently used are gone */
+    ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[3], &costs[3]));
+    ASSERT_UINT_EQUALS(2, aws_lru_cache_get_element_count(&cache));
+    ASSERT_UINT_EQUALS(900, aws_lru_cache_get_total_cost(&cache));
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[1], (void **)&value));
+    ASSERT_NULL(value);
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[2], (void **)&value));
+    ASSERT_NULL(value);
+
+    /* anything over the whole budget is refused, leaving the cache as it was */
+    ASSERT_ERROR(AWS_ERROR_INVALID_ARGUMENT, aws_lru_cache_put(&cache, keys[4], &costs[4]));
+    ASSERT_ERROR(AWS_ERROR_INVALID_ARGUMENT, aws_lru_cache_put_with_cost(&cache, keys[0], &costs[0], 1001));
+    ASSERT_UINT_EQUALS(2, aws_lru_cache_get_element_count(&cache));
+    ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[0], (void **)&value));
+    ASSERT_PTR_EQUALS(&costs[0], value);
+
+    /* replacing an element replaces its cost, and may push out others */
+    ASSERT_SUCCESS(aws_lru_cache_put_with_cost(&cache, keys[0], &costs[0], 500));
+    ASSERT_UINT_EQUALS(1, aws_lru_cache_get_element_count(&cache));
+    ASSERT_UINT_EQUALS(500, aws_lru_cache_get_total_cost(&cache));
+    ASSERT_SUCCESS(aws_lru_cache_put_with_cost(&cache, keys[0], &costs[0], 100));
+    ASSERT_UINT_EQUALS(100, aws_lru_cache_get_total_cost(&cache));
+
+    struct aws_lru_cache_stats stats;
+    aws_lru_cache_get_stats(&cache, &stats);
+    ASSERT_UINT_EQUALS(1, stats.element_count);
+    ASSERT_UINT_EQUALS(100, stats.total_cost);
+    ASSERT_UINT_EQUALS(2, stats.hits);
+    ASSERT_UINT_EQUALS(2, stats.misses);
+    ASSERT_UINT_EQUALS(3, stats.evictions);
+
+    ASSERT_SUCCESS(aws_lru_cache_remove(&cache, keys[0]));
+    ASSERT_UINT_EQUALS(0, aws_lru_cache_get_total_cost(&cache));
+
+    aws_lru_cache_clean_up(&cache);
+
+    /* there must be some limit */
+    options.max_cost = 0;
+    ASSERT_ERROR(AWS_ERROR_INVALID_ARGUMENT, aws_lru_cache_init_with_options(&cache, allocator, &options));
+    return 0;
+}
+
+AWS_TEST_CASE(test_lru_cache_cost_budget, s_test_lru_cache_cost_budget_fn)
+
+/* Random puts of costs from 1 to 1000 against every policy, with a count limit too: neither may ever be exceeded */
+static int s_test_lru_cache_cost_budget_policies_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { CAPACITY = 100, MAX_COST = 20000, KEY_SPACE = 400, OPERATIONS = 20000 };
+
+    static size_t costs[KEY_SPACE];
+    for (size_t policy_idx = 0; policy_idx < AWS_ARRAY_SIZE(s_all_policies); ++policy_idx) {
+        s_destroyed_values = 0;
+        struct aws_lru_cache cache;
+        struct aws_lru_cache_options options = {
+            .hash_fn = aws_hash_ptr,
+            .equals_fn = aws_ptr_eq,
+            .destroy_value_fn = s_count_destroyed_value,
+            .max_items = CAPACITY,
+            .policy = s_all_policies[policy_idx],
+            .max_cost = MAX_COST,
+            .cost_fn = s_value_cost,
+        };
+        ASSERT_SUCCESS(aws_lru_cache_init_with_options(&cache, allocator, &options));
+
+        size_t puts = 0;
+        uint64_t rng = 0x9E3779B97F4A7C15ULL;
+        for (size_t op = 0; op < OPERATIONS; ++op) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            const size_t key_idx = (size_t)(rng % KEY_SPACE);
+
+            void *value = NULL;
+            ASSERT_SUCCESS(aws_lru_cache_find(&cache, (void *)(key_idx + 1), &value));
+            if (!value) {
+                /* a key's cost only changes while it is out of the cache */
+                costs[key_idx] = (size_t)((rng >> 32) % 1000) + 1;
+                ASSERT_SUCCESS(aws_lru_cache_put(&cache, (void *)(key_idx + 1), &costs[key_idx]));
+                ++puts;
+            }
+
+            struct aws_lru_cache_stats stats;
+            aws_lru_cache_get_stats(&cache, &stats);
+            ASSERT_TRUE(stats.element_count <= CAPACITY);
+            ASSERT_TRUE(stats.total_cost <= MAX_COST);
+            ASSERT_TRUE((stats.element_count == 0) == (stats.total_cost == 0));
+            ASSERT_UINT_EQUALS(puts, stats.element_count + s_destroyed_values);
+            ASSERT_UINT_EQUALS(s_destroyed_values, stats.evictions);
+        }
+
+        struct aws_lru_cache_stats stats;
+        aws_lru_cache_get_stats(&cache, &stats);
+        /* with costs averaging 500, the budget binds well before the count */
+        ASSERT_TRUE(stats.element_count < CAPACITY);
+        ASSERT_TRUE(stats.total_cost > MAX_COST - 1000);
+        printf("%s: %zu elements costing %zu", s_policy_names[policy_idx], stats.element_count, stats.total_cost);
+        if (s_all_policies[policy_idx] != AWS_LRU_CACHE_POLICY_CLOCK) {
+            ASSERT_UINT_EQUALS(OPERATIONS, stats.hits + stats.misses);
+            ASSERT_UINT_EQUALS(puts, stats.misses);
+            printf(", hit ratio %.3f", (double)stats.hits / (double)OPERATIONS);
+        }
+        printf("\n");
+
+        aws_lru_cache_clear(&cache);
+        ASSERT_UINT_EQUALS(0, aws_lru_cache_get_total_cost(&cache));
+        aws_lru_cache_clean_up(&cache);
+    }
+
+    return 0;
+}
+
+AWS_TEST_CASE(test_lru_cache_cost_budget_policies, s_test_lru_cache_cost_budget_policies_fn)
+
+static uint64_t s_fake_now;
+
+static int s_fake_clock(uint64_t *timestamp) {
+    *timestamp = s_fake_now;
+    return AWS_OP_SUCCESS;
+}
+
+/* Elements past their expiry are neither found nor kept, whatever the policy, and purging only touches those */
+static int s_test_lru_cache_expiry_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    for (size_t policy_idx = 0; policy_idx < AWS_ARRAY_SIZE(s_all_policies); ++policy_idx) {
+        const enum aws_lru_cache_policy policy = s_all_policies[policy_idx];
+        s_fake_now = 1000;
+        s_destroyed_values = 0;
+        struct aws_lru_cache cache;
+        struct aws_lru_cache_options options = {
+            .hash_fn = aws_hash_c_string,
+            .equals_fn = aws_hash_callback_c_str_eq,
+            .destroy_value_fn = s_count_destroyed_value,
+            .max_items = 100,
+            .policy = policy,
+            .ttl = 100,
+            .clock_fn = s_fake_clock,
+        };
+        ASSERT_SUCCESS(aws_lru_cache_init_with_options(&cache, allocator, &options));
+
+        const char *keys[] = {"first", "second", "third", "fourth", "fifth"};
+        int values[] = {1, 2, 3, 4, 5};
+
+        /* first and second expire at 1100, third at 1050, fourth at 1300 and fifth never */
+        ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[0], &values[0]));
+        ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[1], &values[1]));
+        ASSERT_SUCCESS(aws_lru_cache_put_with_expiry(&cache, keys[2], &values[2], 1050));
+        ASSERT_SUCCESS(aws_lru_cache_put_with_expiry(&cache, keys[3], &values[3], 1300));
+        ASSERT_SUCCESS(aws_lru_cache_put_with_expiry(&cache, keys[4], &values[4], 0));
+
+        uint64_t next_expiry = 0;
+        ASSERT_TRUE(aws_lru_cache_get_next_expiry(&cache, &next_expiry));
+        ASSERT_UINT_EQUALS(1050, next_expiry);
+
+        /* replacing an element replaces its expiry */
+        s_fake_now = 1200;
+        ASSERT_SUCCESS(aws_lru_cache_put(&cache, keys[1], &values[1]));
+        ASSERT_UINT_EQUALS(5, aws_lru_cache_get_element_count(&cache));
+
+        int *value = NULL;
+        ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[0], (void **)&value));
+        ASSERT_NULL(value);
+        ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[1], (void **)&value));
+        ASSERT_PTR_EQUALS(&values[1], value);
+        ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[4], (void **)&value));
+        ASSERT_PTR_EQUALS(&values[4], value);
+
+        /* finds under CLOCK leave the expired element for the purge */
+        const size_t found_expired = policy == AWS_LRU_CACHE_POLICY_CLOCK ? 0 : 1;
+        ASSERT_UINT_EQUALS(5 - found_expired, aws_lru_cache_get_element_count(&cache));
+
+        /* the purge takes the soonest expiring first, and stops at those not yet expired */
+        ASSERT_UINT_EQUALS(1, aws_lru_cache_purge_expired(&cache, s_fake_now, 1));
+        ASSERT_UINT_EQUALS(1 - found_expired, aws_lru_cache_purge_expired(&cache, s_fake_now, 0));
+        ASSERT_UINT_EQUALS(0, aws_lru_cache_purge_expired(&cache, s_fake_now, 0));
+        ASSERT_UINT_EQUALS(3, aws_lru_cache_get_element_count(&cache));
+        /* first and third, and second's value when it was replaced */
+        ASSERT_UINT_EQUALS(3, s_destroyed_values);
+        ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[2], (void **)&value));
+        ASSERT_NULL(value);
+        ASSERT_TRUE(aws_lru_cache_get_next_expiry(&cache, &next_expiry));
+        ASSERT_UINT_EQUALS(1300, next_expiry);
+
+        struct aws_lru_cache_stats stats;
+        aws_lru_cache_get_stats(&cache, &stats);
+        ASSERT_UINT_EQUALS(2, stats.expirations);
+        ASSERT_UINT_EQUALS(0, stats.evictions);
+
+        /* removing an element takes it off the expiry queue too */
+        ASSERT_SUCCESS(aws_lru_cache_remove(&cache, keys[1]));
+        ASSERT_SUCCESS(aws_lru_cache_remove(&cache, keys[3]));
+        ASSERT_FALSE(aws_lru_cache_get_next_expiry(&cache, &next_expiry));
+        s_fake_now = UINT64_MAX;
+        ASSERT_UINT_EQUALS(0, aws_lru_cache_purge_expired(&cache, s_fake_now, 0));
+        ASSERT_SUCCESS(aws_lru_cache_find(&cache, keys[4], (void **)&value));
+        ASSERT_PTR_EQUALS(&values[4], value);
+
+        aws_lru_cache_clean_up(&cache);
+    }
+
+    return 0;
+}
+
+AWS_TEST_CASE(test_lru_cache_expiry, s_test_lru_cache_expiry_fn)
+
+/* With a purge scheduler, expired elements go as the scheduler's clock passes them, in batches, with no finds */
+static int s_test_lru_cache_expiry_purge_task_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { ELEMENT_COUNT = 1000 };
+
+    struct aws_task_scheduler scheduler;
+    ASSERT_SUCCESS(aws_task_scheduler_init(&scheduler, allocator));
+
+    s_fake_now = 0;
+    s_destroyed_values = 0;
+    struct aws_lru_cache cache;
+    struct aws_lru_cache_options options = {
+        .hash_fn = aws_hash_ptr,
+        .equals_fn = aws_ptr_eq,
+        .destroy_value_fn = s_count_destroyed_value,
+        .max_items = ELEMENT_COUNT,
+        .clock_fn = s_fake_clock,
+        .purge_scheduler = &scheduler,
+        .purge_interval = 100,
+    };
+    ASSERT_SUCCESS(aws_lru_cache_init_with_options(&cache, allocator, &options));
+
+    /* element i expires at 1000 + i, added latest first so that the purge task keeps being moved earlier */
+    for (uintptr_t i = ELEMENT_COUNT; i > 0; --i) {
+        ASSERT_SUCCESS(aws_lru_cache_put_with_expiry(&cache, (void *)i, (void *)i, 1000 + i));
+    }
+
+    uint64_t next_task_time = 0;
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(1100, next_task_time);
+
+    /* the task runs once per interval, removing everything expired by then */
+    s_fake_now = 1099;
+    aws_task_scheduler_run_all(&scheduler, s_fake_now);
+    ASSERT_UINT_EQUALS(ELEMENT_COUNT, aws_lru_cache_get_element_count(&cache));
+    s_fake_now = 1150;
+    aws_task_scheduler_run_all(&scheduler, s_fake_now);
+    ASSERT_UINT_EQUALS(ELEMENT_COUNT - 150, aws_lru_cache_get_element_count(&cache));
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(1200, next_task_time);
+
+    /* removing what the task would have purged next doesn't stop it moving on */
+    for (uintptr_t i = 101; i <= 200; ++i) {
+        ASSERT_SUCCESS(aws_lru_cache_remove(&cache, (void *)i));
+    }
+    s_fake_now = 1200;
+    aws_task_scheduler_run_all(&scheduler, s_fake_now);
+    ASSERT_UINT_EQUALS(ELEMENT_COUNT - 200, aws_lru_cache_get_element_count(&cache));
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(1300, next_task_time);
+
+    /* something expiring sooner moves the task earlier */
+    ASSERT_SUCCESS(aws_lru_cache_put_with_expiry(&cache, (void *)(ELEMENT_COUNT + 1), (void *)1, 1201));
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(1300, next_task_time);
+    ASSERT_SUCCESS(aws_lru_cache_put_with_expiry(&cache, (void *)(ELEMENT_COUNT + 2), (void *)1, 1150));
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(1200, next_task_time);
+
+    /* a late run catches up in one batch */
+    s_fake_now = 2000;
+    aws_task_scheduler_run_all(&scheduler, s_fake_now);
+    ASSERT_UINT_EQUALS(0, aws_lru_cache_get_element_count(&cache));
+    ASSERT_FALSE(aws_task_scheduler_has_tasks(&scheduler, NULL));
+    ASSERT_UINT_EQUALS(ELEMENT_COUNT + 2, s_destroyed_values);
+
+    struct aws_lru_cache_stats stats;
+    aws_lru_cache_get_stats(&cache, &stats);
+    /* all but the 50 removed before they expired */
+    ASSERT_UINT_EQUALS(ELEMENT_COUNT - 50 + 2, stats.expirations);
+    ASSERT_UINT_EQUALS(0, stats.hits + stats.misses);
+
+    /* cleaning up cancels a scheduled purge */
+    ASSERT_SUCCESS(aws_lru_cache_put_with_expiry(&cache, (void *)1, (void *)1, 3000));
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, NULL));
+    aws_lru_cache_clean_up(&cache);
+    ASSERT_FALSE(aws_task_scheduler_has_tasks(&scheduler, NULL));
+
+    aws_task_scheduler_clean_up(&scheduler);
+    return 0;
+}
+
+AWS_TEST_CASE(test_lru_cache_expiry_purge_task, s_test_lru_cache_expiry_purge_task_fn)
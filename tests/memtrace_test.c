@@ -0,0 +1,211 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/allocator.h>
+#include <aws/common/system_info.h>
+
+#include <aws/testing/aws_test_harness.h>
+
+#define NUM_ALLOCS 100
+
+static int s_test_memtrace_count(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_allocator *tracer = aws_mem_tracer_new(allocator, AWS_MEMTRACE_BYTES, 0, 0);
+    ASSERT_NOT_NULL(tracer);
+
+    void *allocs[NUM_ALLOCS] = {0};
+    size_t total = 0;
+    for (size_t idx = 0; idx < NUM_ALLOCS; ++idx) {
+        allocs[idx] = aws_mem_acquire(tracer, idx + 1);
+        ASSERT_NOT_NULL(allocs[idx]);
+        total += idx + 1;
+    }
+
+    struct aws_mem_trace_stats stats;
+    aws_mem_tracer_get_stats(tracer, &stats);
+    ASSERT_UINT_EQUALS(total, stats.live_bytes);
+    ASSERT_UINT_EQUALS(total, stats.peak_bytes);
+    ASSERT_UINT_EQUALS(NUM_ALLOCS, stats.live_allocs);
+    ASSERT_UINT_EQUALS(NUM_ALLOCS, stats.total_allocs);
+
+    /* growing an allocation moves the peak, shrinking doesn't */
+    ASSERT_SUCCESS(aws_mem_realloc(tracer, &allocs[0], 1, 1001));
+    ASSERT_SUCCESS(aws_mem_realloc(tracer, &allocs[0], 1001, 1));
+    aws_mem_tracer_get_stats(tracer, &stats);
+    ASSERT_UINT_EQUALS(total, stats.live_bytes);
+    ASSERT_UINT_EQUALS(total + 1000, stats.peak_bytes);
+
+    for (size_t idx = 0; idx < NUM_ALLOCS; ++idx) {
+        if (idx % 2) {
+            aws_mem_release(tracer, allocs[idx]);
+        } else {
+            aws_mem_release_sized(tracer, allocs[idx], idx + 1);
+        }
+    }
+
+    aws_mem_tracer_get_stats(tracer, &stats);
+    ASSERT_UINT_EQUALS(0, stats.live_bytes);
+    ASSERT_UINT_EQUALS(0, stats.live_allocs);
+    ASSERT_UINT_EQUALS(NUM_ALLOCS, stats.total_releases);
+    ASSERT_UINT_EQUALS(0, aws_mem_tracer_top_stacks(tracer, NULL, 0));
+
+    ASSERT_PTR_EQUALS(allocator, aws_mem_tracer_destroy(tracer));
+    return 0;
+}
+AWS_TEST_CASE(test_memtrace_count, s_test_memtrace_count)
+
+/* distinct, non-inlined call sites so that each gets its own stack */
+#if defined(__GNUC__) || defined(__clang__)
+#    define MEMTRACE_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#    define MEMTRACE_NOINLINE __declspec(noinline)
+#else
+#    define MEMTRACE_NOINLINE
+#endif
+
+MEMTRACE_NOINLINE static void *s_alloc_big(struct aws_allocator *allocator) {
+    return aws_mem_acquire(allocator, 1024);
+}
+
+MEMTRACE_NOINLINE static void *s_alloc_small(struct aws_allocator *allocator) {
+    return aws_mem_acquire(allocator, 16);
+}
+
+static int s_test_memtrace_stacks(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    void *probe[1];
+    if (aws_backtrace(probe, 1) == 0) {
+        /* no stack capture on this platform, nothing to test */
+        return 0;
+    }
+
+    struct aws_allocator *tracer = aws_mem_tracer_new(allocator, AWS_MEMTRACE_STACKS, 0, 8);
+    ASSERT_NOT_NULL(tracer);
+
+    void *allocs[NUM_ALLOCS] = {0};
+    for (size_t idx = 0; idx < NUM_ALLOCS; ++idx) {
+        allocs[idx] = (idx < 10) ? s_alloc_big(tracer) : s_alloc_small(tracer);
+        ASSERT_NOT_NULL(allocs[idx]);
+    }
+
+    struct aws_mem_trace_stack_stats stacks[4];
+    size_t count = aws_mem_tracer_top_stacks(tracer, stacks, AWS_ARRAY_SIZE(stacks));
+    ASSERT_UINT_EQUALS(2, count);
+    ASSERT_UINT_EQUALS(10 * 1024, stacks[0].live_bytes);
+    ASSERT_UINT_EQUALS(10, stacks[0].live_allocs);
+    ASSERT_UINT_EQUALS(90 * 16, stacks[1].live_bytes);
+    ASSERT_UINT_EQUALS(90, stacks[1].total_allocs);
+    ASSERT_TRUE(stacks[0].depth > 0 && stacks[0].depth <= 8);
+
+    aws_mem_tracer_dump(tracer);
+
+    for (size_t idx = 0; idx < NUM_ALLOCS; ++idx) {
+        aws_mem_release(tracer, allocs[idx]);
+    }
+
+    /* stacks are remembered after their allocations are gone */
+    count = aws_mem_tracer_top_stacks(tracer, stacks, 1);
+    ASSERT_UINT_EQUALS(1, count);
+    ASSERT_UINT_EQUALS(0, stacks[0].live_bytes);
+
+    aws_mem_tracer_destroy(tracer);
+    return 0;
+}
+AWS_TEST_CASE(test_memtrace_stacks, s_test_memtrace_stacks)
+
+MEMTRACE_NOINLINE static void *s_alloc_via_acquire(struct aws_allocator *allocator) {
+    return aws_mem_acquire(allocator, 1024);
+}
+
+MEMTRACE_NOINLINE static void *s_alloc_via_realloc(struct aws_allocator *allocator) {
+    void *ptr = NULL;
+    if (aws_mem_realloc(allocator, &ptr, 0, 64)) {
+        return NULL;
+    }
+    return ptr;
+}
+
+/* allocations from realloc are attributed to realloc's caller, just like those from acquire */
+static int s_test_memtrace_stacks_realloc(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    void *probe[1];
+    if (aws_backtrace(probe, 1) == 0) {
+        return 0;
+    }
+
+    struct aws_allocator *tracer = aws_mem_tracer_new(allocator, AWS_MEMTRACE_STACKS, 0, 0);
+    ASSERT_NOT_NULL(tracer);
+
+    void *acquired = s_alloc_via_acquire(tracer);
+    ASSERT_NOT_NULL(acquired);
+    void *reallocated = s_alloc_via_realloc(tracer);
+    ASSERT_NOT_NULL(reallocated);
+
+    struct aws_mem_trace_stack_stats stacks[2];
+    ASSERT_UINT_EQUALS(2, aws_mem_tracer_top_stacks(tracer, stacks, AWS_ARRAY_SIZE(stacks)));
+    ASSERT_UINT_EQUALS(1024, stacks[0].live_bytes);
+    ASSERT_UINT_EQUALS(64, stacks[1].live_bytes);
+
+    /* both stacks start in their helper, whose callers are the same from the test onwards */
+    ASSERT_UINT_EQUALS(stacks[0].depth, stacks[1].depth);
+    ASSERT_TRUE(stacks[0].depth > 2);
+    for (size_t idx = 2; idx < stacks[0].depth; ++idx) {
+        ASSERT_PTR_EQUALS(stacks[0].frames[idx], stacks[1].frames[idx]);
+    }
+
+    aws_mem_release(tracer, acquired);
+    aws_mem_release(tracer, reallocated);
+    aws_mem_tracer_destroy(tracer);
+    return 0;
+}
+AWS_TEST_CASE(test_memtrace_stacks_realloc, s_test_memtrace_stacks_realloc)
+
+static int s_test_memtrace_sampled(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    void *probe[1];
+    if (aws_backtrace(probe, 1) == 0) {
+        return 0;
+    }
+
+    struct aws_allocator *tracer = aws_mem_tracer_new(allocator, AWS_MEMTRACE_SAMPLED_STACKS, 4, 0);
+    ASSERT_NOT_NULL(tracer);
+
+    void *allocs[NUM_ALLOCS] = {0};
+    for (size_t idx = 0; idx < NUM_ALLOCS; ++idx) {
+        allocs[idx] = s_alloc_small(tracer);
+        ASSERT_NOT_NULL(allocs[idx]);
+    }
+
+    /* only 1 in 4 allocations are attributed to a stack, but all of them are counted */
+    struct aws_mem_trace_stack_stats stack;
+    ASSERT_UINT_EQUALS(1, aws_mem_tracer_top_stacks(tracer, &stack, 1));
+    ASSERT_UINT_EQUALS(NUM_ALLOCS / 4, stack.total_allocs);
+
+    struct aws_mem_trace_stats stats;
+    aws_mem_tracer_get_stats(tracer, &stats);
+    ASSERT_UINT_EQUALS(NUM_ALLOCS, stats.total_allocs);
+
+    for (size_t idx = 0; idx < NUM_ALLOCS; ++idx) {
+        aws_mem_release(tracer, allocs[idx]);
+    }
+
+    aws_mem_tracer_destroy(tracer);
+    return 0;
+}
+AWS_TEST_CASE(test_memtrace_sampled, s_test_memtrace_sampled)
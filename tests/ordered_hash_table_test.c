@@ -0,0 +1,375 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/ordered_hash_table.h>
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <stdio.h>
+
+#include "benchmark_test_utilities.h"
+
+static size_t s_destroyed_values;
+
+static void s_count_destroyed_value(void *value) {
+    (void)value;
+    ++s_destroyed_values;
+}
+
+/* Checks the table holds exactly the expected keys, in order */
+static int s_check_order(struct aws_ordered_hash_table *table, const uintptr_t *expected, size_t count) {
+    size_t visited = 0;
+    for (struct aws_ordered_hash_iter iter = aws_ordered_hash_iter_begin(table); !aws_ordered_hash_iter_done(&iter);
+         aws_ordered_hash_iter_next(&iter)) {
+        struct aws_hash_element *elem = aws_ordered_hash_iter_get_element(&iter);
+        ASSERT_NOT_NULL(elem);
+        ASSERT_TRUE(visited < count);
+        ASSERT_UINT_EQUALS(expected[visited], (uintptr_t)elem->key);
+        ++visited;
+    }
+    ASSERT_UINT_EQUALS(count, visited);
+    ASSERT_UINT_EQUALS(count, aws_ordered_hash_table_get_entry_count(table));
+    return 0;
+}
+
+AWS_TEST_CASE(ordered_hash_table_insertion_order, s_ordered_hash_table_insertion_order)
+static int s_ordered_hash_table_insertion_order(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { ENTRY_COUNT = 1000 };
+
+    s_destroyed_values = 0;
+    struct aws_ordered_hash_table table;
+    ASSERT_SUCCESS(
+        aws_ordered_hash_table_init(&table, allocator, 0, aws_hash_ptr, aws_ptr_eq, NULL, s_count_destroyed_value));
+
+    /* keys in a scrambled order, so insertion order differs from any hash order; the table grows several times */
+    uintptr_t expected[ENTRY_COUNT];
+    for (uintptr_t i = 0; i < ENTRY_COUNT; ++i) {
+        expected[i] = (i * 7919) % ENTRY_COUNT + 1;
+        int was_created = 0;
+        ASSERT_SUCCESS(aws_ordered_hash_table_put(&table, (void *)expected[i], (void *)i, &was_created));
+        ASSERT_INT_EQUALS(1, was_created);
+    }
+    ASSERT_SUCCESS(s_check_order(&table, expected, ENTRY_COUNT));
+
+    /* overwriting keeps the position, and destroys the old value */
+    int was_created = 1;
+    ASSERT_SUCCESS(aws_ordered_hash_table_put(&table, (void *)expected[10], (void *)(uintptr_t)12345, &was_created));
+    ASSERT_INT_EQUALS(0, was_created);
+    ASSERT_UINT_EQUALS(1, s_destroyed_values);
+    ASSERT_SUCCESS(s_check_order(&table, expected, ENTRY_COUNT));
+
+    struct aws_hash_element *elem = NULL;
+    ASSERT_SUCCESS(aws_ordered_hash_table_find(&table, (void *)expected[10], &elem));
+    ASSERT_NOT_NULL(elem);
+    ASSERT_UINT_EQUALS(12345, (uintptr_t)elem->value);
+
+    /* removing and re-inserting moves a key to the end */
+    struct aws_hash_element removed;
+    int was_present = 0;
+    ASSERT_SUCCESS(aws_ordered_hash_table_remove(&table, (void *)expected[0], &removed, &was_present));
+    ASSERT_INT_EQUALS(1, was_present);
+    ASSERT_UINT_EQUALS(expected[0], (uintptr_t)removed.key);
+    ASSERT_UINT_EQUALS(1, s_destroyed_values);
+    ASSERT_SUCCESS(aws_ordered_hash_table_put(&table, removed.key, removed.value, NULL));
+
+    const uintptr_t first = expected[0];
+    memmove(expected, expected + 1, (ENTRY_COUNT - 1) * sizeof(uintptr_t));
+    expected[ENTRY_COUNT - 1] = first;
+    ASSERT_SUCCESS(s_check_order(&table, expected, ENTRY_COUNT));
+
+    ASSERT_SUCCESS(aws_ordered_hash_table_find(&table, (void *)(uintptr_t)(ENTRY_COUNT + 1), &elem));
+    ASSERT_NULL(elem);
+    ASSERT_SUCCESS(aws_ordered_hash_table_remove(&table, (void *)(uintptr_t)(ENTRY_COUNT + 1), NULL, &was_present));
+    ASSERT_INT_EQUALS(0, was_present);
+
+    aws_ordered_hash_table_clear(&table);
+    ASSERT_UINT_EQUALS(1 + ENTRY_COUNT, s_destroyed_values);
+    ASSERT_SUCCESS(s_check_order(&table, NULL, 0));
+
+    aws_ordered_hash_table_clean_up(&table);
+    aws_ordered_hash_table_clean_up(&table);
+    return 0;
+}
+
+AWS_TEST_CASE(ordered_hash_table_iter_survives_inserts, s_ordered_hash_table_iter_survives_inserts)
+static int s_ordered_hash_table_iter_survives_inserts(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { INITIAL_COUNT = 8, FINAL_COUNT = 4096 };
+
+    struct aws_ordered_hash_table table;
+    ASSERT_SUCCESS(aws_ordered_hash_table_init(&table, allocator, INITIAL_COUNT, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    for (uintptr_t key = 1; key <= INITIAL_COUNT; ++key) {
+        ASSERT_SUCCESS(aws_ordered_hash_table_put(&table, (void *)key, NULL, NULL));
+    }
+
+    /* every element visited inserts another, so the table keeps growing under the iterator */
+    uintptr_t next_key = INITIAL_COUNT + 1;
+    uintptr_t expected_key = 1;
+    for (struct aws_ordered_hash_iter iter = aws_ordered_hash_iter_begin(&table); !aws_ordered_hash_iter_done(&iter);
+         aws_ordered_hash_iter_next(&iter)) {
+        if (next_key <= FINAL_COUNT) {
+            ASSERT_SUCCESS(aws_ordered_hash_table_put(&table, (void *)next_key, NULL, NULL));
+            ++next_key;
+        }
+        struct aws_hash_element *elem = aws_ordered_hash_iter_get_element(&iter);
+        ASSERT_NOT_NULL(elem);
+        ASSERT_UINT_EQUALS(expected_key, (uintptr_t)elem->key);
+        ++expected_key;
+    }
+    ASSERT_UINT_EQUALS(FINAL_COUNT + 1, expected_key);
+    ASSERT_UINT_EQUALS(FINAL_COUNT, aws_ordered_hash_table_get_entry_count(&table));
+
+    aws_ordered_hash_table_clean_up(&table);
+    return 0;
+}
+
+static int s_delete_multiples_of_three(void *context, struct aws_hash_element *p_element) {
+    size_t *visited = context;
+    ++*visited;
+    if ((uintptr_t)p_element->key % 3 == 0) {
+        return AWS_COMMON_HASH_TABLE_ITER_CONTINUE | AWS_COMMON_HASH_TABLE_ITER_DELETE;
+    }
+    return AWS_COMMON_HASH_TABLE_ITER_CONTINUE;
+}
+
+AWS_TEST_CASE(ordered_hash_table_delete_during_iteration, s_ordered_hash_table_delete_during_iteration)
+static int s_ordered_hash_table_delete_during_iteration(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { ENTRY_COUNT = 3000 };
+
+    s_destroyed_values = 0;
+    struct aws_ordered_hash_table table;
+    ASSERT_SUCCESS(
+        aws_ordered_hash_table_init(&table, allocator, 16, aws_hash_ptr, aws_ptr_eq, NULL, s_count_destroyed_value));
+    for (uintptr_t key = 1; key <= ENTRY_COUNT; ++key) {
+        ASSERT_SUCCESS(aws_ordered_hash_table_put(&table, (void *)key, NULL, NULL));
+    }
+
+    /* delete the even keys through the iterator, which stays on the deleted element until moved on */
+    size_t destroyed = 0;
+    for (struct aws_ordered_hash_iter iter = aws_ordered_hash_iter_begin(&table); !aws_ordered_hash_iter_done(&iter);
+         aws_ordered_hash_iter_next(&iter)) {
+        uintptr_t key = (uintptr_t)aws_ordered_hash_iter_get_element(&iter)->key;
+        if (key % 2 == 0) {
+            const bool destroy_contents = key % 4 == 0;
+            aws_ordered_hash_iter_delete(&iter, destroy_contents);
+            destroyed += destroy_contents;
+            ASSERT_NULL(aws_ordered_hash_iter_get_element(&iter));
+        }
+    }
+    ASSERT_UINT_EQUALS(destroyed, s_destroyed_values);
+
+    /* the sweep left tombstones in half the entries, which stay until an insert needs the room */
+    ASSERT_UINT_EQUALS(ENTRY_COUNT / 2, aws_ordered_hash_table_get_entry_count(&table));
+    ASSERT_UINT_EQUALS(ENTRY_COUNT, table.entries_used);
+
+    /* foreach deletes without destroying */
+    size_t visited = 0;
+    ASSERT_SUCCESS(aws_ordered_hash_table_foreach(&table, s_delete_multiples_of_three, &visited));
+    ASSERT_UINT_EQUALS(ENTRY_COUNT / 2, visited);
+    ASSERT_UINT_EQUALS(destroyed, s_destroyed_values);
+
+    uintptr_t expected[ENTRY_COUNT];
+    size_t expected_count = 0;
+    for (uintptr_t key = 1; key <= ENTRY_COUNT; ++key) {
+        if (key % 2 != 0 && key % 3 != 0) {
+            expected[expected_count++] = key;
+        }
+    }
+    ASSERT_SUCCESS(s_check_order(&table, expected, expected_count));
+    for (uintptr_t key = 1; key <= ENTRY_COUNT; ++key) {
+        struct aws_hash_element *elem = NULL;
+        ASSERT_SUCCESS(aws_ordered_hash_table_find(&table, (void *)key, &elem));
+        ASSERT_TRUE((elem != NULL) == (key % 2 != 0 && key % 3 != 0));
+    }
+
+    aws_ordered_hash_table_clean_up(&table);
+    return 0;
+}
+
+/*
+ * Removing other elements by key, ahead of an iterator and behind it, and then an insert which compacts the array,
+ * leave every iterator on its element or the next one still there.
+ */
+AWS_TEST_CASE(ordered_hash_table_iter_survives_removals, s_ordered_hash_table_iter_survives_removals)
+static int s_ordered_hash_table_iter_survives_removals(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_ordered_hash_table table;
+    ASSERT_SUCCESS(aws_ordered_hash_table_init(&table, allocator, 64, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    uintptr_t capacity = 0;
+    while (table.entries_used < table.entries_capacity) {
+        ASSERT_SUCCESS(aws_ordered_hash_table_put(&table, (void *)++capacity, NULL, NULL));
+    }
+    const size_t entries_capacity = table.entries_capacity;
+
+    struct aws_ordered_hash_iter parked = aws_ordered_hash_iter_begin(&table);
+    const uintptr_t midway = capacity / 2 + 1;
+    uintptr_t expected_key = 1;
+    for (struct aws_ordered_hash_iter iter = aws_ordered_hash_iter_begin(&table); !aws_ordered_hash_iter_done(&iter);
+         aws_ordered_hash_iter_next(&iter)) {
+        struct aws_hash_element *elem = aws_ordered_hash_iter_get_element(&iter);
+        ASSERT_NOT_NULL(elem);
+        const uintptr_t key = (uintptr_t)elem->key;
+        ASSERT_UINT_EQUALS(expected_key, key);
+        expected_key = key == capacity - 1 ? capacity + 1 : key + 2;
+
+        ASSERT_SUCCESS(aws_ordered_hash_table_remove(&table, (void *)(key + 1), NULL, NULL));
+        if (key == midway) {
+            /* half the array is now tombstones, so the next insert compacts it rather than growing it */
+            for (uintptr_t behind = 2; behind < key; ++behind) {
+                ASSERT_SUCCESS(aws_ordered_hash_table_remove(&table, (void *)behind, NULL, NULL));
+            }
+            ASSERT_SUCCESS(aws_ordered_hash_table_put(&table, (void *)(capacity + 1), NULL, NULL));
+            ASSERT_UINT_EQUALS(entries_capacity, table.entries_capacity);
+            ASSERT_UINT_EQUALS(aws_ordered_hash_table_get_entry_count(&table), table.entries_used);
+        }
+    }
+    ASSERT_UINT_EQUALS(capacity + 3, expected_key);
+
+    ASSERT_UINT_EQUALS(1, (uintptr_t)aws_ordered_hash_iter_get_element(&parked)->key);
+    aws_ordered_hash_iter_delete(&parked, false);
+    aws_ordered_hash_iter_next(&parked);
+    ASSERT_UINT_EQUALS(midway, (uintptr_t)aws_ordered_hash_iter_get_element(&parked)->key);
+
+    aws_ordered_hash_table_clean_up(&table);
+    return 0;
+}
+
+AWS_TEST_CASE(ordered_hash_table_churn, s_ordered_hash_table_churn)
+static int s_ordered_hash_table_churn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { KEY_SPACE = 3000, OPERATIONS = 200000 };
+
+    struct aws_ordered_hash_table table;
+    ASSERT_SUCCESS(aws_ordered_hash_table_init(&table, allocator, 16, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    struct aws_hash_table reference;
+    ASSERT_SUCCESS(aws_hash_table_init(&reference, allocator, 16, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    for (uintptr_t op = 1; op <= OPERATIONS; ++op) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        void *key = (void *)(uintptr_t)(rng % KEY_SPACE + 1);
+
+        if (rng & (1ULL << 40)) {
+            /* the value is when the key was inserted, which never changes until it is removed */
+            struct aws_hash_element *elem = NULL;
+            int was_created = 0;
+            ASSERT_SUCCESS(aws_ordered_hash_table_create(&table, key, &elem, &was_created));
+            if (was_created) {
+                elem->value = (void *)op;
+            }
+            ASSERT_SUCCESS(aws_hash_table_put(&reference, key, elem->value, NULL));
+        } else {
+            int was_present = 0;
+            int was_present_reference = 0;
+            ASSERT_SUCCESS(aws_ordered_hash_table_remove(&table, key, NULL, &was_present));
+            ASSERT_SUCCESS(aws_hash_table_remove(&reference, key, NULL, &was_present_reference));
+            ASSERT_INT_EQUALS(was_present_reference, was_present);
+        }
+        ASSERT_UINT_EQUALS(
+            aws_hash_table_get_entry_count(&reference), aws_ordered_hash_table_get_entry_count(&table));
+    }
+
+    /* iteration is in insertion order, and matches the reference */
+    uintptr_t last_inserted = 0;
+    size_t visited = 0;
+    for (struct aws_ordered_hash_iter iter = aws_ordered_hash_iter_begin(&table); !aws_ordered_hash_iter_done(&iter);
+         aws_ordered_hash_iter_next(&iter)) {
+        struct aws_hash_element *elem = aws_ordered_hash_iter_get_element(&iter);
+        ASSERT_TRUE((uintptr_t)elem->value > last_inserted);
+        last_inserted = (uintptr_t)elem->value;
+
+        struct aws_hash_element *reference_elem = NULL;
+        ASSERT_SUCCESS(aws_hash_table_find(&reference, elem->key, &reference_elem));
+        ASSERT_NOT_NULL(reference_elem);
+        ASSERT_PTR_EQUALS(reference_elem->value, elem->value);
+        ++visited;
+    }
+    ASSERT_UINT_EQUALS(aws_hash_table_get_entry_count(&reference), visited);
+
+    aws_ordered_hash_table_clean_up(&table);
+    aws_hash_table_clean_up(&reference);
+    return 0;
+}
+
+static int s_sweep_one_in_eight_live(void *context, struct aws_hash_element *p_element) {
+    size_t *visited = context;
+    ++*visited;
+    /* the live keys are the multiples of 16 */
+    if ((uintptr_t)p_element->key % 128 == 0) {
+        return AWS_COMMON_HASH_TABLE_ITER_CONTINUE | AWS_COMMON_HASH_TABLE_ITER_DELETE;
+    }
+    return AWS_COMMON_HASH_TABLE_ITER_CONTINUE;
+}
+
+/*
+ * Repeated expiry-style sweeps over a table which was once much fuller: aws_hash_table_foreach walks every slot of
+ * the sparse table, while the ordered table walks only its dense array, compacted once new arrivals need the room.
+ */
+AWS_TEST_CASE(ordered_hash_table_sweep_benchmark, s_ordered_hash_table_sweep_benchmark)
+static int s_ordered_hash_table_sweep_benchmark(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+    enum { PEAK_COUNT = 1 << 20, LIVE_COUNT = PEAK_COUNT / 16, SWEEPS = 20 };
+
+    struct aws_hash_table hash_table;
+    ASSERT_SUCCESS(aws_hash_table_init(&hash_table, allocator, 16, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    struct aws_ordered_hash_table ordered;
+    ASSERT_SUCCESS(aws_ordered_hash_table_init(&ordered, allocator, 16, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    for (uintptr_t key = 1; key <= PEAK_COUNT; ++key) {
+        ASSERT_SUCCESS(aws_hash_table_put(&hash_table, (void *)key, NULL, NULL));
+        ASSERT_SUCCESS(aws_ordered_hash_table_put(&ordered, (void *)key, NULL, NULL));
+    }
+    for (uintptr_t key = 1; key <= PEAK_COUNT; ++key) {
+        if (key % 16 != 0) {
+            ASSERT_SUCCESS(aws_hash_table_remove(&hash_table, (void *)key, NULL, NULL));
+            ASSERT_SUCCESS(aws_ordered_hash_table_remove(&ordered, (void *)key, NULL, NULL));
+        }
+    }
+
+    long hash_table_elapsed = 0;
+    long ordered_elapsed = 0;
+    size_t hash_table_visited = 0;
+    size_t ordered_visited = 0;
+    for (int sweep = 0; sweep < SWEEPS; ++sweep) {
+        long start = benchmark_timestamp_us();
+        ASSERT_SUCCESS(aws_hash_table_foreach(&hash_table, s_sweep_one_in_eight_live, &hash_table_visited));
+        hash_table_elapsed += benchmark_timestamp_us() - start;
+
+        start = benchmark_timestamp_us();
+        ASSERT_SUCCESS(aws_ordered_hash_table_foreach(&ordered, s_sweep_one_in_eight_live, &ordered_visited));
+        ordered_elapsed += benchmark_timestamp_us() - start;
+
+        /* put back what was swept, as new arrivals would */
+        for (uintptr_t key = 128; key <= PEAK_COUNT; key += 128) {
+            ASSERT_SUCCESS(aws_hash_table_put(&hash_table, (void *)key, NULL, NULL));
+            ASSERT_SUCCESS(aws_ordered_hash_table_put(&ordered, (void *)key, NULL, NULL));
+        }
+    }
+    ASSERT_UINT_EQUALS(hash_table_visited, ordered_visited);
+    ASSERT_UINT_EQUALS(LIVE_COUNT, aws_ordered_hash_table_get_entry_count(&ordered));
+
+    printf("aws_hash_table: %d sweeps of %d elements elapsed=%ld us\n", SWEEPS, LIVE_COUNT, hash_table_elapsed);
+    printf("aws_ordered_hash_table: %d sweeps of %d elements elapsed=%ld us\n", SWEEPS, LIVE_COUNT, ordered_elapsed);
+
+    aws_hash_table_clean_up(&hash_table);
+    aws_ordered_hash_table_clean_up(&ordered);
+    return 0;
+}
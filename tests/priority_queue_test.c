@@ -17,8 +17,11 @@
 
 #include <aws/testing/aws_test_harness.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 
+#include "benchmark_test_utilities.h"
+
 static int s_compare_ints(const void *a, const void *b) {
     int arg1 = *(const int *)a;
     int arg2 = *(const int *)b;
@@ -461,6 +464,295 @@ static int s_test_remove_interior_sift_down(struct aws_allocator *allocator, voi
     return 0;
 }
 
+/* A timer-like element: the queues in these tests hold pointers to these, with a backpointer into each */
+struct pq_test_timer {
+    uint64_t time;
+    struct aws_priority_queue_node node;
+};
+
+static int s_compare_timers(const void *a, const void *b) {
+    uint64_t a_time = (*(struct pq_test_timer *const *)a)->time;
+    uint64_t b_time = (*(struct pq_test_timer *const *)b)->time;
+    return a_time > b_time; /* min-heap */
+}
+
+static uint64_t s_pq_test_rng_next(uint64_t *rng) {
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 7;
+    *rng ^= *rng << 17;
+    return *rng;
+}
+
+static int s_pq_test_push(struct aws_priority_queue *queue, struct pq_test_timer *timer) {
+    if (queue->key_size) {
+        return aws_priority_queue_push_keyed(queue, timer->time, &timer, &timer->node);
+    }
+    return aws_priority_queue_push_ref(queue, &timer, &timer->node);
+}
+
+static const size_t s_pq_test_arities[] = {2, 4, 8};
+
+/* Random pushes, removes and pops at every arity, with and without keys: pops must come out in order, and every
+ * backpointer must stay accurate */
+static int s_test_priority_queue_arity_random(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { TIMER_COUNT = 2000 };
+
+    struct pq_test_timer *timers = aws_mem_calloc(allocator, TIMER_COUNT, sizeof(struct pq_test_timer));
+    ASSERT_NOT_NULL(timers);
+
+    for (size_t arity_idx = 0; arity_idx < AWS_ARRAY_SIZE(s_pq_test_arities); ++arity_idx) {
+        for (int keyed = 0; keyed < 2; ++keyed) {
+            struct aws_priority_queue queue;
+            struct aws_priority_queue_options options = {
+                .initial_size = 4,
+                .item_size = sizeof(struct pq_test_timer *),
+                .pred = keyed ? NULL : s_compare_timers,
+                .arity = s_pq_test_arities[arity_idx],
+                .keyed = keyed,
+            };
+            ASSERT_SUCCESS(aws_priority_queue_init_dynamic_with_options(&queue, allocator, &options));
+
+            uint64_t rng = 0x9E3779B97F4A7C15ULL;
+            for (size_t i = 0; i < TIMER_COUNT; ++i) {
+                /* few distinct times, so that there are plenty of ties */
+                timers[i].time = s_pq_test_rng_next(&rng) % 500;
+                timers[i].node.current_index = SIZE_MAX;
+                ASSERT_SUCCESS(s_pq_test_push(&queue, &timers[i]));
+            }
+
+            /* remove a third, from anywhere in the heap */
+            size_t removed = 0;
+            for (size_t i = 0; i < TIMER_COUNT; ++i) {
+                if (s_pq_test_rng_next(&rng) % 3 == 0) {
+                    struct pq_test_timer *timer = NULL;
+                    ASSERT_SUCCESS(aws_priority_queue_remove(&queue, &timer, &timers[i].node));
+                    ASSERT_PTR_EQUALS(&timers[i], timer);
+                    ASSERT_UINT_EQUALS(SIZE_MAX, timers[i].node.current_index);
+                    ++removed;
+                }
+            }
+            ASSERT_UINT_EQUALS(TIMER_COUNT - removed, aws_priority_queue_size(&queue));
+
+            uint64_t last_time = 0;
+            for (size_t popped = 0; popped < TIMER_COUNT - removed; ++popped) {
+                struct pq_test_timer **top = NULL;
+                ASSERT_SUCCESS(aws_priority_queue_top(&queue, (void **)&top));
+                ASSERT_UINT_EQUALS(0, (*top)->node.current_index);
+                if (keyed) {
+                    uint64_t priority = 0;
+                    ASSERT_SUCCESS(aws_priority_queue_top_priority(&queue, &priority));
+                    ASSERT_UINT_EQUALS((*top)->time, priority);
+                }
+
+                struct pq_test_timer *timer = NULL;
+                ASSERT_SUCCESS(aws_priority_queue_pop(&queue, &timer));
+                ASSERT_TRUE(timer->time >= last_time);
+                ASSERT_UINT_EQUALS(SIZE_MAX, timer->node.current_index);
+                last_time = timer->time;
+
+                /* every so often, check that each remaining backpointer knows where its element is */
+                if (popped % 256 == 0) {
+                    for (size_t i = 0; i < aws_priority_queue_size(&queue); ++i) {
+                        struct pq_test_timer **element = NULL;
+                        ASSERT_SUCCESS(aws_array_list_get_at_ptr(&queue.container, (void **)&element, i));
+                        element = (struct pq_test_timer **)((uint8_t *)element + queue.key_size);
+                        ASSERT_UINT_EQUALS(i, (*element)->node.current_index);
+                    }
+                }
+            }
+            ASSERT_ERROR(AWS_ERROR_PRIORITY_QUEUE_EMPTY, aws_priority_queue_pop(&queue, &last_time));
+
+            aws_priority_queue_clean_up(&queue);
+        }
+    }
+
+    aws_mem_release(allocator, timers);
+    return 0;
+}
+
+/* Keyed mode copies items of any size in and out intact, and the plain and keyed calls don't mix */
+static int s_test_priority_queue_keyed(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct odd_sized_item {
+        uint8_t bytes[13];
+    };
+
+    struct aws_priority_queue queue;
+    struct aws_priority_queue_options options = {
+        .item_size = sizeof(struct odd_sized_item),
+        .arity = 4,
+        .keyed = true,
+    };
+    ASSERT_SUCCESS(aws_priority_queue_init_dynamic_with_options(&queue, allocator, &options));
+
+    struct odd_sized_item item;
+    uint64_t priority = 0;
+    ASSERT_ERROR(AWS_ERROR_PRIORITY_QUEUE_EMPTY, aws_priority_queue_top_priority(&queue, &priority));
+    ASSERT_ERROR(AWS_ERROR_UNSUPPORTED_OPERATION, aws_priority_queue_push(&queue, &item));
+
+    for (uint8_t i = 0; i < 50; ++i) {
+        memset(item.bytes, i, sizeof(item.bytes));
+        ASSERT_SUCCESS(aws_priority_queue_push_keyed(&queue, (uint64_t)(i * 37 % 50) << 40, &item, NULL));
+    }
+    for (uint64_t expected = 0; expected < 50; ++expected) {
+        ASSERT_SUCCESS(aws_priority_queue_top_priority(&queue, &priority));
+        ASSERT_UINT_EQUALS(expected << 40, priority);
+
+        struct odd_sized_item *top = NULL;
+        ASSERT_SUCCESS(aws_priority_queue_top(&queue, (void **)&top));
+        struct odd_sized_item top_copy = *top;
+        ASSERT_SUCCESS(aws_priority_queue_pop(&queue, &item));
+        ASSERT_INT_EQUALS(0, memcmp(&top_copy, &item, sizeof(item)));
+        for (size_t b = 0; b < sizeof(item.bytes); ++b) {
+            ASSERT_UINT_EQUALS(item.bytes[0], item.bytes[b]);
+        }
+        ASSERT_UINT_EQUALS(expected, (uint64_t)item.bytes[0] * 37 % 50);
+    }
+    aws_priority_queue_clean_up(&queue);
+
+    ASSERT_SUCCESS(aws_priority_queue_init_dynamic(&queue, allocator, 4, sizeof(int), s_compare_ints));
+    int value = 1;
+    ASSERT_ERROR(AWS_ERROR_UNSUPPORTED_OPERATION, aws_priority_queue_push_keyed(&queue, 1, &value, NULL));
+    ASSERT_ERROR(AWS_ERROR_UNSUPPORTED_OPERATION, aws_priority_queue_top_priority(&queue, &priority));
+    aws_priority_queue_clean_up(&queue);
+
+    options.arity = 3;
+    ASSERT_ERROR(AWS_ERROR_INVALID_ARGUMENT, aws_priority_queue_init_dynamic_with_options(&queue, allocator, &options));
+    options.arity = 8;
+    options.keyed = false;
+    ASSERT_ERROR(AWS_ERROR_INVALID_ARGUMENT, aws_priority_queue_init_dynamic_with_options(&queue, allocator, &options));
+    return 0;
+}
+
+/* Timers whose times change in place, each followed by an update, pop in order of their new times */
+static int s_test_priority_queue_update(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { TIMER_COUNT = 1000 };
+
+    struct pq_test_timer *timers = aws_mem_calloc(allocator, TIMER_COUNT, sizeof(struct pq_test_timer));
+    ASSERT_NOT_NULL(timers);
+
+    for (size_t arity_idx = 0; arity_idx < AWS_ARRAY_SIZE(s_pq_test_arities); ++arity_idx) {
+        for (int keyed = 0; keyed < 2; ++keyed) {
+            struct aws_priority_queue queue;
+            struct aws_priority_queue_options options = {
+                .initial_size = 4,
+                .item_size = sizeof(struct pq_test_timer *),
+                .pred = keyed ? NULL : s_compare_timers,
+                .arity = s_pq_test_arities[arity_idx],
+                .keyed = keyed,
+            };
+            ASSERT_SUCCESS(aws_priority_queue_init_dynamic_with_options(&queue, allocator, &options));
+
+            uint64_t rng = 0x9E3779B97F4A7C15ULL;
+            for (size_t i = 0; i < TIMER_COUNT; ++i) {
+                timers[i].time = s_pq_test_rng_next(&rng) % 500;
+                ASSERT_SUCCESS(s_pq_test_push(&queue, &timers[i]));
+            }
+
+            /* move timers both earlier and later */
+            for (size_t round = 0; round < TIMER_COUNT * 2; ++round) {
+                struct pq_test_timer *timer = &timers[s_pq_test_rng_next(&rng) % TIMER_COUNT];
+                timer->time = s_pq_test_rng_next(&rng) % 1000;
+                if (keyed) {
+                    ASSERT_SUCCESS(aws_priority_queue_update_keyed(&queue, timer->time, &timer->node));
+                } else {
+                    ASSERT_SUCCESS(aws_priority_queue_update(&queue, &timer->node));
+                }
+            }
+            if (keyed) {
+                ASSERT_ERROR(AWS_ERROR_UNSUPPORTED_OPERATION, aws_priority_queue_update(&queue, &timers[0].node));
+            } else {
+                ASSERT_ERROR(
+                    AWS_ERROR_UNSUPPORTED_OPERATION, aws_priority_queue_update_keyed(&queue, 0, &timers[0].node));
+            }
+
+            uint64_t last_time = 0;
+            for (size_t popped = 0; popped < TIMER_COUNT; ++popped) {
+                struct pq_test_timer *timer = NULL;
+                ASSERT_SUCCESS(aws_priority_queue_pop(&queue, &timer));
+                ASSERT_TRUE(timer->time >= last_time);
+                last_time = timer->time;
+            }
+
+            ASSERT_ERROR(
+                AWS_ERROR_PRIORITY_QUEUE_BAD_NODE,
+                keyed ? aws_priority_queue_update_keyed(&queue, 0, &timers[0].node)
+                      : aws_priority_queue_update(&queue, &timers[0].node));
+            aws_priority_queue_clean_up(&queue);
+        }
+    }
+
+    aws_mem_release(allocator, timers);
+    return 0;
+}
+
+/*
+ * A queue of timers, as an event loop would have: push them all, cancel a quarter, then pop the rest in order. Times
+ * are compared through the element pointer by callback, or inline in keyed mode.
+ */
+static int s_test_priority_queue_benchmark(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+    enum { TIMER_COUNT = 200000 };
+
+    struct pq_test_timer *timers = aws_mem_calloc(allocator, TIMER_COUNT, sizeof(struct pq_test_timer));
+    ASSERT_NOT_NULL(timers);
+
+    for (int keyed = 0; keyed < 2; ++keyed) {
+        for (size_t arity_idx = 0; arity_idx < AWS_ARRAY_SIZE(s_pq_test_arities); ++arity_idx) {
+            struct aws_priority_queue queue;
+            struct aws_priority_queue_options options = {
+                .initial_size = 16,
+                .item_size = sizeof(struct pq_test_timer *),
+                .pred = s_compare_timers,
+                .arity = s_pq_test_arities[arity_idx],
+                .keyed = keyed,
+            };
+            ASSERT_SUCCESS(aws_priority_queue_init_dynamic_with_options(&queue, allocator, &options));
+
+            uint64_t rng = 0x9E3779B97F4A7C15ULL;
+            for (size_t i = 0; i < TIMER_COUNT; ++i) {
+                timers[i].time = s_pq_test_rng_next(&rng) % 1000000000;
+            }
+
+            long start = benchmark_timestamp_us();
+            for (size_t i = 0; i < TIMER_COUNT; ++i) {
+                ASSERT_SUCCESS(s_pq_test_push(&queue, &timers[i]));
+            }
+            long pushed = benchmark_timestamp_us();
+            struct pq_test_timer *timer = NULL;
+            for (size_t i = 0; i < TIMER_COUNT; i += 4) {
+                ASSERT_SUCCESS(aws_priority_queue_remove(&queue, &timer, &timers[i].node));
+            }
+            long removed = benchmark_timestamp_us();
+            uint64_t last_time = 0;
+            while (aws_priority_queue_size(&queue)) {
+                ASSERT_SUCCESS(aws_priority_queue_pop(&queue, &timer));
+                ASSERT_TRUE(timer->time >= last_time);
+                last_time = timer->time;
+            }
+            long popped = benchmark_timestamp_us();
+
+            printf(
+                "%s %zu-ary heap: push elapsed=%ld us, remove elapsed=%ld us, pop elapsed=%ld us\n",
+                keyed ? "keyed" : "callback",
+                s_pq_test_arities[arity_idx],
+                pushed - start,
+                removed - pushed,
+                popped - removed);
+
+            aws_priority_queue_clean_up(&queue);
+        }
+    }
+
+    aws_mem_release(allocator, timers);
+    return 0;
+}
+
 AWS_TEST_CASE(priority_queue_remove_interior_sift_down_test, s_test_remove_interior_sift_down);
 AWS_TEST_CASE(priority_queue_remove_interior_sift_up_test, s_test_remove_interior_sift_up);
 AWS_TEST_CASE(priority_queue_remove_leaf_test, s_test_remove_leaf);
@@ -468,3 +760,7 @@ AWS_TEST_CASE(priority_queue_remove_root_test, s_test_remove_root);
 AWS_TEST_CASE(priority_queue_push_pop_order_test, s_test_priority_queue_preserves_order);
 AWS_TEST_CASE(priority_queue_random_values_test, s_test_priority_queue_random_values);
 AWS_TEST_CASE(priority_queue_size_and_capacity_test, s_test_priority_queue_size_and_capacity);
+AWS_TEST_CASE(priority_queue_arity_random_test, s_test_priority_queue_arity_random);
+AWS_TEST_CASE(priority_queue_keyed_test, s_test_priority_queue_keyed);
+AWS_TEST_CASE(priority_queue_update_test, s_test_priority_queue_update);
+AWS_TEST_CASE(priority_queue_benchmark, s_test_priority_queue_benchmark);
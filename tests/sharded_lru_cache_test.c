@@ -0,0 +1,314 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/sharded_lru_cache.h>
+
+#include <aws/common/atomics.h>
+#include <aws/common/mutex.h>
+#include <aws/common/thread.h>
+#include <aws/testing/aws_test_harness.h>
+
+#include <stdio.h>
+
+#include "benchmark_test_utilities.h"
+
+static struct aws_atomic_var s_destroyed_values;
+static struct aws_atomic_var s_acquired_values;
+
+static void s_count_destroyed_value(void *value) {
+    (void)value;
+    aws_atomic_fetch_add(&s_destroyed_values, 1);
+}
+
+static void s_count_acquired_value(void *value) {
+    (void)value;
+    aws_atomic_fetch_add(&s_acquired_values, 1);
+}
+
+AWS_TEST_CASE(sharded_lru_cache_put_find_remove, s_sharded_lru_cache_put_find_remove)
+static int s_sharded_lru_cache_put_find_remove(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { MAX_ITEMS = 64, PUTS = 1000 };
+    aws_atomic_init_int(&s_destroyed_values, 0);
+    aws_atomic_init_int(&s_acquired_values, 0);
+
+    struct aws_sharded_lru_cache cache;
+    struct aws_sharded_lru_cache_options options = {
+        .hash_fn = aws_hash_ptr,
+        .equals_fn = aws_ptr_eq,
+        .destroy_value_fn = s_count_destroyed_value,
+        .acquire_value_fn = s_count_acquired_value,
+        .max_items = MAX_ITEMS,
+        .shard_count = 3,
+    };
+    ASSERT_SUCCESS(aws_sharded_lru_cache_init(&cache, allocator, &options));
+    ASSERT_UINT_EQUALS(4, cache.shard_count);
+
+    /* each shard fills up to its 16 items and then evicts */
+    for (uintptr_t key = 1; key <= PUTS; ++key) {
+        ASSERT_SUCCESS(aws_sharded_lru_cache_put(&cache, (void *)key, (void *)(key * 2)));
+    }
+    ASSERT_UINT_EQUALS(MAX_ITEMS, aws_sharded_lru_cache_get_element_count(&cache));
+    ASSERT_UINT_EQUALS(PUTS - MAX_ITEMS, aws_atomic_load_int(&s_destroyed_values));
+
+    size_t found = 0;
+    uintptr_t found_key = 0;
+    for (uintptr_t key = 1; key <= PUTS; ++key) {
+        void *value = NULL;
+        ASSERT_SUCCESS(aws_sharded_lru_cache_find(&cache, (void *)key, &value));
+        if (value) {
+            ASSERT_PTR_EQUALS((void *)(key * 2), value);
+            found_key = key;
+            ++found;
+        }
+    }
+    ASSERT_UINT_EQUALS(MAX_ITEMS, found);
+    ASSERT_UINT_EQUALS(MAX_ITEMS, aws_atomic_load_int(&s_acquired_values));
+
+    struct aws_sharded_lru_cache_stats stats;
+    aws_sharded_lru_cache_get_stats(&cache, &stats);
+    ASSERT_UINT_EQUALS(MAX_ITEMS, stats.element_count);
+    ASSERT_UINT_EQUALS(MAX_ITEMS, stats.hits);
+    ASSERT_UINT_EQUALS(PUTS - MAX_ITEMS, stats.misses);
+    ASSERT_UINT_EQUALS(PUTS - MAX_ITEMS, stats.evictions);
+
+    /* removal and overwrites destroy values, but aren't evictions */
+    ASSERT_SUCCESS(aws_sharded_lru_cache_remove(&cache, (void *)found_key));
+    ASSERT_UINT_EQUALS(MAX_ITEMS - 1, aws_sharded_lru_cache_get_element_count(&cache));
+    ASSERT_UINT_EQUALS(PUTS - MAX_ITEMS + 1, aws_atomic_load_int(&s_destroyed_values));
+    void *value = NULL;
+    ASSERT_SUCCESS(aws_sharded_lru_cache_find(&cache, (void *)found_key, &value));
+    ASSERT_NULL(value);
+
+    aws_sharded_lru_cache_clear(&cache);
+    ASSERT_UINT_EQUALS(0, aws_sharded_lru_cache_get_element_count(&cache));
+    ASSERT_UINT_EQUALS(PUTS, aws_atomic_load_int(&s_destroyed_values));
+    aws_sharded_lru_cache_get_stats(&cache, &stats);
+    ASSERT_UINT_EQUALS(PUTS - MAX_ITEMS, stats.evictions);
+
+    aws_sharded_lru_cache_clean_up(&cache);
+    aws_sharded_lru_cache_clean_up(&cache);
+    return 0;
+}
+
+AWS_TEST_CASE(sharded_lru_cache_cost_over_shard_budget, s_sharded_lru_cache_cost_over_shard_budget)
+static int s_sharded_lru_cache_cost_over_shard_budget(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { MAX_COST = 100, SMALL_KEYS = 64 };
+    aws_atomic_init_int(&s_destroyed_values, 0);
+
+    struct aws_sharded_lru_cache cache;
+    struct aws_sharded_lru_cache_options options = {
+        .hash_fn = aws_hash_ptr,
+        .equals_fn = aws_ptr_eq,
+        .destroy_value_fn = s_count_destroyed_value,
+        .max_cost = MAX_COST,
+        .shard_count = 4,
+    };
+    ASSERT_SUCCESS(aws_sharded_lru_cache_init(&cache, allocator, &options));
+
+    for (uintptr_t key = 1; key <= SMALL_KEYS; ++key) {
+        ASSERT_SUCCESS(aws_sharded_lru_cache_put_with_cost(&cache, (void *)key, (void *)key, 1));
+    }
+    size_t small_count = aws_sharded_lru_cache_get_element_count(&cache);
+
+    /* well over a shard's budget of 25, but within the cache's */
+    uintptr_t big_key = 1000;
+    ASSERT_SUCCESS(aws_sharded_lru_cache_put_with_cost(&cache, (void *)big_key, (void *)big_key, MAX_COST - 10));
+    void *value = NULL;
+    ASSERT_SUCCESS(aws_sharded_lru_cache_find(&cache, (void *)big_key, &value));
+    ASSERT_PTR_EQUALS((void *)big_key, value);
+
+    /* it evicted the rest of its shard, and nothing from the others */
+    struct aws_sharded_lru_cache_stats stats;
+    aws_sharded_lru_cache_get_stats(&cache, &stats);
+    ASSERT_TRUE(stats.element_count <= small_count);
+    ASSERT_UINT_EQUALS(small_count + 1 - stats.element_count, aws_atomic_load_int(&s_destroyed_values));
+    ASSERT_UINT_EQUALS(MAX_COST - 10 + stats.element_count - 1, stats.total_cost);
+
+    /* over the whole budget is still rejected, leaving the cache unchanged */
+    ASSERT_ERROR(
+        AWS_ERROR_INVALID_ARGUMENT,
+        aws_sharded_lru_cache_put_with_cost(&cache, (void *)(big_key + 1), (void *)big_key, MAX_COST + 1));
+    ASSERT_SUCCESS(aws_sharded_lru_cache_find(&cache, (void *)big_key, &value));
+    ASSERT_PTR_EQUALS((void *)big_key, value);
+
+    aws_sharded_lru_cache_clean_up(&cache);
+    return 0;
+}
+
+enum {
+    MT_THREAD_COUNT = 4,
+    MT_KEY_SPACE = 4096,
+    MT_MAX_ITEMS = 1024,
+    MT_OPERATIONS = 50000,
+};
+
+struct mt_test_data {
+    struct aws_sharded_lru_cache *cache;
+    /* a cache with a single lock around it, for comparison */
+    struct aws_lru_cache *locked_cache;
+    struct aws_mutex *lock;
+    uint64_t seed;
+    size_t finds;
+    size_t bad_reads;
+};
+
+/* A mix of finds, puts on miss and occasional removes over a skewed key space */
+static void s_mt_worker(void *arg) {
+    struct mt_test_data *data = arg;
+    uint64_t rng = data->seed;
+
+    for (size_t op = 0; op < MT_OPERATIONS; ++op) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        const uintptr_t key = (uintptr_t)((rng % MT_KEY_SPACE) * (rng % MT_KEY_SPACE) / MT_KEY_SPACE) + 1;
+
+        void *value = NULL;
+        if (data->cache) {
+            if (rng & (1ULL << 50)) {
+                aws_sharded_lru_cache_remove(data->cache, (void *)key);
+                continue;
+            }
+            aws_sharded_lru_cache_find(data->cache, (void *)key, &value);
+            if (!value) {
+                aws_sharded_lru_cache_put(data->cache, (void *)key, (void *)(key * 2));
+            }
+        } else {
+            aws_mutex_lock(data->lock);
+            if (rng & (1ULL << 50)) {
+                aws_lru_cache_remove(data->locked_cache, (void *)key);
+                aws_mutex_unlock(data->lock);
+                continue;
+            }
+            aws_lru_cache_find(data->locked_cache, (void *)key, &value);
+            if (!value) {
+                aws_lru_cache_put(data->locked_cache, (void *)key, (void *)(key * 2));
+            }
+            aws_mutex_unlock(data->lock);
+        }
+
+        ++data->finds;
+        if (value && value != (void *)(key * 2)) {
+            ++data->bad_reads;
+        }
+    }
+}
+
+static int s_run_workers(struct aws_allocator *allocator, struct mt_test_data *data) {
+    struct aws_thread threads[MT_THREAD_COUNT];
+    for (size_t idx = 0; idx < MT_THREAD_COUNT; ++idx) {
+        ASSERT_SUCCESS(aws_thread_init(&threads[idx], allocator));
+        ASSERT_SUCCESS(aws_thread_launch(&threads[idx], s_mt_worker, &data[idx], NULL));
+    }
+    for (size_t idx = 0; idx < MT_THREAD_COUNT; ++idx) {
+        ASSERT_SUCCESS(aws_thread_join(&threads[idx]));
+        aws_thread_clean_up(&threads[idx]);
+        ASSERT_UINT_EQUALS(0, data[idx].bad_reads);
+    }
+    return 0;
+}
+
+AWS_TEST_CASE(sharded_lru_cache_multi_threaded, s_sharded_lru_cache_multi_threaded)
+static int s_sharded_lru_cache_multi_threaded(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_sharded_lru_cache cache;
+    struct aws_sharded_lru_cache_options options = {
+        .hash_fn = aws_hash_ptr,
+        .equals_fn = aws_ptr_eq,
+        .max_items = MT_MAX_ITEMS,
+    };
+    ASSERT_SUCCESS(aws_sharded_lru_cache_init(&cache, allocator, &options));
+
+    struct mt_test_data data[MT_THREAD_COUNT];
+    for (size_t idx = 0; idx < MT_THREAD_COUNT; ++idx) {
+        AWS_ZERO_STRUCT(data[idx]);
+        data[idx].cache = &cache;
+        data[idx].seed = 0x9E3779B97F4A7C15ULL * (idx + 1);
+    }
+    ASSERT_SUCCESS(s_run_workers(allocator, data));
+
+    size_t finds = 0;
+    for (size_t idx = 0; idx < MT_THREAD_COUNT; ++idx) {
+        finds += data[idx].finds;
+    }
+
+    struct aws_sharded_lru_cache_stats stats;
+    aws_sharded_lru_cache_get_stats(&cache, &stats);
+    ASSERT_UINT_EQUALS(finds, stats.hits + stats.misses);
+    ASSERT_TRUE(stats.hits > 0);
+    ASSERT_TRUE(stats.element_count <= MT_MAX_ITEMS + cache.shard_count);
+
+    aws_sharded_lru_cache_clean_up(&cache);
+    return 0;
+}
+
+/* The same multi-threaded workload against one aws_lru_cache behind a mutex, and against the sharded cache */
+AWS_TEST_CASE(sharded_lru_cache_benchmark, s_sharded_lru_cache_benchmark)
+static int s_sharded_lru_cache_benchmark(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+
+    struct aws_mutex lock = AWS_MUTEX_INIT;
+    struct aws_lru_cache locked_cache;
+    ASSERT_SUCCESS(aws_lru_cache_init(&locked_cache, allocator, aws_hash_ptr, aws_ptr_eq, NULL, NULL, MT_MAX_ITEMS));
+    struct mt_test_data data[MT_THREAD_COUNT];
+    for (size_t idx = 0; idx < MT_THREAD_COUNT; ++idx) {
+        AWS_ZERO_STRUCT(data[idx]);
+        data[idx].locked_cache = &locked_cache;
+        data[idx].lock = &lock;
+        data[idx].seed = 0x9E3779B97F4A7C15ULL * (idx + 1);
+    }
+    long start = benchmark_timestamp_us();
+    ASSERT_SUCCESS(s_run_workers(allocator, data));
+    const long locked_elapsed = benchmark_timestamp_us() - start;
+    aws_lru_cache_clean_up(&locked_cache);
+    aws_mutex_clean_up(&lock);
+
+    struct aws_sharded_lru_cache cache;
+    struct aws_sharded_lru_cache_options options = {
+        .hash_fn = aws_hash_ptr,
+        .equals_fn = aws_ptr_eq,
+        .max_items = MT_MAX_ITEMS,
+        /* rather than the processor count, so that the shards are exercised on any machine */
+        .shard_count = 16,
+    };
+    ASSERT_SUCCESS(aws_sharded_lru_cache_init(&cache, allocator, &options));
+    for (size_t idx = 0; idx < MT_THREAD_COUNT; ++idx) {
+        AWS_ZERO_STRUCT(data[idx]);
+        data[idx].cache = &cache;
+        data[idx].seed = 0x9E3779B97F4A7C15ULL * (idx + 1);
+    }
+    start = benchmark_timestamp_us();
+    ASSERT_SUCCESS(s_run_workers(allocator, data));
+    const long sharded_elapsed = benchmark_timestamp_us() - start;
+
+    struct aws_sharded_lru_cache_stats stats;
+    aws_sharded_lru_cache_get_stats(&cache, &stats);
+    printf("aws_lru_cache with a mutex: %d threads elapsed=%ld us\n", MT_THREAD_COUNT, locked_elapsed);
+    printf(
+        "aws_sharded_lru_cache (%zu shards): %d threads elapsed=%ld us, hits=%llu, misses=%llu\n",
+        cache.shard_count,
+        MT_THREAD_COUNT,
+        sharded_elapsed,
+        (unsigned long long)stats.hits,
+        (unsigned long long)stats.misses);
+
+    aws_sharded_lru_cache_clean_up(&cache);
+    return 0;
+}
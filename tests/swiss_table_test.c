@@ -0,0 +1,365 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/common/swiss_table.h>
+
+#include <aws/common/string.h>
+#include <aws/testing/aws_test_harness.h>
+
+#include "benchmark_test_utilities.h"
+
+#include <stdio.h>
+
+static size_t s_destroyed_keys = 0;
+static size_t s_destroyed_values = 0;
+
+static void s_destroy_key(void *key) {
+    (void)key;
+    ++s_destroyed_keys;
+}
+
+static void s_destroy_value(void *value) {
+    (void)value;
+    ++s_destroyed_values;
+}
+
+static int s_count_and_delete_odd(void *context, struct aws_hash_element *p_element) {
+    size_t *visited = context;
+    ++*visited;
+    if ((uintptr_t)p_element->key & 1) {
+        return AWS_COMMON_HASH_TABLE_ITER_CONTINUE | AWS_COMMON_HASH_TABLE_ITER_DELETE;
+    }
+    return AWS_COMMON_HASH_TABLE_ITER_CONTINUE;
+}
+
+AWS_TEST_CASE(swiss_table_put_find_remove, s_swiss_table_put_find_remove)
+static int s_swiss_table_put_find_remove(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { ENTRY_COUNT = 10000 };
+
+    struct aws_swiss_table table;
+    ASSERT_SUCCESS(
+        aws_swiss_table_init(&table, allocator, 0, aws_hash_ptr, aws_ptr_eq, s_destroy_key, s_destroy_value));
+    ASSERT_NULL(table.slots);
+
+    struct aws_hash_element *elem = NULL;
+    ASSERT_SUCCESS(aws_swiss_table_find(&table, (void *)1, &elem));
+    ASSERT_NULL(elem);
+
+    /* keys start at 1 so that the NULL key can be tested separately */
+    for (uintptr_t key = 1; key <= ENTRY_COUNT; ++key) {
+        int was_created = 0;
+        ASSERT_SUCCESS(aws_swiss_table_put(&table, (void *)key, (void *)(key * 3), &was_created));
+        ASSERT_INT_EQUALS(1, was_created);
+    }
+    ASSERT_UINT_EQUALS(ENTRY_COUNT, aws_swiss_table_get_entry_count(&table));
+
+    for (uintptr_t key = 1; key <= ENTRY_COUNT; ++key) {
+        ASSERT_SUCCESS(aws_swiss_table_find(&table, (void *)key, &elem));
+        ASSERT_NOT_NULL(elem);
+        ASSERT_PTR_EQUALS((void *)key, elem->key);
+        ASSERT_PTR_EQUALS((void *)(key * 3), elem->value);
+    }
+    ASSERT_SUCCESS(aws_swiss_table_find(&table, (void *)(ENTRY_COUNT + 1), &elem));
+    ASSERT_NULL(elem);
+
+    /* overwriting destroys the old value, and the old key only if it is a different pointer */
+    int was_created = 1;
+    ASSERT_SUCCESS(aws_swiss_table_put(&table, (void *)7, (void *)70, &was_created));
+    ASSERT_INT_EQUALS(0, was_created);
+    ASSERT_UINT_EQUALS(0, s_destroyed_keys);
+    ASSERT_UINT_EQUALS(1, s_destroyed_values);
+
+    /* remove with and without taking ownership of the element */
+    struct aws_hash_element removed;
+    int was_present = 0;
+    ASSERT_SUCCESS(aws_swiss_table_remove(&table, (void *)7, &removed, &was_present));
+    ASSERT_INT_EQUALS(1, was_present);
+    ASSERT_PTR_EQUALS((void *)70, removed.value);
+    ASSERT_UINT_EQUALS(1, s_destroyed_values);
+    ASSERT_SUCCESS(aws_swiss_table_remove(&table, (void *)8, NULL, &was_present));
+    ASSERT_INT_EQUALS(1, was_present);
+    ASSERT_UINT_EQUALS(1, s_destroyed_keys);
+    ASSERT_UINT_EQUALS(2, s_destroyed_values);
+    ASSERT_SUCCESS(aws_swiss_table_remove(&table, (void *)8, NULL, &was_present));
+    ASSERT_INT_EQUALS(0, was_present);
+    ASSERT_UINT_EQUALS(ENTRY_COUNT - 2, aws_swiss_table_get_entry_count(&table));
+
+    /* the NULL key is a key like any other */
+    ASSERT_SUCCESS(aws_swiss_table_put(&table, NULL, (void *)1, NULL));
+    ASSERT_SUCCESS(aws_swiss_table_find(&table, NULL, &elem));
+    ASSERT_NOT_NULL(elem);
+    ASSERT_SUCCESS(aws_swiss_table_remove(&table, NULL, &removed, NULL));
+
+    /* delete through foreach: every odd key goes, which doesn't include 7 (already gone) */
+    size_t visited = 0;
+    ASSERT_SUCCESS(aws_swiss_table_foreach(&table, s_count_and_delete_odd, &visited));
+    ASSERT_UINT_EQUALS(ENTRY_COUNT - 2, visited);
+    ASSERT_UINT_EQUALS(ENTRY_COUNT / 2 - 1, aws_swiss_table_get_entry_count(&table));
+    for (uintptr_t key = 1; key <= ENTRY_COUNT; ++key) {
+        ASSERT_SUCCESS(aws_swiss_table_find(&table, (void *)key, &elem));
+        ASSERT_TRUE((elem != NULL) == (key % 2 == 0 && key != 8));
+    }
+
+    s_destroyed_keys = 0;
+    s_destroyed_values = 0;
+    aws_swiss_table_clean_up(&table);
+    ASSERT_UINT_EQUALS(ENTRY_COUNT / 2 - 1, s_destroyed_keys);
+    ASSERT_UINT_EQUALS(ENTRY_COUNT / 2 - 1, s_destroyed_values);
+    aws_swiss_table_clean_up(&table);
+
+    s_destroyed_keys = 0;
+    s_destroyed_values = 0;
+    return 0;
+}
+
+/* Random puts and removes over a small key space, so that tombstones pile up, checked against aws_hash_table */
+AWS_TEST_CASE(swiss_table_churn, s_swiss_table_churn)
+static int s_swiss_table_churn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { KEY_SPACE = 3000, OPERATIONS = 200000 };
+
+    struct aws_swiss_table table;
+    ASSERT_SUCCESS(aws_swiss_table_init(&table, allocator, 16, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    struct aws_hash_table reference;
+    ASSERT_SUCCESS(aws_hash_table_init(&reference, allocator, 16, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    for (size_t op = 0; op < OPERATIONS; ++op) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        void *key = (void *)(uintptr_t)(rng % KEY_SPACE + 1);
+
+        if (rng & (1ULL << 40)) {
+            ASSERT_SUCCESS(aws_swiss_table_put(&table, key, (void *)(uintptr_t)op, NULL));
+            ASSERT_SUCCESS(aws_hash_table_put(&reference, key, (void *)(uintptr_t)op, NULL));
+        } else {
+            int was_present = 0;
+            int was_present_reference = 0;
+            ASSERT_SUCCESS(aws_swiss_table_remove(&table, key, NULL, &was_present));
+            ASSERT_SUCCESS(aws_hash_table_remove(&reference, key, NULL, &was_present_reference));
+            ASSERT_INT_EQUALS(was_present_reference, was_present);
+        }
+        ASSERT_UINT_EQUALS(aws_hash_table_get_entry_count(&reference), aws_swiss_table_get_entry_count(&table));
+    }
+
+    for (uintptr_t key = 1; key <= KEY_SPACE; ++key) {
+        struct aws_hash_element *elem = NULL;
+        struct aws_hash_element *reference_elem = NULL;
+        ASSERT_SUCCESS(aws_swiss_table_find(&table, (void *)key, &elem));
+        ASSERT_SUCCESS(aws_hash_table_find(&reference, (void *)key, &reference_elem));
+        ASSERT_TRUE((elem == NULL) == (reference_elem == NULL));
+        if (elem) {
+            ASSERT_PTR_EQUALS(reference_elem->value, elem->value);
+        }
+    }
+
+    aws_hash_table_clean_up(&reference);
+    aws_swiss_table_clean_up(&table);
+    return 0;
+}
+
+AWS_TEST_CASE(swiss_table_string_keys, s_swiss_table_string_keys)
+static int s_swiss_table_string_keys(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_swiss_table table;
+    ASSERT_SUCCESS(aws_swiss_table_init(
+        &table, allocator, 4, aws_hash_string, aws_hash_callback_string_eq, aws_hash_callback_string_destroy, NULL));
+
+    char buf[32];
+    for (int idx = 0; idx < 1000; ++idx) {
+        snprintf(buf, sizeof(buf), "key-%d", idx);
+        struct aws_string *key = aws_string_new_from_c_str(allocator, buf);
+        ASSERT_NOT_NULL(key);
+        ASSERT_SUCCESS(aws_swiss_table_put(&table, key, (void *)(uintptr_t)idx, NULL));
+    }
+
+    /* look up with equal but distinct strings */
+    for (int idx = 0; idx < 1000; ++idx) {
+        snprintf(buf, sizeof(buf), "key-%d", idx);
+        struct aws_string *key = aws_string_new_from_c_str(allocator, buf);
+        struct aws_hash_element *elem = NULL;
+        ASSERT_SUCCESS(aws_swiss_table_find(&table, key, &elem));
+        ASSERT_NOT_NULL(elem);
+        ASSERT_PTR_EQUALS((void *)(uintptr_t)idx, elem->value);
+        aws_string_destroy(key);
+    }
+
+    /* the table's key strings are destroyed by the key destructor, or the test allocator would report a leak */
+    aws_swiss_table_clean_up(&table);
+    return 0;
+}
+
+AWS_TEST_CASE(swiss_table_init_too_large, s_swiss_table_init_too_large)
+static int s_swiss_table_init_too_large(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    /* the capacity fits in a size_t, but its slots and control bytes don't, so nothing should be allocated */
+    struct aws_swiss_table table;
+    ASSERT_ERROR(
+        AWS_ERROR_OOM, aws_swiss_table_init(&table, allocator, SIZE_MAX / 8, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    ASSERT_NULL(table.slots);
+    ASSERT_UINT_EQUALS(0, table.capacity);
+
+    aws_swiss_table_clean_up(&table);
+    return 0;
+}
+
+struct table_timings {
+    long put;
+    long find_hit;
+    long find_miss;
+};
+
+/* Each table is sized up front for exactly ENTRY_COUNT entries, so both run at their highest load factor */
+enum { BENCHMARK_ENTRY_COUNT = 114688 /* 7/8 of 2^17 */, BENCHMARK_ROUNDS = 10 };
+
+static int s_benchmark_hash_table(
+    struct aws_allocator *allocator,
+    aws_hash_fn *hash_fn,
+    aws_hash_callback_eq_fn *eq_fn,
+    const void **keys,
+    const void **missing_keys,
+    struct table_timings *timings) {
+    struct aws_hash_table table;
+    ASSERT_SUCCESS(aws_hash_table_init(&table, allocator, BENCHMARK_ENTRY_COUNT, hash_fn, eq_fn, NULL, NULL));
+
+    long start = benchmark_timestamp_us();
+    for (size_t idx = 0; idx < BENCHMARK_ENTRY_COUNT; ++idx) {
+        ASSERT_SUCCESS(aws_hash_table_put(&table, keys[idx], NULL, NULL));
+    }
+    timings->put += benchmark_timestamp_us() - start;
+
+    struct aws_hash_element *elem = NULL;
+    start = benchmark_timestamp_us();
+    for (size_t idx = 0; idx < BENCHMARK_ENTRY_COUNT; ++idx) {
+        aws_hash_table_find(&table, keys[idx], &elem);
+        ASSERT_NOT_NULL(elem);
+    }
+    timings->find_hit += benchmark_timestamp_us() - start;
+
+    start = benchmark_timestamp_us();
+    for (size_t idx = 0; idx < BENCHMARK_ENTRY_COUNT; ++idx) {
+        aws_hash_table_find(&table, missing_keys[idx], &elem);
+        ASSERT_NULL(elem);
+    }
+    timings->find_miss += benchmark_timestamp_us() - start;
+
+    aws_hash_table_clean_up(&table);
+    return 0;
+}
+
+static int s_benchmark_swiss_table(
+    struct aws_allocator *allocator,
+    aws_hash_fn *hash_fn,
+    aws_hash_callback_eq_fn *eq_fn,
+    const void **keys,
+    const void **missing_keys,
+    struct table_timings *timings) {
+    struct aws_swiss_table table;
+    ASSERT_SUCCESS(aws_swiss_table_init(&table, allocator, BENCHMARK_ENTRY_COUNT, hash_fn, eq_fn, NULL, NULL));
+
+    long start = benchmark_timestamp_us();
+    for (size_t idx = 0; idx < BENCHMARK_ENTRY_COUNT; ++idx) {
+        ASSERT_SUCCESS(aws_swiss_table_put(&table, keys[idx], NULL, NULL));
+    }
+    timings->put += benchmark_timestamp_us() - start;
+
+    struct aws_hash_element *elem = NULL;
+    start = benchmark_timestamp_us();
+    for (size_t idx = 0; idx < BENCHMARK_ENTRY_COUNT; ++idx) {
+        aws_swiss_table_find(&table, keys[idx], &elem);
+        ASSERT_NOT_NULL(elem);
+    }
+    timings->find_hit += benchmark_timestamp_us() - start;
+
+    start = benchmark_timestamp_us();
+    for (size_t idx = 0; idx < BENCHMARK_ENTRY_COUNT; ++idx) {
+        aws_swiss_table_find(&table, missing_keys[idx], &elem);
+        ASSERT_NULL(elem);
+    }
+    timings->find_miss += benchmark_timestamp_us() - start;
+
+    aws_swiss_table_clean_up(&table);
+    return 0;
+}
+
+static int s_benchmark_tables(
+    struct aws_allocator *allocator,
+    const char *label,
+    aws_hash_fn *hash_fn,
+    aws_hash_callback_eq_fn *eq_fn,
+    const void **keys,
+    const void **missing_keys) {
+    struct table_timings hash_table_timings = {0};
+    struct table_timings swiss_table_timings = {0};
+
+    for (int round = 0; round < BENCHMARK_ROUNDS; ++round) {
+        ASSERT_SUCCESS(s_benchmark_hash_table(allocator, hash_fn, eq_fn, keys, missing_keys, &hash_table_timings));
+        ASSERT_SUCCESS(s_benchmark_swiss_table(allocator, hash_fn, eq_fn, keys, missing_keys, &swiss_table_timings));
+    }
+
+    printf(
+        "%s keys, aws_hash_table: put elapsed=%ld us, find hit elapsed=%ld us, find miss elapsed=%ld us\n",
+        label,
+        hash_table_timings.put,
+        hash_table_timings.find_hit,
+        hash_table_timings.find_miss);
+    printf(
+        "%s keys, aws_swiss_table: put elapsed=%ld us, find hit elapsed=%ld us, find miss elapsed=%ld us\n",
+        label,
+        swiss_table_timings.put,
+        swiss_table_timings.find_hit,
+        swiss_table_timings.find_miss);
+    return 0;
+}
+
+AWS_TEST_CASE(swiss_table_benchmark, s_swiss_table_benchmark)
+static int s_swiss_table_benchmark(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+
+    const void **keys = aws_mem_calloc(allocator, 2 * BENCHMARK_ENTRY_COUNT, sizeof(void *));
+    ASSERT_NOT_NULL(keys);
+    const void **missing_keys = keys + BENCHMARK_ENTRY_COUNT;
+
+    /* pointer keys: distinct addresses, the way tables keyed on objects see them */
+    uint8_t *objects = aws_mem_acquire(allocator, 2 * BENCHMARK_ENTRY_COUNT * 16);
+    ASSERT_NOT_NULL(objects);
+    for (size_t idx = 0; idx < 2 * BENCHMARK_ENTRY_COUNT; ++idx) {
+        keys[idx] = objects + idx * 16;
+    }
+    ASSERT_SUCCESS(s_benchmark_tables(allocator, "pointer", aws_hash_ptr, aws_ptr_eq, keys, missing_keys));
+    aws_mem_release(allocator, objects);
+
+    /* string keys */
+    char buf[64];
+    for (size_t idx = 0; idx < 2 * BENCHMARK_ENTRY_COUNT; ++idx) {
+        snprintf(buf, sizeof(buf), "/some/resource/path/%zu", idx);
+        keys[idx] = aws_string_new_from_c_str(allocator, buf);
+        ASSERT_NOT_NULL(keys[idx]);
+    }
+    ASSERT_SUCCESS(
+        s_benchmark_tables(allocator, "string", aws_hash_string, aws_hash_callback_string_eq, keys, missing_keys));
+    for (size_t idx = 0; idx < 2 * BENCHMARK_ENTRY_COUNT; ++idx) {
+        aws_string_destroy((struct aws_string *)keys[idx]);
+    }
+
+    aws_mem_release(allocator, (void *)keys);
+    return 0;
+}
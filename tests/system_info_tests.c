@@ -107,3 +107,32 @@ static int s_test_stack_trace_decoding(struct aws_allocator *allocator, void *ct
 }
 
 AWS_TEST_CASE(test_stack_trace_decoding, s_test_stack_trace_decoding);
+
+static int s_test_cpu_groups_are_consistent(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    uint16_t group_count = aws_get_cpu_group_count();
+    ASSERT_TRUE(group_count >= 1);
+    ASSERT_TRUE(aws_get_current_cpu_group() < group_count);
+
+    size_t total_cpus = 0;
+    for (uint16_t group = 0; group < group_count; ++group) {
+        size_t cpu_count = aws_get_cpu_count_for_group(group);
+        total_cpus += cpu_count;
+
+        /* ask for one more than there is, to check that the spare entry is marked unused */
+        struct aws_cpu_info *cpus = aws_mem_calloc(allocator, cpu_count + 1, sizeof(struct aws_cpu_info));
+        ASSERT_NOT_NULL(cpus);
+        aws_get_cpu_ids_for_group(group, cpus, cpu_count + 1);
+        for (size_t idx = 0; idx < cpu_count; ++idx) {
+            ASSERT_TRUE(cpus[idx].cpu_id >= 0);
+        }
+        ASSERT_INT_EQUALS(-1, cpus[cpu_count].cpu_id);
+        aws_mem_release(allocator, cpus);
+    }
+
+    ASSERT_TRUE(total_cpus >= 1);
+    return 0;
+}
+
+AWS_TEST_CASE(test_cpu_groups_are_consistent, s_test_cpu_groups_are_consistent)
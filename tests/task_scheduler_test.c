@@ -17,6 +17,10 @@
 #include <aws/common/thread.h>
 #include <aws/testing/aws_test_harness.h>
 
+#include <stdio.h>
+
+#include "benchmark_test_utilities.h"
+
 struct executed_task_data {
     struct aws_task *task;
     void *arg;
@@ -556,6 +560,410 @@ static int s_test_scheduler_oom_during_init(struct aws_allocator *allocator, voi
     return 0;
 }
 
+/* The timer wheel runs tasks in the same order as the heap, whichever level of the wheel they wait on */
+static int s_test_scheduler_timer_wheel(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    s_executed_tasks_n = 0;
+
+    struct aws_task_scheduler scheduler;
+    struct aws_task_scheduler_options options = {
+        .timer_backend = (enum aws_task_scheduler_timer_backend)7,
+        .wheel_tick = 10,
+    };
+    ASSERT_ERROR(AWS_ERROR_INVALID_ARGUMENT, aws_task_scheduler_init_with_options(&scheduler, allocator, &options));
+    options.timer_backend = AWS_TASK_SCHEDULER_TIMER_WHEEL;
+    ASSERT_SUCCESS(aws_task_scheduler_init_with_options(&scheduler, allocator, &options));
+    /* the wheel only takes tasks once it has been started at a time */
+    aws_task_scheduler_run_all(&scheduler, 0);
+
+    /* due in the current tick, on levels 0, 1 and 3 of the wheel, beyond the wheel, and on level 1 again */
+    const uint64_t times[] = {5, 250, 255, 7000, 10000005, 10 * (1ULL << 36) + 1, 2000};
+    struct aws_task tasks[AWS_ARRAY_SIZE(times)];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(times); ++i) {
+        aws_task_init(&tasks[i], s_task_n_fn, (void *)i, "scheduler_timer_wheel");
+        aws_task_scheduler_schedule_future(&scheduler, &tasks[i], times[i]);
+    }
+    aws_task_scheduler_cancel_task(&scheduler, &tasks[6]);
+
+    uint64_t next_task_time = 0;
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(5, next_task_time);
+    aws_task_scheduler_run_all(&scheduler, 5);
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(250, next_task_time);
+    aws_task_scheduler_run_all(&scheduler, 254);
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(255, next_task_time);
+    aws_task_scheduler_run_all(&scheduler, 255);
+
+    /* 7000 is in the level 1 slot for ticks 640 to 703, so the wheel can only say the next task is at 6400 or later */
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(6400, next_task_time);
+    aws_task_scheduler_run_all(&scheduler, 6400);
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(7000, next_task_time);
+
+    /* 10000005 is in the tick reached, but not yet due */
+    aws_task_scheduler_run_all(&scheduler, 10000000);
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(10000005, next_task_time);
+    aws_task_scheduler_run_all(&scheduler, 10000005);
+    aws_task_scheduler_clean_up(&scheduler);
+
+    const size_t expected_order[] = {6, 0, 1, 2, 3, 4, 5};
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(expected_order), s_executed_tasks_n);
+    for (size_t i = 0; i < s_executed_tasks_n; ++i) {
+        ASSERT_PTR_EQUALS(&tasks[expected_order[i]], s_executed_tasks[i].task);
+        enum aws_task_status expected_status =
+            (i == 0 || i == s_executed_tasks_n - 1) ? AWS_TASK_STATUS_CANCELED : AWS_TASK_STATUS_RUN_READY;
+        ASSERT_INT_EQUALS(expected_status, s_executed_tasks[i].status);
+    }
+    return 0;
+}
+
+/* Tasks scheduled before the first run_all can't go on the wheel, which doesn't know the time yet */
+static int s_test_scheduler_timer_wheel_before_run(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    s_executed_tasks_n = 0;
+    const uint64_t second = 1000000000;
+    const uint64_t now = 1000 * second;
+
+    struct aws_task_scheduler scheduler;
+    struct aws_task_scheduler_options options = {.timer_backend = AWS_TASK_SCHEDULER_TIMER_WHEEL};
+    ASSERT_SUCCESS(aws_task_scheduler_init_with_options(&scheduler, allocator, &options));
+
+    struct aws_task tasks[2];
+    aws_task_init(&tasks[0], s_task_n_fn, (void *)0, "scheduler_timer_wheel_before_run");
+    aws_task_init(&tasks[1], s_task_n_fn, (void *)1, "scheduler_timer_wheel_before_run");
+    aws_task_scheduler_schedule_future(&scheduler, &tasks[0], now + 10 * second);
+
+    /* the time is exact, not the start of a wheel slot from before now */
+    uint64_t next_task_time = 0;
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(now + 10 * second, next_task_time);
+    aws_task_scheduler_run_all(&scheduler, now);
+    ASSERT_UINT_EQUALS(0, s_executed_tasks_n);
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_UINT_EQUALS(now + 10 * second, next_task_time);
+
+    /* once started, later tasks go on the wheel, which never reports a time before now */
+    aws_task_scheduler_schedule_future(&scheduler, &tasks[1], now + 5 * second);
+    ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+    ASSERT_TRUE(next_task_time >= now && next_task_time <= now + 5 * second);
+
+    aws_task_scheduler_run_all(&scheduler, now + 10 * second);
+    ASSERT_FALSE(aws_task_scheduler_has_tasks(&scheduler, NULL));
+    aws_task_scheduler_clean_up(&scheduler);
+
+    ASSERT_UINT_EQUALS(2, s_executed_tasks_n);
+    ASSERT_PTR_EQUALS(&tasks[1], s_executed_tasks[0].task);
+    ASSERT_PTR_EQUALS(&tasks[0], s_executed_tasks[1].task);
+    return 0;
+}
+
+static uint64_t s_scheduler_test_rng_next(uint64_t *rng) {
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 7;
+    *rng ^= *rng << 17;
+    return *rng;
+}
+
+/* Records which task ran, and whether it was cancelled, in the order they run */
+struct scheduler_test_log {
+    struct aws_task *tasks;
+    size_t *entries;
+    size_t count;
+};
+
+static void s_log_task_fn(struct aws_task *task, void *arg, enum aws_task_status status) {
+    struct scheduler_test_log *log = arg;
+    log->entries[log->count++] = (size_t)(task - log->tasks) * 2 + (status == AWS_TASK_STATUS_CANCELED);
+}
+
+/* Random schedules, cancellations and runs, spread over every level of the wheel, play out the same on both backends */
+static int s_test_scheduler_timer_wheel_random(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    enum { TASK_COUNT = 4000, PER_ROUND = 20 };
+    const uint64_t spans[] = {100, 10000, 10000000, 1000000000000ULL};
+
+    struct aws_task_scheduler schedulers[2];
+    struct scheduler_test_log logs[2];
+    ASSERT_SUCCESS(aws_task_scheduler_init(&schedulers[0], allocator));
+    struct aws_task_scheduler_options options = {
+        .timer_backend = AWS_TASK_SCHEDULER_TIMER_WHEEL,
+        .wheel_tick = 64,
+    };
+    ASSERT_SUCCESS(aws_task_scheduler_init_with_options(&schedulers[1], allocator, &options));
+    for (size_t b = 0; b < 2; ++b) {
+        logs[b].tasks = aws_mem_calloc(allocator, TASK_COUNT, sizeof(struct aws_task));
+        logs[b].entries = aws_mem_calloc(allocator, TASK_COUNT, sizeof(size_t));
+        logs[b].count = 0;
+        ASSERT_NOT_NULL(logs[b].tasks);
+        ASSERT_NOT_NULL(logs[b].entries);
+    }
+    bool *pending = aws_mem_calloc(allocator, TASK_COUNT, sizeof(bool));
+    ASSERT_NOT_NULL(pending);
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    uint64_t now = 0;
+    size_t scheduled = 0;
+    while (scheduled < TASK_COUNT) {
+        for (size_t i = 0; i < PER_ROUND && scheduled < TASK_COUNT; ++i, ++scheduled) {
+            /* unique times, so that both backends must agree on the order */
+            uint64_t time = now + s_scheduler_test_rng_next(&rng) % spans[s_scheduler_test_rng_next(&rng) % 4];
+            time = time - time % TASK_COUNT + scheduled;
+            if (s_scheduler_test_rng_next(&rng) % 100 == 0) {
+                time = UINT64_MAX - scheduled;
+            }
+            for (size_t b = 0; b < 2; ++b) {
+                aws_task_init(&logs[b].tasks[scheduled], s_log_task_fn, &logs[b], "scheduler_timer_wheel_random");
+                aws_task_scheduler_schedule_future(&schedulers[b], &logs[b].tasks[scheduled], time);
+            }
+            pending[scheduled] = true;
+        }
+
+        for (size_t i = 0; i < PER_ROUND / 2; ++i) {
+            size_t victim = (size_t)(s_scheduler_test_rng_next(&rng) % scheduled);
+            if (pending[victim]) {
+                for (size_t b = 0; b < 2; ++b) {
+                    aws_task_scheduler_cancel_task(&schedulers[b], &logs[b].tasks[victim]);
+                }
+                pending[victim] = false;
+            }
+        }
+
+        now += s_scheduler_test_rng_next(&rng) % spans[s_scheduler_test_rng_next(&rng) % 3];
+        size_t logged = logs[0].count;
+        for (size_t b = 0; b < 2; ++b) {
+            aws_task_scheduler_run_all(&schedulers[b], now);
+        }
+        ASSERT_UINT_EQUALS(logs[0].count, logs[1].count);
+        for (size_t i = logged; i < logs[0].count; ++i) {
+            ASSERT_UINT_EQUALS(logs[0].entries[i], logs[1].entries[i]);
+            pending[logs[0].entries[i] / 2] = false;
+        }
+
+        uint64_t heap_next = 0;
+        uint64_t wheel_next = 0;
+        bool heap_has_tasks = aws_task_scheduler_has_tasks(&schedulers[0], &heap_next);
+        ASSERT_INT_EQUALS(heap_has_tasks, aws_task_scheduler_has_tasks(&schedulers[1], &wheel_next));
+        ASSERT_TRUE(wheel_next <= heap_next);
+        ASSERT_TRUE(!heap_has_tasks || wheel_next > now);
+    }
+
+    for (size_t b = 0; b < 2; ++b) {
+        aws_task_scheduler_clean_up(&schedulers[b]);
+    }
+    ASSERT_UINT_EQUALS(TASK_COUNT, logs[0].count);
+    ASSERT_UINT_EQUALS(TASK_COUNT, logs[1].count);
+    ASSERT_INT_EQUALS(0, memcmp(logs[0].entries, logs[1].entries, TASK_COUNT * sizeof(size_t)));
+
+    for (size_t b = 0; b < 2; ++b) {
+        aws_mem_release(allocator, logs[b].tasks);
+        aws_mem_release(allocator, logs[b].entries);
+    }
+    aws_mem_release(allocator, pending);
+    return 0;
+}
+
+static void s_benchmark_fired_fn(struct aws_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    if (status == AWS_TASK_STATUS_RUN_READY) {
+        ++*(size_t *)arg;
+    }
+}
+
+/*
+ * Timeouts as an event loop sees them: each millisecond, a batch of 10s timeouts is scheduled, and nearly all of them
+ * are cancelled a few milliseconds later, when their operation completes.
+ */
+static int s_test_scheduler_timer_wheel_benchmark(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+    enum { STEPS = 20000, PER_STEP = 10, CANCEL_AFTER = 5 };
+    const uint64_t millisecond = 1000000;
+
+    struct aws_task *tasks = aws_mem_calloc(allocator, STEPS * PER_STEP, sizeof(struct aws_task));
+    ASSERT_NOT_NULL(tasks);
+
+    size_t fired[2] = {0, 0};
+    for (int wheel = 0; wheel < 2; ++wheel) {
+        struct aws_task_scheduler scheduler;
+        struct aws_task_scheduler_options options = {
+            .timer_backend = wheel ? AWS_TASK_SCHEDULER_TIMER_WHEEL : AWS_TASK_SCHEDULER_TIMER_HEAP,
+        };
+        ASSERT_SUCCESS(aws_task_scheduler_init_with_options(&scheduler, allocator, &options));
+
+        uint64_t rng = 0x9E3779B97F4A7C15ULL;
+        uint64_t now = 1000 * millisecond;
+        aws_task_scheduler_run_all(&scheduler, now);
+
+        long start = benchmark_timestamp_us();
+        for (size_t step = 0; step < STEPS; ++step) {
+            now += millisecond;
+            for (size_t i = step * PER_STEP; i < (step + 1) * PER_STEP; ++i) {
+                aws_task_init(&tasks[i], s_benchmark_fired_fn, &fired[wheel], "scheduler_timer_wheel_benchmark");
+                uint64_t timeout = 10000 * millisecond + s_scheduler_test_rng_next(&rng) % millisecond;
+                aws_task_scheduler_schedule_future(&scheduler, &tasks[i], now + timeout);
+            }
+            if (step >= CANCEL_AFTER) {
+                for (size_t i = (step - CANCEL_AFTER) * PER_STEP; i < (step - CANCEL_AFTER + 1) * PER_STEP; ++i) {
+                    if (i % 20) {
+                        aws_task_scheduler_cancel_task(&scheduler, &tasks[i]);
+                    }
+                }
+            }
+            aws_task_scheduler_run_all(&scheduler, now);
+        }
+        long elapsed = benchmark_timestamp_us() - start;
+        aws_task_scheduler_clean_up(&scheduler);
+
+        printf(
+            "%s: %d timeouts, %zu fired, elapsed=%ld us\n",
+            wheel ? "timer wheel" : "heap",
+            STEPS * PER_STEP,
+            fired[wheel],
+            elapsed);
+    }
+    ASSERT_UINT_EQUALS(fired[0], fired[1]);
+
+    aws_mem_release(allocator, tasks);
+    return 0;
+}
+
+/* Rescheduling moves a task wherever it waits, without running it, and schedules it afresh once it has run */
+static int s_test_scheduler_reschedule_future(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    for (int wheel = 0; wheel < 2; ++wheel) {
+        s_executed_tasks_n = 0;
+
+        struct aws_task_scheduler scheduler;
+        struct aws_task_scheduler_options options = {
+            .timer_backend = wheel ? AWS_TASK_SCHEDULER_TIMER_WHEEL : AWS_TASK_SCHEDULER_TIMER_HEAP,
+            .wheel_tick = 10,
+        };
+        ASSERT_SUCCESS(aws_task_scheduler_init_with_options(&scheduler, allocator, &options));
+
+        /* in the heap either way, on the wheel if there is one, scheduled now, already run, cancelled, and never
+         * scheduled at all */
+        struct aws_task in_heap;
+        struct aws_task on_wheel;
+        struct aws_task now;
+        struct aws_task ran;
+        struct aws_task cancelled;
+        struct aws_task unscheduled;
+        aws_task_init(&in_heap, s_task_n_fn, NULL, "scheduler_reschedule_future_heap");
+        aws_task_init(&on_wheel, s_task_n_fn, NULL, "scheduler_reschedule_future_wheel");
+        aws_task_init(&now, s_task_n_fn, NULL, "scheduler_reschedule_future_now");
+        aws_task_init(&ran, s_task_n_fn, NULL, "scheduler_reschedule_future_ran");
+        aws_task_init(&cancelled, s_task_n_fn, NULL, "scheduler_reschedule_future_cancelled");
+        aws_task_init(&unscheduled, s_task_n_fn, NULL, "scheduler_reschedule_future_unscheduled");
+
+        aws_task_scheduler_schedule_future(&scheduler, &ran, 1);
+        aws_task_scheduler_run_all(&scheduler, 1);
+        aws_task_scheduler_schedule_future(&scheduler, &cancelled, 2);
+        aws_task_scheduler_cancel_task(&scheduler, &cancelled);
+        ASSERT_UINT_EQUALS(2, s_executed_tasks_n);
+
+        aws_task_scheduler_schedule_future(&scheduler, &in_heap, 5);
+        aws_task_scheduler_schedule_future(&scheduler, &on_wheel, 100);
+        aws_task_scheduler_schedule_now(&scheduler, &now);
+
+        aws_task_scheduler_reschedule_future(&scheduler, &in_heap, 300);
+        aws_task_scheduler_reschedule_future(&scheduler, &on_wheel, 50);
+        aws_task_scheduler_reschedule_future(&scheduler, &now, 200);
+        aws_task_scheduler_reschedule_future(&scheduler, &ran, 400);
+        aws_task_scheduler_reschedule_future(&scheduler, &cancelled, 150);
+        aws_task_scheduler_reschedule_future(&scheduler, &unscheduled, 250);
+        ASSERT_UINT_EQUALS(2, s_executed_tasks_n);
+
+        uint64_t next_task_time = 0;
+        ASSERT_TRUE(aws_task_scheduler_has_tasks(&scheduler, &next_task_time));
+        ASSERT_UINT_EQUALS(50, next_task_time);
+
+        aws_task_scheduler_run_all(&scheduler, 1000);
+        ASSERT_FALSE(aws_task_scheduler_has_tasks(&scheduler, NULL));
+
+        struct aws_task *expected_order[] = {
+            &ran, &cancelled, &on_wheel, &cancelled, &now, &unscheduled, &in_heap, &ran};
+        ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(expected_order), s_executed_tasks_n);
+        for (size_t i = 0; i < s_executed_tasks_n; ++i) {
+            ASSERT_PTR_EQUALS(expected_order[i], s_executed_tasks[i].task);
+            enum aws_task_status expected_status = i == 1 ? AWS_TASK_STATUS_CANCELED : AWS_TASK_STATUS_RUN_READY;
+            ASSERT_INT_EQUALS(expected_status, s_executed_tasks[i].status);
+        }
+
+        aws_task_scheduler_clean_up(&scheduler);
+    }
+    return 0;
+}
+
+/*
+ * Keep-alive timers, each pushed back every time there is traffic on its connection: by cancelling and scheduling
+ * again, or by rescheduling in place.
+ */
+static int s_test_scheduler_reschedule_benchmark(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    (void)allocator;
+    allocator = aws_default_allocator();
+    enum { TIMER_COUNT = 10000, ROUNDS = 100 };
+    const uint64_t millisecond = 1000000;
+
+    struct aws_task *tasks = aws_mem_calloc(allocator, TIMER_COUNT, sizeof(struct aws_task));
+    ASSERT_NOT_NULL(tasks);
+
+    for (int wheel = 0; wheel < 2; ++wheel) {
+        for (int reschedule = 0; reschedule < 2; ++reschedule) {
+            struct aws_task_scheduler scheduler;
+            struct aws_task_scheduler_options options = {
+                .timer_backend = wheel ? AWS_TASK_SCHEDULER_TIMER_WHEEL : AWS_TASK_SCHEDULER_TIMER_HEAP,
+            };
+            ASSERT_SUCCESS(aws_task_scheduler_init_with_options(&scheduler, allocator, &options));
+
+            uint64_t rng = 0x9E3779B97F4A7C15ULL;
+            uint64_t now = 1000 * millisecond;
+            aws_task_scheduler_run_all(&scheduler, now);
+
+            size_t fired = 0;
+            for (size_t i = 0; i < TIMER_COUNT; ++i) {
+                aws_task_init(&tasks[i], s_benchmark_fired_fn, &fired, "scheduler_reschedule_benchmark");
+                aws_task_scheduler_schedule_future(
+                    &scheduler, &tasks[i], now + 30000 * millisecond + s_scheduler_test_rng_next(&rng) % millisecond);
+            }
+
+            long start = benchmark_timestamp_us();
+            for (size_t round = 0; round < ROUNDS; ++round) {
+                now += millisecond;
+                for (size_t i = 0; i < TIMER_COUNT; ++i) {
+                    uint64_t time = now + 30000 * millisecond + s_scheduler_test_rng_next(&rng) % millisecond;
+                    if (reschedule) {
+                        aws_task_scheduler_reschedule_future(&scheduler, &tasks[i], time);
+                    } else {
+                        aws_task_scheduler_cancel_task(&scheduler, &tasks[i]);
+                        aws_task_scheduler_schedule_future(&scheduler, &tasks[i], time);
+                    }
+                }
+                aws_task_scheduler_run_all(&scheduler, now);
+            }
+            long elapsed = benchmark_timestamp_us() - start;
+            ASSERT_UINT_EQUALS(0, fired);
+            aws_task_scheduler_clean_up(&scheduler);
+
+            printf(
+                "%s, %s: %d resets, elapsed=%ld us\n",
+                wheel ? "timer wheel" : "heap",
+                reschedule ? "reschedule" : "cancel and schedule",
+                TIMER_COUNT * ROUNDS,
+                elapsed);
+        }
+    }
+
+    aws_mem_release(allocator, tasks);
+    return 0;
+}
+
 AWS_TEST_CASE(scheduler_pops_task_late_test, s_test_scheduler_pops_task_fashionably_late);
 AWS_TEST_CASE(scheduler_ordering_test, s_test_scheduler_ordering);
 AWS_TEST_CASE(scheduler_has_tasks_test, s_test_scheduler_has_tasks);
@@ -566,3 +974,9 @@ AWS_TEST_CASE(scheduler_oom_still_works, s_test_scheduler_oom_still_works);
 AWS_TEST_CASE(scheduler_schedule_cancellation, s_test_scheduler_schedule_cancellation);
 AWS_TEST_CASE(scheduler_cleanup_idempotent, s_test_scheduler_cleanup_idempotent);
 AWS_TEST_CASE(scheduler_oom_during_init, s_test_scheduler_oom_during_init);
+AWS_TEST_CASE(scheduler_timer_wheel, s_test_scheduler_timer_wheel);
+AWS_TEST_CASE(scheduler_timer_wheel_before_run, s_test_scheduler_timer_wheel_before_run);
+AWS_TEST_CASE(scheduler_timer_wheel_random, s_test_scheduler_timer_wheel_random);
+AWS_TEST_CASE(scheduler_timer_wheel_benchmark, s_test_scheduler_timer_wheel_benchmark);
+AWS_TEST_CASE(scheduler_reschedule_future, s_test_scheduler_reschedule_future);
+AWS_TEST_CASE(scheduler_reschedule_benchmark, s_test_scheduler_reschedule_benchmark);
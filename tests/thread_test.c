@@ -89,3 +89,33 @@ static int s_test_thread_atexit(struct aws_allocator *allocator, void *ctx) {
 }
 
 AWS_TEST_CASE(thread_atexit_test, s_test_thread_atexit)
+
+struct bind_test_data {
+    int result;
+    int error;
+};
+
+static void s_thread_worker_bind(void *arg) {
+    struct bind_test_data *data = arg;
+    data->result = aws_thread_current_bind_to_cpu_group(0);
+    data->error = data->result ? aws_last_error() : 0;
+}
+
+static int s_test_thread_bind_to_cpu_group(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct bind_test_data data = {.result = AWS_OP_ERR};
+
+    struct aws_thread thread;
+    ASSERT_SUCCESS(aws_thread_init(&thread, allocator));
+    ASSERT_SUCCESS(aws_thread_launch(&thread, s_thread_worker_bind, &data, 0));
+    ASSERT_SUCCESS(aws_thread_join(&thread));
+    aws_thread_clean_up(&thread);
+
+    /* group 0 always exists, so binding to it can only be refused by a platform that doesn't support it */
+    if (data.result != AWS_OP_SUCCESS) {
+        ASSERT_INT_EQUALS(AWS_ERROR_UNSUPPORTED_OPERATION, data.error);
+    }
+    return 0;
+}
+
+AWS_TEST_CASE(thread_bind_to_cpu_group_test, s_test_thread_bind_to_cpu_group)